@@ -0,0 +1,6 @@
+TEMPLATE = subdirs
+SUBDIRS += objload \
+    weld \
+    meshmath \
+    rgbe \
+    tonemap
@@ -0,0 +1,49 @@
+#ifndef BENCHMARK_H
+#define BENCHMARK_H
+
+/*
+      benchmark.h
+
+      Timing and file listing shared by the benchmarks in bench/.  Each
+      benchmark is a console program run from the root of the tree, so
+      that models/ and textures/ are found where the application finds
+      them.
+*/
+
+#include <algorithm>
+#include <string>
+#include <vector>
+#include <dirent.h>
+#include <string.h>
+#include <time.h>
+
+/* benchNow: a monotonic clock in milliseconds */
+inline double benchNow()
+{
+    timespec t;
+    clock_gettime(CLOCK_MONOTONIC, &t);
+    return t.tv_sec * 1e3 + t.tv_nsec / 1e6;
+}
+
+/* benchListFiles: the files of a directory ending in suffix, sorted by
+ * name, with the directory prepended.
+ */
+inline std::vector<std::string> benchListFiles(const char* directory, const char* suffix)
+{
+    std::vector<std::string> files;
+    DIR* dir = opendir(directory);
+    if (!dir)
+        return files;
+    size_t suffixlength = strlen(suffix);
+    while (dirent* entry = readdir(dir))
+    {
+        size_t length = strlen(entry->d_name);
+        if (length > suffixlength && !strcmp(entry->d_name + length - suffixlength, suffix))
+            files.push_back(std::string(directory) + "/" + entry->d_name);
+    }
+    closedir(dir);
+    std::sort(files.begin(), files.end());
+    return files;
+}
+
+#endif // BENCHMARK_H
@@ -0,0 +1,240 @@
+/*
+      meshmath
+
+      Micro-benchmark of the meshmath routines behind glmDimensions,
+      glmUnitize, glmScale and glmFacetNormals.  Every operation runs on
+      each model in models/ three ways: the loops glm had before meshmath
+      (kept here as the reference), the scalar path and the AVX2 path.
+      Both paths must give the reference's results exactly; a zero bound
+      may only differ in its sign.
+
+      usage: meshmath [directory]
+*/
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <GL/gl.h>
+#include "glm.h"
+#include "meshmath.h"
+#include "benchmark.h"
+
+#define T(x) (model->triangles[(x)])
+
+enum Operation { Dimensions, Unitize, Scale, FacetNormals, NUM_OPERATIONS };
+static const char* OPERATION_NAMES[NUM_OPERATIONS] = { "dimensions", "unitize", "scale", "facetnorms" };
+
+/* Paths an operation runs through */
+enum Path { Reference, Scalar, SIMD, NUM_PATHS };
+
+static GLfloat absolute(GLfloat f)
+{
+    return f < 0 ? -f : f;
+}
+
+/* referenceBounds: the bounding box loop glmUnitize and glmDimensions
+ * both had
+ */
+static void referenceBounds(GLMmodel* model, GLfloat* min, GLfloat* max)
+{
+    GLfloat maxx, minx, maxy, miny, maxz, minz;
+    maxx = minx = model->vertices[3 + 0];
+    maxy = miny = model->vertices[3 + 1];
+    maxz = minz = model->vertices[3 + 2];
+    for (GLuint i = 1; i <= model->numvertices; i++)
+    {
+        if (maxx < model->vertices[3 * i + 0])
+            maxx = model->vertices[3 * i + 0];
+        if (minx > model->vertices[3 * i + 0])
+            minx = model->vertices[3 * i + 0];
+        if (maxy < model->vertices[3 * i + 1])
+            maxy = model->vertices[3 * i + 1];
+        if (miny > model->vertices[3 * i + 1])
+            miny = model->vertices[3 * i + 1];
+        if (maxz < model->vertices[3 * i + 2])
+            maxz = model->vertices[3 * i + 2];
+        if (minz > model->vertices[3 * i + 2])
+            minz = model->vertices[3 * i + 2];
+    }
+    min[0] = minx;
+    min[1] = miny;
+    min[2] = minz;
+    max[0] = maxx;
+    max[1] = maxy;
+    max[2] = maxz;
+}
+
+static void referenceDimensions(GLMmodel* model, GLfloat* dimensions)
+{
+    GLfloat min[3], max[3];
+    referenceBounds(model, min, max);
+    for (int c = 0; c < 3; c++)
+        dimensions[c] = absolute(max[c]) + absolute(min[c]);
+}
+
+static GLfloat referenceUnitize(GLMmodel* model)
+{
+    GLfloat min[3], max[3], center[3], size[3];
+    referenceBounds(model, min, max);
+    for (int c = 0; c < 3; c++)
+    {
+        size[c] = absolute(max[c]) + absolute(min[c]);
+        center[c] = (max[c] + min[c]) / 2.0;
+    }
+    GLfloat largest = size[0] > size[1] ? size[0] : size[1];
+    GLfloat scale = 2.0 / (largest > size[2] ? largest : size[2]);
+    for (GLuint i = 1; i <= model->numvertices; i++)
+    {
+        model->vertices[3 * i + 0] -= center[0];
+        model->vertices[3 * i + 1] -= center[1];
+        model->vertices[3 * i + 2] -= center[2];
+        model->vertices[3 * i + 0] *= scale;
+        model->vertices[3 * i + 1] *= scale;
+        model->vertices[3 * i + 2] *= scale;
+    }
+    return scale;
+}
+
+static void referenceScale(GLMmodel* model, GLfloat scale)
+{
+    for (GLuint i = 1; i <= model->numvertices; i++)
+    {
+        model->vertices[3 * i + 0] *= scale;
+        model->vertices[3 * i + 1] *= scale;
+        model->vertices[3 * i + 2] *= scale;
+    }
+}
+
+static void referenceFacetNormals(GLMmodel* model)
+{
+    GLfloat u[3], v[3];
+    for (GLuint i = 0; i < model->numtriangles; i++)
+    {
+        T(i).findex = i + 1;
+        for (int c = 0; c < 3; c++)
+        {
+            u[c] = model->vertices[3 * T(i).vindices[1] + c] - model->vertices[3 * T(i).vindices[0] + c];
+            v[c] = model->vertices[3 * T(i).vindices[2] + c] - model->vertices[3 * T(i).vindices[0] + c];
+        }
+        GLfloat* n = &model->facetnorms[3 * (i + 1)];
+        n[0] = u[1] * v[2] - u[2] * v[1];
+        n[1] = u[2] * v[0] - u[0] * v[2];
+        n[2] = u[0] * v[1] - u[1] * v[0];
+        GLfloat length = (GLfloat)sqrt(n[0] * n[0] + n[1] * n[1] + n[2] * n[2]);
+        n[0] /= length;
+        n[1] /= length;
+        n[2] /= length;
+    }
+}
+
+/* run: one operation through one path.  Dimensions and the unitize
+ * scale factor are returned in values.
+ */
+static void run(GLMmodel* model, Operation operation, Path path, GLfloat* values)
+{
+    switch (operation)
+    {
+    case Dimensions:
+        if (path == Reference)
+            referenceDimensions(model, values);
+        else
+            glmDimensions(model, values);
+        break;
+    case Unitize:
+        values[0] = path == Reference ? referenceUnitize(model) : glmUnitize(model);
+        break;
+    case Scale:
+        if (path == Reference)
+            referenceScale(model, 1.37f);
+        else
+            glmScale(model, 1.37f);
+        break;
+    default:
+        if (path == Reference)
+            referenceFacetNormals(model);
+        else
+            glmFacetNormals(model);
+        break;
+    }
+}
+
+/* results: what an operation produced: the dimensions, the vertices
+ * and scale factor, the vertices, or the facet normals
+ */
+static std::vector<GLfloat> results(GLMmodel* model, Operation operation, const GLfloat* values)
+{
+    std::vector<GLfloat> result;
+    if (operation == Dimensions)
+        result.assign(values, values + 3);
+    else if (operation == FacetNormals)
+        result.assign(model->facetnorms + 3, model->facetnorms + 3 * (model->numtriangles + 1));
+    else
+        result.assign(model->vertices + 3, model->vertices + 3 * (model->numvertices + 1));
+    if (operation == Unitize)
+        result.push_back(values[0]);
+    return result;
+}
+
+int main(int argc, char** argv)
+{
+    const char* directory = argc > 1 ? argv[1] : "models";
+    std::vector<std::string> files = benchListFiles(directory, ".obj");
+    bool simd = meshmathSetSIMD(1);
+    bool ok = true;
+
+    printf("best times in ms, reference / scalar / %s\n", simd ? "AVX2" : "AVX2 (unsupported, scalar again)");
+    printf("%-20s %7s %7s", "model", "verts", "tris");
+    for (int op = 0; op < NUM_OPERATIONS; op++)
+        printf("  %-21s", OPERATION_NAMES[op]);
+    printf("\n");
+    for (size_t f = 0; f < files.size(); f++)
+    {
+        GLMmodel* model = glmReadOBJ(files[f].c_str());
+        glmFacetNormals(model);
+        std::vector<GLfloat> vertices(model->vertices, model->vertices + 3 * (model->numvertices + 1));
+        int runs = model->numvertices < 100000 ? 200 : 20;
+        printf("%-20s %7u %7u", strrchr(files[f].c_str(), '/') + 1, model->numvertices, model->numtriangles);
+        for (int op = 0; op < NUM_OPERATIONS; op++)
+        {
+            std::vector<GLfloat> reference;
+            double best[NUM_PATHS];
+            bool same = true;
+            for (int path = 0; path < NUM_PATHS; path++)
+            {
+                if (path != Reference)
+                    meshmathSetSIMD(path == SIMD);
+                best[path] = 1e30;
+                for (int i = 0; i < runs; i++)
+                {
+                    memcpy(model->vertices, &vertices[0], sizeof(GLfloat) * vertices.size());
+                    GLfloat values[3];
+                    double start = benchNow();
+                    run(model, (Operation)op, (Path)path, values);
+                    double elapsed = benchNow() - start;
+                    if (elapsed < best[path])
+                        best[path] = elapsed;
+                    if (i)
+                        continue;
+                    std::vector<GLfloat> result = results(model, (Operation)op, values);
+                    if (path == Reference)
+                        reference = result;
+                    else
+                    {
+                        /* == lets the sign of a zero differ */
+                        same = same && result.size() == reference.size();
+                        for (size_t k = 0; k < result.size() && same; k++)
+                            same = result[k] == reference[k];
+                    }
+                }
+            }
+            printf("  %5.3f/%5.3f/%5.3f%s", best[Reference], best[Scalar], best[SIMD], same ? "  " : " !");
+            ok = ok && same;
+        }
+        printf("\n");
+        glmDelete(model);
+    }
+    if (!ok)
+        printf("! marks results that differ from the reference\n");
+    return ok ? 0 : 1;
+}
@@ -0,0 +1,171 @@
+/*
+      objload
+
+      Load-time benchmark of the OBJ readers over every file in models/:
+      the original two-pass fscanf reader, glmReadOBJ (one pass over the
+      mapped file) and glmReadOBJParallel (the same split over threads).
+      Every model is also checked to come out of all three identical.
+
+      usage: objload [directory] [runs]
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <GL/gl.h>
+#include "glm.h"
+#include "benchmark.h"
+#include "twopass.h"
+
+typedef GLMmodel* (*Reader)(const char* filename);
+
+static GLMmodel* readSinglePass(const char* filename)
+{
+    return glmReadOBJ(filename);
+}
+
+static GLMmodel* readParallel(const char* filename)
+{
+    return glmReadOBJParallel(filename, 0);
+}
+
+/* bestOf: the fastest of a number of loads, in ms.  The model of the
+ * last one is returned in *model.
+ */
+static double bestOf(Reader reader, const char* filename, int runs, GLMmodel** model)
+{
+    double best = 1e30;
+    *model = NULL;
+    for (int i = 0; i < runs; i++)
+    {
+        if (*model)
+            glmDelete(*model);
+        double start = benchNow();
+        *model = reader(filename);
+        double elapsed = benchNow() - start;
+        if (elapsed < best)
+            best = elapsed;
+    }
+    return best;
+}
+
+static bool sameArray(const GLfloat* a, const GLfloat* b, GLuint count, int size)
+{
+    /* element 0 is unused */
+    return !count || !memcmp(a + size, b + size, sizeof(GLfloat) * size * count);
+}
+
+static bool sameIndices(const GLuint* a, const GLuint* b)
+{
+    return a[0] == b[0] && a[1] == b[1] && a[2] == b[2];
+}
+
+/* sameModel: do two readers agree on the geometry of a model?  The two
+ * pass reader leaves the indices of missing attributes uninitialized,
+ * so those are skipped.
+ */
+static bool sameModel(const GLMmodel* a, const GLMmodel* b)
+{
+    if (a->numvertices != b->numvertices || a->numnormals != b->numnormals ||
+        a->numtexcoords != b->numtexcoords || a->numtriangles != b->numtriangles ||
+        a->numgroups != b->numgroups)
+        return false;
+    if (!sameArray(a->vertices, b->vertices, a->numvertices, 3) ||
+        !sameArray(a->normals, b->normals, a->numnormals, 3) ||
+        !sameArray(a->texcoords, b->texcoords, a->numtexcoords, 2))
+        return false;
+    for (GLuint i = 0; i < a->numtriangles; i++)
+    {
+        const GLMtriangle& s = a->triangles[i];
+        const GLMtriangle& t = b->triangles[i];
+        if (!sameIndices(s.vindices, t.vindices) ||
+            (a->numnormals && !sameIndices(s.nindices, t.nindices)) ||
+            (a->numtexcoords && !sameIndices(s.tindices, t.tindices)))
+            return false;
+    }
+    const GLMgroup* g = a->groups;
+    const GLMgroup* h = b->groups;
+    for (; g && h; g = g->next, h = h->next)
+    {
+        if (strcmp(g->name, h->name) || g->numtriangles != h->numtriangles ||
+            (g->numtriangles && memcmp(g->triangles, h->triangles, sizeof(GLuint) * g->numtriangles)))
+            return false;
+    }
+    return !g && !h;
+}
+
+/* checkEmpty: an empty file reads as a model with nothing in it */
+static bool checkEmpty()
+{
+    char filename[] = "/tmp/objloadXXXXXX";
+    int fd = mkstemp(filename);
+    if (fd < 0)
+        return false;
+    close(fd);
+    GLMmodel* model = glmReadOBJ(filename);
+    bool empty = model && !model->numvertices && !model->numtriangles;
+    glmDelete(model);
+    unlink(filename);
+    return empty;
+}
+
+/* checkHugeIndex: a face index too large for an int ends the face
+ * there, as anything else that isn't an index does
+ */
+static bool checkHugeIndex()
+{
+    char filename[] = "/tmp/objloadXXXXXX";
+    int fd = mkstemp(filename);
+    if (fd < 0)
+        return false;
+    const char text[] = "v 0 0 0\nv 1 0 0\nv 0 1 0\nv 1 1 0\n"
+        "f 1 2 3 99999999999999999999\nf 1 2 3 -2147483648\nf 2 4 3\n";
+    bool written = write(fd, text, sizeof(text) - 1) == (ssize_t)sizeof(text) - 1;
+    close(fd);
+    GLMmodel* model = written ? glmReadOBJ(filename) : NULL;
+    bool ended = model && model->numtriangles == 3 && model->triangles[2].vindices[1] == 4;
+    glmDelete(model);
+    unlink(filename);
+    return ended;
+}
+
+int main(int argc, char** argv)
+{
+    const char* directory = argc > 1 ? argv[1] : "models";
+    int runs = argc > 2 ? atoi(argv[2]) : 5;
+    std::vector<std::string> files = benchListFiles(directory, ".obj");
+    if (files.empty())
+    {
+        fprintf(stderr, "objload: no .obj files in \"%s\"\n", directory);
+        return 1;
+    }
+
+    bool ok = checkEmpty();
+    if (!ok)
+        printf("an empty file doesn't read as an empty model\n");
+    if (!checkHugeIndex())
+    {
+        printf("an index too large for an int doesn't end its face\n");
+        ok = false;
+    }
+
+    printf("best of %d loads, ms\n", runs);
+    printf("%-24s %10s %10s %10s %8s\n", "model", "two-pass", "single", "parallel", "speedup");
+    for (size_t i = 0; i < files.size(); i++)
+    {
+        const char* filename = files[i].c_str();
+        GLMmodel *reference, *single, *parallel;
+        double twopassms = bestOf(glmReadOBJTwoPass, filename, runs, &reference);
+        double singlems = bestOf(readSinglePass, filename, runs, &single);
+        double parallelms = bestOf(readParallel, filename, runs, &parallel);
+        bool same = sameModel(reference, single) && sameModel(reference, parallel);
+        printf("%-24s %10.2f %10.2f %10.2f %7.1fx%s\n", strrchr(filename, '/') + 1,
+               twopassms, singlems, parallelms, twopassms / singlems, same ? "" : "  MISMATCH");
+        ok = ok && same;
+        glmDelete(reference);
+        glmDelete(single);
+        glmDelete(parallel);
+    }
+    return ok ? 0 : 1;
+}
@@ -0,0 +1,24 @@
+TARGET = objload
+TEMPLATE = app
+CONFIG += console
+CONFIG -= qt \
+    app_bundle
+INCLUDEPATH += .. \
+    ../../lib
+DEPENDPATH += .. \
+    ../../lib
+LIBS += -lGLU \
+    -lGL \
+    -lpthread
+HEADERS += ../benchmark.h \
+    twopass.h \
+    ../../lib/glm.h \
+    ../../lib/targa.h \
+    ../../lib/parallel.h \
+    ../../lib/meshmath.h
+SOURCES += main.cpp \
+    twopass.cpp \
+    ../../lib/glm.cpp \
+    ../../lib/targa.cpp \
+    ../../lib/parallel.cpp \
+    ../../lib/meshmath.cpp
@@ -0,0 +1,388 @@
+/*
+      twopass.cpp
+
+      The OBJ reader glm used before it parsed a mapped file in a single
+      pass: a first fscanf pass counts everything, a second one reads it
+      into arrays of exactly the right size.  Kept here, unchanged apart
+      from skipping material libraries, as the baseline of the load-time
+      benchmark and the reference its output is checked against.
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <GL/gl.h>
+#include "glm.h"
+#include "twopass.h"
+
+/* defined in glm.cpp but not declared in glm.h */
+GLMgroup* glmAddGroup(GLMmodel* model, char* name);
+GLuint glmFindMaterial(GLMmodel* model, char* name);
+
+#define T(x) (model->triangles[(x)])
+
+/* glmFirstPass: first pass at a Wavefront OBJ file that gets all the
+ * statistics of the model (such as #vertices, #normals, etc)
+ *
+ * model - properly initialized GLMmodel structure
+ * file  - (fopen'd) file descriptor 
+ */
+static GLvoid glmFirstPass(GLMmodel* model, FILE* file) {
+    GLuint  numvertices;        /* number of vertices in model */
+    GLuint  numnormals;         /* number of normals in model */
+    GLuint  numtexcoords;       /* number of texcoords in model */
+    GLuint  numtriangles;       /* number of triangles in model */
+    GLMgroup* group;            /* current group */
+    unsigned    v, n, t;
+    char        buf[128];
+    /* make a default group */
+    group = glmAddGroup(model, (char*)"default");
+    numvertices = numnormals = numtexcoords = numtriangles = 0;
+    while(fscanf(file, "%s", buf) != EOF) {
+        switch(buf[0]) {
+        case '#':               /* comment */
+            /* eat up rest of line */
+            fgets(buf, sizeof(buf), file);
+            break;
+        case 'v':               /* v, vn, vt */
+            switch(buf[1]) {
+            case '\0':          /* vertex */
+                /* eat up rest of line */
+                fgets(buf, sizeof(buf), file);
+                numvertices++;
+                break;
+            case 'n':           /* normal */
+                /* eat up rest of line */
+                fgets(buf, sizeof(buf), file);
+                numnormals++;
+                break;
+            case 't':           /* texcoord */
+                /* eat up rest of line */
+                fgets(buf, sizeof(buf), file);
+                numtexcoords++;
+                break;
+            default:
+                printf("glmFirstPass(): Unknown token \"%s\".\n", buf);
+                exit(1);
+                break;
+            }
+            break;
+            case 'm': //mtllib
+                /* the material library itself is left unread: only the
+                   geometry is compared and timed */
+                fgets(buf, sizeof(buf), file);
+                sscanf(buf, "%s %s", buf, buf);
+                model->mtllibname = strdup(buf);
+                break;
+            case 'u': //usemtl
+                /* eat up rest of line */
+                fgets(buf, sizeof(buf), file);
+                break;
+            case 'g':               /* group */
+                /* eat up rest of line */
+                fgets(buf, sizeof(buf), file);
+#if SINGLE_STRING_GROUP_NAMES
+                sscanf(buf, "%s", buf);
+#else
+                buf[strlen(buf)-1] = '\0';  /* nuke '\n' */
+#endif
+                group = glmAddGroup(model, buf);
+                break;
+            case 'f':               /* face */
+                v = n = t = 0;
+                fscanf(file, "%s", buf);
+                /* can be one of %d, %d//%d, %d/%d, %d/%d/%d %d//%d */
+                if (strstr(buf, "//")) {
+                    /* v//n */
+                    sscanf(buf, "%d//%d", &v, &n);
+                    fscanf(file, "%d//%d", &v, &n);
+                    fscanf(file, "%d//%d", &v, &n);
+                    numtriangles++;
+                    group->numtriangles++;
+                    while(fscanf(file, "%d//%d", &v, &n) > 0) {
+                        numtriangles++;
+                        group->numtriangles++;
+                    }
+                } else if (sscanf(buf, "%d/%d/%d", &v, &t, &n) == 3) {
+                    /* v/t/n */
+                    fscanf(file, "%d/%d/%d", &v, &t, &n);
+                    fscanf(file, "%d/%d/%d", &v, &t, &n);
+                    numtriangles++;
+                    group->numtriangles++;
+                    while(fscanf(file, "%d/%d/%d", &v, &t, &n) > 0) {
+                        numtriangles++;
+                        group->numtriangles++;
+                    }
+                } else if (sscanf(buf, "%d/%d", &v, &t) == 2) {
+                    /* v/t */
+                    fscanf(file, "%d/%d", &v, &t);
+                    fscanf(file, "%d/%d", &v, &t);
+                    numtriangles++;
+                    group->numtriangles++;
+                    while(fscanf(file, "%d/%d", &v, &t) > 0) {
+                        numtriangles++;
+                        group->numtriangles++;
+                    }
+                } else {
+                    /* v */
+                    fscanf(file, "%d", &v);
+                    fscanf(file, "%d", &v);
+                    numtriangles++;
+                    group->numtriangles++;
+                    while(fscanf(file, "%d", &v) > 0) {
+                        numtriangles++;
+                        group->numtriangles++;
+                    }
+                }
+                break;
+                
+            default:
+                /* eat up rest of line */
+                fgets(buf, sizeof(buf), file);
+                break;
+            }
+
+    }
+
+    /* set the stats in the model structure */
+    model->numvertices  = numvertices;
+    model->numnormals   = numnormals;
+    model->numtexcoords = numtexcoords;
+    model->numtriangles = numtriangles;
+
+    /* allocate memory for the triangles in each group */
+    group = model->groups;
+    while(group) {
+        group->triangles = (GLuint*)malloc(sizeof(GLuint) * group->numtriangles);
+        group->numtriangles = 0;
+        group = group->next;
+    }
+}
+
+/* glmSecondPass: second pass at a Wavefront OBJ file that gets all
+ * the data.
+ *
+ * model - properly initialized GLMmodel structure
+ * file  - (fopen'd) file descriptor 
+ */
+static GLvoid glmSecondPass(GLMmodel* model, FILE* file) {
+    GLuint  numvertices;        /* number of vertices in model */
+    GLuint  numnormals;         /* number of normals in model */
+    GLuint  numtexcoords;       /* number of texcoords in model */
+    GLuint  numtriangles;       /* number of triangles in model */
+    GLfloat*    vertices;           /* array of vertices  */
+    GLfloat*    normals;            /* array of normals */
+    GLfloat*    texcoords;          /* array of texture coordinates */
+    GLMgroup* group;            /* current group pointer */
+    GLuint  material;           /* current material */
+    GLuint  v, n, t;
+    char        buf[128];
+    /* set the pointer shortcuts */
+    vertices       = model->vertices;
+    normals    = model->normals;
+    texcoords    = model->texcoords;
+    group      = model->groups;
+    /* on the second pass through the file, read all the data into the
+    allocated arrays */
+    numvertices = numnormals = numtexcoords = 1;
+    numtriangles = 0;
+    material = 0;
+    while(fscanf(file, "%s", buf) != EOF) {
+        switch(buf[0]) {
+        case '#':               /* comment */
+            /* eat up rest of line */
+            fgets(buf, sizeof(buf), file);
+            break;
+        case 'v':               /* v, vn, vt */
+            switch(buf[1]) {
+            case '\0':          /* vertex */
+                fscanf(file, "%f %f %f",
+                       &vertices[3 * numvertices + 0],
+                       &vertices[3 * numvertices + 1],
+                       &vertices[3 * numvertices + 2]);
+                numvertices++;
+                /*  if (numvertices%200==0)
+                        if (call)
+                        {
+                                sprintf(afis,"%s (%s )... ",call->text, group->name);
+                                int procent = ((float)((float)numvertices*70/model->numvertices+30)/100)*(call->end-call->start)+call->start;
+                                call->loadcallback(procent,afis); // Modelul e 70% din incarcare
+                        }*/
+                break;
+            case 'n':           /* normal */
+                fscanf(file, "%f %f %f",
+                       &normals[3 * numnormals + 0],
+                       &normals[3 * numnormals + 1],
+                       &normals[3 * numnormals + 2]);
+                numnormals++;
+                break;
+            case 't':           /* texcoord */
+                fscanf(file, "%f %f", 
+                       &texcoords[2 * numtexcoords + 0],
+                       &texcoords[2 * numtexcoords + 1]);
+                numtexcoords++;
+                break;
+            }
+            break;
+            case 'u':
+            fgets(buf, sizeof(buf), file);
+            sscanf(buf, "%s %s", buf, buf);
+            group->material = material = glmFindMaterial(model, buf);
+            break;
+            case 'g':               /* group */
+                /* eat up rest of line */
+                fgets(buf, sizeof(buf), file);
+#if SINGLE_STRING_GROUP_NAMES
+                sscanf(buf, "%s", buf);
+#else
+                buf[strlen(buf)-1] = '\0';  /* nuke '\n' */
+#endif
+                group = glmFindGroup(model, buf);
+                group->material = material;
+                break;
+case 'f':				/* face */
+    v = n = t = 0;
+    fscanf(file, "%s", buf);
+    /* can be one of %d, %d//%d, %d/%d, %d/%d/%d %d//%d */
+    if (strstr(buf, "//")) {
+        /* v//n */
+        sscanf(buf, "%d//%d", &v, &n);
+        T(numtriangles).vindices[0] = v;
+        T(numtriangles).nindices[0] = n;
+        fscanf(file, "%d//%d", &v, &n);
+        T(numtriangles).vindices[1] = v;
+        T(numtriangles).nindices[1] = n;
+        fscanf(file, "%d//%d", &v, &n);
+        T(numtriangles).vindices[2] = v;
+        T(numtriangles).nindices[2] = n;
+        group->triangles[group->numtriangles++] = numtriangles;
+        numtriangles++;
+        while(fscanf(file, "%d//%d", &v, &n) > 0) {
+            T(numtriangles).vindices[0] = T(numtriangles-1).vindices[0];
+            T(numtriangles).nindices[0] = T(numtriangles-1).nindices[0];
+            T(numtriangles).vindices[1] = T(numtriangles-1).vindices[2];
+            T(numtriangles).nindices[1] = T(numtriangles-1).nindices[2];
+            T(numtriangles).vindices[2] = v;
+            T(numtriangles).nindices[2] = n;
+            group->triangles[group->numtriangles++] = numtriangles;
+            numtriangles++;
+        }
+    } else if (sscanf(buf, "%d/%d/%d", &v, &t, &n) == 3) {
+        /* v/t/n */
+        T(numtriangles).vindices[0] = v;
+        T(numtriangles).tindices[0] = t;
+        T(numtriangles).nindices[0] = n;
+        fscanf(file, "%d/%d/%d", &v, &t, &n);
+        T(numtriangles).vindices[1] = v;
+        T(numtriangles).tindices[1] = t;
+        T(numtriangles).nindices[1] = n;
+        fscanf(file, "%d/%d/%d", &v, &t, &n);
+        T(numtriangles).vindices[2] = v;
+        T(numtriangles).tindices[2] = t;
+        T(numtriangles).nindices[2] = n;
+        group->triangles[group->numtriangles++] = numtriangles;
+        numtriangles++;
+        while(fscanf(file, "%d/%d/%d", &v, &t, &n) > 0) {
+            T(numtriangles).vindices[0] = T(numtriangles-1).vindices[0];
+            T(numtriangles).tindices[0] = T(numtriangles-1).tindices[0];
+            T(numtriangles).nindices[0] = T(numtriangles-1).nindices[0];
+            T(numtriangles).vindices[1] = T(numtriangles-1).vindices[2];
+            T(numtriangles).tindices[1] = T(numtriangles-1).tindices[2];
+            T(numtriangles).nindices[1] = T(numtriangles-1).nindices[2];
+            T(numtriangles).vindices[2] = v;
+            T(numtriangles).tindices[2] = t;
+            T(numtriangles).nindices[2] = n;
+            group->triangles[group->numtriangles++] = numtriangles;
+            numtriangles++;
+        }
+    } else if (sscanf(buf, "%d/%d", &v, &t) == 2) {
+        /* v/t */
+        T(numtriangles).vindices[0] = v;
+        T(numtriangles).tindices[0] = t;
+        fscanf(file, "%d/%d", &v, &t);
+        T(numtriangles).vindices[1] = v;
+        T(numtriangles).tindices[1] = t;
+        fscanf(file, "%d/%d", &v, &t);
+        T(numtriangles).vindices[2] = v;
+        T(numtriangles).tindices[2] = t;
+        group->triangles[group->numtriangles++] = numtriangles;
+        numtriangles++;
+        while(fscanf(file, "%d/%d", &v, &t) > 0) {
+            T(numtriangles).vindices[0] = T(numtriangles-1).vindices[0];
+            T(numtriangles).tindices[0] = T(numtriangles-1).tindices[0];
+            T(numtriangles).vindices[1] = T(numtriangles-1).vindices[2];
+            T(numtriangles).tindices[1] = T(numtriangles-1).tindices[2];
+            T(numtriangles).vindices[2] = v;
+            T(numtriangles).tindices[2] = t;
+            group->triangles[group->numtriangles++] = numtriangles;
+            numtriangles++;
+        }
+    } else {
+        /* v */
+        sscanf(buf, "%d", &v);
+        T(numtriangles).vindices[0] = v;
+        fscanf(file, "%d", &v);
+        T(numtriangles).vindices[1] = v;
+        fscanf(file, "%d", &v);
+        T(numtriangles).vindices[2] = v;
+        group->triangles[group->numtriangles++] = numtriangles;
+        numtriangles++;
+        while(fscanf(file, "%d", &v) > 0) {
+            T(numtriangles).vindices[0] = T(numtriangles-1).vindices[0];
+            T(numtriangles).vindices[1] = T(numtriangles-1).vindices[2];
+            T(numtriangles).vindices[2] = v;
+            group->triangles[group->numtriangles++] = numtriangles;
+            numtriangles++;
+        }
+    }
+    break;
+            default:
+    /* eat up rest of line */
+    fgets(buf, sizeof(buf), file);
+    break;
+}
+    }
+}
+
+/* glmReadOBJTwoPass: Reads a model description from a Wavefront .OBJ
+ * file the way glmReadOBJ did before the single-pass parser.  Free the
+ * model with glmDelete().
+ *
+ * filename - name of the file containing the Wavefront .OBJ format data.
+ */
+GLMmodel* glmReadOBJTwoPass(const char* filename){
+    GLMmodel* model;
+    FILE*   file;
+    /* open the file */
+    file = fopen(filename, "r");
+    if (!file) {
+        fprintf(stderr, "glmReadOBJTwoPass() failed: can't open data file \"%s\".\n",
+                filename);
+        exit(1);
+    }
+    /* allocate a new model */
+    model = (GLMmodel*)calloc(1, sizeof(GLMmodel));
+    model->pathname    = strdup(filename);
+    /* make a first pass through the file to get a count of the number
+    of vertices, normals, texcoords & triangles */
+    glmFirstPass(model, file);
+    /* allocate memory */
+    model->vertices = (GLfloat*)malloc(sizeof(GLfloat) *
+                                       3 * (model->numvertices + 1));
+    model->triangles = (GLMtriangle*)malloc(sizeof(GLMtriangle) *
+                                            model->numtriangles);
+    if (model->numnormals) {
+        model->normals = (GLfloat*)malloc(sizeof(GLfloat) *
+                                          3 * (model->numnormals + 1));
+    }
+    if (model->numtexcoords) {
+        model->texcoords = (GLfloat*)malloc(sizeof(GLfloat) *
+                                            2 * (model->numtexcoords + 1));
+    }
+    /* rewind to beginning of file and read in the data this pass */
+    rewind(file);
+    glmSecondPass(model, file);
+    /* close the file */
+    fclose(file);
+    return model;
+}
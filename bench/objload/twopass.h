@@ -0,0 +1,13 @@
+#ifndef TWOPASS_H
+#define TWOPASS_H
+
+#include "glm.h"
+
+/* glmReadOBJTwoPass: Reads a model description from a Wavefront .OBJ
+ * file with the original two-pass fscanf reader.
+ *
+ * filename - name of the file containing the Wavefront .OBJ format data.
+ */
+GLMmodel* glmReadOBJTwoPass(const char* filename);
+
+#endif // TWOPASS_H
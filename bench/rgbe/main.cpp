@@ -0,0 +1,191 @@
+/*
+      rgbe
+
+      Load-time benchmark of the .hdr readers over every file in
+      textures/: RGBE_ReadHeader and RGBE_ReadPixels_RLE from
+      rgbe/rgbe.cpp, then rgbeOpen with the scanlines decoded on one
+      thread (scalar and AVX2) and with rgbeDecode over the pool.  A
+      larger probe is made by tiling the last file 3 by 3 and written
+      with RGBE_WritePixels_RLE.  Every reader must give exactly the
+      floats RGBE_ReadPixels_RLE gives.
+
+      RGBE_ReadHeader prints the header to std::cout, which is muted
+      while it runs, and only reads the layout the HDR Shop files in
+      textures/ have, so the probe is given that layout too.
+
+      usage: rgbe [directory] [runs]
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <iostream>
+#include "rgbe.h"
+#include "rgbeimage.h"
+#include "benchmark.h"
+
+/* number of times the probe repeats the last file across and down */
+static const int TILES = 3;
+
+enum Reader { Original, Scalar, SIMD, Parallel, NUM_READERS };
+static const char* READER_NAMES[NUM_READERS] = { "original", "scalar", "AVX2", "parallel" };
+
+/* readOriginal: the file through rgbe.cpp.  Returns NULL if it can't
+ * be read.
+ */
+static float* readOriginal(const char* filename, int* width, int* height)
+{
+    FILE* file = fopen(filename, "rb");
+    if (!file)
+        return NULL;
+    float* pixels = NULL;
+    std::cout.setstate(std::ios::failbit);
+    if (RGBE_ReadHeader(file, width, height, NULL) == RGBE_RETURN_SUCCESS)
+    {
+        pixels = (float*)malloc(sizeof(float) * 3 * *width * *height);
+        if (RGBE_ReadPixels_RLE(file, pixels, *width, *height) != RGBE_RETURN_SUCCESS)
+        {
+            free(pixels);
+            pixels = NULL;
+        }
+    }
+    std::cout.clear();
+    fclose(file);
+    return pixels;
+}
+
+/* readImage: the file through rgbeimage.h, into pixels.  Returns
+ * whether it could be read.
+ */
+static bool readImage(const char* filename, Reader reader, float* pixels)
+{
+    RGBEimage* image = rgbeOpen(filename);
+    if (!image)
+        return false;
+    int ok;
+    if (reader == Parallel)
+        ok = rgbeDecode(image, pixels);
+    else
+        ok = rgbeDecodeScanlines(image, 0, image->height, pixels);
+    rgbeClose(image);
+    return ok;
+}
+
+/* writeProbe: the pixels repeated TILES times each way, as a new .hdr
+ * file.  Returns whether it could be written.
+ */
+static bool writeProbe(const char* filename, const float* pixels, int width, int height)
+{
+    FILE* file = fopen(filename, "wb");
+    if (!file)
+        return false;
+    int probewidth = width * TILES;
+    float* scanline = (float*)malloc(sizeof(float) * 3 * probewidth);
+    bool ok = fprintf(file, "#?RADIANCE\nFORMAT=32-bit_rle_rgbe\nEXPOSURE=1\n\n-Y %d +X %d\n",
+                      height * TILES, probewidth) > 0;
+    for (int y = 0; y < height * TILES && ok; y++)
+    {
+        for (int x = 0; x < TILES; x++)
+            memcpy(scanline + 3 * width * x, pixels + 3 * width * (y % height), sizeof(float) * 3 * width);
+        ok = RGBE_WritePixels_RLE(file, scanline, probewidth, 1) == RGBE_RETURN_SUCCESS;
+    }
+    free(scanline);
+    return !fclose(file) && ok;
+}
+
+/* benchmark: times every reader on a file and prints a line.  Returns
+ * whether they all agreed with the original.
+ */
+static bool benchmark(const char* filename, const char* name, int runs)
+{
+    int width, height;
+    double best[NUM_READERS];
+    best[Original] = 1e30;
+    float* reference = NULL;
+    for (int i = 0; i < runs; i++)
+    {
+        free(reference);
+        double start = benchNow();
+        reference = readOriginal(filename, &width, &height);
+        double elapsed = benchNow() - start;
+        if (elapsed < best[Original])
+            best[Original] = elapsed;
+    }
+    if (!reference)
+    {
+        printf("%-24s can't be read\n", name);
+        return false;
+    }
+
+    size_t size = sizeof(float) * 3 * width * height;
+    float* pixels = (float*)malloc(size);
+    bool same = true;
+    for (int reader = Scalar; reader < NUM_READERS; reader++)
+    {
+        rgbeSetSIMD(reader != Scalar);
+        best[reader] = 1e30;
+        for (int i = 0; i < runs; i++)
+        {
+            memset(pixels, 0, size);
+            double start = benchNow();
+            bool ok = readImage(filename, (Reader)reader, pixels);
+            double elapsed = benchNow() - start;
+            if (elapsed < best[reader])
+                best[reader] = elapsed;
+            same = same && ok && !memcmp(pixels, reference, size);
+        }
+    }
+    printf("%-24s %5dx%-5d", name, width, height);
+    for (int reader = 0; reader < NUM_READERS; reader++)
+        printf(" %9.2f", best[reader]);
+    printf(" %7.1fx%s\n", best[Original] / best[Parallel], same ? "" : "  MISMATCH");
+    free(pixels);
+    free(reference);
+    return same;
+}
+
+int main(int argc, char** argv)
+{
+    const char* directory = argc > 1 ? argv[1] : "textures";
+    int runs = argc > 2 ? atoi(argv[2]) : 5;
+    std::vector<std::string> files = benchListFiles(directory, ".hdr");
+    if (files.empty())
+    {
+        fprintf(stderr, "rgbe: no .hdr files in \"%s\"\n", directory);
+        return 1;
+    }
+
+    bool simd = rgbeSetSIMD(1);
+    printf("best of %d loads, ms%s\n", runs, simd ? "" : " (no AVX2, scalar again)");
+    printf("%-24s %-11s", "image", "size");
+    for (int reader = 0; reader < NUM_READERS; reader++)
+        printf(" %9s", READER_NAMES[reader]);
+    printf(" %8s\n", "speedup");
+    bool ok = true;
+    for (size_t i = 0; i < files.size(); i++)
+        ok = benchmark(files[i].c_str(), strrchr(files[i].c_str(), '/') + 1, runs) && ok;
+
+    int width, height;
+    float* pixels = readOriginal(files.back().c_str(), &width, &height);
+    char probe[] = "/tmp/rgbeXXXXXX";
+    int fd = mkstemp(probe);
+    if (fd < 0 || !pixels || !writeProbe(probe, pixels, width, height))
+    {
+        printf("the probe can't be written\n");
+        ok = false;
+    }
+    else
+    {
+        char name[32];
+        sprintf(name, "probe (%dx%d tiles)", TILES, TILES);
+        ok = benchmark(probe, name, runs) && ok;
+    }
+    if (fd >= 0)
+    {
+        close(fd);
+        unlink(probe);
+    }
+    free(pixels);
+    return ok ? 0 : 1;
+}
@@ -0,0 +1,20 @@
+TARGET = rgbe
+TEMPLATE = app
+CONFIG += console
+CONFIG -= qt \
+    app_bundle
+INCLUDEPATH += .. \
+    ../../lib \
+    ../../rgbe
+DEPENDPATH += .. \
+    ../../lib \
+    ../../rgbe
+LIBS += -lpthread
+HEADERS += ../benchmark.h \
+    ../../lib/rgbeimage.h \
+    ../../lib/parallel.h \
+    ../../rgbe/rgbe.h
+SOURCES += main.cpp \
+    ../../lib/rgbeimage.cpp \
+    ../../lib/parallel.cpp \
+    ../../rgbe/rgbe.cpp
@@ -0,0 +1,422 @@
+/*
+      tonemap
+
+      Checks and times the CPU tone mapping of tonemap.h over every file
+      in textures/.  Each kernel runs on the image cropped to an odd size,
+      so that rows end in the scalar tail, once scalar and once with AVX2:
+      the two must give exactly the same floats.
+
+      Then the shaders the renderer tone maps with (tonemap.frag,
+      bilat_down.frag, bilat.frag and combine.frag) are run on the first
+      image in an OpenGL context made without a display through EGL, and
+      each must agree with its kernel to well within one step of the
+      8-bit output: colors to 0.1% and log10 luminances to 0.0002.  The
+      GPU's exp, log and pow are not exact, so no closer.  That part is
+      skipped when no such context can be made.
+
+      usage: tonemap [directory] [runs]
+*/
+
+#define GL_GLEXT_PROTOTYPES
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <EGL/egl.h>
+#include <EGL/eglext.h>
+#include <GL/gl.h>
+#include <GL/glext.h>
+#include "rgbeimage.h"
+#include "tonemap.h"
+#include "benchmark.h"
+
+/* the settings Renderer tone maps with */
+static const float EXPOSURE = 0.5f;
+static const int RADIUS = 8;
+static const float RANGE_SIGMA = 0.4f;
+static const float COMPRESSION = 0.5f;
+
+/* how closely the shaders must agree with the kernels */
+static const float COLOR_TOLERANCE = 1e-3f;
+static const float LOG_TOLERANCE = 2e-4f;
+
+/* what the image is cropped by for the CPU checks */
+static const int CROP_X = 5, CROP_Y = 3;
+
+enum Kernel { LogAverage, Reinhard, ReinhardKey, LogLuminance, Bilateral, Combine, DurandDorsey, NUM_KERNELS };
+static const char* KERNEL_NAMES[NUM_KERNELS] =
+    { "logaverage", "reinhard", "key", "logluminance", "bilateral", "combine", "durand" };
+
+/* Image: float RGB, with the base layer of its log luminance */
+struct Image
+{
+    int width, height;
+    std::vector<float> rgb;
+    float logAverage, maxLuminance;
+    std::vector<float> loglum, base;
+};
+
+/* readImage: decodes a .hdr file, cropped by cropx and cropy.  Returns
+ * whether it could be read.
+ */
+static bool readImage(const char* filename, int cropx, int cropy, Image* image)
+{
+    RGBEimage* file = rgbeOpen(filename);
+    if (!file)
+        return false;
+    std::vector<float> rgb(3 * file->width * file->height);
+    bool ok = rgbeDecode(file, &rgb[0]) && file->width > cropx && file->height > cropy;
+    image->width = file->width - cropx;
+    image->height = file->height - cropy;
+    if (ok)
+    {
+        image->rgb.resize(3 * image->width * image->height);
+        for (int y = 0; y < image->height; y++)
+            memcpy(&image->rgb[3 * image->width * y], &rgb[3 * file->width * y], sizeof(float) * 3 * image->width);
+    }
+    rgbeClose(file);
+    return ok;
+}
+
+/* prepare: what the later stages of the bilateral operator start from */
+static void prepare(Image* image)
+{
+    int basewidth = tonemapBaseSize(image->width), baseheight = tonemapBaseSize(image->height);
+    image->loglum.resize(basewidth * baseheight);
+    image->base.resize(basewidth * baseheight);
+    tonemapLogAverage(&image->rgb[0], image->width, image->height, &image->logAverage, &image->maxLuminance);
+    tonemapLogLuminance(&image->rgb[0], image->width, image->height, &image->loglum[0]);
+    tonemapBilateral(&image->loglum[0], basewidth, baseheight, RADIUS, RANGE_SIGMA, &image->base[0]);
+}
+
+/* run: one kernel on an image, into out */
+static void run(const Image& image, Kernel kernel, std::vector<float>& out)
+{
+    int width = image.width, height = image.height;
+    int basewidth = tonemapBaseSize(width), baseheight = tonemapBaseSize(height);
+    const float* rgb = &image.rgb[0];
+    switch (kernel)
+    {
+    case LogAverage:
+        out.resize(2);
+        tonemapLogAverage(rgb, width, height, &out[0], &out[1]);
+        break;
+    case Reinhard:
+        out.resize(3 * width * height);
+        tonemapReinhard(rgb, width, height, EXPOSURE, &out[0]);
+        break;
+    case ReinhardKey:
+        out.resize(3 * width * height);
+        tonemapReinhardKey(rgb, width, height, EXPOSURE, image.logAverage, image.maxLuminance, &out[0]);
+        break;
+    case LogLuminance:
+        out.resize(basewidth * baseheight);
+        tonemapLogLuminance(rgb, width, height, &out[0]);
+        break;
+    case Bilateral:
+        out.resize(basewidth * baseheight);
+        tonemapBilateral(&image.loglum[0], basewidth, baseheight, RADIUS, RANGE_SIGMA, &out[0]);
+        break;
+    case Combine:
+        out.resize(3 * width * height);
+        tonemapCombine(rgb, width, height, &image.base[0], RANGE_SIGMA, COMPRESSION, EXPOSURE, &out[0]);
+        break;
+    default:
+        out.resize(3 * width * height);
+        tonemapDurandDorsey(rgb, width, height, RADIUS, RANGE_SIGMA, COMPRESSION, EXPOSURE, &out[0]);
+        break;
+    }
+}
+
+/* checkKernels: times every kernel both ways on a file and prints a
+ * line.  Returns whether the two agreed.
+ */
+static bool checkKernels(const char* filename, int runs)
+{
+    const char* name = strrchr(filename, '/') + 1;
+    Image image;
+    if (!readImage(filename, CROP_X, CROP_Y, &image))
+    {
+        printf("%-20s can't be read\n", name);
+        return false;
+    }
+    prepare(&image);
+    printf("%-20s %4dx%-4d", name, image.width, image.height);
+    bool ok = true;
+    for (int kernel = 0; kernel < NUM_KERNELS; kernel++)
+    {
+        std::vector<float> out[2];
+        double best[2];
+        for (int simd = 0; simd < 2; simd++)
+        {
+            tonemapSetSIMD(simd);
+            best[simd] = 1e30;
+            for (int i = 0; i < runs; i++)
+            {
+                double start = benchNow();
+                run(image, (Kernel)kernel, out[simd]);
+                double elapsed = benchNow() - start;
+                if (elapsed < best[simd])
+                    best[simd] = elapsed;
+            }
+        }
+        bool same = out[0].size() == out[1].size() &&
+            !memcmp(&out[0][0], &out[1][0], sizeof(float) * out[0].size());
+        printf("  %6.2f/%-6.2f%s", best[0], best[1], same ? " " : "!");
+        ok = ok && same;
+    }
+    printf("\n");
+    return ok;
+}
+
+/* makeContext: makes an OpenGL context current without a display, with
+ * no default framebuffer.  Returns whether it could.
+ */
+static bool makeContext()
+{
+    PFNEGLGETPLATFORMDISPLAYEXTPROC getPlatformDisplay =
+        (PFNEGLGETPLATFORMDISPLAYEXTPROC)eglGetProcAddress("eglGetPlatformDisplayEXT");
+    EGLDisplay display = getPlatformDisplay ?
+        getPlatformDisplay(EGL_PLATFORM_SURFACELESS_MESA, EGL_DEFAULT_DISPLAY, NULL) : eglGetDisplay(EGL_DEFAULT_DISPLAY);
+    EGLint major, minor;
+    if (display == EGL_NO_DISPLAY || !eglInitialize(display, &major, &minor) || !eglBindAPI(EGL_OPENGL_API))
+        return false;
+    EGLContext context = eglCreateContext(display, EGL_NO_CONFIG_KHR, EGL_NO_CONTEXT, NULL);
+    return context != EGL_NO_CONTEXT && eglMakeCurrent(display, EGL_NO_SURFACE, EGL_NO_SURFACE, context);
+}
+
+/* loadShader: a program of one fragment shader from shaders/, 0 (after
+ * printing why) if it doesn't build
+ */
+static GLuint loadShader(const char* name)
+{
+    std::string path = std::string("shaders/") + name;
+    FILE* file = fopen(path.c_str(), "rb");
+    if (!file)
+    {
+        printf("%s can't be read\n", path.c_str());
+        return 0;
+    }
+    std::string source;
+    char buffer[4096];
+    size_t count;
+    while ((count = fread(buffer, 1, sizeof(buffer), file)) > 0)
+        source.append(buffer, count);
+    fclose(file);
+
+    const char* text = source.c_str();
+    GLuint shader = glCreateShader(GL_FRAGMENT_SHADER);
+    glShaderSource(shader, 1, &text, NULL);
+    glCompileShader(shader);
+    GLuint program = glCreateProgram();
+    glAttachShader(program, shader);
+    glLinkProgram(program);
+    glDeleteShader(shader);
+    GLint linked;
+    glGetProgramiv(program, GL_LINK_STATUS, &linked);
+    if (!linked)
+    {
+        glGetProgramInfoLog(program, sizeof(buffer), NULL, buffer);
+        printf("%s doesn't build: %s\n", path.c_str(), buffer);
+        glDeleteProgram(program);
+        return 0;
+    }
+    glUseProgram(program);
+    return program;
+}
+
+/* newTexture: a float texture, clamped and linearly filtered as the
+ * render graph's targets are
+ */
+static GLuint newTexture(int width, int height, GLenum format, const float* pixels)
+{
+    GLuint texture;
+    glGenTextures(1, &texture);
+    glBindTexture(GL_TEXTURE_2D, texture);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA32F, width, height, 0, format, GL_FLOAT, pixels);
+    return texture;
+}
+
+/* draw: runs the bound program over a target, reading the textures of
+ * the units that are bound, and returns the first channels of every
+ * pixel of it
+ */
+static std::vector<float> draw(GLuint target, int width, int height, int channels)
+{
+    glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, target, 0);
+    glViewport(0, 0, width, height);
+    glBegin(GL_QUADS);
+    glTexCoord2f(0, 0);
+    glVertex2f(-1, -1);
+    glTexCoord2f(1, 0);
+    glVertex2f(1, -1);
+    glTexCoord2f(1, 1);
+    glVertex2f(1, 1);
+    glTexCoord2f(0, 1);
+    glVertex2f(-1, 1);
+    glEnd();
+
+    std::vector<float> rgba(4 * width * height), pixels(channels * width * height);
+    glReadPixels(0, 0, width, height, GL_RGBA, GL_FLOAT, &rgba[0]);
+    for (int i = 0; i < width * height; i++)
+        for (int c = 0; c < channels; c++)
+            pixels[channels * i + c] = rgba[4 * i + c];
+    return pixels;
+}
+
+/* compare: prints and checks the largest difference between a shader's
+ * output and its kernel's, relative to the kernel's value (but at least
+ * floor) when relative is set
+ */
+static bool compare(const char* name, const std::vector<float>& gpu, const std::vector<float>& cpu,
+                    bool relative, float floor, float tolerance)
+{
+    double largest = 0;
+    for (size_t i = 0; i < cpu.size(); i++)
+    {
+        double difference = fabs((double)gpu[i] - cpu[i]);
+        if (relative)
+            difference /= fabs(cpu[i]) > floor ? fabs(cpu[i]) : floor;
+        if (difference > largest)
+            largest = difference;
+    }
+    bool ok = largest <= tolerance;
+    printf("  %-16s %-9s %9.2e (at most %.0e)%s\n", name, relative ? "relative" : "absolute",
+           largest, tolerance, ok ? "" : "  MISMATCH");
+    return ok;
+}
+
+/* checkShaders: runs the tone mapping shaders on a file and compares
+ * them with the kernels.  Returns whether they all agreed.
+ */
+static bool checkShaders(const char* filename)
+{
+    Image image;
+    if (!readImage(filename, 0, 0, &image))
+        return false;
+    prepare(&image);
+    int width = image.width, height = image.height;
+    int basewidth = tonemapBaseSize(width), baseheight = tonemapBaseSize(height);
+    printf("\nkernels against the shaders on %s, %s\n", strrchr(filename, '/') + 1,
+           (const char*)glGetString(GL_RENDERER));
+
+    GLuint framebuffer;
+    glGenFramebuffers(1, &framebuffer);
+    glBindFramebuffer(GL_FRAMEBUFFER, framebuffer);
+    GLuint hdr = newTexture(width, height, GL_RGB, &image.rgb[0]);
+    GLuint output = newTexture(width, height, GL_RGBA, NULL);
+    GLuint loglum = newTexture(basewidth, baseheight, GL_RGBA, NULL);
+    GLuint half = newTexture(basewidth, baseheight, GL_RGBA, NULL);
+    GLuint base = newTexture(basewidth, baseheight, GL_RGBA, NULL);
+
+    // The Frame block of FrameUniforms (renderer.h): the exposure after
+    // the SH9 coefficients, then whether it adapts and is read back
+    GLfloat frame[44] = { 0 };
+    frame[36] = EXPOSURE;
+    frame[37] = image.logAverage;
+    frame[38] = image.maxLuminance;
+    GLint* flags = (GLint*)&frame[40];
+    GLuint uniforms;
+    glGenBuffers(1, &uniforms);
+    glBindBufferBase(GL_UNIFORM_BUFFER, 0, uniforms);
+
+    bool ok = true;
+    std::vector<float> cpu, gpu;
+    GLuint program = loadShader("tonemap.frag");
+    if (!program)
+        return false;
+    glUniformBlockBinding(program, glGetUniformBlockIndex(program, "Frame"), 0);
+    glUniform1i(glGetUniformLocation(program, "tex"), 0);
+    for (int key = 0; key < 2; key++)
+    {
+        flags[0] = flags[1] = key;
+        glBufferData(GL_UNIFORM_BUFFER, sizeof(frame), frame, GL_STATIC_DRAW);
+        glBindTexture(GL_TEXTURE_2D, hdr);
+        gpu = draw(output, width, height, 3);
+        run(image, key ? ReinhardKey : Reinhard, cpu);
+        ok = compare(key ? "tonemap.frag key" : "tonemap.frag", gpu, cpu, true, 1e-3f, COLOR_TOLERANCE) && ok;
+    }
+
+    program = loadShader("bilat_down.frag");
+    if (!program)
+        return false;
+    glUniform1i(glGetUniformLocation(program, "tex"), 0);
+    glUniform2f(glGetUniformLocation(program, "texel"), 1.f / width, 1.f / height);
+    glBindTexture(GL_TEXTURE_2D, hdr);
+    gpu = draw(loglum, basewidth, baseheight, 1);
+    ok = compare("bilat_down.frag", gpu, image.loglum, false, 0, LOG_TOLERANCE) && ok;
+
+    program = loadShader("bilat.frag");
+    if (!program)
+        return false;
+    GLfloat weights[TONEMAP_MAX_RADIUS + 1];
+    float sigma = RADIUS / 3.f;
+    for (int i = 0; i <= RADIUS; i++)
+        weights[i] = exp(-(i * i) / (2.f * sigma * sigma));
+    glUniform1i(glGetUniformLocation(program, "tex"), 0);
+    glUniform1i(glGetUniformLocation(program, "radius"), RADIUS);
+    glUniform1fv(glGetUniformLocation(program, "weights"), RADIUS + 1, weights);
+    glUniform1f(glGetUniformLocation(program, "rangeScale"), -0.5f / (RANGE_SIGMA * RANGE_SIGMA));
+    glUniform2f(glGetUniformLocation(program, "direction"), 1.f / basewidth, 0);
+    glBindTexture(GL_TEXTURE_2D, loglum);
+    draw(half, basewidth, baseheight, 1);
+    glUniform2f(glGetUniformLocation(program, "direction"), 0, 1.f / baseheight);
+    glBindTexture(GL_TEXTURE_2D, half);
+    gpu = draw(base, basewidth, baseheight, 1);
+    ok = compare("bilat.frag", gpu, image.base, false, 0, LOG_TOLERANCE) && ok;
+
+    program = loadShader("combine.frag");
+    if (!program)
+        return false;
+    glUniformBlockBinding(program, glGetUniformBlockIndex(program, "Frame"), 0);
+    flags[0] = flags[1] = 0;
+    glBufferData(GL_UNIFORM_BUFFER, sizeof(frame), frame, GL_STATIC_DRAW);
+    glUniform1i(glGetUniformLocation(program, "tex"), 0);
+    glUniform1i(glGetUniformLocation(program, "base"), 1);
+    glUniform2f(glGetUniformLocation(program, "baseSize"), basewidth, baseheight);
+    glUniform1f(glGetUniformLocation(program, "rangeScale"), -0.5f / (RANGE_SIGMA * RANGE_SIGMA));
+    glUniform1f(glGetUniformLocation(program, "compression"), COMPRESSION);
+    glUniform1i(glGetUniformLocation(program, "showDetail"), 0);
+    glActiveTexture(GL_TEXTURE1);
+    glBindTexture(GL_TEXTURE_2D, base);
+    glActiveTexture(GL_TEXTURE0);
+    glBindTexture(GL_TEXTURE_2D, hdr);
+    gpu = draw(output, width, height, 3);
+    run(image, Combine, cpu);
+    ok = compare("combine.frag", gpu, cpu, true, 1e-3f, COLOR_TOLERANCE) && ok;
+    return ok;
+}
+
+int main(int argc, char** argv)
+{
+    const char* directory = argc > 1 ? argv[1] : "textures";
+    int runs = argc > 2 ? atoi(argv[2]) : 5;
+    std::vector<std::string> files = benchListFiles(directory, ".hdr");
+    if (files.empty())
+    {
+        fprintf(stderr, "tonemap: no .hdr files in \"%s\"\n", directory);
+        return 1;
+    }
+
+    bool simd = tonemapSetSIMD(1);
+    printf("best of %d, ms, scalar / %s; ! marks results that differ\n", runs,
+           simd ? "AVX2" : "AVX2 (unsupported, scalar again)");
+    printf("%-20s %-9s", "image", "size");
+    for (int kernel = 0; kernel < NUM_KERNELS; kernel++)
+        printf("  %-14s", KERNEL_NAMES[kernel]);
+    printf("\n");
+    bool ok = true;
+    for (size_t i = 0; i < files.size(); i++)
+        ok = checkKernels(files[i].c_str(), runs) && ok;
+
+    tonemapSetSIMD(1);
+    if (makeContext())
+        ok = checkShaders(files[0].c_str()) && ok;
+    else
+        printf("\nno OpenGL context without a display, the shaders aren't checked\n");
+    return ok ? 0 : 1;
+}
@@ -0,0 +1,20 @@
+TARGET = tonemap
+TEMPLATE = app
+CONFIG += console
+CONFIG -= qt \
+    app_bundle
+INCLUDEPATH += .. \
+    ../../lib
+DEPENDPATH += .. \
+    ../../lib
+LIBS += -lEGL \
+    -lGL \
+    -lpthread
+HEADERS += ../benchmark.h \
+    ../../lib/tonemap.h \
+    ../../lib/rgbeimage.h \
+    ../../lib/parallel.h
+SOURCES += main.cpp \
+    ../../lib/tonemap.cpp \
+    ../../lib/rgbeimage.cpp \
+    ../../lib/parallel.cpp
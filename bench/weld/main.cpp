@@ -0,0 +1,180 @@
+/*
+      weld
+
+      Checks and times glmWeldVectors.  First every model in models/ is
+      welded at a few epsilons and compared with a straightforward
+      quadratic implementation of the rule glmWeldVectors documents:
+      each vector is replaced by the first vector kept before it that it
+      is glmEqual() to, or kept itself if there is none.  Then synthetic
+      sets of 10k to 10M vectors are welded, shuffled and in spatial
+      order, to show how the hash grid scales.
+
+      usage: weld [directory] [largest set]
+*/
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <GL/gl.h>
+#include "glm.h"
+#include "benchmark.h"
+
+/* defined in glm.cpp but not declared in glm.h */
+GLfloat* glmWeldVectors(GLfloat* vectors, GLuint* numvectors, GLfloat epsilon);
+
+/* sets larger than this aren't welded by the quadratic reference */
+static const GLuint MAX_QUADRATIC = 30000;
+
+/* equal: glmEqual */
+static bool equal(const GLfloat* u, const GLfloat* v, GLfloat epsilon)
+{
+    return fabsf(u[0] - v[0]) < epsilon && fabsf(u[1] - v[1]) < epsilon &&
+        fabsf(u[2] - v[2]) < epsilon;
+}
+
+/* quadraticWeld: the welding rule, comparing every vector with every
+ * copy kept so far
+ */
+static GLfloat* quadraticWeld(GLfloat* vectors, GLuint* numvectors, GLfloat epsilon)
+{
+    GLfloat* copies = (GLfloat*)malloc(sizeof(GLfloat) * 3 * (*numvectors + 1));
+    GLuint copied = 0;
+    for (GLuint i = 1; i <= *numvectors; i++)
+    {
+        GLuint found = 0;
+        for (GLuint j = 1; j <= copied && !found; j++)
+        {
+            if (equal(&vectors[3 * i], &copies[3 * j], epsilon))
+                found = j;
+        }
+        if (!found)
+        {
+            found = ++copied;
+            memcpy(&copies[3 * found], &vectors[3 * i], sizeof(GLfloat) * 3);
+        }
+        vectors[3 * i] = (GLfloat)found;
+    }
+    *numvectors = copied;
+    return copies;
+}
+
+/* compare: weld a copy of the vectors both ways.  Returns whether the
+ * kept vectors and the index of every vector agree.
+ */
+static bool compare(const GLfloat* vectors, GLuint count, GLfloat epsilon,
+                    GLuint* kept, double* gridms, double* quadraticms)
+{
+    size_t size = sizeof(GLfloat) * 3 * (count + 1);
+    GLfloat* a = (GLfloat*)malloc(size);
+    GLfloat* b = (GLfloat*)malloc(size);
+    memcpy(a, vectors, size);
+    memcpy(b, vectors, size);
+    GLuint na = count, nb = count;
+    double start = benchNow();
+    GLfloat* ca = glmWeldVectors(a, &na, epsilon);
+    *gridms = benchNow() - start;
+    start = benchNow();
+    GLfloat* cb = quadraticWeld(b, &nb, epsilon);
+    *quadraticms = benchNow() - start;
+    bool same = na == nb && !memcmp(ca + 3, cb + 3, sizeof(GLfloat) * 3 * na);
+    for (GLuint i = 1; i <= count && same; i++)
+        same = a[3 * i] == b[3 * i];
+    *kept = na;
+    free(a);
+    free(b);
+    free(ca);
+    free(cb);
+    return same;
+}
+
+/* random: xorshift, in [0, 1) */
+static double random01()
+{
+    static unsigned long long state = 88172645463325252ULL;
+    state ^= state << 13;
+    state ^= state >> 7;
+    state ^= state << 17;
+    return (state >> 11) * (1.0 / 9007199254740992.0);
+}
+
+/* makeVectors: count vectors in [-1, 1]^3, about six copies of each
+ * position jittered by under epsilon / 4, as the corners of a mesh
+ * are.  The copies are either spread over the whole set or next to
+ * each other.
+ */
+static GLfloat* makeVectors(GLuint count, GLfloat epsilon, bool ordered)
+{
+    GLuint positions = count / 6 + 1;
+    GLfloat* base = (GLfloat*)malloc(sizeof(GLfloat) * 3 * positions);
+    for (GLuint i = 0; i < 3 * positions; i++)
+        base[i] = random01() * 2 - 1;
+    GLfloat* vectors = (GLfloat*)malloc(sizeof(GLfloat) * 3 * (count + 1));
+    for (GLuint i = 1; i <= count; i++)
+    {
+        GLuint b = ordered ? (GLuint)((double)(i - 1) * positions / count) : (GLuint)(random01() * positions);
+        for (int c = 0; c < 3; c++)
+            vectors[3 * i + c] = base[3 * b + c] + (random01() - 0.5) * epsilon * 0.5;
+    }
+    free(base);
+    return vectors;
+}
+
+int main(int argc, char** argv)
+{
+    const char* directory = argc > 1 ? argv[1] : "models";
+    GLuint largest = argc > 2 ? strtoul(argv[2], NULL, 10) : 10000000;
+    std::vector<std::string> files = benchListFiles(directory, ".obj");
+    static const GLfloat EPSILONS[] = { 1e-5f, 1e-3f, 2e-2f };
+    bool ok = true;
+
+    printf("unitized models against the quadratic rule, ms\n");
+    printf("%-24s %8s %8s %8s %8s %10s\n", "model", "epsilon", "vectors", "kept", "grid", "quadratic");
+    for (size_t i = 0; i < files.size(); i++)
+    {
+        GLMmodel* model = glmReadOBJ(files[i].c_str());
+        glmUnitize(model);
+        for (size_t e = 0; e < sizeof(EPSILONS) / sizeof(EPSILONS[0]); e++)
+        {
+            GLuint kept;
+            double gridms, quadraticms;
+            bool same = compare(model->vertices, model->numvertices, EPSILONS[e], &kept, &gridms, &quadraticms);
+            printf("%-24s %8g %8u %8u %8.2f %10.1f%s\n", strrchr(files[i].c_str(), '/') + 1, EPSILONS[e],
+                   model->numvertices, kept, gridms, quadraticms, same ? "" : "  MISMATCH");
+            ok = ok && same;
+        }
+        glmDelete(model);
+    }
+
+    static const GLuint COUNTS[] = { 10000, 30000, 100000, 300000, 1000000, 3000000, 10000000 };
+    const GLfloat epsilon = 1e-5f;
+    printf("\nsynthetic sets, epsilon %g, ms\n", epsilon);
+    printf("%10s %10s %10s %10s\n", "vectors", "shuffled", "ordered", "quadratic");
+    for (size_t i = 0; i < sizeof(COUNTS) / sizeof(COUNTS[0]) && COUNTS[i] <= largest; i++)
+    {
+        GLuint count = COUNTS[i];
+        double ms[2];
+        for (int ordered = 0; ordered < 2; ordered++)
+        {
+            GLfloat* vectors = makeVectors(count, epsilon, ordered);
+            GLuint kept = count;
+            double start = benchNow();
+            free(glmWeldVectors(vectors, &kept, epsilon));
+            ms[ordered] = benchNow() - start;
+            free(vectors);
+        }
+        printf("%10u %10.1f %10.1f", count, ms[0], ms[1]);
+        if (count <= MAX_QUADRATIC)
+        {
+            GLfloat* vectors = makeVectors(count, epsilon, false);
+            GLuint kept;
+            double gridms, quadraticms;
+            bool same = compare(vectors, count, epsilon, &kept, &gridms, &quadraticms);
+            printf(" %10.1f%s", quadraticms, same ? "" : "  MISMATCH");
+            ok = ok && same;
+            free(vectors);
+        }
+        printf("\n");
+    }
+    return ok ? 0 : 1;
+}
@@ -0,0 +1,22 @@
+TARGET = weld
+TEMPLATE = app
+CONFIG += console
+CONFIG -= qt \
+    app_bundle
+INCLUDEPATH += .. \
+    ../../lib
+DEPENDPATH += .. \
+    ../../lib
+LIBS += -lGLU \
+    -lGL \
+    -lpthread
+HEADERS += ../benchmark.h \
+    ../../lib/glm.h \
+    ../../lib/targa.h \
+    ../../lib/parallel.h \
+    ../../lib/meshmath.h
+SOURCES += main.cpp \
+    ../../lib/glm.cpp \
+    ../../lib/targa.cpp \
+    ../../lib/parallel.cpp \
+    ../../lib/meshmath.cpp
@@ -12,18 +12,52 @@ DEPENDPATH += lab \
     math \
     support
 HEADERS += lab/glwidget.h \
+    lab/renderer.h \
+    lab/rendergraph.h \
+    lab/readbackring.h \
+    lab/framecapture.h \
+    lab/environmentmanager.h \
+    lab/shadermanager.h \
+    lab/uniforms.h \
+    lab/drawlist.h \
     lib/targa.h \
     lib/glm.h \
+    lib/parallel.h \
+    lib/meshmath.h \
+    lib/rgbeimage.h \
+    lib/pixelpack.h \
+    lib/envfilter.h \
+    lib/envcache.h \
+    lib/tonemap.h \
     math/vector.h \
     support/resourceloader.h \
+    support/framewriter.h \
+    support/environmentdecoder.h \
     support/mainwindow.h \
     support/camera.h \
     lib/targa.h \
     rgbe/rgbe.h
 SOURCES += lab/glwidget.cpp \
+    lab/renderer.cpp \
+    lab/rendergraph.cpp \
+    lab/readbackring.cpp \
+    lab/framecapture.cpp \
+    lab/environmentmanager.cpp \
+    lab/shadermanager.cpp \
+    lab/uniforms.cpp \
+    lab/drawlist.cpp \
     lib/targa.cpp \
     lib/glm.cpp \
+    lib/parallel.cpp \
+    lib/meshmath.cpp \
+    lib/rgbeimage.cpp \
+    lib/pixelpack.cpp \
+    lib/envfilter.cpp \
+    lib/envcache.cpp \
+    lib/tonemap.cpp \
     support/resourceloader.cpp \
+    support/framewriter.cpp \
+    support/environmentdecoder.cpp \
     support/mainwindow.cpp \
     support/main.cpp \
     support/camera.cpp \
@@ -37,15 +71,15 @@ OTHER_FILES += shaders/refract.vert \
     shaders/brightpass.frag \
     shaders/blur.frag \
     shaders/tonemap.frag \
+    shaders/luminance.frag \
     shaders/basic.frag \
     shaders/basic.vert \
     shaders/shadow.frag \
     shaders/shadow.vert \
     shaders/bilat.frag \
+    shaders/bilat_down.frag \
     shaders/refractFres.frag \
     shaders/refractFres.vert \
     shaders/combine.frag \
-    shaders/color.frag \
-    shaders/bilat_high.frag \
     shaders/tester.frag
 RESOURCES += 
@@ -0,0 +1,209 @@
+#define GL_GLEXT_PROTOTYPES
+#include "drawlist.h"
+
+#include <QGLShaderProgram>
+#include <algorithm>
+#include <math.h>
+#include <string.h>
+
+Transform::Transform()
+{
+    memset(m, 0, sizeof(m));
+    m[0] = m[5] = m[10] = m[15] = 1.f;
+}
+
+Transform &Transform::translate(float x, float y, float z)
+{
+    for (int i = 0; i < 4; ++i)
+        m[12 + i] += m[i] * x + m[4 + i] * y + m[8 + i] * z;
+    return *this;
+}
+
+Transform &Transform::scale(float x, float y, float z)
+{
+    for (int i = 0; i < 4; ++i)
+    {
+        m[i] *= x;
+        m[4 + i] *= y;
+        m[8 + i] *= z;
+    }
+    return *this;
+}
+
+/**
+  Rotates about an axis through the origin, as glRotatef does.
+
+  @param degrees: the angle, counterclockwise looking down the axis
+  @param x, y, z: the axis, which needn't be normalized
+**/
+Transform &Transform::rotate(float degrees, float x, float y, float z)
+{
+    float length = sqrt(x * x + y * y + z * z);
+    if (length == 0.f)
+        return *this;
+    x /= length;
+    y /= length;
+    z /= length;
+    float radians = degrees * M_PI / 180.0;
+    float c = cos(radians), s = sin(radians), t = 1.f - c;
+    GLfloat r[16] =
+    {
+        x * x * t + c,     y * x * t + z * s, x * z * t - y * s, 0.f,
+        x * y * t - z * s, y * y * t + c,     y * z * t + x * s, 0.f,
+        x * z * t + y * s, y * z * t - x * s, z * z * t + c,     0.f,
+        0.f,               0.f,               0.f,               1.f
+    };
+    return multiply(r);
+}
+
+Transform &Transform::multiply(const GLfloat *right)
+{
+    GLfloat result[16];
+    for (int column = 0; column < 4; ++column)
+        for (int row = 0; row < 4; ++row)
+            result[4 * column + row] = m[row] * right[4 * column] + m[4 + row] * right[4 * column + 1] +
+                                       m[8 + row] * right[4 * column + 2] + m[12 + row] * right[4 * column + 3];
+    memcpy(m, result, sizeof(m));
+    return *this;
+}
+
+StateCache::StateCache() :
+    m_calls(0), m_skipped(0)
+{
+    invalidate();
+}
+
+void StateCache::invalidate()
+{
+    for (int i = 0; i < NUM_CAPS; ++i)
+        m_caps[i] = -1;
+    m_cubeMap = 0;
+    m_cubeMapKnown = false;
+    m_program = 0;
+    m_programKnown = false;
+    for (int i = 0; i < MAX_BINDINGS; ++i)
+    {
+        m_blockBuffers[i] = 0;
+        m_blocks[i] = -1;
+    }
+}
+
+/**
+  Counts a state change asked for.
+
+  @param known: whether the cache knows the current value
+  @param same: whether it is the one asked for
+  @return whether GL must be called
+**/
+bool StateCache::changed(bool known, bool same)
+{
+    if (known && same)
+    {
+        ++m_skipped;
+        return false;
+    }
+    ++m_calls;
+    return true;
+}
+
+void StateCache::enable(Cap cap, bool enabled)
+{
+    static const GLenum caps[NUM_CAPS] = { GL_DEPTH_TEST, GL_CULL_FACE, GL_TEXTURE_CUBE_MAP };
+    if (!changed(m_caps[cap] >= 0, m_caps[cap] == enabled))
+        return;
+    m_caps[cap] = enabled;
+    if (enabled)
+        glEnable(caps[cap]);
+    else
+        glDisable(caps[cap]);
+}
+
+// On the active texture unit
+void StateCache::bindCubeMap(GLuint texture)
+{
+    if (!changed(m_cubeMapKnown, m_cubeMap == texture))
+        return;
+    m_cubeMap = texture;
+    m_cubeMapKnown = true;
+    glBindTexture(GL_TEXTURE_CUBE_MAP, texture);
+}
+
+void StateCache::useProgram(QGLShaderProgram *program)
+{
+    if (!changed(m_programKnown, m_program == program))
+        return;
+    m_program = program;
+    m_programKnown = true;
+    if (program)
+        program->bind();
+    else
+        glUseProgram(0);
+}
+
+void StateCache::bindBlock(const UniformBuffer &buffer, int block, GLuint binding)
+{
+    Q_ASSERT(binding < MAX_BINDINGS);
+    if (!changed(m_blockBuffers[binding] != 0, m_blockBuffers[binding] == &buffer && m_blocks[binding] == block))
+        return;
+    m_blockBuffers[binding] = &buffer;
+    m_blocks[binding] = block;
+    buffer.bind(block, binding);
+}
+
+void DrawList::add(const DrawItem &item)
+{
+    m_items.append(item);
+}
+
+bool DrawList::lessThan(const Entry &a, const Entry &b)
+{
+    return a.key < b.key;
+}
+
+/**
+  Sorts the draws by a key packing, from the most significant bits down, the
+  program, the cube map, culling, the material and the order they were added
+  in, then draws them.
+
+  @param uniforms: the buffer holding the Material blocks
+  @param materialBinding: the binding point of the Material block
+**/
+void DrawList::submit(StateCache &state, const UniformBuffer &uniforms, GLuint materialBinding)
+{
+    m_order.resize(m_items.size());
+    for (int i = 0; i < m_items.size(); ++i)
+    {
+        const DrawItem &item = m_items[i];
+        quint64 program = item.program ? item.program->programId() & 0xffff : 0;
+        m_order[i].key = program << 48 | (quint64) (item.cubeMap & 0xffff) << 32 |
+                         (quint64) item.cull << 31 | (quint64) ((item.material + 1) & 0x7f) << 24 | i;
+        m_order[i].index = i;
+    }
+    std::sort(m_order.begin(), m_order.end(), lessThan);
+
+    state.invalidate();
+    glActiveTexture(GL_TEXTURE0);
+    glMatrixMode(GL_MODELVIEW);
+    state.enable(StateCache::DepthTest, true);
+    state.enable(StateCache::CubeMapTexture, true);
+    for (int i = 0; i < m_order.size(); ++i)
+    {
+        const DrawItem &item = m_items[m_order[i].index];
+        state.useProgram(item.program);
+        state.bindCubeMap(item.cubeMap);
+        state.enable(StateCache::CullFace, item.cull);
+        if (item.material >= 0)
+            state.bindBlock(uniforms, item.material, materialBinding);
+        glLoadMatrixf(item.transform.m);
+        if (item.mesh)
+            glmDrawMesh(item.model, item.mesh);
+        else
+            glCallList(item.callList);
+    }
+    glLoadIdentity();
+    state.enable(StateCache::CullFace, false);
+    state.enable(StateCache::DepthTest, false);
+    state.bindCubeMap(0);
+    state.enable(StateCache::CubeMapTexture, false);
+    state.useProgram(0);
+}
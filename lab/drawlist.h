@@ -0,0 +1,117 @@
+#ifndef DRAWLIST_H
+#define DRAWLIST_H
+
+#include <QGLWidget>
+#include <QVector>
+
+#include "glm.h"
+#include "uniforms.h"
+
+class QGLShaderProgram;
+
+/**
+    A 4x4 column-major matrix built up like the fixed function modelview:
+    every call multiplies on the right, as glTranslatef and friends do.
+ **/
+struct Transform
+{
+    GLfloat m[16];
+
+    Transform();
+    Transform &translate(float x, float y, float z);
+    Transform &scale(float x, float y, float z);
+    Transform &rotate(float degrees, float x, float y, float z);
+    Transform &multiply(const GLfloat *right);
+};
+
+/**
+    The GL state the scene's draws change, set through a cache that only
+    calls GL when a value differs from the one it set last, and counts the
+    calls it makes and skips.  Other code changes the same state, so the
+    cache must be invalidated before it is used again, after which the first
+    set of each state always goes through.
+ **/
+class StateCache
+{
+public:
+    enum Cap { DepthTest, CullFace, CubeMapTexture, NUM_CAPS };
+
+    StateCache();
+
+    // Forgets the state; the counters stay
+    void invalidate();
+
+    void enable(Cap cap, bool enabled);
+    void bindCubeMap(GLuint texture);
+    void useProgram(QGLShaderProgram *program);
+    void bindBlock(const UniformBuffer &buffer, int block, GLuint binding);
+
+    // GL calls made and skipped since resetCounters()
+    int calls() const { return m_calls; }
+    int skipped() const { return m_skipped; }
+    void resetCounters() { m_calls = m_skipped = 0; }
+
+private:
+    enum { MAX_BINDINGS = 4 };
+
+    bool changed(bool known, bool same);
+
+    int m_caps[NUM_CAPS];               // 1 enabled, 0 disabled, -1 unknown
+    GLuint m_cubeMap;
+    bool m_cubeMapKnown;
+    QGLShaderProgram *m_program;
+    bool m_programKnown;
+    const UniformBuffer *m_blockBuffers[MAX_BINDINGS];  // 0 if unknown
+    int m_blocks[MAX_BINDINGS];
+    int m_calls, m_skipped;
+};
+
+/**
+    One draw of the scene: a mesh, or a call list when mesh is 0, with
+    everything it needs bound.  Depth testing and the cube map texture
+    target are on for every draw.
+ **/
+struct DrawItem
+{
+    DrawItem() : model(0), mesh(0), callList(0), program(0), material(-1), cubeMap(0), cull(true) {}
+
+    GLMmodel *model;
+    GLMmesh *mesh;
+    GLuint callList;
+    QGLShaderProgram *program;          // 0 for the fixed function
+    int material;                       // block of the Material uniforms, or -1
+    GLuint cubeMap;
+    bool cull;                          // cull back faces
+    Transform transform;                // the modelview
+};
+
+/**
+    The draws of a frame.  submit() sorts them so that draws sharing a
+    program, then a cube map, then a material come together, and issues them
+    through a StateCache, which drops the binds repeated between them.
+ **/
+class DrawList
+{
+public:
+    void clear() { m_items.clear(); }
+    void add(const DrawItem &item);
+    int size() const { return m_items.size(); }
+
+    // Draws everything and leaves depth testing, culling, the cube map and the
+    // program off, and the modelview the identity
+    void submit(StateCache &state, const UniformBuffer &uniforms, GLuint materialBinding);
+
+private:
+    struct Entry
+    {
+        quint64 key;
+        int index;
+    };
+
+    static bool lessThan(const Entry &a, const Entry &b);
+
+    QVector<DrawItem> m_items;
+    QVector<Entry> m_order;
+};
+
+#endif // DRAWLIST_H
@@ -0,0 +1,206 @@
+#define GL_GLEXT_PROTOTYPES
+#include "environmentmanager.h"
+
+#include <QTime>
+#include <iostream>
+#include <string.h>
+
+using std::cout;
+using std::endl;
+
+// Scanlines of a face uploaded at a time
+static const int SLICE_ROWS = 32;
+
+EnvironmentManager::EnvironmentManager(GLenum format) :
+    m_format(format), m_texture(0), m_levels(1), m_streaming(false), m_pending(0), m_level(0), m_face(0),
+    m_row(0), m_slices(0)
+{
+    memset(m_irradiance, 0, sizeof(m_irradiance));
+    m_buffers[0] = m_buffers[1] = 0;
+}
+
+/**
+  Decodes a cube map and uploads it in one go, replacing the current one
+  (and dropping any that was being streamed) if that works.
+ **/
+bool EnvironmentManager::load(const char *filename)
+{
+    CubeFaces faces;
+    if (!ResourceLoader::decodeCubeCross(filename, m_format, faces))
+    {
+        cout << "failed to load " << filename << endl;
+        return false;
+    }
+    dropPending();
+    m_streaming = false;
+    m_filename = filename;
+    m_faces = faces;
+    beginUpload();
+    while (m_level < m_faces.levels)
+        uploadSlice();
+    finishUpload();
+    return true;
+}
+
+void EnvironmentManager::stream(const QString &filename)
+{
+    dropPending();
+    m_filename = filename;
+    m_streaming = true;
+    m_decoder.decode(filename, m_format);
+}
+
+float EnvironmentManager::progress() const
+{
+    if (!m_streaming || !m_pending)
+        return 0.f;
+    int done = 0, total = 0;
+    for (int level = 0; level < m_faces.levels; ++level)
+    {
+        int size = qMax(m_faces.size >> level, 1);
+        total += 6 * size;
+        if (level < m_level)
+            done += 6 * size;
+        else if (level == m_level)
+            done += m_face * size + m_row;
+    }
+    return (float) done / total;
+}
+
+/**
+  Uploads what the frame's budget allows of a streamed cube map, and swaps it
+  in once it is complete.
+
+  @param budget: milliseconds to spend on the upload
+  @return whether the new cube map was swapped in
+ **/
+bool EnvironmentManager::update(int budget)
+{
+    if (!m_streaming)
+        return false;
+    if (!m_pending)
+    {
+        if (!m_decoder.take(m_faces))
+            return false;
+        if (m_faces.size == 0)
+        {
+            cout << "failed to load " << m_filename.toStdString() << endl;
+            m_streaming = false;
+            return false;
+        }
+        beginUpload();
+    }
+
+    QTime timer;
+    timer.start();
+    do
+    {
+        uploadSlice();
+    } while (m_level < m_faces.levels && timer.elapsed() < budget);
+    if (m_level < m_faces.levels)
+        return false;
+
+    m_streaming = false;
+    finishUpload();
+    return true;
+}
+
+/**
+  Creates the texture the decoded faces go into.
+ **/
+void EnvironmentManager::beginUpload()
+{
+    m_pending = ResourceLoader::newCubeMap(m_format, m_faces.size, m_faces.levels);
+    glBindTexture(GL_TEXTURE_CUBE_MAP, 0);
+    m_level = m_face = m_row = 0;
+    if (!m_buffers[0])
+        glGenBuffers(2, m_buffers);
+}
+
+/**
+  Replaces the current cube map with the fully uploaded one.
+ **/
+void EnvironmentManager::finishUpload()
+{
+    glDeleteTextures(1, &m_texture);
+    m_texture = m_pending;
+    m_levels = m_faces.levels;
+    memcpy(m_irradiance, m_faces.irradiance, sizeof(m_irradiance));
+    m_pending = 0;
+    m_faces = CubeFaces();
+    m_slices = 0;
+}
+
+/**
+  Uploads the next slice of rows of the current face and level through the
+  next pixel buffer.  The buffer is orphaned first so the driver can still be copying
+  from the previous one.
+ **/
+void EnvironmentManager::uploadSlice()
+{
+    GLenum pixelFormat, type;
+    int texelBytes;
+    ResourceLoader::cubeTexelFormat(m_faces.format, pixelFormat, type, texelBytes);
+    // The levels of a face follow each other
+    int offset = 0;
+    for (int level = 0; level < m_level; ++level)
+        offset += qMax(m_faces.size >> level, 1) * qMax(m_faces.size >> level, 1);
+    int size = qMax(m_faces.size >> m_level, 1);
+    int rows = qMin(SLICE_ROWS, size - m_row);
+    int bytes = texelBytes * size * rows;
+    const char *pixels = m_faces.faces[m_face].constData() + texelBytes * (offset + size * m_row);
+
+    glBindTexture(GL_TEXTURE_CUBE_MAP, m_pending);
+    glBindBuffer(GL_PIXEL_UNPACK_BUFFER, m_buffers[m_slices % 2]);
+    glBufferData(GL_PIXEL_UNPACK_BUFFER, bytes, NULL, GL_STREAM_DRAW);
+    void *mapped = glMapBuffer(GL_PIXEL_UNPACK_BUFFER, GL_WRITE_ONLY);
+    if (mapped)
+    {
+        memcpy(mapped, pixels, bytes);
+        glUnmapBuffer(GL_PIXEL_UNPACK_BUFFER);
+        pixels = 0;
+    }
+    else
+    {
+        glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+    }
+    glTexSubImage2D(GL_TEXTURE_CUBE_MAP_POSITIVE_X + m_face, m_level, 0, m_row, size, rows,
+                    pixelFormat, type, pixels);
+    glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+    glBindTexture(GL_TEXTURE_CUBE_MAP, 0);
+
+    m_slices++;
+    m_row += rows;
+    if (m_row == size)
+    {
+        m_row = 0;
+        m_face++;
+    }
+    if (m_face == 6)
+    {
+        m_face = 0;
+        m_level++;
+    }
+}
+
+/**
+  Abandons the upload in progress, if any.
+ **/
+void EnvironmentManager::dropPending()
+{
+    glDeleteTextures(1, &m_pending);
+    m_pending = 0;
+    m_faces = CubeFaces();
+    m_slices = 0;
+}
+
+void EnvironmentManager::clear()
+{
+    dropPending();
+    m_streaming = false;
+    glDeleteTextures(1, &m_texture);
+    m_texture = 0;
+    if (m_buffers[0])
+        glDeleteBuffers(2, m_buffers);
+    m_buffers[0] = m_buffers[1] = 0;
+}
@@ -0,0 +1,68 @@
+#ifndef ENVIRONMENTMANAGER_H
+#define ENVIRONMENTMANAGER_H
+
+#include <QGLWidget>
+#include <QString>
+#include "environmentdecoder.h"
+#include "resourceloader.h"
+
+/**
+    Owns the environment cube map and swaps in new ones without stalling the
+    render loop.  stream() has an EnvironmentDecoder thread decode the file;
+    once the faces are ready, update() uploads a few slices of them per frame
+    through a pair of pixel buffers into a second texture, and only when that
+    one is complete, every level of it, does it replace the current one, which
+    is then deleted.  Until then texture() keeps returning the old cube map.
+
+    The cube map's mip levels are prefiltered for glossy reflections: a
+    surface of a given roughness looks up level roughness * maxLod().  The
+    diffuse light comes with it as SH9 coefficients, in irradiance().
+ **/
+class EnvironmentManager
+{
+public:
+    EnvironmentManager(GLenum format = GL_R11F_G11F_B10F);
+
+    // Loads a cube map right away, replacing the current one if that works
+    bool load(const char *filename);
+
+    // Starts loading a cube map in the background; a later call supersedes it
+    void stream(const QString &filename);
+
+    // Uploads slices of a streamed cube map for about budget milliseconds (at
+    // least one slice).  Returns true on the frame the new one is swapped in.
+    bool update(int budget = 2);
+
+    GLuint texture() const { return m_texture; }
+    float maxLod() const { return m_levels - 1; }
+    const float *irradiance() const { return m_irradiance; }
+    bool streaming() const { return m_streaming; }
+    QString streamedFile() const { return m_filename; }
+
+    // Fraction of the streamed cube map uploaded so far
+    float progress() const;
+
+    // Deletes the textures and buffers; the context must be current
+    void clear();
+
+private:
+    void beginUpload();
+    void uploadSlice();
+    void finishUpload();
+    void dropPending();
+
+    GLenum m_format;
+    GLuint m_texture;                   // the current cube map
+    int m_levels;                       // its mip levels
+    float m_irradiance[27];             // and the SH9 coefficients of its diffuse light
+    EnvironmentDecoder m_decoder;
+    bool m_streaming;                   // a cube map is being decoded or uploaded
+    QString m_filename;                 // the one being streamed
+    CubeFaces m_faces;                  // its decoded faces, while they are uploaded
+    GLuint m_pending;                   // the texture they go into
+    int m_level, m_face, m_row;         // the next slice to upload
+    GLuint m_buffers[2];                // pixel buffers the slices take turns in
+    int m_slices;                       // slices uploaded so far
+};
+
+#endif // ENVIRONMENTMANAGER_H
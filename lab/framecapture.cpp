@@ -0,0 +1,127 @@
+#include "framecapture.h"
+
+FrameCapture::FrameCapture(int buffers, int maxQueued) :
+    m_readbacks(buffers), m_writer(maxQueued), m_lossless(false), m_captured(0), m_failed(0)
+{
+    m_writer.setDropWhenFull(true);
+}
+
+FrameCapture::~FrameCapture()
+{
+    m_writer.finish();
+}
+
+/**
+  Lossless capture waits for a free pixel buffer and for room in the writer's
+  queue instead of dropping frames.
+ **/
+void FrameCapture::setLossless(bool lossless)
+{
+    m_lossless = lossless;
+    m_writer.setDropWhenFull(!lossless);
+}
+
+void FrameCapture::startWriter()
+{
+    if (!m_writer.isRunning())
+        m_writer.start();
+}
+
+void FrameCapture::openStream(const QString &target)
+{
+    startWriter();
+    m_writer.openStream(target);
+}
+
+/**
+  Closes the stream once the raw frames still in flight are written to it.
+ **/
+void FrameCapture::closeStream()
+{
+    poll(true);
+    m_writer.closeStream();
+}
+
+bool FrameCapture::capture(Format format, const QString &path, int width, int height)
+{
+    Frame frame;
+    frame.format = format;
+    frame.path = path;
+    frame.width = width;
+    frame.height = height;
+    bool hdr = format == Rgbe || format == Reference;
+    frame.bytes = hdr ? 3 * sizeof(GLfloat) * width * height : 4 * width * height;
+
+    if (m_lossless && m_readbacks.full())
+        take(true);
+    if (hdr)
+    {
+        if (!m_readbacks.read(0, 0, width, height, GL_RGB, GL_FLOAT, frame.bytes))
+            return false;
+    }
+    else if (!m_readbacks.read(0, 0, width, height, GL_RGBA, GL_UNSIGNED_BYTE, frame.bytes))
+    {
+        return false;
+    }
+    m_frames.enqueue(frame);
+    m_captured++;
+    return true;
+}
+
+void FrameCapture::poll(bool wait)
+{
+    while (!m_frames.isEmpty() && take(wait))
+        ;
+}
+
+/**
+  Takes the oldest readback and queues it on the writer.
+
+  @param wait: block until it arrives
+  @return whether the readback was done
+ **/
+bool FrameCapture::take(bool wait)
+{
+    const Frame &frame = m_frames.head();
+    if (m_pixels.size() != frame.bytes)
+        m_pixels.resize(frame.bytes);
+
+    int pending = m_readbacks.pending();
+    if (!m_readbacks.take(m_pixels.data(), wait))
+    {
+        // The buffer is gone when it could not be mapped
+        if (m_readbacks.pending() == pending)
+            return false;
+        m_failed++;
+        m_frames.dequeue();
+        return true;
+    }
+
+    startWriter();
+    switch (frame.format)
+    {
+        case Png:
+            m_writer.writePng(frame.path, m_pixels, frame.width, frame.height);
+            break;
+        case Rgbe:
+            m_writer.writeHdr(frame.path, m_pixels, frame.width, frame.height);
+            break;
+        case Reference:
+            m_writer.writeReference(frame.path, m_pixels, frame.width, frame.height, m_toneMapping);
+            break;
+        case Raw:
+            m_writer.writeRaw(m_pixels, frame.width, frame.height);
+            break;
+    }
+
+    // The writer keeps its own reference, the next readback gets a new array
+    m_pixels = QByteArray();
+    m_frames.dequeue();
+    return true;
+}
+
+void FrameCapture::finish()
+{
+    poll(true);
+    m_writer.finish();
+}
@@ -0,0 +1,80 @@
+#ifndef FRAMECAPTURE_H
+#define FRAMECAPTURE_H
+
+#include <QByteArray>
+#include <QQueue>
+#include <QString>
+#include "readbackring.h"
+#include "framewriter.h"
+
+/**
+    Captures frames without stalling the render loop: capture() starts an
+    asynchronous readback of the bound framebuffer into a ring of pixel buffer
+    objects, and poll() hands the ones that have arrived to a FrameWriter
+    thread to be encoded.  When the GPU or the writer falls behind, frames are
+    dropped and counted, unless the capture is lossless, in which case it
+    waits for them instead (for batch rendering).
+ **/
+class FrameCapture
+{
+public:
+    enum Format
+    {
+        Png,                            // 8-bit RGBA, saved to path
+        Rgbe,                           // float RGB, saved to path
+        Reference,                      // float RGB, tone mapped on the CPU and saved as PNG to path
+        Raw                             // 8-bit RGBA, appended to the stream
+    };
+
+    FrameCapture(int buffers = 3, int maxQueued = 8);
+    ~FrameCapture();
+
+    void setLossless(bool lossless);
+
+    // How Reference frames are tone mapped
+    void setReferenceToneMapping(const ReferenceToneMapping &toneMapping) { m_toneMapping = toneMapping; }
+
+    // Raw frames go to this file, or into this command if it starts with '|'
+    void openStream(const QString &target);
+    void closeStream();
+
+    // Starts reading back width x height pixels of the bound framebuffer.
+    // Returns false if the frame was dropped.
+    bool capture(Format format, const QString &path, int width, int height);
+
+    // Hands the readbacks that have arrived to the writer; with wait, all of them
+    void poll(bool wait = false);
+
+    // Waits until everything captured is written; the context must be current
+    void finish();
+
+    int captured() const { return m_captured; }
+    int pending() const { return m_frames.size(); }
+    int droppedReadbacks() const { return m_readbacks.dropped(); }
+    int droppedWrites() const { return m_writer.dropped(); }
+    int written() const { return m_writer.written(); }
+    int failed() const { return m_writer.failed() + m_failed; }
+
+private:
+    struct Frame
+    {
+        Format format;
+        QString path;
+        int width, height;
+        int bytes;
+    };
+
+    void startWriter();
+    bool take(bool wait);
+
+    ReadbackRing m_readbacks;
+    QQueue<Frame> m_frames;             // readbacks in flight, oldest first
+    QByteArray m_pixels;                // the readback being taken
+    FrameWriter m_writer;
+    ReferenceToneMapping m_toneMapping;
+    bool m_lossless;
+    int m_captured;
+    int m_failed;                       // readbacks that could not be mapped
+};
+
+#endif // FRAMECAPTURE_H
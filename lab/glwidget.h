@@ -2,17 +2,12 @@
 #define GLWIDGET_H
 
 #include <QGLWidget>
-#include <QHash>
-#include <QString>
 #include <QTimer>
 #include <QTime>
 
-#include "camera.h"
 #include "vector.h"
-#include "resourceloader.h"
-
-class QGLShaderProgram;
-class QGLFramebufferObject;
+#include "renderer.h"
+#include "framecapture.h"
 
 
 class GLWidget : public QGLWidget
@@ -33,22 +28,11 @@ protected:
     void mousePressEvent(QMouseEvent *event);
     void keyPressEvent(QKeyEvent *event);
 
-    // Initialization code
-    void initializeResources();
-    void loadCubeMap(char* filename);
-    void createShaderPrograms();
-    void createFramebufferObjects(int width, int height);
-    void createBlurKernel(int radius, int width, int height, GLfloat* kernel, GLfloat* offsets);
-    void createBilatKernel(int radius, int width, int height, GLfloat* kernel);
-
     // Drawing code
-    void applyOrthogonalCamera(float width, float height);
-    void applyPerspectiveCamera(float width, float height);
-    void renderTexturedQuad(int width, int height, bool flip);
-    void renderBlur(int width, int height);
-    void renderScene();
-    void renderShadowScene();
     void paintText();
+    void captureFrame();
+    void startRecording();
+    void stopRecording();
 
 private:
     QTimer m_timer;
@@ -56,24 +40,11 @@ private:
     int m_prevTime;
     float m_prevFps, m_fps;
     Vector2 m_prevMousePos;
-    OrbitCamera m_camera;
-
-    // Resources
-    QHash<QString, QGLShaderProgram *> m_shaderPrograms; // hash map of all shader programs
-    QHash<QString, QGLFramebufferObject *> m_framebufferObjects; // hash map of all framebuffer objects
-    Model m_dragon; // dragon model
-    Model m_sphere; // sphere model
-    Model m_elephant; // elephant model
-    Model m_model1;
-    Model m_model2;
-    GLuint m_skybox; // skybox call list ID
-    GLuint m_cubeMap; // cubeMap texture ID
+    Renderer m_renderer; // the scene and its HDR pipeline
+    FrameCapture m_capture; // asynchronous screenshots and recordings
+    QString m_screenshotPath; // where the next frame is saved, if anywhere
+    bool m_recording; // every frame is captured into the raw stream
     QFont m_font; // font for rendering text
-    float m_exp; //image exposure
-    bool m_isHDR;
-    bool m_isBilat;
-    bool m_isEdges;
-    float m_increment;
 
 };
 
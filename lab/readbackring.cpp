@@ -0,0 +1,87 @@
+#define GL_GLEXT_PROTOTYPES
+#include "readbackring.h"
+
+#include <string.h>
+
+ReadbackRing::ReadbackRing(int size) : m_first(0), m_count(0), m_dropped(0)
+{
+    Slot slot;
+    slot.buffer = 0;
+    slot.fence = 0;
+    slot.capacity = slot.bytes = 0;
+    m_slots = QVector<Slot>(qMax(size, 1), slot);
+}
+
+ReadbackRing::~ReadbackRing()
+{
+    clear();
+}
+
+void ReadbackRing::clear()
+{
+    for (int i = 0; i < m_slots.size(); ++i)
+    {
+        Slot &slot = m_slots[i];
+        if (slot.fence)
+            glDeleteSync(slot.fence);
+        if (slot.buffer)
+            glDeleteBuffers(1, &slot.buffer);
+        slot.buffer = 0;
+        slot.fence = 0;
+        slot.capacity = slot.bytes = 0;
+    }
+    m_first = m_count = 0;
+}
+
+bool ReadbackRing::read(int x, int y, int width, int height, GLenum format, GLenum type, int bytes)
+{
+    if (m_count == m_slots.size())
+    {
+        m_dropped++;
+        return false;
+    }
+
+    Slot &slot = m_slots[(m_first + m_count) % m_slots.size()];
+    if (!slot.buffer)
+        glGenBuffers(1, &slot.buffer);
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, slot.buffer);
+    if (slot.capacity < bytes)
+    {
+        glBufferData(GL_PIXEL_PACK_BUFFER, bytes, 0, GL_STREAM_READ);
+        slot.capacity = bytes;
+    }
+    glReadPixels(x, y, width, height, format, type, 0);
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+    slot.fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+    slot.bytes = bytes;
+    m_count++;
+    return true;
+}
+
+bool ReadbackRing::take(void *data, bool wait)
+{
+    if (!m_count)
+        return false;
+
+    // A zero timeout only polls the fence, so this never blocks unless told to
+    Slot &slot = m_slots[m_first];
+    GLuint64 timeout = wait ? 1000000000 : 0;
+    GLenum status = glClientWaitSync(slot.fence, GL_SYNC_FLUSH_COMMANDS_BIT, timeout);
+    while (wait && status == GL_TIMEOUT_EXPIRED)
+        status = glClientWaitSync(slot.fence, 0, timeout);
+    if (status != GL_ALREADY_SIGNALED && status != GL_CONDITION_SATISFIED)
+        return false;
+    glDeleteSync(slot.fence);
+    slot.fence = 0;
+
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, slot.buffer);
+    const void *pixels = glMapBufferRange(GL_PIXEL_PACK_BUFFER, 0, slot.bytes, GL_MAP_READ_BIT);
+    if (pixels)
+        memcpy(data, pixels, slot.bytes);
+    glUnmapBuffer(GL_PIXEL_PACK_BUFFER);
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+
+    m_first = (m_first + 1) % m_slots.size();
+    m_count--;
+    return pixels != 0;
+}
@@ -0,0 +1,54 @@
+#ifndef READBACKRING_H
+#define READBACKRING_H
+
+#include <QGLWidget>
+#include <QVector>
+
+/**
+    Reads pixels back from the GPU without stalling.  read() starts an
+    asynchronous glReadPixels into the next of a ring of pixel buffer objects
+    and puts a fence behind it; take() hands out the oldest readback whose
+    fence has passed and returns false instead of waiting if none has.  With
+    N buffers the results arrive up to N - 1 frames late; if all of them are
+    still in flight read() drops the request and counts it.
+**/
+class ReadbackRing
+{
+public:
+    ReadbackRing(int size = 3);
+    ~ReadbackRing();
+
+    // Starts reading a rectangle of the bound read framebuffer.  bytes is the
+    // size of the pixels in the given format and type.  Returns false if the
+    // request was dropped because every buffer is busy.
+    bool read(int x, int y, int width, int height, GLenum format, GLenum type, int bytes);
+
+    // Copies the oldest finished readback into data (at least its bytes long)
+    // and frees its buffer.  Returns false if none has finished yet, unless
+    // wait is set: then it blocks until the oldest one has.
+    bool take(void *data, bool wait = false);
+
+    // Releases the buffers; needs the context they were created in to be current.
+    void clear();
+
+    int size() const { return m_slots.size(); }
+    int pending() const { return m_count; }
+    int dropped() const { return m_dropped; }
+    bool full() const { return m_count == m_slots.size(); }
+
+private:
+    struct Slot
+    {
+        GLuint buffer;
+        GLsync fence;
+        int capacity;                   // bytes allocated for the buffer
+        int bytes;                      // bytes of the readback in flight
+    };
+
+    QVector<Slot> m_slots;
+    int m_first;                        // oldest readback in flight
+    int m_count;                        // readbacks in flight
+    int m_dropped;
+};
+
+#endif // READBACKRING_H
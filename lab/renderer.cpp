@@ -0,0 +1,1306 @@
+#include "renderer.h"
+
+#include <iostream>
+#include <QGLFramebufferObject>
+#include <QGLShaderProgram>
+#include "glm.h"
+#include <math.h>
+#include <string.h>
+
+using std::cout;
+using std::endl;
+
+// GGX roughness of the glass models and of the mirror sphere, and how much of
+// the environment's diffuse light the sphere adds to its reflection
+static const float GLASS_ROUGHNESS = 0.1f;
+static const float SPHERE_ROUGHNESS = 0.25f;
+static const float SPHERE_DIFFUSE = 0.2f;
+
+extern "C"
+{
+    extern void APIENTRY glActiveTexture(GLenum);
+    extern void APIENTRY glBlendColor(GLclampf, GLclampf, GLclampf, GLclampf);
+}
+
+/**
+  Constructor.  Initialize all member variables here; nothing touches OpenGL
+  before initialize().
+ **/
+Renderer::Renderer()
+{
+    m_camera.center = Vector3(0.f, 0.f, 0.f);
+    m_camera.up = Vector3(0.f, 1.f, 0.f);
+    m_camera.zoom = 3.5f;
+    m_camera.theta = M_PI * 1.5f, m_camera.phi = 0.2f;
+    m_camera.fovy = 60.f;
+
+    m_exp = 0.50;
+    m_isHDR = true;
+    m_isBilat = false;
+    m_isEdges = false;
+    m_increment = 0.0;
+    m_renderGraphDirty = true;
+    m_renderGraphCompiled = false;
+    m_graphWidth = m_graphHeight = 0;
+    m_blurRadius = 3;
+    m_bloomThreshold = 1.0f;
+    m_bilatRadius = 8;
+    m_bilatRangeSigma = 0.4f;
+    m_bilatCompression = 0.5f;
+    m_hdrFbo = 0;
+    m_keepHdr = false;
+    m_exposureFbo = 0;
+    m_autoExposure = true;
+    m_exposureReadback = false;
+    m_exposureReset = true;
+    m_adaptationRate = 2.0f;
+    m_frameSeconds = 0.f;
+    m_logAverage = 0.f;
+    m_maxLuminance = 1.f;
+    m_skybox = 0;
+    m_dragon.model = m_sphere.model = m_elephant.model = m_model1.model = m_model2.model = 0;
+}
+
+/**
+  Destructor.  Delete any 'new'ed objects here.  The context the resources
+  were loaded into must be current.
+ **/
+Renderer::~Renderer()
+{
+    m_shaders.clear();
+    if (!m_dragon.model)
+        return;
+    glDeleteLists(m_skybox, 1);
+    m_uniformBuffer.clear();
+    m_environment.clear();
+    glmDeleteMesh(m_dragon.mesh);
+    glmDeleteMesh(m_sphere.mesh);
+    glmDeleteMesh(m_elephant.mesh);
+    glmDeleteMesh(m_model1.mesh);
+    glmDeleteMesh(m_model2.mesh);
+    glmDelete(m_dragon.model);
+    glmDelete(m_sphere.model);
+    glmDelete(m_elephant.model);
+    glmDelete(m_model1.model);
+    glmDelete(m_model2.model);
+    m_exposureReadbacks.clear();
+    delete m_exposureFbo;
+    delete m_hdrFbo;
+}
+
+/**
+  Initialize the OpenGL state and all resources.
+  This includes models, textures, call lists and shader programs; the
+  framebuffer objects follow on the first frame, once its size is known.
+ **/
+void Renderer::initialize()
+{
+    // Set up OpenGL
+    glEnable(GL_TEXTURE_2D);
+
+    glEnable(GL_CULL_FACE);
+    glCullFace(GL_BACK);
+    glFrontFace(GL_CCW);
+
+    glDisable(GL_DITHER);
+
+    // Filter across the edges of cube map faces, which show on the small,
+    // blurry levels the glossy reflections read from
+    glEnable(GL_TEXTURE_CUBE_MAP_SEAMLESS);
+
+    glDisable(GL_LIGHTING);
+    // Enable color materials with ambient and diffuse lighting terms
+    glEnable(GL_COLOR_MATERIAL);
+    glColorMaterial(GL_FRONT, GL_AMBIENT_AND_DIFFUSE);
+
+    // Set up material properties
+    GLfloat shiny = 25;
+    GLfloat ambientMat[] = {0.0f, 0.0f, 0.0f, 0.0f};
+    GLfloat diffuseMat[] = { 0.0f, 0.0f, 0.0, 0.0f };
+    GLfloat specularMat[] = { 0.5f, 0.5f, 0.5f, 1.0f };
+    glMaterialfv(GL_FRONT_AND_BACK, GL_AMBIENT, ambientMat);
+    glMaterialfv(GL_FRONT_AND_BACK, GL_DIFFUSE, diffuseMat);
+    glMaterialfv(GL_FRONT_AND_BACK, GL_SPECULAR, specularMat);
+    glMaterialfv(GL_FRONT_AND_BACK, GL_SHININESS, &shiny);
+
+    glShadeModel(GL_FLAT);
+
+    glClearColor(0.0f, 0.0f, 0.0f, 0.0f);
+
+    cout << "Using OpenGL Version " << glGetString(GL_VERSION) << endl << endl;
+    // Ideally we would now check to make sure all the OGL functions we use are supported
+    // by the video card.  But that's a pain to do so we're not going to.
+    cout << "--- Loading Resources ---" << endl;
+
+
+    m_dragon = ResourceLoader::loadObjModel("/course/cs123/data/mesh/dragon.obj");
+    cout << "Loaded dragon..." << endl;
+
+    m_sphere = ResourceLoader::loadObjModel("/course/cs123/data/mesh/sphere.obj");
+    cout << "Loaded sphere..." << endl;
+
+    m_elephant = ResourceLoader::loadObjModel("/home/gen/courses/Courses_Fall2011/cs123/final/models/elephal.obj");
+    cout << "Loaded elephant..." << endl;
+
+    m_model1 = ResourceLoader::loadObjModel("/course/cs123/data/mesh/objAnotexture.obj");
+    cout << "Loaded polygon-a-mawhatsit..." << endl;
+
+    m_model2 = ResourceLoader::loadObjModel("/course/cs123/data/mesh/piano.obj");
+    cout << "Loaded piano..." << endl;
+
+
+    char* cube_map = "../final/textures/stpeters_cross.hdr";
+    loadCubeMap(cube_map);
+    cout << "Loaded cube map..." << endl;
+
+    m_skybox = ResourceLoader::loadSkybox(m_environment.texture());
+    cout << "Loaded skybox..." << endl;
+    createShaderPrograms();
+    cout << "Loaded shader programs..." << endl;
+
+    cout << " --- Finish Loading Resources ---" << endl;
+}
+
+/**
+  Load a cube map for the skybox
+ **/
+void Renderer::loadCubeMap(const char* filename)
+{
+    m_environment.load(filename);
+}
+
+/**
+  Moves the animation forward and tells the exposure adaptation how long the
+  frame took.
+
+  @param seconds: the duration of the frame
+  @param ticks: the animation time it covers
+ **/
+void Renderer::advance(float seconds, float ticks)
+{
+    m_frameSeconds = seconds;
+    m_increment += ticks;
+}
+
+/**
+  Draws a frame of the current mode into the default framebuffer.  The render
+  graph is rebuilt first if the mode or the size changed.
+
+  @param width: the width of the output
+  @param height: the height of the output
+ **/
+void Renderer::render(int width, int height)
+{
+    // A streamed cube map replaces the old one between frames
+    m_environment.update();
+
+    // So does a shader program rebuilt after its file was edited
+    if (m_shaders.update())
+        m_renderGraphDirty = true;
+    updateUniforms();
+    m_stateCache.resetCounters();
+
+    // Clear the screen
+    glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+
+    if (m_isHDR && (m_renderGraphDirty || width != m_graphWidth || height != m_graphHeight))
+        buildRenderGraph(width, height);
+
+    // Without post-processing if the graph didn't compile
+    if(!m_isHDR || !m_renderGraphCompiled)
+    {
+        applyPerspectiveCamera(width, height);
+        renderScene();
+    }
+    else
+    {
+        m_renderGraph.execute();
+        if (!m_isBilat && m_autoExposure && m_exposureReadback)
+            readExposure();
+    }
+}
+
+Renderer::Mode Renderer::mode() const
+{
+    if (!m_isHDR)
+        return LowDynamicRange;
+    if (!m_isBilat)
+        return GlobalToneMapping;
+    return m_isEdges ? DetailLayer : BilateralToneMapping;
+}
+
+void Renderer::setMode(Mode mode)
+{
+    m_isHDR = mode != LowDynamicRange;
+    m_isBilat = mode == BilateralToneMapping || mode == DetailLayer;
+    m_isEdges = mode == DetailLayer;
+    m_renderGraphDirty = true;
+}
+
+void Renderer::setAutoExposure(bool enabled)
+{
+    m_autoExposure = enabled;
+    m_exposureReset = true;
+    m_renderGraphDirty = true;
+}
+
+void Renderer::setKeepHdr(bool keep)
+{
+    m_keepHdr = keep;
+    m_renderGraphDirty = true;
+}
+
+/**
+  Create shader programs.
+ **/
+void Renderer::createShaderPrograms()
+{
+    // One buffer holds the uniform blocks: the frame's values and the materials'
+    m_frameBlock = m_uniformBuffer.add(sizeof(FrameUniforms));
+    for (int i = 0; i < NUM_MATERIALS; ++i)
+        m_materialBlocks[i] = m_uniformBuffer.add(sizeof(MaterialUniforms));
+    m_uniformBuffer.create();
+
+    // Programs come from the binary cache or build together in the background
+    m_shaders.add("reflect", "../final/shaders/reflect.vert", "../final/shaders/reflect.frag",
+                  &m_reflectUniforms);
+    m_shaders.add("shadow", "../final/shaders/shadow.vert", "../final/shaders/shadow.frag");
+    m_shaders.add("refract", "../final/shaders/refract.vert", "../final/shaders/refract.frag",
+                  &m_refractUniforms);
+    m_shaders.add("refractFres", "../final/shaders/refractFres.vert", "../final/shaders/refractFres.frag");
+    m_shaders.add("basic", "../final/shaders/basic.vert", "../final/shaders/basic.frag");
+
+    m_shaders.add("luminance", QString(), "../final/shaders/luminance.frag", &m_luminanceUniforms);
+    m_shaders.add("brightpass", QString(), "../final/shaders/brightpass.frag", &m_brightpassUniforms);
+    m_shaders.add("blur", QString(), "../final/shaders/blur.frag", &m_blurUniforms);
+
+    m_shaders.add("bilat_down", QString(), "../final/shaders/bilat_down.frag", &m_bilatDownUniforms);
+    m_shaders.add("bilat", QString(), "../final/shaders/bilat.frag", &m_bilatUniforms);
+
+    m_shaders.add("tonemap", QString(), "../final/shaders/tonemap.frag", &m_tonemapUniforms);
+    m_shaders.add("combine", QString(), "../final/shaders/combine.frag", &m_combineUniforms);
+    m_shaders.add("tester", QString(), "../final/shaders/tester.frag");
+    m_shaders.finishBuilds();
+}
+
+/**
+  Declares the post-processing passes of the current mode and compiles them,
+  which allocates (or reuses) the framebuffer objects they render into.
+
+  Global tone mapping:   scene -> hdr -> tonemap -> screen, plus a bloom pyramid
+                         of the bright parts (1/4 to 1/32 size) added on top.
+                         With auto exposure the hdr luminance is reduced to
+                         1x1 and blended into m_exposureFbo, which tonemap reads.
+  Bilateral tone mapping: scene -> hdr -> log luminance at 1/4 size, bilateral
+                         filtered there into the base layer, which one last
+                         pass upsamples, splits off the detail and compresses.
+
+  @param width: the viewport width
+  @param height: the viewport height
+ **/
+void Renderer::buildRenderGraph(int width, int height)
+{
+    RenderGraph &graph = m_renderGraph;
+    graph.clear();
+
+    // Only the scene needs a depth attachment.  A kept hdr image is imported,
+    // so no later pass can take over its framebuffer.
+    RenderGraph::Target hdr;
+    if (m_keepHdr)
+    {
+        if (!m_hdrFbo || m_hdrFbo->width() != width || m_hdrFbo->height() != height)
+        {
+            delete m_hdrFbo;
+            m_hdrFbo = new QGLFramebufferObject(width, height, QGLFramebufferObject::Depth,
+                                                GL_TEXTURE_2D, GL_RGB16F_ARB);
+        }
+        hdr = graph.importTarget("hdr", m_hdrFbo);
+    }
+    else
+    {
+        hdr = graph.createTarget("hdr", 1, GL_RGB16F_ARB, true);
+    }
+    int pass = graph.addPass("scene", 0, this, &Renderer::scenePass);
+    graph.write(pass, hdr);
+
+    if (!m_isBilat)
+    {
+        RenderGraph::Target exposure = m_autoExposure ? buildExposure(hdr) : RenderGraph::NoTarget;
+        pass = graph.addPass("tonemap", m_shaders.program("tonemap"), this, &Renderer::tonemapPass);
+        graph.read(pass, hdr);
+        if (exposure != RenderGraph::NoTarget)
+            graph.read(pass, exposure);
+        graph.write(pass, RenderGraph::Screen);
+
+        // Bloom pyramid: the bright parts at half size are halved again for
+        // every level and blurred there, then the levels are added back up
+        // from the smallest one, so wide glows only cost small blurs
+        RenderGraph::Target bright = graph.createTarget("bright", 2, GL_RGB16F_ARB);
+        pass = graph.addPass("brightpass", m_shaders.program("brightpass"), this, &Renderer::brightPass);
+        graph.read(pass, hdr);
+        if (exposure != RenderGraph::NoTarget)
+            graph.read(pass, exposure);
+        graph.write(pass, bright);
+
+        RenderGraph::Target levels[BLOOM_LEVELS];
+        RenderGraph::Target previous = bright;
+        for (int i = 0; i < BLOOM_LEVELS; ++i)
+        {
+            int divisor = 4 << i;
+            QString name = QString("bloom%1").arg(divisor);
+            RenderGraph::Target down = graph.createTarget(name + "_down", divisor, GL_RGB16F_ARB);
+            RenderGraph::Target half = graph.createTarget(name + "_h", divisor, GL_RGB16F_ARB);
+            levels[i] = graph.createTarget(name, divisor, GL_RGB16F_ARB);
+
+            pass = graph.addPass(name + " down", 0, this, &Renderer::downsamplePass);
+            graph.read(pass, previous);
+            graph.write(pass, down);
+
+            pass = graph.addPass(name + " blur_h", m_shaders.program("blur"), this, &Renderer::blurHorizontalPass);
+            graph.read(pass, down);
+            graph.write(pass, half);
+
+            pass = graph.addPass(name + " blur_v", m_shaders.program("blur"), this, &Renderer::blurVerticalPass);
+            graph.read(pass, half);
+            graph.write(pass, levels[i]);
+
+            previous = down;
+        }
+
+        RenderGraph::Target sum = levels[BLOOM_LEVELS - 1];
+        for (int i = BLOOM_LEVELS - 2; i >= 0; --i)
+        {
+            QString name = QString("bloom%1").arg(4 << i);
+            RenderGraph::Target up = graph.createTarget(name + "_up", 4 << i, GL_RGB16F_ARB);
+            pass = graph.addPass(name + " up", 0, this, &Renderer::upsamplePass);
+            graph.read(pass, levels[i]);
+            graph.read(pass, sum);
+            graph.write(pass, up);
+            sum = up;
+        }
+
+        pass = graph.addPass("bloom", 0, this, &Renderer::bloomPass);
+        graph.read(pass, sum);
+        graph.write(pass, RenderGraph::Screen);
+    }
+    else
+    {
+        RenderGraph::Target logLum = graph.createTarget("loglum", BILAT_DOWNSAMPLE, GL_RGB16F_ARB);
+        RenderGraph::Target half = graph.createTarget("bilat_h", BILAT_DOWNSAMPLE, GL_RGB16F_ARB);
+        RenderGraph::Target base = graph.createTarget("base", BILAT_DOWNSAMPLE, GL_RGB16F_ARB);
+        createBilatKernel(m_bilatRadius, m_bilatWeights);
+
+        pass = graph.addPass("bilat_down", m_shaders.program("bilat_down"), this, &Renderer::bilatDownsamplePass);
+        graph.read(pass, hdr);
+        graph.write(pass, logLum);
+
+        pass = graph.addPass("bilat_h", m_shaders.program("bilat"), this, &Renderer::bilatHorizontalPass);
+        graph.read(pass, logLum);
+        graph.write(pass, half);
+
+        pass = graph.addPass("bilat_v", m_shaders.program("bilat"), this, &Renderer::bilatVerticalPass);
+        graph.read(pass, half);
+        graph.write(pass, base);
+
+        // Splits off the detail layer (or draws it, for the edges) and
+        // recombines in the same pass
+        pass = graph.addPass("combine", m_shaders.program("combine"), this, &Renderer::combinePass);
+        graph.read(pass, hdr);
+        graph.read(pass, base);
+        graph.write(pass, RenderGraph::Screen);
+    }
+
+    // Tried once until something changes the graph, so a broken one is reported once
+    m_renderGraphCompiled = graph.compile(width, height);
+    if (!m_renderGraphCompiled)
+        cout << "Render graph doesn't compile, drawing the scene without post-processing" << endl;
+    m_renderGraphDirty = false;
+    m_graphWidth = width;
+    m_graphHeight = height;
+}
+
+/**
+  Declares the automatic exposure passes: the luminance of the hdr target is
+  reduced to one pixel holding its log average and maximum, which is blended
+  into m_exposureFbo so the exposure adapts over time.  The result stays on the
+  GPU; tonemap.frag reads it as a texture.
+
+  @param hdr: the target to measure
+  @return the imported target of m_exposureFbo
+ **/
+RenderGraph::Target Renderer::buildExposure(RenderGraph::Target hdr)
+{
+    RenderGraph &graph = m_renderGraph;
+    if (!m_exposureFbo)
+    {
+        m_exposureFbo = new QGLFramebufferObject(1, 1, QGLFramebufferObject::NoAttachment,
+                                                 GL_TEXTURE_2D, GL_RGBA16F_ARB);
+        m_exposureReset = true;
+    }
+
+    // Every step shrinks the image by 4 in both directions
+    RenderGraph::Target level = graph.createFixedTarget("luminance", LUMINANCE_SIZE, LUMINANCE_SIZE, GL_RGB16F_ARB);
+    int pass = graph.addPass("luminance", m_shaders.program("luminance"), this, &Renderer::luminancePass);
+    graph.read(pass, hdr);
+    graph.write(pass, level);
+    for (int size = LUMINANCE_SIZE / 4; size >= 1; size /= 4)
+    {
+        QString name = QString("luminance%1").arg(size);
+        RenderGraph::Target next = graph.createFixedTarget(name, size, size, GL_RGB16F_ARB);
+        pass = graph.addPass(name, m_shaders.program("luminance"), this, &Renderer::reducePass);
+        graph.read(pass, level);
+        graph.write(pass, next);
+        level = next;
+    }
+
+    RenderGraph::Target exposure = graph.importTarget("exposure", m_exposureFbo);
+    pass = graph.addPass("adapt", 0, this, &Renderer::adaptPass);
+    graph.read(pass, level);
+    graph.write(pass, exposure);
+    return exposure;
+}
+
+/**
+  Starts reading the adapted exposure back through the PBO ring and takes the
+  newest readback that has arrived, for tone mapping without sampling the
+  exposure texture.  Never waits for the GPU.
+ **/
+void Renderer::readExposure()
+{
+    GLfloat pixel[4];
+    m_exposureFbo->bind();
+    m_exposureReadbacks.read(0, 0, 1, 1, GL_RGBA, GL_FLOAT, sizeof(pixel));
+    m_exposureFbo->release();
+    while (m_exposureReadbacks.take(pixel))
+    {
+        m_logAverage = pixel[0];
+        m_maxLuminance = pixel[1];
+    }
+}
+
+/**
+  Called to switch to an orthogonal OpenGL camera.
+  Useful for rending a textured quad across the whole screen.
+
+  @param width: the viewport width
+  @param height: the viewport height
+**/
+void Renderer::applyOrthogonalCamera(float width, float height)
+{
+    glMatrixMode(GL_PROJECTION);
+    glLoadIdentity();
+    glOrtho(0, width, height, 0.f, -1.f, 1.f);
+    glMatrixMode(GL_MODELVIEW);
+    glLoadIdentity();
+}
+
+/**
+  Called to switch to a perspective OpenGL camera.
+
+  @param width: the viewport width
+  @param height: the viewport height
+**/
+void Renderer::applyPerspectiveCamera(float width, float height)
+{
+    float ratio = ((float) width) / height;
+    Vector3 dir(-Vector3::fromAngles(m_camera.theta, m_camera.phi));
+    Vector3 eye(m_camera.center - dir * m_camera.zoom);
+
+    glMatrixMode(GL_PROJECTION);
+    glLoadIdentity();
+    gluPerspective(m_camera.fovy, ratio, 0.1f, 1000.f);
+    gluLookAt(eye.x, eye.y, eye.z, eye.x + dir.x, eye.y + dir.y, eye.z + dir.z,
+              m_camera.up.x, m_camera.up.y, m_camera.up.z);
+    glMatrixMode(GL_MODELVIEW);
+    glLoadIdentity();
+}
+
+
+int fact(int n){
+    if(n <= 0)
+        return 1;
+    else
+        return (n * fact(n - 1));
+}
+
+float bernstein(int n, int j, float t){
+    float b = fact(n)/((fact(j) * fact(n - j))) * pow(t, j) * pow((1-t), (n-j));
+    return b;
+}
+//
+//n = # petal
+//P = [];
+//at = 1/3*pi;
+//a1 = n/3*pi;
+//r1 = 1;
+//r2 = 3;
+//r3 = sqrt(r1*r1+r2*r2);
+//a2 = pi/2 - at/2;
+//a3 = asin((r2*sin(a2))/r3);
+//P = [r1*cos(a1); r1*sin(a1); 0];
+//P = [P [r3*cos(a1+at-a3); r3*sin(a1+at-a3); 0]];
+//P = [P [r3*cos(a1+a3); r3*sin(a1+a3); 0]];
+//P = [P [r1*cos(a1+at); r1*sin(a1+at); 0]];
+//
+//LOOP
+//n = # loop
+//P = [];
+//at = 1/3*pi;
+//a1 = n/3*pi;
+//r1 = 1;
+//r2 = 3;
+//r3 = sqrt(r1*r1+r2*r2);
+//a2 = pi/2 - at/2;
+//a3 = asin((r2*sin(a2))/r3);
+//P = [r1*cos(a1); r1*sin(a1); 0];
+//P = [P [r3*cos(a1+a3); r3*sin(a1+a3); 0]];
+//P = [P [r3*cos(a1+at-a3); r3*sin(a1+at-a3); 0]];
+//P = [P [r1*cos(a1+at); r1*sin(a1+at); 0]];
+
+
+// xs and ys are size 4, petal between 0 and 5
+void makeBezPet(float* xs, float* ys, int petal){
+    float at = M_PI/3.0;
+    float a1 = (petal * M_PI)/3.0;
+    float r1 = 2.0;
+    float r2 = 3.0;
+    float r3 = sqrt((r1 * r1) + (r2 * r2));
+    float a2 = (M_PI/2.0) - (at/2.0);
+    float a3 = asin((r2 * sin(a2))/r3);
+    xs[0] = r1 * cos(a1);
+    xs[1] = r3 * cos(a1+at-a3);
+    xs[2] = r3 * cos(a1+a3);
+    xs[3] = r1 * cos(a1+at);
+
+    ys[0] = r1*sin(a1);
+    ys[1] = r3*sin(a1+at-a3);
+    ys[2] = r3*sin(a1+a3);
+    ys[3] = r1*sin(a1+at);
+}
+
+void makeBezLoop(float* xs, float* ys, int petal){
+    float at = M_PI/3.0;
+    float a1 = (petal * M_PI)/3.0;
+    float r1 = 2.0;
+    float r2 = 3.0;
+    float r3 = sqrt((r1 * r1) + (r2 * r2));
+    float a2 = (M_PI/2.0) - (at/2.0);
+    float a3 = asin((r2 * sin(a2))/r3);
+    xs[1] = r1 * cos(a1);
+    xs[0] = r3*cos(a1+at-a3);
+    xs[3] = r3*cos(a1+a3);
+    xs[2] = r1*cos(a1+at);
+
+    ys[1] = r1*sin(a1);
+    ys[0] = r3*sin(a1+at-a3);
+    ys[3] = r3*sin(a1+a3);
+    ys[2] = r1*sin(a1+at);
+}
+
+/**
+  Renders the scene.  May be called multiple times by render() if necessary.
+  The draws are collected in m_drawList, which sorts them by state and
+  submits them through m_stateCache.
+**/
+void Renderer::renderScene() {
+
+    m_drawList.clear();
+
+    // The skybox, drawn with the fixed function
+    DrawItem skybox;
+    skybox.callList = m_skybox;
+    skybox.cubeMap = m_environment.texture();
+    skybox.cull = false;
+    m_drawList.add(skybox);
+
+    // The glass models, with the refraction shader
+    DrawItem glass;
+    glass.program = m_shaders.program("refract");
+    glass.material = m_materialBlocks[GlassMaterial];
+    glass.cubeMap = m_environment.texture();
+
+    float div_val = 1.0;
+    if(!m_isBilat)
+    {
+    if(!m_isHDR){
+        div_val = 250;
+    }
+    else{
+        div_val = 100;
+    }
+
+    float time = m_increment / div_val;
+
+    float pxs[13] = {-10, -5, 0, 5, 10, 7.5, 10, 5, 0, -5, -10, -7.5, -10};
+    float pys[13] = {10, 10, 15, 10, 10, 0, -10, -10, 15, -10, -10, 0, 10};
+
+    for(int i = 0; i < 13; i++){
+        pxs[i] *= 0.8;
+        pys[i] *= 0.8;
+    }
+
+    float pianoxs[8] = {4.7, 7.7, 19.6, 11.9, 13.8, 9.9, 14.1, 4.7};
+    float pianozs[8] = {12.9, 7.1, 10.1, 29.1, 20.6, 19.2, 12.4, 12.9};
+    float pianoys[8] = {0.0, 1.0, -1.0, 0.0, 1.0, -1.0, 5.0, 0.0};
+
+    //Make star points...
+
+    float t = fmod(time, 1);
+    float tpiano = fmod(time, 6);
+    float px = 0;
+    float py = 0;
+
+    float pianox = 0;
+    float pianoy = 0;
+    float pianoz = 0;
+
+    for(int j = 0; j < 13; j++){
+        px += pxs[j] * bernstein(12, j, t);
+        py += pys[j] * bernstein(12, j, t);
+    }
+
+    for(int j = 0; j < 8; j++){
+        pianox += pianoxs[j] * bernstein(7, j, tpiano/2) - 1;
+        pianoy += pianoys[j] * bernstein(7, j, tpiano/2);
+        pianoz += pianozs[j] * bernstein(7, j, tpiano/2) - 2;
+    }
+
+    float arcx = 0;
+    float arcy = 0;
+
+    float arc0xs[4];
+    float arc0ys[4];
+    float arc1xs[4];
+    float arc1ys[4];
+    float arc2xs[4];
+    float arc2ys[4];
+    float arc3xs[4];
+    float arc3ys[4];
+    float arc4xs[4];
+    float arc4ys[4];
+    float arc5xs[4];
+    float arc5ys[4];
+
+    makeBezPet(arc0xs, arc0ys, 0);
+    makeBezPet(arc1xs, arc1ys, 1);
+    makeBezPet(arc2xs, arc2ys, 2);
+    makeBezPet(arc3xs, arc3ys, 3);
+    makeBezPet(arc4xs, arc4ys, 4);
+    makeBezPet(arc5xs, arc5ys, 5);
+
+//    for(int i = 0; i < 4; i++){
+//        std::cout<<"xarc0: "<<arc0xs[i]<<std::endl;
+//        std::cout<<"yarc0: "<<arc0ys[i]<<std::endl;
+//    }
+//    for(int i = 0; i < 4; i++){
+//        std::cout<<"xarc1: "<<arc1xs[i]<<std::endl;
+//        std::cout<<"yarc1: "<<arc1ys[i]<<std::endl;
+//    }
+   // std::cout<<arc1xs[1]<<std::endl;
+
+
+    if((tpiano >= 0.85) && (tpiano < 1.85)){
+        for(int j = 0; j < 4; j++){
+            arcx += arc1xs[j] * bernstein(4, j, (tpiano - 1));
+            arcy += arc1ys[j] * bernstein(4, j, (tpiano - 1));
+        }
+    }
+    else if((tpiano >= 1.85) && (tpiano < 2.85)){
+        for(int j = 0; j < 4; j++){
+            arcx += arc2xs[j] * bernstein(4, j, (tpiano - 2));
+            arcy += arc2ys[j] * bernstein(4, j, (tpiano - 2));
+        }
+    }
+    else if((tpiano >= 2.85) && (tpiano < 3.85)){
+        for(int j = 0; j < 4; j++){
+            arcx += arc3xs[j] * bernstein(4, j, (tpiano - 3));
+            arcy += arc3ys[j] * bernstein(4, j, (tpiano - 3));
+        }
+    }
+    else if((tpiano >=  3.85) && (tpiano < 4.85)){
+        for(int j = 0; j < 4; j++){
+            arcx += arc4xs[j] * bernstein(4, j, (tpiano - 4));
+            arcy += arc4ys[j] * bernstein(4, j, (tpiano - 4));
+        }
+    }
+    else if((tpiano >= 4.85) && (tpiano < 5.85)){
+        for(int j = 0; j < 4; j++){
+            arcx += arc5xs[j] * bernstein(4, j, (tpiano - 5));
+            arcy += arc5ys[j] * bernstein(4, j, (tpiano - 5));
+        }
+    }
+    else{
+        for(int j = 0; j < 4; j++){
+            arcx += arc0xs[j] * bernstein(4, j, tpiano);
+            arcy += arc0ys[j] * bernstein(4, j, tpiano);
+        }
+    }
+
+    glass.model = m_model2.model;
+    glass.mesh = m_model2.mesh;
+    glass.transform = Transform().translate(arcx, arcy, 0).scale(0.3f, 0.3f, 0.3f);
+    m_drawList.add(glass);
+
+
+    float scoopx = 0;
+    float scoopy = 0;
+
+    float scoop0xs[4];
+    float scoop0ys[4];
+    float scoop1xs[4];
+    float scoop1ys[4];
+    float scoop2xs[4];
+    float scoop2ys[4];
+    float scoop3xs[4];
+    float scoop3ys[4];
+    float scoop4xs[4];
+    float scoop4ys[4];
+    float scoop5xs[4];
+    float scoop5ys[4];
+
+    makeBezLoop(scoop0xs, scoop0ys, 0);
+    makeBezLoop(scoop1xs, scoop1ys, 1);
+    makeBezLoop(scoop2xs, scoop2ys, 2);
+    makeBezLoop(scoop3xs, scoop3ys, 3);
+    makeBezLoop(scoop4xs, scoop4ys, 4);
+    makeBezLoop(scoop5xs, scoop5ys, 5);
+
+//    for(int i = 0; i < 4; i++){
+//        std::cout<<"xscoop0: "<<scoop0xs[i]<<std::endl;
+//        std::cout<<"yscoop0: "<<scoop0ys[i]<<std::endl;
+//    }
+//    for(int i = 0; i < 4; i++){
+//        std::cout<<"xscoop1: "<<scoop1xs[i]<<std::endl;
+//        std::cout<<"yscoop1: "<<scoop1ys[i]<<std::endl;
+//    }
+   // std::cout<<scoop1xs[1]<<std::endl;
+
+
+    if((tpiano >= 0.92) && (tpiano < 1.85)){
+        for(int j = 0; j < 4; j++){
+            scoopx += scoop1xs[j] * bernstein(4, j, (tpiano - 1));
+            scoopy += scoop1ys[j] * bernstein(4, j, (tpiano - 1));
+        }
+    }
+    else if((tpiano >= 1.92) && (tpiano < 2.85)){
+        for(int j = 0; j < 4; j++){
+            scoopx += scoop2xs[j] * bernstein(4, j, (tpiano - 2));
+            scoopy += scoop2ys[j] * bernstein(4, j, (tpiano - 2));
+        }
+    }
+    else if((tpiano >= 2.92) && (tpiano < 3.85)){
+        for(int j = 0; j < 4; j++){
+            scoopx += scoop3xs[j] * bernstein(4, j, (tpiano - 3));
+            scoopy += scoop3ys[j] * bernstein(4, j, (tpiano - 3));
+        }
+    }
+    else if((tpiano >=  3.92) && (tpiano < 4.85)){
+        for(int j = 0; j < 4; j++){
+            scoopx += scoop4xs[j] * bernstein(4, j, (tpiano - 4));
+            scoopy += scoop4ys[j] * bernstein(4, j, (tpiano - 4));
+        }
+    }
+    else if((tpiano >= 4.92) && (tpiano < 5.85)){
+        for(int j = 0; j < 4; j++){
+            scoopx += scoop5xs[j] * bernstein(4, j, (tpiano - 5));
+            scoopy += scoop5ys[j] * bernstein(4, j, (tpiano - 5));
+        }
+    }
+    else{
+        for(int j = 0; j < 4; j++){
+            scoopx += scoop0xs[j] * bernstein(4, j, tpiano);
+            scoopy += scoop0ys[j] * bernstein(4, j, tpiano);
+        }
+    }
+    glass.model = m_model1.model;
+    glass.mesh = m_model1.mesh;
+    glass.transform = Transform().translate(scoopx, 0, scoopy).scale(0.3f, 0.3f, 0.3f);
+    m_drawList.add(glass);
+
+//    glPushMatrix();
+//    glTranslatef(px, py, 0);
+//    glScalef(0.5f, 0.5f, 0.5f);
+//    glmDrawMesh(m_model1.model, m_model1.mesh);
+//    glPopMatrix();
+//
+
+    float rad =1.5f;
+    float a1 = -rad*cos(fmod(time, (2*M_PI)));
+    float a2 = rad*sin(fmod(time, (2*M_PI)));
+    float a3 = 0.f;
+
+    float angle;
+    if(a1 >=0){
+        angle= atan(a2/a1)*180.0/M_PI - 90;
+    }
+    else{
+        angle= atan(a2/a1)*180.0/M_PI + 90;
+    }
+    glass.model = m_dragon.model;
+    glass.mesh = m_dragon.mesh;
+    glass.transform = Transform().translate(a1, a2, a3).scale(0.3f, 0.3f, 0.3f)
+                                 .rotate(angle, 0, 0, 1).rotate(180, 0, 1, 0);
+    m_drawList.add(glass);
+
+    a1 =-rad*cos(fmod(time+0.5, (2*M_PI)));
+    a2 =rad*sin(fmod(time+0.5, (2*M_PI)));
+    if(a1 >=0){
+        angle = atan(a2/a1)*180.0/M_PI - 90;
+    }
+    else{
+        angle = atan(a2/a1)*180.0/M_PI + 90;
+    }
+    glass.model = m_elephant.model;
+    glass.mesh = m_elephant.mesh;
+    glass.transform = Transform().translate(a1, a2, a3).scale(0.3f, 0.3f, 0.3f)
+                                 .rotate(angle, 0, 0, 1).rotate(90, 0, 1, 0);
+    m_drawList.add(glass);
+    }
+
+    else
+    {
+        float rad =1.5f;
+        glass.model = m_dragon.model;
+        glass.mesh = m_dragon.mesh;
+        glass.transform = Transform().translate(rad, 0.f, 0.f).scale(0.3f, 0.3f, 0.3f)
+                                     .rotate(-45, 0, 0, 1).rotate(180, 0, 1, 0);
+        m_drawList.add(glass);
+    }
+
+    // The sphere, with the reflection shader
+    DrawItem sphere;
+    sphere.model = m_sphere.model;
+    sphere.mesh = m_sphere.mesh;
+    sphere.program = m_shaders.program("reflect");
+    sphere.material = m_materialBlocks[SphereMaterial];
+    sphere.cubeMap = m_environment.texture();
+    m_drawList.add(sphere);
+
+    glClear(GL_DEPTH_BUFFER_BIT);
+    m_drawList.submit(m_stateCache, m_uniformBuffer, MATERIAL_BINDING);
+}
+
+/**
+  Render graph pass: draws the scene from the camera.
+**/
+void Renderer::scenePass(const RenderGraph::PassContext &context)
+{
+    applyPerspectiveCamera(context.width, context.height);
+    renderScene();
+}
+
+/**
+  Writes the Frame and Material uniform blocks for this frame, with a single
+  mapping of the uniform buffer, and binds the Frame block.  The exposure
+  read back comes from the frames before, as it did when it was set per pass.
+**/
+void Renderer::updateUniforms()
+{
+    static const float roughness[NUM_MATERIALS] = { GLASS_ROUGHNESS, SPHERE_ROUGHNESS };
+    static const float diffuse[NUM_MATERIALS] = { 0.f, SPHERE_DIFFUSE };
+
+    FrameUniforms frame;
+    memset(&frame, 0, sizeof(frame));
+    const float *irradiance = m_environment.irradiance();
+    for (int i = 0; i < 9; ++i)
+        for (int c = 0; c < 3; ++c)
+            frame.irradiance[i][c] = irradiance[3 * i + c];
+    frame.exposure = m_exp;
+    frame.logAverage = m_logAverage;
+    frame.maxLuminance = m_maxLuminance;
+    frame.maxLod = m_environment.maxLod();
+    frame.autoExposure = m_autoExposure;
+    frame.readback = m_exposureReadback;
+
+    char *data = m_uniformBuffer.map();
+    if (!data)
+        return;
+    memcpy(data + m_uniformBuffer.offset(m_frameBlock), &frame, sizeof(frame));
+    for (int i = 0; i < NUM_MATERIALS; ++i)
+    {
+        MaterialUniforms material;
+        memset(&material, 0, sizeof(material));
+        material.roughness = roughness[i];
+        material.diffuse = diffuse[i];
+        memcpy(data + m_uniformBuffer.offset(m_materialBlocks[i]), &material, sizeof(material));
+    }
+    m_uniformBuffer.unmap();
+    m_uniformBuffer.bind(m_frameBlock, FRAME_BINDING);
+}
+
+/**
+  Binds the adapted luminance that tonemap.frag and brightpass.frag sample to
+  texture unit 1: with auto exposure it is the pass's second input.  The rest
+  of the exposure comes from the Frame block.
+**/
+void Renderer::bindExposure(const RenderGraph::PassContext &context)
+{
+    glActiveTexture(GL_TEXTURE1);
+    glBindTexture(GL_TEXTURE_2D, context.inputs.size() > 1 ? context.inputs[1] : 0);
+    glActiveTexture(GL_TEXTURE0);
+}
+
+void Renderer::releaseExposure()
+{
+    glActiveTexture(GL_TEXTURE1);
+    glBindTexture(GL_TEXTURE_2D, 0);
+    glActiveTexture(GL_TEXTURE0);
+}
+
+/**
+  Render graph pass: global tone mapping of the first input.
+**/
+void Renderer::tonemapPass(const RenderGraph::PassContext &context)
+{
+    applyOrthogonalCamera(context.width, context.height);
+    context.program->bind();
+    bindExposure(context);
+    renderTexture(context.inputs[0], context.width, context.height);
+    releaseExposure();
+    context.program->release();
+}
+
+/**
+  Render graph passes: the first and the following steps of the luminance
+  reduction (see luminance.frag).
+**/
+void Renderer::luminancePass(const RenderGraph::PassContext &context)
+{
+    renderReduction(context, true);
+}
+
+void Renderer::reducePass(const RenderGraph::PassContext &context)
+{
+    renderReduction(context, false);
+}
+
+/**
+  Reduces 4x4 samples of the first input to every output pixel.  The hdr
+  image is sampled linearly, the later levels exactly, as the maximum must not
+  be filtered.
+
+  @param first: whether the input is the hdr image
+**/
+void Renderer::renderReduction(const RenderGraph::PassContext &context, bool first)
+{
+    QGLShaderProgram *program = context.program;
+    GLenum filter = first ? GL_LINEAR : GL_NEAREST;
+
+    applyOrthogonalCamera(context.width, context.height);
+    program->bind();
+    m_luminanceUniforms.spacing.set(Vector2(0.25f / context.width, 0.25f / context.height));
+    m_luminanceUniforms.first.set(first);
+    glBindTexture(GL_TEXTURE_2D, context.inputs[0]);
+    glTexParameterf(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, filter);
+    glTexParameterf(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, filter);
+    renderTexturedQuad(context.width, context.height, true);
+    glBindTexture(GL_TEXTURE_2D, 0);
+    program->release();
+}
+
+/**
+  Render graph pass: moves the adapted exposure toward the 1x1 luminance in the
+  first input, by blending with a factor that depends on the frame time.  The
+  first frame takes it over as it is.
+**/
+void Renderer::adaptPass(const RenderGraph::PassContext &context)
+{
+    float amount = m_exposureReset ? 1.f : 1.f - exp(-m_adaptationRate * m_frameSeconds);
+    m_exposureReset = false;
+
+    applyOrthogonalCamera(context.width, context.height);
+    glEnable(GL_BLEND);
+    glBlendColor(0.f, 0.f, 0.f, amount);
+    glBlendFunc(GL_CONSTANT_ALPHA, GL_ONE_MINUS_CONSTANT_ALPHA);
+    renderTexture(context.inputs[0], context.width, context.height);
+    glDisable(GL_BLEND);
+}
+
+/**
+  Render graph pass: keeps the part of the exposed first input that is
+  brighter than m_bloomThreshold, exposed like the tone mapped image.
+**/
+void Renderer::brightPass(const RenderGraph::PassContext &context)
+{
+    applyOrthogonalCamera(context.width, context.height);
+    context.program->bind();
+    m_brightpassUniforms.threshold.set(m_bloomThreshold);
+    bindExposure(context);
+    renderTextureLinear(context.inputs[0], context.width, context.height);
+    releaseExposure();
+    context.program->release();
+}
+
+/**
+  Render graph pass: halves the first input.  Every output pixel lands on the
+  corner of four input pixels, so the linear filter averages them.
+**/
+void Renderer::downsamplePass(const RenderGraph::PassContext &context)
+{
+    applyOrthogonalCamera(context.width, context.height);
+    renderTextureLinear(context.inputs[0], context.width, context.height);
+}
+
+/**
+  Render graph pass: adds the second input (a smaller level of the bloom
+  pyramid), stretched to the output size, to the first one.
+**/
+void Renderer::upsamplePass(const RenderGraph::PassContext &context)
+{
+    applyOrthogonalCamera(context.width, context.height);
+    renderTextureLinear(context.inputs[0], context.width, context.height);
+    glEnable(GL_BLEND);
+    glBlendFunc(GL_ONE, GL_ONE);
+    renderTextureLinear(context.inputs[1], context.width, context.height);
+    glDisable(GL_BLEND);
+}
+
+/**
+  Render graph pass: adds the (lower resolution) bloom on top of the output.
+**/
+void Renderer::bloomPass(const RenderGraph::PassContext &context)
+{
+    applyOrthogonalCamera(context.width, context.height);
+    glEnable(GL_BLEND);
+    glBlendFunc(GL_ONE, GL_ONE);
+    renderTextureLinear(context.inputs[0], context.width, context.height);
+    glDisable(GL_BLEND);
+}
+
+/**
+  Render graph pass: shrinks the first input to its log luminance (see bilat_down.frag).
+**/
+void Renderer::bilatDownsamplePass(const RenderGraph::PassContext &context)
+{
+    applyOrthogonalCamera(context.width, context.height);
+    context.program->bind();
+    m_bilatDownUniforms.texel.set(Vector2(1.f / (context.width * BILAT_DOWNSAMPLE),
+                                          1.f / (context.height * BILAT_DOWNSAMPLE)));
+    renderTextureLinear(context.inputs[0], context.width, context.height);
+    context.program->release();
+}
+
+/**
+  Render graph passes: the two halves of the separable bilateral filter.
+**/
+void Renderer::bilatHorizontalPass(const RenderGraph::PassContext &context)
+{
+    renderBilateral(context, 1.f / context.width, 0.f);
+}
+
+void Renderer::bilatVerticalPass(const RenderGraph::PassContext &context)
+{
+    renderBilateral(context, 0.f, 1.f / context.height);
+}
+
+/**
+  Bilateral filters the first input along one axis, with the spatial weights
+  of m_bilatRadius and the range sigma m_bilatRangeSigma.
+
+  @param dx, dy: one texel along the filter axis, in texture coordinates
+**/
+void Renderer::renderBilateral(const RenderGraph::PassContext &context, float dx, float dy)
+{
+    QGLShaderProgram *program = context.program;
+
+    applyOrthogonalCamera(context.width, context.height);
+    program->bind();
+    m_bilatUniforms.direction.set(Vector2(dx, dy));
+    m_bilatUniforms.radius.set(m_bilatRadius);
+    m_bilatUniforms.weights.set(m_bilatWeights, m_bilatRadius + 1);
+    m_bilatUniforms.rangeScale.set(-0.5f / (m_bilatRangeSigma * m_bilatRangeSigma));
+    renderTexture(context.inputs[0], context.width, context.height);
+    program->release();
+}
+
+/**
+  Render graph pass: Durand-Dorsey tone mapping of the first input (hdr) with
+  the bilateral filtered base layer in the second one.  Draws the detail layer
+  instead when the edges are shown.
+**/
+void Renderer::combinePass(const RenderGraph::PassContext &context)
+{
+    QGLShaderProgram *program = context.program;
+
+    applyOrthogonalCamera(context.width, context.height);
+    program->bind();
+    m_combineUniforms.baseSize.set(Vector2(context.width / BILAT_DOWNSAMPLE, context.height / BILAT_DOWNSAMPLE));
+    m_combineUniforms.rangeScale.set(-0.5f / (m_bilatRangeSigma * m_bilatRangeSigma));
+    m_combineUniforms.compression.set(m_bilatCompression);
+    m_combineUniforms.showDetail.set(m_isEdges);
+
+    glActiveTexture(GL_TEXTURE1);
+    glBindTexture(GL_TEXTURE_2D, context.inputs[1]);
+    glActiveTexture(GL_TEXTURE0);
+    renderTexture(context.inputs[0], context.width, context.height);
+    glActiveTexture(GL_TEXTURE1);
+    glBindTexture(GL_TEXTURE_2D, 0);
+    glActiveTexture(GL_TEXTURE0);
+    program->release();
+}
+
+/**
+  Render graph passes: the two halves of the separable bloom blur.
+**/
+void Renderer::blurHorizontalPass(const RenderGraph::PassContext &context)
+{
+    renderBlur(context, 1.f / context.width, 0.f);
+}
+
+void Renderer::blurVerticalPass(const RenderGraph::PassContext &context)
+{
+    renderBlur(context, 0.f, 1.f / context.height);
+}
+
+/**
+  Blurs the first input along one axis with a gaussian of radius m_blurRadius.
+  The input must have the size of the output.
+
+  @param dx, dy: one texel along the blur axis, in texture coordinates
+**/
+void Renderer::renderBlur(const RenderGraph::PassContext &context, float dx, float dy)
+{
+    const BlurKernel &kernel = blurKernel(m_blurRadius);
+    QGLShaderProgram *program = context.program;
+
+    applyOrthogonalCamera(context.width, context.height);
+    program->bind();
+    m_blurUniforms.direction.set(Vector2(dx, dy));
+    m_blurUniforms.taps.set(kernel.taps);
+    m_blurUniforms.offsets.set(kernel.offsets, kernel.taps);
+    m_blurUniforms.weights.set(kernel.weights, kernel.taps);
+
+    // The merged taps rely on the linear filter to weight their two texels
+    renderTextureLinear(context.inputs[0], context.width, context.height);
+    program->release();
+}
+
+/**
+  Draws a textured quad. The texture most be bound and unbound
+  before and after calling this method - this method assumes that the texture
+  has been bound before hand.
+
+  @param w: the width of the quad to draw
+  @param h: the height of the quad to draw
+  @param flip: flip the texture vertically
+**/
+void Renderer::renderTexturedQuad(int width, int height, bool flip) {
+    // Clamp value to edge of texture when texture index is out of bounds
+    glTexParameterf(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+    glTexParameterf(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+
+    // Draw the  quad
+    glBegin(GL_QUADS);
+    glTexCoord2f(0.0f, flip ? 1.0f : 0.0f);
+    glVertex2f(0.0f, 0.0f);
+    glTexCoord2f(1.0f, flip ? 1.0f : 0.0f);
+    glVertex2f(width, 0.0f);
+    glTexCoord2f(1.0f, flip ? 0.0f : 1.0f);
+    glVertex2f(width, height);
+    glTexCoord2f(0.0f, flip ? 0.0f : 1.0f);
+    glVertex2f(0.0f, height);
+    glEnd();
+}
+
+/**
+  Draws a texture over a width x height output, keeping it upright.
+  This binds and unbinds the texture itself.
+
+  @param texture: the texture to draw
+  @param width: the width of the quad to draw
+  @param height: the height of the quad to draw
+**/
+void Renderer::renderTexture(GLuint texture, int width, int height)
+{
+    glBindTexture(GL_TEXTURE_2D, texture);
+    renderTexturedQuad(width, height, true);
+    glBindTexture(GL_TEXTURE_2D, 0);
+}
+
+/**
+  Like renderTexture, but samples the texture with linear filtering, for
+  textures of a different size than the output.
+**/
+void Renderer::renderTextureLinear(GLuint texture, int width, int height)
+{
+    glBindTexture(GL_TEXTURE_2D, texture);
+    glTexParameterf(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    glTexParameterf(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+    renderTexturedQuad(width, height, true);
+    glBindTexture(GL_TEXTURE_2D, 0);
+}
+
+/**
+  Creates one side of a normalized 1D gaussian kernel with the specified radius
+  (sigma = radius / 3).  Texels 2i-1 and 2i are merged into one tap placed
+  between them so that a single linear texture fetch returns their weighted
+  sum, which roughly halves the fetches: radius 64 takes 33 taps per side.
+
+  @param radius: The radius of the kernel to create, at most MAX_BLUR_RADIUS.
+  @param weights: The array to write the tap weights to.
+  @param offsets: The array to write the tap offsets (in texels) to.
+  @return The number of taps, counting the center one.
+**/
+int Renderer::createBlurKernel(int radius, GLfloat* weights, GLfloat* offsets)
+{
+    weights[0] = 1.0f;
+    offsets[0] = 0.0f;
+    if (radius < 1)
+        return 1;
+
+    float sigma = radius / 3.0f;
+    float twoSigmaSigma = 2.0f * sigma * sigma;
+    float texel[MAX_BLUR_RADIUS + 2];
+    float total = 0.0f;
+    for (int x = 0; x <= radius; ++x)
+    {
+        texel[x] = exp(-(x * x) / twoSigmaSigma);
+        total += x ? 2.0f * texel[x] : texel[x];
+    }
+    texel[radius + 1] = 0.0f;
+
+    int taps = 1;
+    weights[0] = texel[0] / total;
+    for (int x = 1; x <= radius; x += 2, ++taps)
+    {
+        float weight = texel[x] + texel[x + 1];
+        weights[taps] = weight / total;
+        offsets[taps] = (x * texel[x] + (x + 1) * texel[x + 1]) / weight;
+    }
+    return taps;
+}
+
+/**
+  Returns the blur kernel of a radius, creating it the first time it is asked for.
+**/
+const BlurKernel &Renderer::blurKernel(int radius)
+{
+    radius = qBound(0, radius, MAX_BLUR_RADIUS);
+    QHash<int, BlurKernel>::iterator it = m_blurKernels.find(radius);
+    if (it == m_blurKernels.end())
+    {
+        BlurKernel kernel;
+        kernel.taps = createBlurKernel(radius, kernel.weights, kernel.offsets);
+        it = m_blurKernels.insert(radius, kernel);
+    }
+    return it.value();
+}
+
+
+/**
+  Creates the spatial weights of the separable bilateral filter: one side of
+  a gaussian with the specified radius (sigma = radius / 3).  They need no
+  normalization, the shader divides by the sum of the weights it used.
+
+  @param radius: The radius of the kernel to create, at most MAX_BILAT_RADIUS.
+  @param weights: The array to write the radius + 1 weights to, center first.
+**/
+void Renderer::createBilatKernel(int radius, GLfloat* weights)
+{
+    float sigma = qMax(radius, 1) / 3.0f;
+    float twoSigmaSigma = 2.0f * sigma * sigma;
+    for (int x = 0; x <= radius; ++x)
+    {
+        weights[x] = exp(-(x * x) / twoSigmaSigma);
+    }
+}
@@ -0,0 +1,374 @@
+#ifndef RENDERER_H
+#define RENDERER_H
+
+#include <QGLWidget>
+#include <QHash>
+#include <QString>
+#include <stddef.h>
+
+#include "camera.h"
+#include "vector.h"
+#include "resourceloader.h"
+#include "rendergraph.h"
+#include "readbackring.h"
+#include "environmentmanager.h"
+#include "shadermanager.h"
+#include "uniforms.h"
+#include "drawlist.h"
+
+class QGLShaderProgram;
+class QGLFramebufferObject;
+
+// Largest blur radius, and the number of taps one side of such a kernel needs
+// (must match MAX_TAPS in blur.frag)
+const int MAX_BLUR_RADIUS = 64;
+const int MAX_BLUR_TAPS = MAX_BLUR_RADIUS / 2 + 1;
+
+// The bilateral filter runs on an image this many times smaller (must match
+// bilat_down.frag), with a radius of at most MAX_BILAT_RADIUS of its pixels
+// (must match MAX_RADIUS in bilat.frag)
+const int BILAT_DOWNSAMPLE = 4;
+const int MAX_BILAT_RADIUS = 32;
+
+// Blurred levels of the bloom pyramid, at 1/4, 1/8, ... of the viewport size
+const int BLOOM_LEVELS = 4;
+
+// Size of the first level of the luminance reduction, a power of 4
+const int LUMINANCE_SIZE = 256;
+
+// Binding points of the uniform blocks
+const GLuint FRAME_BINDING = 0;
+const GLuint MATERIAL_BINDING = 1;
+
+/**
+    The Frame uniform block of the shaders, in std140 layout: everything that
+    changes at most once a frame.
+ **/
+struct FrameUniforms
+{
+    GLfloat irradiance[9][4];   // SH9 of the environment's diffuse light; vec3 array entries take 16 bytes
+    GLfloat exposure;
+    GLfloat logAverage;
+    GLfloat maxLuminance;
+    GLfloat maxLod;
+    GLint autoExposure;
+    GLint readback;
+    GLint padding[2];
+};
+
+const BlockMember FRAME_MEMBERS[] =
+{
+    { "irradiance", offsetof(FrameUniforms, irradiance) },
+    { "exposure", offsetof(FrameUniforms, exposure) },
+    { "logAverage", offsetof(FrameUniforms, logAverage) },
+    { "maxLuminance", offsetof(FrameUniforms, maxLuminance) },
+    { "maxLod", offsetof(FrameUniforms, maxLod) },
+    { "autoExposure", offsetof(FrameUniforms, autoExposure) },
+    { "readback", offsetof(FrameUniforms, readback) },
+    { 0, 0 }
+};
+
+/**
+    The Material uniform block of reflect.frag and refract.frag (std140).
+ **/
+struct MaterialUniforms
+{
+    GLfloat roughness;
+    GLfloat diffuse;
+    GLfloat padding[2];
+};
+
+const BlockMember MATERIAL_MEMBERS[] =
+{
+    { "roughness", offsetof(MaterialUniforms, roughness) },
+    { "diffuse", offsetof(MaterialUniforms, diffuse) },
+    { 0, 0 }
+};
+
+// Uniforms of the shader programs the renderer sets (see uniforms.h)
+struct EnvironmentUniforms : public ShaderUniforms     // reflect.frag and refract.frag
+{
+    void locate()
+    {
+        sampler("envMap", 0);
+        block("Frame", FRAME_BINDING, FRAME_MEMBERS, sizeof(FrameUniforms));
+        block("Material", MATERIAL_BINDING, MATERIAL_MEMBERS, sizeof(MaterialUniforms));
+    }
+};
+
+struct TonemapUniforms : public ShaderUniforms
+{
+    void locate()
+    {
+        sampler("tex", 0);
+        sampler("luminance", 1);
+        block("Frame", FRAME_BINDING, FRAME_MEMBERS, sizeof(FrameUniforms));
+    }
+};
+
+struct BrightpassUniforms : public ShaderUniforms
+{
+    Uniform<float> threshold;
+
+    void locate()
+    {
+        sampler("tex", 0);
+        sampler("luminance", 1);
+        block("Frame", FRAME_BINDING, FRAME_MEMBERS, sizeof(FrameUniforms));
+        find(threshold, "threshold");
+    }
+};
+
+struct LuminanceUniforms : public ShaderUniforms
+{
+    Uniform<Vector2> spacing;
+    Uniform<bool> first;
+
+    void locate()
+    {
+        sampler("tex", 0);
+        find(spacing, "spacing");
+        find(first, "first");
+    }
+};
+
+struct BlurUniforms : public ShaderUniforms
+{
+    Uniform<Vector2> direction;
+    Uniform<int> taps;
+    UniformArray<float> offsets, weights;
+
+    void locate()
+    {
+        sampler("tex", 0);
+        find(direction, "direction");
+        find(taps, "taps");
+        find(offsets, "offsets");
+        find(weights, "weights");
+    }
+};
+
+struct BilatDownUniforms : public ShaderUniforms
+{
+    Uniform<Vector2> texel;
+
+    void locate()
+    {
+        sampler("tex", 0);
+        find(texel, "texel");
+    }
+};
+
+struct BilatUniforms : public ShaderUniforms
+{
+    Uniform<Vector2> direction;
+    Uniform<int> radius;
+    UniformArray<float> weights;
+    Uniform<float> rangeScale;
+
+    void locate()
+    {
+        sampler("tex", 0);
+        find(direction, "direction");
+        find(radius, "radius");
+        find(weights, "weights");
+        find(rangeScale, "rangeScale");
+    }
+};
+
+struct CombineUniforms : public ShaderUniforms
+{
+    Uniform<Vector2> baseSize;
+    Uniform<float> rangeScale, compression;
+    Uniform<bool> showDetail;
+
+    void locate()
+    {
+        sampler("tex", 0);
+        sampler("base", 1);
+        block("Frame", FRAME_BINDING, FRAME_MEMBERS, sizeof(FrameUniforms));
+        find(baseSize, "baseSize");
+        find(rangeScale, "rangeScale");
+        find(compression, "compression");
+        find(showDetail, "showDetail");
+    }
+};
+
+/**
+    One side of a separable gaussian kernel, with neighbouring texels merged
+    into single bilinear taps.  Offsets are in texels, tap 0 is the center.
+ **/
+struct BlurKernel
+{
+    int taps;
+    GLfloat weights[MAX_BLUR_TAPS];
+    GLfloat offsets[MAX_BLUR_TAPS];
+};
+
+/**
+    The scene and its HDR pipeline, independent of any window: draws a frame
+    of the current mode into the default framebuffer of whatever OpenGL
+    context is current.  GLWidget drives it interactively, the batch renderer
+    (support/batchmain.cpp) from an offscreen pixel buffer.
+ **/
+class Renderer
+{
+public:
+    enum Mode
+    {
+        LowDynamicRange,        // the scene straight to the output
+        GlobalToneMapping,      // Reinhard with auto exposure, plus bloom
+        BilateralToneMapping,   // Durand-Dorsey
+        DetailLayer             // the detail layer of the bilateral tone mapping
+    };
+
+    Renderer();
+    ~Renderer();
+
+    // Sets up the OpenGL state and loads every resource into the current context
+    void initialize();
+    void loadCubeMap(const char* filename);
+
+    // Loads a cube map in the background; frames keep the current one until
+    // the new one is uploaded, a little of it every frame
+    void streamCubeMap(const QString &filename) { m_environment.stream(filename); }
+    const EnvironmentManager &environment() const { return m_environment; }
+
+    // State changes the last frame's scene draws made and skipped
+    const StateCache &stateCache() const { return m_stateCache; }
+
+    // Moves the animation on by a number of ticks (GLWidget takes one per
+    // frame) and lets the exposure adapt for the duration of the frame
+    void advance(float seconds, float ticks = 1.f);
+
+    // Draws a frame of the given size into the default framebuffer
+    void render(int width, int height);
+
+    // The framebuffers must be reallocated before the next frame
+    void invalidate() { m_renderGraphDirty = true; }
+
+    OrbitCamera &camera() { return m_camera; }
+    RenderGraph &renderGraph() { return m_renderGraph; }
+
+    Mode mode() const;
+    void setMode(Mode mode);
+    float exposure() const { return m_exp; }
+    void setExposure(float exposure) { m_exp = exposure; }
+    bool autoExposure() const { return m_autoExposure; }
+    void setAutoExposure(bool enabled);
+    bool exposureReadback() const { return m_exposureReadback; }
+    void setExposureReadback(bool enabled) { m_exposureReadback = enabled; }
+    float logAverage() const { return m_logAverage; }
+    float maxLuminance() const { return m_maxLuminance; }
+    int droppedReadbacks() const { return m_exposureReadbacks.dropped(); }
+
+    // The bilateral filter's radius (in pixels of the base layer) and range
+    // sigma, and the contrast the bilateral tone mapping keeps of the base
+    int bilateralRadius() const { return m_bilatRadius; }
+    float bilateralRangeSigma() const { return m_bilatRangeSigma; }
+    float bilateralCompression() const { return m_bilatCompression; }
+
+    // Keeps the scene's radiance of the last frame in hdrFramebuffer() (RGB16F,
+    // the size of the output) instead of a pooled target that later passes reuse
+    void setKeepHdr(bool keep);
+    QGLFramebufferObject *hdrFramebuffer() const { return m_keepHdr && m_isHDR ? m_hdrFbo : 0; }
+
+protected:
+    // Materials of the scene, each with a Material block in m_uniformBuffer
+    enum Material { GlassMaterial, SphereMaterial, NUM_MATERIALS };
+
+    // Initialization code
+    void createShaderPrograms();
+    void buildRenderGraph(int width, int height);
+    RenderGraph::Target buildExposure(RenderGraph::Target hdr);
+    int createBlurKernel(int radius, GLfloat* weights, GLfloat* offsets);
+    const BlurKernel &blurKernel(int radius);
+    void createBilatKernel(int radius, GLfloat* weights);
+
+    // Drawing code
+    void applyOrthogonalCamera(float width, float height);
+    void applyPerspectiveCamera(float width, float height);
+    void renderTexturedQuad(int width, int height, bool flip);
+    void renderTexture(GLuint texture, int width, int height);
+    void renderTextureLinear(GLuint texture, int width, int height);
+    void renderBlur(const RenderGraph::PassContext &context, float dx, float dy);
+    void renderBilateral(const RenderGraph::PassContext &context, float dx, float dy);
+    void renderReduction(const RenderGraph::PassContext &context, bool first);
+    void readExposure();
+    void updateUniforms();
+    void bindExposure(const RenderGraph::PassContext &context);
+    void releaseExposure();
+    void renderScene();
+
+    // Render graph passes
+    void scenePass(const RenderGraph::PassContext &context);
+    void tonemapPass(const RenderGraph::PassContext &context);
+    void luminancePass(const RenderGraph::PassContext &context);
+    void reducePass(const RenderGraph::PassContext &context);
+    void adaptPass(const RenderGraph::PassContext &context);
+    void blurHorizontalPass(const RenderGraph::PassContext &context);
+    void blurVerticalPass(const RenderGraph::PassContext &context);
+    void brightPass(const RenderGraph::PassContext &context);
+    void downsamplePass(const RenderGraph::PassContext &context);
+    void upsamplePass(const RenderGraph::PassContext &context);
+    void bloomPass(const RenderGraph::PassContext &context);
+    void bilatDownsamplePass(const RenderGraph::PassContext &context);
+    void bilatHorizontalPass(const RenderGraph::PassContext &context);
+    void bilatVerticalPass(const RenderGraph::PassContext &context);
+    void combinePass(const RenderGraph::PassContext &context);
+
+private:
+    OrbitCamera m_camera;
+
+    // Resources
+    ShaderManager m_shaders; // all shader programs, rebuilt when their files change
+    EnvironmentUniforms m_reflectUniforms, m_refractUniforms; // uniforms of the programs, found when they link
+    TonemapUniforms m_tonemapUniforms;
+    BrightpassUniforms m_brightpassUniforms;
+    LuminanceUniforms m_luminanceUniforms;
+    BlurUniforms m_blurUniforms;
+    BilatDownUniforms m_bilatDownUniforms;
+    BilatUniforms m_bilatUniforms;
+    CombineUniforms m_combineUniforms;
+    UniformBuffer m_uniformBuffer; // the Frame and Material blocks, rewritten every frame
+    int m_frameBlock; // index of the Frame block in m_uniformBuffer
+    int m_materialBlocks[NUM_MATERIALS]; // and of the Material blocks
+    DrawList m_drawList; // the scene's draws, rebuilt every time it is rendered
+    StateCache m_stateCache; // GL state set by the draws, and the changes counted
+    RenderGraph m_renderGraph; // post-processing passes and their framebuffers
+    bool m_renderGraphDirty; // the graph must be rebuilt before the next frame
+    bool m_renderGraphCompiled; // the last compile succeeded, so the graph can run
+    int m_graphWidth, m_graphHeight; // the output size the graph was compiled for
+    QHash<int, BlurKernel> m_blurKernels; // blur kernels by radius
+    int m_blurRadius; // radius of the bloom blur, in pixels of each pyramid level
+    float m_bloomThreshold; // exposed luminance above which pixels bloom
+    int m_bilatRadius; // radius of the bilateral filter, in pixels of the downsampled image
+    float m_bilatRangeSigma; // luminance sigma of the bilateral filter, in log10 units
+    float m_bilatCompression; // contrast kept of the base layer
+    GLfloat m_bilatWeights[MAX_BILAT_RADIUS + 1]; // spatial weights of the bilateral filter
+    QGLFramebufferObject *m_hdrFbo; // the scene's radiance, when it is kept
+    bool m_keepHdr;
+    QGLFramebufferObject *m_exposureFbo; // 1x1 adapted log average and max luminance
+    ReadbackRing m_exposureReadbacks; // asynchronous readbacks of m_exposureFbo
+    bool m_autoExposure; // expose for the measured luminance rather than m_exp alone
+    bool m_exposureReadback; // tone map with values read back instead of sampling m_exposureFbo
+    bool m_exposureReset; // the next adaptation takes the measured luminance as it is
+    float m_adaptationRate; // how fast the exposure adapts, per second
+    float m_frameSeconds; // duration of the last frame
+    float m_logAverage, m_maxLuminance; // last exposure read back
+    Model m_dragon; // dragon model
+    Model m_sphere; // sphere model
+    Model m_elephant; // elephant model
+    Model m_model1;
+    Model m_model2;
+    GLuint m_skybox; // skybox call list ID
+    EnvironmentManager m_environment; // the skybox's cube map, and the next one while it streams in
+    float m_exp; //image exposure
+    bool m_isHDR;
+    bool m_isBilat;
+    bool m_isEdges;
+    float m_increment; // animation time, in ticks
+
+};
+
+#endif // RENDERER_H
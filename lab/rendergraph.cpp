@@ -0,0 +1,477 @@
+#define GL_GLEXT_PROTOTYPES
+#include "rendergraph.h"
+
+#include <iostream>
+#include <QGLFramebufferObject>
+#include <QGLShaderProgram>
+
+using std::cout;
+using std::endl;
+
+/**
+  Approximate size of one pixel of a color attachment in video memory.
+ **/
+static int bytesPerPixel(GLenum format)
+{
+    switch (format)
+    {
+    case GL_RGB16F_ARB:  return 6;
+    case GL_RGBA16F_ARB: return 8;
+    case GL_RGB32F_ARB:  return 12;
+    case GL_RGBA32F_ARB: return 16;
+    case GL_RGB8:        return 3;
+    default:             return 4;
+    }
+}
+
+static long framebufferSize(int width, int height, GLenum format, bool depth)
+{
+    return (long)width * height * (bytesPerPixel(format) + (depth ? 4 : 0));
+}
+
+RenderGraph::RenderGraph() : m_width(0), m_height(0), m_timing(false), m_frame(0)
+{
+    m_queriesIssued[0] = m_queriesIssued[1] = false;
+}
+
+RenderGraph::~RenderGraph()
+{
+    clear();
+    deleteQueries();
+    for (int i = 0; i < m_pool.size(); ++i)
+        delete m_pool[i].fbo;
+}
+
+/**
+  Forgets all passes and targets.  The framebuffers stay in the pool so that
+  the next compile() can hand them out again without reallocating.
+ **/
+void RenderGraph::clear()
+{
+    for (int i = 0; i < m_passes.size(); ++i)
+        delete m_passes[i].callback;
+    m_passes.clear();
+    m_targets.clear();
+    m_order.clear();
+    m_contexts.clear();
+    m_outputs.clear();
+    m_times.clear();
+}
+
+RenderGraph::Target RenderGraph::createTarget(const QString &name, int divisor, GLenum internalFormat, bool depth)
+{
+    TargetInfo target;
+    target.name = name;
+    target.divisor = divisor > 0 ? divisor : 1;
+    target.fixedWidth = target.fixedHeight = 0;
+    target.format = internalFormat;
+    target.depth = depth;
+    target.external = 0;
+    target.writer = -1;
+    target.width = target.height = 0;
+    target.framebuffer = -1;
+    m_targets.append(target);
+    return m_targets.size() - 1;
+}
+
+RenderGraph::Target RenderGraph::createFixedTarget(const QString &name, int width, int height, GLenum internalFormat)
+{
+    Target target = createTarget(name, 1, internalFormat);
+    m_targets[target].fixedWidth = qMax(1, width);
+    m_targets[target].fixedHeight = qMax(1, height);
+    return target;
+}
+
+RenderGraph::Target RenderGraph::importTarget(const QString &name, QGLFramebufferObject *fbo)
+{
+    Target target = createTarget(name, 1, GL_RGBA);
+    m_targets[target].external = fbo;
+    return target;
+}
+
+/**
+  Whether a pass has effects outside the graph: it draws to the screen or
+  into an imported framebuffer, so it is never dropped.
+ **/
+bool RenderGraph::isRoot(const PassInfo &pass) const
+{
+    return pass.output == Screen || m_targets[pass.output].external;
+}
+
+QGLFramebufferObject *RenderGraph::framebuffer(Target target) const
+{
+    const TargetInfo &info = m_targets[target];
+    return info.external ? info.external : m_pool[info.framebuffer].fbo;
+}
+
+int RenderGraph::addPass(const QString &name, QGLShaderProgram *program, Callback *callback)
+{
+    PassInfo pass;
+    pass.name = name;
+    pass.program = program;
+    pass.callback = callback;
+    pass.output = NoTarget;
+    m_passes.append(pass);
+    return m_passes.size() - 1;
+}
+
+void RenderGraph::read(int pass, Target target)
+{
+    Q_ASSERT(target >= 0 && target < m_targets.size());
+    m_passes[pass].reads.append(target);
+}
+
+void RenderGraph::write(int pass, Target target)
+{
+    Q_ASSERT(target == Screen || (target >= 0 && target < m_targets.size()));
+    Q_ASSERT(m_passes[pass].output == NoTarget);
+    m_passes[pass].output = target;
+    if (target != Screen)
+    {
+        Q_ASSERT(m_targets[target].writer < 0);
+        m_targets[target].writer = pass;
+    }
+}
+
+/**
+  Finds an idle pooled framebuffer matching the target, or allocates one.
+
+  @param target: the target that needs a framebuffer
+  @param busy: per pool entry, whether a live target currently holds it
+  @return the index of the framebuffer in the pool
+ **/
+int RenderGraph::acquireFramebuffer(const TargetInfo &target, QVector<bool> &busy)
+{
+    for (int i = 0; i < m_pool.size(); ++i)
+    {
+        const Framebuffer &fb = m_pool[i];
+        if (!busy[i] && fb.width == target.width && fb.height == target.height &&
+            fb.format == target.format && fb.depth == target.depth)
+        {
+            busy[i] = true;
+            m_pool[i].used = true;
+            return i;
+        }
+    }
+
+    Framebuffer fb;
+    fb.fbo = new QGLFramebufferObject(target.width, target.height,
+                                      target.depth ? QGLFramebufferObject::Depth : QGLFramebufferObject::NoAttachment,
+                                      GL_TEXTURE_2D, target.format);
+    fb.width = target.width;
+    fb.height = target.height;
+    fb.format = target.format;
+    fb.depth = target.depth;
+    fb.used = true;
+    m_pool.append(fb);
+    busy.append(true);
+    return m_pool.size() - 1;
+}
+
+/**
+  Compiles the declared passes for a viewport of the given size:
+
+  1. Passes that neither draw to the screen (or an imported target) nor feed
+     a pass that does are dropped.
+  2. The rest are ordered so every pass runs after the writers of what it reads;
+     passes drawing to the screen keep their declaration order.
+  3. Targets other than imported ones get pooled framebuffers.  A framebuffer goes back to the pool right
+     after the last pass reading its target, so targets whose lifetimes do not
+     overlap share memory.
+  4. Framebuffer and texture handles are resolved into per-pass contexts.
+
+  @param width: the viewport width
+  @param height: the viewport height
+  @return false if a pass reads a target nobody writes or the passes form a cycle
+ **/
+bool RenderGraph::compile(int width, int height)
+{
+    int numPasses = m_passes.size();
+    m_width = width;
+    m_height = height;
+    m_order.clear();
+    m_contexts.clear();
+    m_outputs.clear();
+
+    for (int p = 0; p < numPasses; ++p)
+    {
+        if (m_passes[p].output == NoTarget)
+        {
+            cout << "RenderGraph: pass " << m_passes[p].name.toStdString() << " writes nothing" << endl;
+            return false;
+        }
+        for (int r = 0; r < m_passes[p].reads.size(); ++r)
+        {
+            const TargetInfo &target = m_targets[m_passes[p].reads[r]];
+            if (target.writer < 0 && !target.external)
+            {
+                cout << "RenderGraph: pass " << m_passes[p].name.toStdString() << " reads "
+                     << m_targets[m_passes[p].reads[r]].name.toStdString() << ", which nothing writes" << endl;
+                return false;
+            }
+        }
+    }
+
+    // Keep the passes the screen and the imported targets depend on
+    QVector<bool> live(numPasses, false);
+    QVector<int> stack;
+    for (int p = 0; p < numPasses; ++p)
+    {
+        if (isRoot(m_passes[p]))
+        {
+            live[p] = true;
+            stack.append(p);
+        }
+    }
+    while (!stack.isEmpty())
+    {
+        int p = stack.last();
+        stack.pop_back();
+        for (int r = 0; r < m_passes[p].reads.size(); ++r)
+        {
+            int writer = m_targets[m_passes[p].reads[r]].writer;
+            if (writer >= 0 && !live[writer])
+            {
+                live[writer] = true;
+                stack.append(writer);
+            }
+        }
+    }
+
+    // Order them: repeatedly take the first declared pass whose inputs are ready
+    QVector<bool> done(numPasses, false);
+    int lastScreenPass = -1;
+    for (;;)
+    {
+        int next = -1;
+        for (int p = 0; p < numPasses && next < 0; ++p)
+        {
+            if (!live[p] || done[p])
+                continue;
+            bool ready = true;
+            for (int r = 0; r < m_passes[p].reads.size() && ready; ++r)
+            {
+                // an imported target nobody writes holds last frame's contents
+                int writer = m_targets[m_passes[p].reads[r]].writer;
+                ready = writer < 0 || done[writer];
+            }
+            if (ready && m_passes[p].output == Screen)
+            {
+                // screen passes draw on top of each other, so keep their order
+                for (int q = lastScreenPass + 1; q < p && ready; ++q)
+                    ready = !(live[q] && m_passes[q].output == Screen);
+            }
+            if (ready)
+                next = p;
+        }
+        if (next < 0)
+            break;
+        done[next] = true;
+        if (m_passes[next].output == Screen)
+            lastScreenPass = next;
+        m_order.append(next);
+    }
+    for (int p = 0; p < numPasses; ++p)
+    {
+        if (live[p] && !done[p])
+        {
+            cout << "RenderGraph: pass " << m_passes[p].name.toStdString() << " is part of a cycle" << endl;
+            m_order.clear();
+            return false;
+        }
+    }
+
+    // Lifetimes: position of the last pass reading each pooled target
+    QVector<bool> pooled(m_targets.size(), false);
+    QVector<int> lastUse(m_targets.size(), -1);
+    for (int t = 0; t < m_targets.size(); ++t)
+        pooled[t] = !m_targets[t].external;
+    for (int i = 0; i < m_order.size(); ++i)
+    {
+        const PassInfo &pass = m_passes[m_order[i]];
+        for (int r = 0; r < pass.reads.size(); ++r)
+            lastUse[pass.reads[r]] = i;
+        if (pass.output != Screen && lastUse[pass.output] < i)
+            lastUse[pass.output] = i;
+    }
+
+    // Assign framebuffers
+    QVector<bool> busy(m_pool.size(), false);
+    for (int i = 0; i < m_pool.size(); ++i)
+        m_pool[i].used = false;
+    for (int t = 0; t < m_targets.size(); ++t)
+    {
+        TargetInfo &target = m_targets[t];
+        if (target.external)
+        {
+            target.width = target.external->width();
+            target.height = target.external->height();
+        }
+        else if (target.fixedWidth)
+        {
+            target.width = target.fixedWidth;
+            target.height = target.fixedHeight;
+        }
+        else
+        {
+            target.width = qMax(1, width / target.divisor);
+            target.height = qMax(1, height / target.divisor);
+        }
+        target.framebuffer = -1;
+    }
+    for (int i = 0; i < m_order.size(); ++i)
+    {
+        const PassInfo &pass = m_passes[m_order[i]];
+        bool output = pass.output != Screen && pooled[pass.output];
+        if (output)
+            m_targets[pass.output].framebuffer = acquireFramebuffer(m_targets[pass.output], busy);
+        for (int r = 0; r < pass.reads.size(); ++r)
+            if (pooled[pass.reads[r]] && lastUse[pass.reads[r]] == i)
+                busy[m_targets[pass.reads[r]].framebuffer] = false;
+        if (output && lastUse[pass.output] == i)
+            busy[m_targets[pass.output].framebuffer] = false;
+    }
+
+    // Release framebuffers this graph does not need
+    QVector<int> remap(m_pool.size(), -1);
+    QVector<Framebuffer> pool;
+    for (int i = 0; i < m_pool.size(); ++i)
+    {
+        if (m_pool[i].used)
+        {
+            remap[i] = pool.size();
+            pool.append(m_pool[i]);
+        }
+        else
+        {
+            delete m_pool[i].fbo;
+        }
+    }
+    m_pool = pool;
+    for (int t = 0; t < m_targets.size(); ++t)
+        if (m_targets[t].framebuffer >= 0)
+            m_targets[t].framebuffer = remap[m_targets[t].framebuffer];
+
+    // Resolve everything execute() needs
+    for (int i = 0; i < m_order.size(); ++i)
+    {
+        const PassInfo &pass = m_passes[m_order[i]];
+        PassContext context;
+        context.program = pass.program;
+        if (pass.output == Screen)
+        {
+            context.width = width;
+            context.height = height;
+            m_outputs.append(0);
+        }
+        else
+        {
+            context.width = m_targets[pass.output].width;
+            context.height = m_targets[pass.output].height;
+            m_outputs.append(framebuffer(pass.output));
+        }
+        for (int r = 0; r < pass.reads.size(); ++r)
+            context.inputs.append(framebuffer(pass.reads[r])->texture());
+        m_contexts.append(context);
+    }
+    m_times = QVector<float>(m_order.size(), 0.f);
+    if (m_timing)
+        createQueries();
+    return true;
+}
+
+/**
+  Runs the compiled passes, binding each one's framebuffer and viewport.
+ **/
+void RenderGraph::execute()
+{
+    int set = m_frame & 1;
+    bool timed = m_timing && !m_queries.isEmpty();
+    if (timed && m_queriesIssued[set])
+        collectQueries(set);
+
+    for (int i = 0; i < m_order.size(); ++i)
+    {
+        QGLFramebufferObject *fbo = m_outputs[i];
+        if (timed)
+            glBeginQuery(GL_TIME_ELAPSED, m_queries[set * m_order.size() + i]);
+        if (fbo)
+            fbo->bind();
+        glViewport(0, 0, m_contexts[i].width, m_contexts[i].height);
+        m_passes[m_order[i]].callback->run(m_contexts[i]);
+        if (fbo)
+            fbo->release();
+        if (timed)
+            glEndQuery(GL_TIME_ELAPSED);
+    }
+    glViewport(0, 0, m_width, m_height);
+
+    if (timed)
+        m_queriesIssued[set] = true;
+    m_frame++;
+}
+
+void RenderGraph::setTimingEnabled(bool enabled)
+{
+    if (enabled == m_timing)
+        return;
+    m_timing = enabled;
+    if (enabled)
+        createQueries();
+    else
+        deleteQueries();
+}
+
+void RenderGraph::createQueries()
+{
+    deleteQueries();
+    if (m_order.isEmpty())
+        return;
+    m_queries.resize(2 * m_order.size());
+    glGenQueries(m_queries.size(), m_queries.data());
+}
+
+void RenderGraph::deleteQueries()
+{
+    if (!m_queries.isEmpty())
+        glDeleteQueries(m_queries.size(), m_queries.data());
+    m_queries.clear();
+    m_queriesIssued[0] = m_queriesIssued[1] = false;
+}
+
+/**
+  Copies the results of one query set into m_times.  Queries whose result has
+  not arrived yet keep their previous time rather than waiting for the GPU.
+ **/
+void RenderGraph::collectQueries(int set)
+{
+    for (int i = 0; i < m_order.size(); ++i)
+    {
+        GLuint query = m_queries[set * m_order.size() + i];
+        GLint available = 0;
+        glGetQueryObjectiv(query, GL_QUERY_RESULT_AVAILABLE, &available);
+        if (available)
+        {
+            GLuint64 nanoseconds = 0;
+            glGetQueryObjectui64v(query, GL_QUERY_RESULT, &nanoseconds);
+            m_times[i] = nanoseconds / 1000000.0;
+        }
+    }
+}
+
+long RenderGraph::memoryUsage() const
+{
+    long bytes = 0;
+    for (int i = 0; i < m_pool.size(); ++i)
+        bytes += framebufferSize(m_pool[i].width, m_pool[i].height, m_pool[i].format, m_pool[i].depth);
+    return bytes;
+}
+
+long RenderGraph::unaliasedMemoryUsage() const
+{
+    long bytes = 0;
+    for (int t = 0; t < m_targets.size(); ++t)
+        if (m_targets[t].framebuffer >= 0)
+            bytes += framebufferSize(m_targets[t].width, m_targets[t].height, m_targets[t].format, m_targets[t].depth);
+    return bytes;
+}
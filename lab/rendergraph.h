@@ -0,0 +1,173 @@
+#ifndef RENDERGRAPH_H
+#define RENDERGRAPH_H
+
+#include <QGLWidget>
+#include <QString>
+#include <QVector>
+
+class QGLShaderProgram;
+class QGLFramebufferObject;
+
+/**
+    A declarative list of render passes.  Passes declare the targets they read
+    and write; compile() then orders them, drops passes nobody needs, and
+    assigns every transient target a framebuffer object from a pool, reusing a
+    framebuffer as soon as the last pass reading its previous target is done.
+    execute() only walks the compiled list, so no names are looked up per frame.
+
+    Typical use:
+
+        RenderGraph::Target hdr = graph.createTarget("hdr", 1, GL_RGB16F_ARB, true);
+        int pass = graph.addPass("scene", 0, this, &GLWidget::scenePass);
+        graph.write(pass, hdr);
+        pass = graph.addPass("tonemap", tonemapProgram, this, &GLWidget::tonemapPass);
+        graph.read(pass, hdr);
+        graph.write(pass, RenderGraph::Screen);
+        graph.compile(width, height);
+        ...
+        graph.execute();
+**/
+class RenderGraph
+{
+public:
+    // Handle of a virtual render target.  Screen is the window's framebuffer.
+    typedef int Target;
+    enum { Screen = -1, NoTarget = -2 };
+
+    /**
+        What a pass callback gets when it runs.  The output framebuffer is
+        already bound and the viewport covers it.
+    **/
+    struct PassContext
+    {
+        int width, height;              // size of the output in pixels
+        QGLShaderProgram *program;      // program given to addPass (may be 0)
+        QVector<GLuint> inputs;         // textures of the read() targets, in order
+    };
+
+    RenderGraph();
+    ~RenderGraph();
+
+    // Removes all passes and targets.  Pooled framebuffers are kept for the next compile().
+    void clear();
+
+    // Declares a target of 1/divisor the viewport size.
+    Target createTarget(const QString &name, int divisor, GLenum internalFormat, bool depth = false);
+
+    // Declares a target of a fixed size, whatever the viewport.
+    Target createFixedTarget(const QString &name, int width, int height, GLenum internalFormat);
+
+    // Declares a target backed by a framebuffer the caller owns, so its
+    // contents outlive the frame.  Passes writing it are never dropped, and
+    // reading it without a writer gives what the previous frames left there.
+    Target importTarget(const QString &name, QGLFramebufferObject *fbo);
+
+    // Declares a pass calling (object->*method)(context) when it runs.  Returns the pass index.
+    template <class T>
+    int addPass(const QString &name, QGLShaderProgram *program, T *object,
+                void (T::*method)(const PassContext &))
+    {
+        return addPass(name, program, new MethodCallback<T>(object, method));
+    }
+
+    // Declares that a pass samples a target, or renders into it.  Every pass
+    // writes exactly one target and every target but Screen has one writer.
+    void read(int pass, Target target);
+    void write(int pass, Target target);
+
+    // Orders the passes and assigns framebuffers for a viewport of the given size.
+    // Returns false (and prints why) if the graph is inconsistent.
+    bool compile(int width, int height);
+
+    // Runs the compiled passes.
+    void execute();
+
+    // Measures the GPU time of every pass with timer queries.  Results are
+    // collected a frame or two later, so reading them never stalls.
+    void setTimingEnabled(bool enabled);
+    bool timingEnabled() const { return m_timing; }
+
+    // Statistics of the last compile().  Passes are numbered in compiled order.
+    int numPasses() const { return m_order.size(); }
+    QString passName(int i) const { return m_passes[m_order[i]].name; }
+    float passMilliseconds(int i) const { return m_times[i]; }
+    int numFramebuffers() const { return m_pool.size(); }
+    long memoryUsage() const;           // bytes held by the pooled framebuffers
+    long unaliasedMemoryUsage() const;  // bytes one framebuffer per target would take
+
+private:
+    class Callback
+    {
+    public:
+        virtual ~Callback() {}
+        virtual void run(const PassContext &context) = 0;
+    };
+
+    template <class T>
+    class MethodCallback : public Callback
+    {
+    public:
+        MethodCallback(T *object, void (T::*method)(const PassContext &)) :
+            m_object(object), m_method(method) {}
+        void run(const PassContext &context) { (m_object->*m_method)(context); }
+    private:
+        T *m_object;
+        void (T::*m_method)(const PassContext &);
+    };
+
+    struct TargetInfo
+    {
+        QString name;
+        int divisor;
+        int fixedWidth, fixedHeight;    // 0 if the size follows the viewport
+        GLenum format;
+        bool depth;
+        QGLFramebufferObject *external; // framebuffer of an imported target, else 0
+        int writer;                     // pass writing the target, -1 if none yet
+        int width, height;              // set by compile()
+        int framebuffer;                // index into m_pool, set by compile()
+    };
+
+    struct PassInfo
+    {
+        QString name;
+        QGLShaderProgram *program;
+        Callback *callback;
+        QVector<Target> reads;
+        Target output;                  // NoTarget until write() is called
+    };
+
+    struct Framebuffer
+    {
+        QGLFramebufferObject *fbo;
+        int width, height;
+        GLenum format;
+        bool depth;
+        bool used;                      // taken by the graph being compiled
+    };
+
+    int addPass(const QString &name, QGLShaderProgram *program, Callback *callback);
+    bool isRoot(const PassInfo &pass) const;
+    QGLFramebufferObject *framebuffer(Target target) const;
+    int acquireFramebuffer(const TargetInfo &target, QVector<bool> &busy);
+    void createQueries();
+    void deleteQueries();
+    void collectQueries(int set);
+
+    QVector<TargetInfo> m_targets;
+    QVector<PassInfo> m_passes;
+    QVector<Framebuffer> m_pool;
+    QVector<int> m_order;               // compiled pass order
+    QVector<PassContext> m_contexts;    // resolved context of every compiled pass
+    QVector<QGLFramebufferObject *> m_outputs;  // bound framebuffer of every compiled pass, 0 = screen
+    int m_width, m_height;
+
+    // Timer queries: two sets of one query per pass, used on alternate frames
+    bool m_timing;
+    QVector<GLuint> m_queries;
+    bool m_queriesIssued[2];
+    int m_frame;
+    QVector<float> m_times;             // last measured time of every compiled pass
+};
+
+#endif // RENDERGRAPH_H
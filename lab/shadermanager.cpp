@@ -0,0 +1,414 @@
+#define GL_GLEXT_PROTOTYPES
+#include "shadermanager.h"
+
+#include <QFile>
+#include <QFileInfo>
+#include <QGLContext>
+#include <iostream>
+#include <stdio.h>
+#include <string.h>
+
+using std::cout;
+using std::endl;
+
+#ifndef GL_COMPLETION_STATUS_KHR
+#define GL_COMPLETION_STATUS_KHR 0x91B1
+#endif
+
+// "GLPB" read as a little-endian word, and a version to bump whenever the
+// layout of a cache file changes
+static const quint32 CACHE_MAGIC = 0x42504c47;
+static const quint32 CACHE_VERSION = 1;
+
+// Start of a cache file; the program binary follows it
+struct CacheHeader
+{
+    quint32 magic;
+    quint32 version;
+    quint64 hash;                       // of the sources and the driver strings
+    quint32 format;                     // binary format glGetProgramBinary gave
+    quint32 length;                     // bytes of binary
+};
+
+typedef void (APIENTRY *MaxShaderCompilerThreads)(GLuint count);
+
+/**
+  64-bit FNV-1a hash of some bytes, continuing from hash.
+ **/
+static quint64 hashBytes(const QByteArray &bytes, quint64 hash)
+{
+    const unsigned char *data = (const unsigned char *) bytes.constData();
+    for (int i = 0; i < bytes.size(); ++i)
+    {
+        hash ^= data[i];
+        hash *= 1099511628211ULL;
+    }
+    return hash;
+}
+
+/**
+  Modification time of a shader file, or a null time if there is none.
+ **/
+static QDateTime modified(const QString &file)
+{
+    return file.isEmpty() ? QDateTime() : QFileInfo(file).lastModified();
+}
+
+/**
+  Prints the info log of a shader or program, if it has one.
+ **/
+static void printLog(const QString &what, GLuint object, bool program)
+{
+    GLint length = 0;
+    if (program)
+        glGetProgramiv(object, GL_INFO_LOG_LENGTH, &length);
+    else
+        glGetShaderiv(object, GL_INFO_LOG_LENGTH, &length);
+    if (length <= 1)
+        return;
+    QByteArray log(length, '\0');
+    if (program)
+        glGetProgramInfoLog(object, length, 0, log.data());
+    else
+        glGetShaderInfoLog(object, length, 0, log.data());
+    cout << what.toStdString() << ":" << endl << log.constData() << endl;
+}
+
+ShaderManager::ShaderManager() :
+    m_driverReady(false), m_binaries(false), m_parallel(false)
+{
+    m_lastCheck.start();
+}
+
+ShaderManager::~ShaderManager()
+{
+}
+
+/**
+  Finds out what the driver can do, the first time a program is added.
+ **/
+void ShaderManager::initDriver()
+{
+    if (m_driverReady)
+        return;
+    m_driverReady = true;
+    m_driver = QByteArray((const char *) glGetString(GL_VENDOR)) + '\n' +
+               QByteArray((const char *) glGetString(GL_RENDERER)) + '\n' +
+               QByteArray((const char *) glGetString(GL_VERSION));
+
+    GLint formats = 0;
+    glGetIntegerv(GL_NUM_PROGRAM_BINARY_FORMATS, &formats);
+    m_binaries = formats > 0;
+
+    // Let the driver use as many compiler threads as it likes
+    QByteArray extensions((const char *) glGetString(GL_EXTENSIONS));
+    const char *setThreads = 0;
+    if (extensions.contains("GL_KHR_parallel_shader_compile"))
+        setThreads = "glMaxShaderCompilerThreadsKHR";
+    else if (extensions.contains("GL_ARB_parallel_shader_compile"))
+        setThreads = "glMaxShaderCompilerThreadsARB";
+    MaxShaderCompilerThreads threads = setThreads ?
+        (MaxShaderCompilerThreads) QGLContext::currentContext()->getProcAddress(setThreads) : 0;
+    m_parallel = threads != 0;
+    if (threads)
+        threads(0xffffffff);
+}
+
+/**
+  Reads the shader files of a program and hashes them together with the
+  driver strings.
+
+  @return false if a file can't be read
+ **/
+bool ShaderManager::readSources(const Build &build, QByteArray &vert, QByteArray &frag, quint64 &hash) const
+{
+    bool ok = true;
+    const QString *files[2] = { &build.vertFile, &build.fragFile };
+    QByteArray *sources[2] = { &vert, &frag };
+    hash = 14695981039346656037ULL;
+    for (int i = 0; i < 2; ++i)
+    {
+        sources[i]->clear();
+        if (!files[i]->isEmpty())
+        {
+            QFile file(*files[i]);
+            if (file.open(QIODevice::ReadOnly))
+                *sources[i] = file.readAll();
+            else
+            {
+                cout << "can't read shader " << files[i]->toStdString() << endl;
+                ok = false;
+            }
+        }
+        // The length goes in too, so moving text between files changes the hash
+        hash = hashBytes(QByteArray::number(sources[i]->size()) + ':', hash);
+        hash = hashBytes(*sources[i], hash);
+    }
+    hash = hashBytes(m_driver, hash);
+    return ok;
+}
+
+QString ShaderManager::cacheFile(const QString &name) const
+{
+    const Build &build = m_builds[name];
+    QString file = build.fragFile.isEmpty() ? build.vertFile : build.fragFile;
+    return QFileInfo(file).path() + "/" + name + ".glpb";
+}
+
+/**
+  Loads a program from its cache file, if that holds a binary of the same
+  sources for the same driver and the driver still takes it.
+
+  @return the linked program, or 0
+ **/
+QGLShaderProgram *ShaderManager::loadBinary(const QString &name, quint64 hash) const
+{
+    if (!m_binaries)
+        return 0;
+    QFile file(cacheFile(name));
+    if (!file.open(QIODevice::ReadOnly))
+        return 0;
+    QByteArray data = file.readAll();
+    CacheHeader header;
+    if (data.size() < (int) sizeof(header))
+        return 0;
+    memcpy(&header, data.constData(), sizeof(header));
+    if (header.magic != CACHE_MAGIC || header.version != CACHE_VERSION || header.hash != hash ||
+        header.length != data.size() - sizeof(header))
+        return 0;
+
+    QGLShaderProgram *program = new QGLShaderProgram(QGLContext::currentContext());
+    GLuint id = program->programId();
+    glProgramBinary(id, header.format, data.constData() + sizeof(header), header.length);
+    GLint linked = 0;
+    glGetProgramiv(id, GL_LINK_STATUS, &linked);
+
+    // With no shaders added, link() only checks the program is linked
+    if (!linked || !program->link())
+    {
+        delete program;
+        return 0;
+    }
+    return program;
+}
+
+/**
+  Writes a linked program's binary to its cache file.  It goes to a
+  temporary file first, which is then renamed over the old one.
+ **/
+void ShaderManager::saveBinary(const QString &name, quint64 hash, QGLShaderProgram *program) const
+{
+    if (!m_binaries)
+        return;
+    GLuint id = program->programId();
+    GLint length = 0;
+    glGetProgramiv(id, GL_PROGRAM_BINARY_LENGTH, &length);
+    if (length <= 0)
+        return;
+
+    CacheHeader header;
+    QByteArray data(sizeof(header) + length, '\0');
+    GLenum format = 0;
+    glGetProgramBinary(id, length, &length, &format, data.data() + sizeof(header));
+    header.magic = CACHE_MAGIC;
+    header.version = CACHE_VERSION;
+    header.hash = hash;
+    header.format = format;
+    header.length = length;
+    memcpy(data.data(), &header, sizeof(header));
+
+    QByteArray path = cacheFile(name).toLocal8Bit();
+    QByteArray temp = path + ".tmp";
+    FILE *file = fopen(temp.constData(), "wb");
+    bool ok = file && fwrite(data.constData(), 1, sizeof(header) + length, file) == sizeof(header) + length;
+    if (file && fclose(file) != 0)
+        ok = false;
+    if (!ok || rename(temp.constData(), path.constData()) != 0)
+    {
+        cout << "can't write shader cache " << path.constData() << endl;
+        remove(temp.constData());
+    }
+}
+
+/**
+  Compiles and links a program without waiting for the result.  The shaders
+  are handed to GL directly rather than through QGLShader, so nothing asks
+  whether they compiled until buildDone() says the link is complete.
+ **/
+void ShaderManager::startBuild(const QString &name, Build &build, const QByteArray &vert,
+                               const QByteArray &frag, quint64 hash)
+{
+    Q_UNUSED(name);
+    const QString *files[2] = { &build.vertFile, &build.fragFile };
+    const QByteArray *sources[2] = { &vert, &frag };
+    const GLenum types[2] = { GL_VERTEX_SHADER, GL_FRAGMENT_SHADER };
+
+    QGLShaderProgram *program = new QGLShaderProgram(QGLContext::currentContext());
+    GLuint id = program->programId();
+    for (int i = 0; i < 2; ++i)
+    {
+        build.shaders[i] = 0;
+        if (files[i]->isEmpty())
+            continue;
+        const char *text = sources[i]->constData();
+        GLint length = sources[i]->size();
+        build.shaders[i] = glCreateShader(types[i]);
+        glShaderSource(build.shaders[i], 1, &text, &length);
+        glCompileShader(build.shaders[i]);
+        glAttachShader(id, build.shaders[i]);
+    }
+    if (m_binaries)
+        glProgramParameteri(id, GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE);
+    glLinkProgram(id);
+    build.pending = program;
+    build.pendingHash = hash;
+}
+
+bool ShaderManager::buildDone(const Build &build) const
+{
+    if (!m_parallel)
+        return true;
+    GLint done = GL_TRUE;
+    glGetProgramiv(build.pending->programId(), GL_COMPLETION_STATUS_KHR, &done);
+    return done == GL_TRUE;
+}
+
+/**
+  Takes the result of a build.  A program that linked replaces the old one
+  and is saved to the cache.  One that didn't has its logs printed; it is
+  dropped if there is an old program to keep, and kept (unlinked, as before
+  there was a cache) if not, so program() never returns 0 for a name added.
+
+  @return whether m_programs changed
+ **/
+bool ShaderManager::finishBuild(const QString &name, Build &build)
+{
+    const QString *files[2] = { &build.vertFile, &build.fragFile };
+    QGLShaderProgram *program = build.pending;
+    GLuint id = program->programId();
+    GLint linked = 0;
+    glGetProgramiv(id, GL_LINK_STATUS, &linked);
+    build.pending = 0;
+    build.hash = build.pendingHash;
+
+    if (linked)
+    {
+        for (int i = 0; i < 2; ++i)
+            if (build.shaders[i])
+                glDetachShader(id, build.shaders[i]);
+        program->link();
+        saveBinary(name, build.hash, program);
+        if (build.uniforms)
+            build.uniforms->resolve(id, name);
+    }
+    else
+    {
+        for (int i = 0; i < 2; ++i)
+            if (build.shaders[i])
+                printLog(*files[i], build.shaders[i], false);
+        printLog(name + " program", id, true);
+    }
+    for (int i = 0; i < 2; ++i)
+        if (build.shaders[i])
+            glDeleteShader(build.shaders[i]);
+
+    QGLShaderProgram *old = m_programs.value(name);
+    if (!linked && old)
+    {
+        cout << "shader " << name.toStdString() << " failed to build, keeping the old one" << endl;
+        delete program;
+        return false;
+    }
+    if (old)
+        cout << "reloaded shader " << name.toStdString() << endl;
+    delete old;
+    m_programs[name] = program;
+    return true;
+}
+
+void ShaderManager::add(const QString &name, const QString &vertFile, const QString &fragFile,
+                        ShaderUniforms *uniforms)
+{
+    initDriver();
+    Build &build = m_builds[name];
+    build.vertFile = vertFile;
+    build.fragFile = fragFile;
+    build.uniforms = uniforms;
+    build.vertTime = modified(vertFile);
+    build.fragTime = modified(fragFile);
+
+    QByteArray vert, frag;
+    quint64 hash;
+    bool ok = readSources(build, vert, frag, hash);
+    QGLShaderProgram *program = ok ? loadBinary(name, hash) : 0;
+    if (program)
+    {
+        if (uniforms)
+            uniforms->resolve(program->programId(), name);
+        build.hash = hash;
+        delete m_programs.value(name);
+        m_programs[name] = program;
+        return;
+    }
+    startBuild(name, build, vert, frag, hash);
+}
+
+void ShaderManager::finishBuilds()
+{
+    for (QHash<QString, Build>::iterator i = m_builds.begin(); i != m_builds.end(); ++i)
+        if (i.value().pending)
+            finishBuild(i.key(), i.value());
+}
+
+bool ShaderManager::update(int interval)
+{
+    bool swapped = false;
+    bool check = m_lastCheck.elapsed() >= interval;
+    if (check)
+        m_lastCheck.start();
+
+    for (QHash<QString, Build>::iterator i = m_builds.begin(); i != m_builds.end(); ++i)
+    {
+        Build &build = i.value();
+        if (build.pending)
+        {
+            if (buildDone(build) && finishBuild(i.key(), build))
+                swapped = true;
+            continue;
+        }
+        if (!check)
+            continue;
+
+        // Saving a file without changing it, or changing it back, costs a
+        // read and a hash but no rebuild
+        QDateTime vertTime = modified(build.vertFile), fragTime = modified(build.fragFile);
+        if (vertTime == build.vertTime && fragTime == build.fragTime)
+            continue;
+        build.vertTime = vertTime;
+        build.fragTime = fragTime;
+        QByteArray vert, frag;
+        quint64 hash;
+        if (!readSources(build, vert, frag, hash) || hash == build.hash)
+            continue;
+        startBuild(i.key(), build, vert, frag, hash);
+    }
+    return swapped;
+}
+
+void ShaderManager::clear()
+{
+    for (QHash<QString, Build>::iterator i = m_builds.begin(); i != m_builds.end(); ++i)
+    {
+        Build &build = i.value();
+        if (!build.pending)
+            continue;
+        for (int j = 0; j < 2; ++j)
+            if (build.shaders[j])
+                glDeleteShader(build.shaders[j]);
+        delete build.pending;
+        build.pending = 0;
+    }
+    foreach (QGLShaderProgram *program, m_programs)
+        delete program;
+    m_programs.clear();
+}
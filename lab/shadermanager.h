@@ -0,0 +1,87 @@
+#ifndef SHADERMANAGER_H
+#define SHADERMANAGER_H
+
+#include <QDateTime>
+#include <QGLShaderProgram>
+#include <QHash>
+#include <QString>
+#include <QTime>
+
+#include "uniforms.h"
+
+/**
+    Owns the shader programs, builds them from their files and keeps them up
+    to date while the program runs.
+
+    Linked programs are saved as driver binaries next to their shaders
+    (<name>.glpb), keyed by a hash of their sources and of the GL vendor,
+    renderer and version strings, and a later start loads them back instead
+    of compiling.  Builds hand the
+    sources to the driver and only look at the result once it reports the
+    link complete, so where the driver compiles in parallel
+    (KHR_parallel_shader_compile) all the programs build at once at startup,
+    and a rebuild runs alongside the frames being drawn.
+
+    update() looks at the files' modification times now and then and rebuilds
+    a program whose sources have changed.  The new program replaces the old
+    one only if it links; otherwise the log is printed and the old one stays.
+ **/
+class ShaderManager
+{
+public:
+    ShaderManager();
+    ~ShaderManager();
+
+    // Adds a program made of a vertex and a fragment shader file, either of
+    // which may be empty.  It comes from the cache or starts building.  The
+    // uniforms, if given, are resolved whenever the program links.
+    void add(const QString &name, const QString &vertFile, const QString &fragFile,
+             ShaderUniforms *uniforms = 0);
+
+    // Waits for the builds started by add(); every program exists afterwards
+    void finishBuilds();
+
+    // Checks for edited shaders every interval milliseconds and swaps in
+    // programs whose rebuild has linked.  Returns true on the frame one is
+    // swapped in, after which pointers from program() must be fetched again.
+    bool update(int interval = 500);
+
+    QGLShaderProgram *program(const QString &name) const { return m_programs.value(name); }
+
+    // Deletes the programs; the context must be current
+    void clear();
+
+private:
+    struct Build
+    {
+        Build() : uniforms(0), hash(0), pending(0), pendingHash(0) { shaders[0] = shaders[1] = 0; }
+
+        QString vertFile, fragFile;
+        ShaderUniforms *uniforms;
+        QDateTime vertTime, fragTime;   // modification times of the sources built last
+        quint64 hash;                   // and their hash
+        QGLShaderProgram *pending;      // a build in progress, or 0
+        GLuint shaders[2];              // its shader objects
+        quint64 pendingHash;
+    };
+
+    void initDriver();
+    bool readSources(const Build &build, QByteArray &vert, QByteArray &frag, quint64 &hash) const;
+    QString cacheFile(const QString &name) const;
+    QGLShaderProgram *loadBinary(const QString &name, quint64 hash) const;
+    void saveBinary(const QString &name, quint64 hash, QGLShaderProgram *program) const;
+    void startBuild(const QString &name, Build &build, const QByteArray &vert, const QByteArray &frag,
+                    quint64 hash);
+    bool buildDone(const Build &build) const;
+    bool finishBuild(const QString &name, Build &build);
+
+    QHash<QString, QGLShaderProgram *> m_programs;
+    QHash<QString, Build> m_builds;
+    QTime m_lastCheck;
+    bool m_driverReady;
+    QByteArray m_driver;                // vendor, renderer and version of the GL
+    bool m_binaries;                    // the driver can save and load programs
+    bool m_parallel;                    // and can compile them in the background
+};
+
+#endif // SHADERMANAGER_H
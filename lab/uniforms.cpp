@@ -0,0 +1,187 @@
+#define GL_GLEXT_PROTOTYPES
+#include "uniforms.h"
+
+#include <iostream>
+#include <string>
+
+using std::cout;
+using std::endl;
+
+void setUniform(GLint location, float value)
+{
+    glUniform1f(location, value);
+}
+
+void setUniform(GLint location, int value)
+{
+    glUniform1i(location, value);
+}
+
+void setUniform(GLint location, bool value)
+{
+    glUniform1i(location, value);
+}
+
+void setUniform(GLint location, const Vector2 &value)
+{
+    glUniform2f(location, value.x, value.y);
+}
+
+void setUniform(GLint location, const Vector3 &value)
+{
+    glUniform3f(location, value.x, value.y, value.z);
+}
+
+void setUniformArray(GLint location, const float *values, int count)
+{
+    glUniform1fv(location, count, values);
+}
+
+void ShaderUniforms::resolve(GLuint program, const QString &name)
+{
+    m_program = program;
+    m_name = name;
+    m_found.clear();
+
+    GLint previous = 0;
+    glGetIntegerv(GL_CURRENT_PROGRAM, &previous);
+    glUseProgram(program);
+    locate();
+    glUseProgram(previous);
+
+    // Every uniform outside a block should be one locate() knows about
+    GLint count = 0;
+    glGetProgramiv(program, GL_ACTIVE_UNIFORMS, &count);
+    for (GLuint i = 0; i < (GLuint) count; ++i)
+    {
+        GLint block = -1;
+        glGetActiveUniformsiv(program, 1, &i, GL_UNIFORM_BLOCK_INDEX, &block);
+        if (block != -1)
+            continue;
+        char buffer[256];
+        GLsizei length = 0;
+        glGetActiveUniformName(program, i, sizeof(buffer), &length, buffer);
+        QByteArray uniform(buffer, length);
+        if (uniform.endsWith("[0]"))
+            uniform.chop(3);
+        if (!uniform.startsWith("gl_") && !m_found.contains(uniform))
+            cout << name.toStdString() << ": uniform " << uniform.constData() << " is never set" << endl;
+    }
+}
+
+GLint ShaderUniforms::location(const char *name)
+{
+    m_found.append(name);
+    GLint location = glGetUniformLocation(m_program, name);
+    if (location < 0)
+        cout << m_name.toStdString() << ": no active uniform " << name << endl;
+    return location;
+}
+
+void ShaderUniforms::sampler(const char *name, int unit)
+{
+    glUniform1i(location(name), unit);
+}
+
+/**
+  Binds a uniform block to a binding point and checks its layout against the
+  struct that fills it: the same members at the same offsets, and no more
+  bytes than the struct has.
+
+  @param members: the struct's members, ending with a null name
+  @param size: sizeof the struct
+**/
+void ShaderUniforms::block(const char *name, GLuint binding, const BlockMember *members, int size)
+{
+    std::string program = m_name.toStdString();
+    GLuint index = glGetUniformBlockIndex(m_program, name);
+    if (index == GL_INVALID_INDEX)
+    {
+        cout << program << ": no active uniform block " << name << endl;
+        return;
+    }
+    glUniformBlockBinding(m_program, index, binding);
+
+    GLint blockSize = 0, active = 0, count = 0;
+    glGetActiveUniformBlockiv(m_program, index, GL_UNIFORM_BLOCK_DATA_SIZE, &blockSize);
+    glGetActiveUniformBlockiv(m_program, index, GL_UNIFORM_BLOCK_ACTIVE_UNIFORMS, &active);
+    for (; members[count].name; ++count)
+    {
+        GLuint member = GL_INVALID_INDEX;
+        GLint offset = -1;
+        glGetUniformIndices(m_program, 1, &members[count].name, &member);
+        if (member != GL_INVALID_INDEX)
+            glGetActiveUniformsiv(m_program, 1, &member, GL_UNIFORM_OFFSET, &offset);
+        if (offset != members[count].offset)
+            cout << program << ": " << name << "." << members[count].name << " is at offset " << offset
+                 << ", in its struct at " << members[count].offset << endl;
+    }
+    if (active != count || blockSize > size)
+        cout << program << ": uniform block " << name << " has " << active << " members in " << blockSize
+             << " bytes, its struct " << count << " in " << size << endl;
+}
+
+UniformBuffer::UniformBuffer() :
+    m_buffer(0), m_size(0)
+{
+}
+
+UniformBuffer::~UniformBuffer()
+{
+}
+
+int UniformBuffer::add(int size)
+{
+    m_sizes.append(size);
+    return m_sizes.size() - 1;
+}
+
+void UniformBuffer::create()
+{
+    GLint alignment = 1;
+    glGetIntegerv(GL_UNIFORM_BUFFER_OFFSET_ALIGNMENT, &alignment);
+    m_offsets.clear();
+    m_size = 0;
+    foreach (int size, m_sizes)
+    {
+        m_offsets.append(m_size);
+        m_size += (size + alignment - 1) / alignment * alignment;
+    }
+
+    glGenBuffers(1, &m_buffer);
+    glBindBuffer(GL_UNIFORM_BUFFER, m_buffer);
+    glBufferData(GL_UNIFORM_BUFFER, m_size, 0, GL_STREAM_DRAW);
+    glBindBuffer(GL_UNIFORM_BUFFER, 0);
+}
+
+/**
+  Maps the whole buffer, invalidating what it held.
+
+  @return the mapping, or 0 if it failed (the buffer is then unbound)
+**/
+char *UniformBuffer::map()
+{
+    glBindBuffer(GL_UNIFORM_BUFFER, m_buffer);
+    char *data = (char *) glMapBufferRange(GL_UNIFORM_BUFFER, 0, m_size,
+                                           GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_BUFFER_BIT);
+    if (!data)
+        glBindBuffer(GL_UNIFORM_BUFFER, 0);
+    return data;
+}
+
+void UniformBuffer::unmap()
+{
+    glUnmapBuffer(GL_UNIFORM_BUFFER);
+    glBindBuffer(GL_UNIFORM_BUFFER, 0);
+}
+
+void UniformBuffer::bind(int block, GLuint binding) const
+{
+    glBindBufferRange(GL_UNIFORM_BUFFER, binding, m_buffer, m_offsets[block], m_sizes[block]);
+}
+
+void UniformBuffer::clear()
+{
+    glDeleteBuffers(1, &m_buffer);
+    m_buffer = 0;
+}
@@ -0,0 +1,134 @@
+#ifndef UNIFORMS_H
+#define UNIFORMS_H
+
+#include <QByteArray>
+#include <QGLWidget>
+#include <QList>
+#include <QString>
+
+#include "vector.h"
+
+// glUniform for each type a Uniform can have
+void setUniform(GLint location, float value);
+void setUniform(GLint location, int value);
+void setUniform(GLint location, bool value);
+void setUniform(GLint location, const Vector2 &value);
+void setUniform(GLint location, const Vector3 &value);
+void setUniformArray(GLint location, const float *values, int count);
+
+// A member of a uniform block, and where the C++ struct filling the block
+// holds it; a list of them ends with a null name
+struct BlockMember
+{
+    const char *name;
+    int offset;
+};
+
+/**
+    A uniform of GLSL type T (float, int, bool, Vector2 or Vector3) of one
+    program.  Its location is looked up when the program links, so setting it
+    is a single glUniform call, made while the program is bound.
+ **/
+template <class T>
+class Uniform
+{
+public:
+    Uniform() : m_location(-1) {}
+    void set(const T &value) const { setUniform(m_location, value); }
+
+private:
+    friend class ShaderUniforms;
+    GLint m_location;
+};
+
+/**
+    A uniform array of GLSL type T[].  Only the first count entries are set.
+ **/
+template <class T>
+class UniformArray
+{
+public:
+    UniformArray() : m_location(-1) {}
+    void set(const T *values, int count) const { setUniformArray(m_location, values, count); }
+
+private:
+    friend class ShaderUniforms;
+    GLint m_location;
+};
+
+/**
+    The uniforms of one program.  A subclass holds a Uniform or UniformArray
+    member for each uniform the renderer sets and names them in locate(),
+    along with the samplers, whose texture units never change, and the
+    uniform blocks, which are given their binding points.
+
+    ShaderManager calls resolve() every time the program links, before it is
+    used.  Names and layouts are checked there: a name the program doesn't
+    have, a block member missing from the C++ struct or at another offset, and
+    a uniform of the program that locate() leaves out are all reported at
+    once, rather than silently ignored on every frame.
+ **/
+class ShaderUniforms
+{
+public:
+    ShaderUniforms() : m_program(0) {}
+    virtual ~ShaderUniforms() {}
+
+    // Looks up the uniforms in a newly linked program
+    void resolve(GLuint program, const QString &name);
+
+protected:
+    // Runs with the program bound and calls find(), sampler() and block()
+    virtual void locate() = 0;
+
+    template <class T>
+    void find(Uniform<T> &uniform, const char *name) { uniform.m_location = location(name); }
+    template <class T>
+    void find(UniformArray<T> &uniform, const char *name) { uniform.m_location = location(name); }
+    void sampler(const char *name, int unit);
+    void block(const char *name, GLuint binding, const BlockMember *members, int size);
+
+private:
+    GLint location(const char *name);
+
+    GLuint m_program;
+    QString m_name;
+    QList<QByteArray> m_found;          // names locate() asked for
+};
+
+/**
+    One buffer holding several uniform blocks, each at an offset
+    glBindBufferRange accepts.  It is rewritten as a whole with a single
+    mapping, which orphans the old storage, so frames the GPU is still
+    drawing keep their values without a stall.
+ **/
+class UniformBuffer
+{
+public:
+    UniformBuffer();
+    ~UniformBuffer();
+
+    // Appends a block of the given size.  Returns its index.
+    int add(int size);
+
+    // Lays the blocks out and allocates the buffer; the context must be current
+    void create();
+
+    // Maps the buffer for writing; block i starts at data + offset(i)
+    char *map();
+    void unmap();
+    int offset(int block) const { return m_offsets[block]; }
+
+    // Binds a block to a uniform block binding point
+    void bind(int block, GLuint binding) const;
+
+    // Deletes the buffer; the context must be current
+    void clear();
+
+private:
+    GLuint m_buffer;
+    QList<int> m_sizes, m_offsets;
+    int m_size;
+};
+
+#endif // UNIFORMS_H
@@ -0,0 +1,243 @@
+/*
+      envcache.cpp
+
+      The environment map cache declared in envcache.h.  An entry is a
+      header, the source's absolute path and the six faces, each at an
+      aligned offset so that the mapped file can be used in place.
+*/
+
+#include "envcache.h"
+#include <limits.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+/* ENVCACHE_MAGIC: "ENVC" read as a little-endian word */
+#define ENVCACHE_MAGIC   0x43564e45
+/* ENVCACHE_VERSION: bump whenever the layout, the filter or the packing changes */
+#define ENVCACHE_VERSION 1
+/* ENVCACHE_ALIGN: alignment of every section in the file */
+#define ENVCACHE_ALIGN   64
+
+/* ENVcacheheader: start of a cache file */
+typedef struct _ENVcacheheader {
+    unsigned magic;
+    unsigned version;
+    unsigned headersize;                /* sizeof(ENVcacheheader) */
+    unsigned format;
+    int      size;
+    int      levels;
+    int      samples;
+    unsigned pathsize;                  /* length of the source path, with its NUL */
+    uint64_t filesize;                  /* size of the whole cache */
+    uint64_t srcsize;                   /* size of the source image */
+    int64_t  srcmtime;                  /* modification time of the source (ns) */
+    uint64_t srchash;                   /* FNV-1a hash of the source contents */
+    uint64_t facesize;                  /* bytes of one face */
+    uint64_t path;                      /* section offsets */
+    uint64_t faces[6];
+    float    sh[27];
+    unsigned pad;
+} ENVcacheheader;
+
+/* envcacheHashFile: 64-bit FNV-1a hash of the contents of a file.
+ * Returns 0 if the file can't be read.
+ */
+static int envcacheHashFile(const char* filename, uint64_t* hash)
+{
+    struct stat st;
+    const unsigned char* data;
+    uint64_t h = 14695981039346656037ULL;
+    size_t i;
+    int fd = open(filename, O_RDONLY);
+    if (fd < 0)
+        return 0;
+    if (fstat(fd, &st) < 0) {
+        close(fd);
+        return 0;
+    }
+    data = st.st_size ? (const unsigned char*)mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0) : NULL;
+    close(fd);
+    if (data == MAP_FAILED)
+        return 0;
+    madvise((void*)data, st.st_size, MADV_SEQUENTIAL);
+    for (i = 0; i < (size_t)st.st_size; i++) {
+        h ^= data[i];
+        h *= 1099511628211ULL;
+    }
+    if (data)
+        munmap((void*)data, st.st_size);
+    *hash = h;
+    return 1;
+}
+
+/* envcacheModTime: modification time of a file in nanoseconds */
+static int64_t envcacheModTime(const struct stat* st)
+{
+    return (int64_t)st->st_mtim.tv_sec * 1000000000 + st->st_mtim.tv_nsec;
+}
+
+/* envcacheSection: reserve size bytes at the next aligned offset */
+static uint64_t envcacheSection(uint64_t* offset, uint64_t size)
+{
+    uint64_t start = (*offset + ENVCACHE_ALIGN - 1) & ~(uint64_t)(ENVCACHE_ALIGN - 1);
+    *offset = start + size;
+    return start;
+}
+
+/* envcacheCheck: is the section [offset, offset + size) inside the file? */
+static int envcacheCheck(const ENVcacheheader* header, uint64_t offset, uint64_t size)
+{
+    return offset >= sizeof(ENVcacheheader) && offset <= header->filesize &&
+        size <= header->filesize - offset;
+}
+
+/* envcacheFresh: check that an entry was made from the current contents
+ * of its source, refreshing the stored mtime if only that changed.
+ */
+static int envcacheFresh(const ENVcacheheader* header, const char* filename, const char* source)
+{
+    struct stat st;
+    uint64_t hash;
+    int64_t mtime;
+    int fd;
+    if (stat(source, &st) < 0 || (uint64_t)st.st_size != header->srcsize)
+        return 0;
+    if (envcacheModTime(&st) == header->srcmtime)
+        return 1;
+    if (!envcacheHashFile(source, &hash) || hash != header->srchash)
+        return 0;
+    mtime = envcacheModTime(&st);
+    fd = open(filename, O_WRONLY);
+    if (fd >= 0) {
+        if (pwrite(fd, &mtime, sizeof(mtime), offsetof(ENVcacheheader, srcmtime)) != sizeof(mtime))
+            fprintf(stderr, "envcacheOpen(): can't refresh \"%s\".\n", filename);
+        close(fd);
+    }
+    return 1;
+}
+
+ENVcache* envcacheOpen(const char* filename, const char* source, unsigned format, int levels, int samples)
+{
+    const ENVcacheheader* header;
+    ENVcache* cache;
+    char path[PATH_MAX];
+    struct stat st;
+    char* data;
+    int fd, f, ok;
+
+    if (!realpath(source, path))
+        return NULL;
+    fd = open(filename, O_RDONLY);
+    if (fd < 0)
+        return NULL;
+    if (fstat(fd, &st) < 0 || (size_t)st.st_size < sizeof(ENVcacheheader)) {
+        close(fd);
+        return NULL;
+    }
+    data = (char*)mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (data == MAP_FAILED)
+        return NULL;
+
+    /* make sure the entry is the one asked for */
+    header = (const ENVcacheheader*)data;
+    ok = header->magic == ENVCACHE_MAGIC && header->version == ENVCACHE_VERSION &&
+        header->headersize == sizeof(ENVcacheheader) && header->filesize == (uint64_t)st.st_size &&
+        header->format == format && header->levels == levels && header->samples == samples &&
+        header->pathsize == strlen(path) + 1 && envcacheCheck(header, header->path, header->pathsize) &&
+        memcmp(data + header->path, path, header->pathsize) == 0;
+    for (f = 0; f < 6 && ok; f++)
+        ok = envcacheCheck(header, header->faces[f], header->facesize);
+    if (!ok || !envcacheFresh(header, filename, source)) {
+        munmap(data, st.st_size);
+        return NULL;
+    }
+    madvise(data, st.st_size, MADV_WILLNEED);
+
+    cache = (ENVcache*)malloc(sizeof(ENVcache));
+    cache->format = header->format;
+    cache->size = header->size;
+    cache->levels = header->levels;
+    memcpy(cache->sh, header->sh, sizeof(cache->sh));
+    for (f = 0; f < 6; f++)
+        cache->faces[f] = data + header->faces[f];
+    cache->facesize = header->facesize;
+    cache->mapped = data;
+    cache->mappedsize = st.st_size;
+    return cache;
+}
+
+void envcacheClose(ENVcache* cache)
+{
+    if (!cache)
+        return;
+    munmap(cache->mapped, cache->mappedsize);
+    free(cache);
+}
+
+int envcacheWrite(const char* filename, const char* source, unsigned format, int size, int levels,
+                  int samples, const float sh[27], const char* const faces[6], size_t facesize)
+{
+    ENVcacheheader header;
+    char path[PATH_MAX];
+    struct stat st;
+    char* tempname;
+    FILE* file;
+    uint64_t offset;
+    int f, ok = 0;
+
+    memset(&header, 0, sizeof(header));
+    if (!realpath(source, path) || stat(source, &st) < 0 || !envcacheHashFile(source, &header.srchash)) {
+        fprintf(stderr, "envcacheWrite(): can't read source \"%s\".\n", source);
+        return 0;
+    }
+    header.magic      = ENVCACHE_MAGIC;
+    header.version    = ENVCACHE_VERSION;
+    header.headersize = sizeof(ENVcacheheader);
+    header.format     = format;
+    header.size       = size;
+    header.levels     = levels;
+    header.samples    = samples;
+    header.pathsize   = strlen(path) + 1;
+    header.srcsize    = st.st_size;
+    header.srcmtime   = envcacheModTime(&st);
+    header.facesize   = facesize;
+    memcpy(header.sh, sh, sizeof(header.sh));
+
+    /* lay out the sections */
+    offset = sizeof(ENVcacheheader);
+    header.path = envcacheSection(&offset, header.pathsize);
+    for (f = 0; f < 6; f++)
+        header.faces[f] = envcacheSection(&offset, facesize);
+    header.filesize = offset;
+
+    /* write it out under a temporary name and move it into place; the
+       gaps before aligned sections are filled by seeking past them */
+    tempname = (char*)malloc(strlen(filename) + 5);
+    strcpy(tempname, filename);
+    strcat(tempname, ".tmp");
+    file = fopen(tempname, "wb");
+    if (file) {
+        ok = fwrite(&header, sizeof(header), 1, file) == 1 &&
+            fseek(file, header.path, SEEK_SET) == 0 && fwrite(path, header.pathsize, 1, file) == 1;
+        for (f = 0; f < 6 && ok; f++)
+            ok = fseek(file, header.faces[f], SEEK_SET) == 0 && fwrite(faces[f], 1, facesize, file) == facesize;
+        if (fclose(file) != 0)
+            ok = 0;
+    }
+    if (!ok || rename(tempname, filename) < 0) {
+        fprintf(stderr, "envcacheWrite(): can't write cache \"%s\".\n", filename);
+        unlink(tempname);
+        free(tempname);
+        return 0;
+    }
+    free(tempname);
+    return 1;
+}
@@ -0,0 +1,70 @@
+#ifndef ENVCACHE_H
+#define ENVCACHE_H
+
+#include <stddef.h>
+
+/*
+      envcache.h
+
+      A disk cache of preprocessed environment maps.  An entry holds a
+      cube map exactly as it is uploaded: the texels of every mip level
+      of the six faces, already packed in the texture's format, and the
+      SH9 coefficients of its diffuse light.  The file is mapped rather
+      than read, so the faces are used in place and opening an entry
+      costs little more than the page faults of the upload.
+
+      An entry is keyed on the absolute path, size, modification time
+      and contents of its source image, and on the texel format, level
+      count and GGX sample count it was made with.  A matching size and
+      mtime is trusted as is; if only the mtime differs the source is
+      hashed, and the stored mtime is refreshed when the contents turn
+      out to be unchanged.
+*/
+
+/* ENVcache: an open cache entry */
+typedef struct _ENVcache {
+    unsigned format;                    /* OpenGL internal format of the texels */
+    int size;                           /* width and height of a level 0 face */
+    int levels;                         /* mip levels */
+    float sh[27];                       /* SH9 coefficients, as envfilterIrradianceSH9 gives them */
+    const char* faces[6];               /* each face's levels one after another, in the mapping */
+    size_t facesize;                    /* bytes of one face */
+    void* mapped;                       /* the cache file */
+    size_t mappedsize;
+} ENVcache;
+
+/* envcacheOpen: maps a cache entry.  Returns NULL if the file is
+ * missing, corrupt or from another version, if it was made for other
+ * settings, or if it no longer matches its source image.
+ *
+ * filename - name of the cache file
+ * source   - name of the image it stands for
+ * format   - texel format wanted
+ * levels   - mip levels wanted
+ * samples  - GGX samples per texel the levels must have been made with
+ */
+ENVcache* envcacheOpen(const char* filename, const char* source, unsigned format, int levels, int samples);
+
+/* envcacheClose: unmaps an entry and frees it.
+ */
+void envcacheClose(ENVcache* cache);
+
+/* envcacheWrite: writes a cache entry, stamped with the path, size,
+ * modification time and hash of its source.  It is written to a
+ * temporary file first and renamed into place, so a reader never sees
+ * a half-written entry.  Returns 0 if it can't be written.
+ *
+ * filename - name of the cache file
+ * source   - name of the image the cube map was made from
+ * format   - texel format of the faces
+ * size     - width and height of a level 0 face
+ * levels   - mip levels
+ * samples  - GGX samples per texel the levels were made with
+ * sh       - SH9 coefficients of the diffuse light
+ * faces    - the six faces, each with its levels one after another
+ * facesize - bytes of one face
+ */
+int envcacheWrite(const char* filename, const char* source, unsigned format, int size, int levels,
+                  int samples, const float sh[27], const char* const faces[6], size_t facesize);
+
+#endif // ENVCACHE_H
@@ -0,0 +1,541 @@
+/*
+      envfilter.cpp
+
+      GGX prefiltering and SH9 projection of cube maps, as declared in
+      envfilter.h.  The filter works a row of a face at a time: every
+      texel of the row turns the same table of tangent space sample
+      directions into its own frame, finds the face and texels each
+      direction lands on and blends them bilinearly.  The AVX2 version
+      does 8 texels of a row at once with the same operations in the
+      same order, fetching with gathers, so its results match the scalar
+      one exactly.
+*/
+
+#include "envfilter.h"
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+#include "parallel.h"
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define ENVFILTER_X86 1
+#include <immintrin.h>
+#define ENVFILTER_AVX2 __attribute__((target("avx2")))
+#endif
+
+#ifndef M_PI
+#define M_PI 3.14159265358979323846
+#endif
+
+/* normals this close to the z axis get their tangent from the x axis */
+#define ENVFILTER_POLE 0.999f
+
+static int g_simd = -1;             /* -1 = not decided yet */
+
+/* envfilterCanUseSIMD: does the processor run AVX2 code? */
+static int envfilterCanUseSIMD()
+{
+#ifdef ENVFILTER_X86
+    __builtin_cpu_init();
+    return __builtin_cpu_supports("avx2") ? 1 : 0;
+#else
+    return 0;
+#endif
+}
+
+int envfilterHasSIMD()
+{
+    if (g_simd < 0)
+        g_simd = envfilterCanUseSIMD();
+    return g_simd;
+}
+
+int envfilterSetSIMD(int enable)
+{
+    g_simd = enable ? envfilterCanUseSIMD() : 0;
+    return g_simd;
+}
+
+/* ---- cubes ---- */
+
+ENVcube* envfilterNew(int size, int levels)
+{
+    ENVcube* cube;
+    int i, full = 1;
+    while (size >> full)
+        full++;
+    if (levels > full)
+        levels = full;
+    if (levels > ENVFILTER_MAX_LEVELS)
+        levels = ENVFILTER_MAX_LEVELS;
+    if (size < 1 || levels < 1)
+        return NULL;
+    cube = (ENVcube*)calloc(1, sizeof(ENVcube));
+    if (!cube)
+        return NULL;
+    cube->size = size;
+    cube->levels = levels;
+    for (i = 0; i < levels; i++) {
+        int s = envfilterLevelSize(cube, i);
+        cube->data[i] = (float*)malloc(sizeof(float) * 3 * 6 * s * s);
+        if (!cube->data[i]) {
+            envfilterFree(cube);
+            return NULL;
+        }
+    }
+    return cube;
+}
+
+void envfilterFree(ENVcube* cube)
+{
+    int i;
+    if (!cube)
+        return;
+    for (i = 0; i < ENVFILTER_MAX_LEVELS; i++)
+        free(cube->data[i]);
+    free(cube);
+}
+
+int envfilterLevelSize(const ENVcube* cube, int level)
+{
+    int s = cube->size >> level;
+    return s > 0 ? s : 1;
+}
+
+float* envfilterFace(const ENVcube* cube, int level, int face)
+{
+    int s = envfilterLevelSize(cube, level);
+    return cube->data[level] + (size_t)3 * s * s * face;
+}
+
+/* envfilterDownsample: box filters six faces to half their size */
+static void envfilterDownsample(const float* src, int size, float* dst)
+{
+    int half = size > 1 ? size / 2 : 1;
+    int f, x, y, c;
+    for (f = 0; f < 6; f++) {
+        const float* face = src + (size_t)3 * size * size * f;
+        for (y = 0; y < half; y++) {
+            int y0 = 2 * y < size ? 2 * y : size - 1, y1 = 2 * y + 1 < size ? 2 * y + 1 : size - 1;
+            for (x = 0; x < half; x++, dst += 3) {
+                int x0 = 2 * x < size ? 2 * x : size - 1, x1 = 2 * x + 1 < size ? 2 * x + 1 : size - 1;
+                for (c = 0; c < 3; c++)
+                    dst[c] = 0.25f * (face[3 * (y0 * size + x0) + c] + face[3 * (y0 * size + x1) + c] +
+                                      face[3 * (y1 * size + x0) + c] + face[3 * (y1 * size + x1) + c]);
+            }
+        }
+    }
+}
+
+/* ENV_FACE_AXES: the direction through a texel of each face, as
+ * a * [0] + b * [1] + [2] per component, where a and b run from -1 to
+ * 1 across and down the face.
+ */
+static const float ENV_FACE_AXES[6][3][3] = {
+    { { 0,  0,  1 }, { 0, -1,  0 }, { -1,  0,  0 } },  /* +X */
+    { { 0,  0, -1 }, { 0, -1,  0 }, {  1,  0,  0 } },  /* -X */
+    { { 1,  0,  0 }, { 0,  0,  1 }, {  0,  1,  0 } },  /* +Y */
+    { { 1,  0,  0 }, { 0,  0, -1 }, {  0, -1,  0 } },  /* -Y */
+    { { 1,  0,  0 }, { 0, -1,  0 }, {  0,  0,  1 } },  /* +Z */
+    { {-1,  0,  0 }, { 0, -1,  0 }, {  0,  0, -1 } }   /* -Z */
+};
+
+/* ---- GGX prefilter ---- */
+
+/* ENVsample: a direction of the sample table, in tangent space */
+typedef struct {
+    float x, y, z;
+    float weight;                       /* cosine with the normal */
+    int level;                          /* source level it is read from */
+} ENVsample;
+
+typedef struct {
+    const float* src[ENVFILTER_MAX_LEVELS];  /* level 0 and its box filtered mips */
+    int srcsize;
+    ENVsample* samples;
+    int count;
+    float invweight;                    /* 1 / the sum of the weights */
+    float* dst;                         /* the level being filled */
+    int size;                           /* its face size */
+} ENVggxJob;
+
+/* envfilterRadicalInverse: van der Corput sequence in base 2 */
+static double envfilterRadicalInverse(unsigned i)
+{
+    i = (i << 16) | (i >> 16);
+    i = ((i & 0x55555555u) << 1) | ((i & 0xaaaaaaaau) >> 1);
+    i = ((i & 0x33333333u) << 2) | ((i & 0xccccccccu) >> 2);
+    i = ((i & 0x0f0f0f0fu) << 4) | ((i & 0xf0f0f0f0u) >> 4);
+    i = ((i & 0x00ff00ffu) << 8) | ((i & 0xff00ff00u) >> 8);
+    return i * 2.3283064365386963e-10;
+}
+
+/* envfilterSampleTable: importance samples the GGX distribution over a
+ * Hammersley set, dropping the directions below the horizon, and picks
+ * the source level for each from the solid angle it stands for.
+ * Returns the number of samples kept.
+ */
+static int envfilterSampleTable(ENVggxJob* job, int count, double roughness, int srclevels)
+{
+    double a2 = roughness * roughness * roughness * roughness;
+    double texelangle = 4.0 * M_PI / (6.0 * job->srcsize * job->srcsize);
+    double total = 0.0;
+    int i, n = 0;
+    for (i = 0; i < count; i++) {
+        double phi = 2.0 * M_PI * i / count, u = envfilterRadicalInverse(i);
+        double c = sqrt((1.0 - u) / (1.0 + (a2 - 1.0) * u)), s = sqrt(1.0 - c * c);
+        double d = c * c * (a2 - 1.0) + 1.0, pdf = a2 / (M_PI * d * d) / 4.0;
+        double lod = 0.5 * log2(1.0 / (count * pdf * texelangle)) + 1.0;
+        ENVsample* sample = &job->samples[n];
+        if (2.0 * c * c - 1.0 <= 0.0)
+            continue;
+        sample->x = (float)(2.0 * c * s * cos(phi));
+        sample->y = (float)(2.0 * c * s * sin(phi));
+        sample->z = (float)(2.0 * c * c - 1.0);
+        sample->weight = sample->z;
+        sample->level = lod <= 0.0 ? 0 : lod >= srclevels - 1 ? srclevels - 1 : (int)(lod + 0.5);
+        total += sample->weight;
+        n++;
+    }
+    job->count = n;
+    job->invweight = (float)(1.0 / total);
+    return n;
+}
+
+/* envfilterFetch: bilinearly filtered texel of a cube in direction
+ * (x, y, z), clamped to the edges of the face it lands on.
+ */
+static void envfilterFetch(const float* texels, int size, float x, float y, float z, float* rgb)
+{
+    float ax = fabsf(x), ay = fabsf(y), az = fabsf(z), ma, sc, tc, u, v, fx, fy, x0f, y0f;
+    int face, x0, x1, y0, y1, c;
+    const float *c00, *c10, *c01, *c11;
+    if (ax >= ay && ax >= az) {
+        ma = ax; tc = -y;
+        if (x >= 0.0f) { face = 0; sc = -z; } else { face = 1; sc = z; }
+    } else if (ay >= az) {
+        ma = ay; sc = x;
+        if (y >= 0.0f) { face = 2; tc = z; } else { face = 3; tc = -z; }
+    } else {
+        ma = az; tc = -y;
+        if (z >= 0.0f) { face = 4; sc = x; } else { face = 5; sc = -x; }
+    }
+    u = (sc / ma + 1.0f) * (0.5f * size) - 0.5f;
+    v = (tc / ma + 1.0f) * (0.5f * size) - 0.5f;
+    x0f = floorf(u);
+    y0f = floorf(v);
+    fx = u - x0f;
+    fy = v - y0f;
+    x0 = (int)x0f; x1 = x0 + 1;
+    y0 = (int)y0f; y1 = y0 + 1;
+    x0 = x0 < 0 ? 0 : x0 > size - 1 ? size - 1 : x0;
+    x1 = x1 < 0 ? 0 : x1 > size - 1 ? size - 1 : x1;
+    y0 = y0 < 0 ? 0 : y0 > size - 1 ? size - 1 : y0;
+    y1 = y1 < 0 ? 0 : y1 > size - 1 ? size - 1 : y1;
+    c00 = texels + 3 * ((face * size + y0) * size + x0);
+    c10 = texels + 3 * ((face * size + y0) * size + x1);
+    c01 = texels + 3 * ((face * size + y1) * size + x0);
+    c11 = texels + 3 * ((face * size + y1) * size + x1);
+    for (c = 0; c < 3; c++)
+        rgb[c] = (c00[c] * (1.0f - fx) + c10[c] * fx) * (1.0f - fy) + (c01[c] * (1.0f - fx) + c11[c] * fx) * fy;
+}
+
+/* envfilterTexelScalar: filters the texel at (a, b) on a face */
+static void envfilterTexelScalar(const ENVggxJob* job, int face, float a, float b, float* out)
+{
+    const float (*axes)[3] = ENV_FACE_AXES[face];
+    float nx = axes[0][0] * a + axes[0][1] * b + axes[0][2];
+    float ny = axes[1][0] * a + axes[1][1] * b + axes[1][2];
+    float nz = axes[2][0] * a + axes[2][1] * b + axes[2][2];
+    float inv = 1.0f / sqrtf(nx * nx + ny * ny + nz * nz);
+    float tx, ty, tz, bx, by, bz, sum[3] = { 0.0f, 0.0f, 0.0f }, rgb[3];
+    int k;
+    nx = nx * inv; ny = ny * inv; nz = nz * inv;
+    if (fabsf(nz) < ENVFILTER_POLE) {
+        tx = -ny; ty = nx; tz = 0.0f;
+    } else {
+        tx = 0.0f; ty = -nz; tz = ny;
+    }
+    inv = 1.0f / sqrtf(tx * tx + ty * ty + tz * tz);
+    tx = tx * inv; ty = ty * inv; tz = tz * inv;
+    bx = ny * tz - nz * ty;
+    by = nz * tx - nx * tz;
+    bz = nx * ty - ny * tx;
+    for (k = 0; k < job->count; k++) {
+        const ENVsample* s = &job->samples[k];
+        envfilterFetch(job->src[s->level], job->srcsize >> s->level,
+                       tx * s->x + bx * s->y + nx * s->z,
+                       ty * s->x + by * s->y + ny * s->z,
+                       tz * s->x + bz * s->y + nz * s->z, rgb);
+        sum[0] = sum[0] + rgb[0] * s->weight;
+        sum[1] = sum[1] + rgb[1] * s->weight;
+        sum[2] = sum[2] + rgb[2] * s->weight;
+    }
+    out[0] = sum[0] * job->invweight;
+    out[1] = sum[1] * job->invweight;
+    out[2] = sum[2] * job->invweight;
+}
+
+#ifdef ENVFILTER_X86
+
+/* envfilterFetchAVX2: envfilterFetch for 8 directions */
+ENVFILTER_AVX2
+static inline void envfilterFetchAVX2(const float* texels, int size, __m256 x, __m256 y, __m256 z,
+                                      __m256* r, __m256* g, __m256* b)
+{
+    const __m256 sign = _mm256_set1_ps(-0.0f);
+    const __m256 zero = _mm256_setzero_ps();
+    const __m256 one = _mm256_set1_ps(1.0f);
+    const __m256 half = _mm256_set1_ps(0.5f * size);
+    const __m256i last = _mm256_set1_epi32(size - 1);
+    const __m256i izero = _mm256_setzero_si256();
+    const __m256i three = _mm256_set1_epi32(3);
+    __m256 ax = _mm256_andnot_ps(sign, x), ay = _mm256_andnot_ps(sign, y), az = _mm256_andnot_ps(sign, z);
+    __m256 nx = _mm256_xor_ps(x, sign), ny = _mm256_xor_ps(y, sign), nz = _mm256_xor_ps(z, sign);
+    __m256 xmajor = _mm256_and_ps(_mm256_cmp_ps(ax, ay, _CMP_GE_OQ), _mm256_cmp_ps(ax, az, _CMP_GE_OQ));
+    __m256 ymajor = _mm256_andnot_ps(xmajor, _mm256_cmp_ps(ay, az, _CMP_GE_OQ));
+    __m256 xpos = _mm256_cmp_ps(x, zero, _CMP_GE_OQ);
+    __m256 ypos = _mm256_cmp_ps(y, zero, _CMP_GE_OQ);
+    __m256 zpos = _mm256_cmp_ps(z, zero, _CMP_GE_OQ);
+    __m256 ma, sc, tc, face, u, v, x0f, y0f, fx, fy, gx, gy;
+    __m256i ix0, ix1, iy0, iy1, row0, row1, i00, i10, i01, i11;
+
+    /* z major, then overridden by y and x major lanes */
+    ma = az;
+    sc = _mm256_blendv_ps(nx, x, zpos);
+    tc = ny;
+    face = _mm256_blendv_ps(_mm256_set1_ps(5.0f), _mm256_set1_ps(4.0f), zpos);
+    ma = _mm256_blendv_ps(ma, ay, ymajor);
+    sc = _mm256_blendv_ps(sc, x, ymajor);
+    tc = _mm256_blendv_ps(tc, _mm256_blendv_ps(nz, z, ypos), ymajor);
+    face = _mm256_blendv_ps(face, _mm256_blendv_ps(_mm256_set1_ps(3.0f), _mm256_set1_ps(2.0f), ypos), ymajor);
+    ma = _mm256_blendv_ps(ma, ax, xmajor);
+    sc = _mm256_blendv_ps(sc, _mm256_blendv_ps(z, nz, xpos), xmajor);
+    tc = _mm256_blendv_ps(tc, ny, xmajor);
+    face = _mm256_blendv_ps(face, _mm256_blendv_ps(one, zero, xpos), xmajor);
+
+    u = _mm256_sub_ps(_mm256_mul_ps(_mm256_add_ps(_mm256_div_ps(sc, ma), one), half), _mm256_set1_ps(0.5f));
+    v = _mm256_sub_ps(_mm256_mul_ps(_mm256_add_ps(_mm256_div_ps(tc, ma), one), half), _mm256_set1_ps(0.5f));
+    x0f = _mm256_floor_ps(u);
+    y0f = _mm256_floor_ps(v);
+    fx = _mm256_sub_ps(u, x0f);
+    fy = _mm256_sub_ps(v, y0f);
+    gx = _mm256_sub_ps(one, fx);
+    gy = _mm256_sub_ps(one, fy);
+    ix0 = _mm256_cvttps_epi32(x0f);
+    iy0 = _mm256_cvttps_epi32(y0f);
+    ix1 = _mm256_min_epi32(_mm256_max_epi32(_mm256_add_epi32(ix0, _mm256_set1_epi32(1)), izero), last);
+    iy1 = _mm256_min_epi32(_mm256_max_epi32(_mm256_add_epi32(iy0, _mm256_set1_epi32(1)), izero), last);
+    ix0 = _mm256_min_epi32(_mm256_max_epi32(ix0, izero), last);
+    iy0 = _mm256_min_epi32(_mm256_max_epi32(iy0, izero), last);
+
+    /* index of texel (x, y) of a face: 3 * ((face * size + y) * size + x) */
+    row0 = _mm256_mullo_epi32(_mm256_add_epi32(_mm256_mullo_epi32(_mm256_cvttps_epi32(face), _mm256_set1_epi32(size)), iy0),
+                              _mm256_set1_epi32(size));
+    row1 = _mm256_add_epi32(row0, _mm256_mullo_epi32(_mm256_sub_epi32(iy1, iy0), _mm256_set1_epi32(size)));
+    i00 = _mm256_mullo_epi32(_mm256_add_epi32(row0, ix0), three);
+    i10 = _mm256_mullo_epi32(_mm256_add_epi32(row0, ix1), three);
+    i01 = _mm256_mullo_epi32(_mm256_add_epi32(row1, ix0), three);
+    i11 = _mm256_mullo_epi32(_mm256_add_epi32(row1, ix1), three);
+
+#define ENVFILTER_BILERP(p) \
+    _mm256_add_ps(_mm256_mul_ps(_mm256_add_ps(_mm256_mul_ps(_mm256_i32gather_ps((p), i00, 4), gx), \
+                                              _mm256_mul_ps(_mm256_i32gather_ps((p), i10, 4), fx)), gy), \
+                  _mm256_mul_ps(_mm256_add_ps(_mm256_mul_ps(_mm256_i32gather_ps((p), i01, 4), gx), \
+                                              _mm256_mul_ps(_mm256_i32gather_ps((p), i11, 4), fx)), fy))
+    *r = ENVFILTER_BILERP(texels);
+    *g = ENVFILTER_BILERP(texels + 1);
+    *b = ENVFILTER_BILERP(texels + 2);
+#undef ENVFILTER_BILERP
+}
+
+/* envfilterTexelsAVX2: filters 8 texels of a row, starting at column x */
+ENVFILTER_AVX2
+static void envfilterTexelsAVX2(const ENVggxJob* job, int face, int x, float b, float* out)
+{
+    const float (*axes)[3] = ENV_FACE_AXES[face];
+    const __m256 sign = _mm256_set1_ps(-0.0f);
+    const __m256 one = _mm256_set1_ps(1.0f);
+    const __m256 zero = _mm256_setzero_ps();
+    __m256 a = _mm256_sub_ps(_mm256_div_ps(_mm256_mul_ps(_mm256_set1_ps(2.0f),
+                             _mm256_add_ps(_mm256_cvtepi32_ps(_mm256_add_epi32(_mm256_set1_epi32(x),
+                                                                              _mm256_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7))),
+                                           _mm256_set1_ps(0.5f))),
+                             _mm256_set1_ps((float)job->size)), one);
+    __m256 vb = _mm256_set1_ps(b);
+    __m256 nx = _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(_mm256_set1_ps(axes[0][0]), a), _mm256_mul_ps(_mm256_set1_ps(axes[0][1]), vb)), _mm256_set1_ps(axes[0][2]));
+    __m256 ny = _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(_mm256_set1_ps(axes[1][0]), a), _mm256_mul_ps(_mm256_set1_ps(axes[1][1]), vb)), _mm256_set1_ps(axes[1][2]));
+    __m256 nz = _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(_mm256_set1_ps(axes[2][0]), a), _mm256_mul_ps(_mm256_set1_ps(axes[2][1]), vb)), _mm256_set1_ps(axes[2][2]));
+    __m256 inv, tx, ty, tz, bx, by, bz, side, sr, sg, sb, r, g, bl;
+    float rgb[3][8];
+    int k, i;
+
+    inv = _mm256_div_ps(one, _mm256_sqrt_ps(_mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(nx, nx), _mm256_mul_ps(ny, ny)), _mm256_mul_ps(nz, nz))));
+    nx = _mm256_mul_ps(nx, inv);
+    ny = _mm256_mul_ps(ny, inv);
+    nz = _mm256_mul_ps(nz, inv);
+    side = _mm256_cmp_ps(_mm256_andnot_ps(sign, nz), _mm256_set1_ps(ENVFILTER_POLE), _CMP_LT_OQ);
+    tx = _mm256_blendv_ps(zero, _mm256_xor_ps(ny, sign), side);
+    ty = _mm256_blendv_ps(_mm256_xor_ps(nz, sign), nx, side);
+    tz = _mm256_blendv_ps(ny, zero, side);
+    inv = _mm256_div_ps(one, _mm256_sqrt_ps(_mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(tx, tx), _mm256_mul_ps(ty, ty)), _mm256_mul_ps(tz, tz))));
+    tx = _mm256_mul_ps(tx, inv);
+    ty = _mm256_mul_ps(ty, inv);
+    tz = _mm256_mul_ps(tz, inv);
+    bx = _mm256_sub_ps(_mm256_mul_ps(ny, tz), _mm256_mul_ps(nz, ty));
+    by = _mm256_sub_ps(_mm256_mul_ps(nz, tx), _mm256_mul_ps(nx, tz));
+    bz = _mm256_sub_ps(_mm256_mul_ps(nx, ty), _mm256_mul_ps(ny, tx));
+
+    sr = sg = sb = zero;
+    for (k = 0; k < job->count; k++) {
+        const ENVsample* s = &job->samples[k];
+        __m256 lx = _mm256_set1_ps(s->x), ly = _mm256_set1_ps(s->y), lz = _mm256_set1_ps(s->z);
+        __m256 w = _mm256_set1_ps(s->weight);
+        envfilterFetchAVX2(job->src[s->level], job->srcsize >> s->level,
+                           _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(tx, lx), _mm256_mul_ps(bx, ly)), _mm256_mul_ps(nx, lz)),
+                           _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(ty, lx), _mm256_mul_ps(by, ly)), _mm256_mul_ps(ny, lz)),
+                           _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(tz, lx), _mm256_mul_ps(bz, ly)), _mm256_mul_ps(nz, lz)),
+                           &r, &g, &bl);
+        sr = _mm256_add_ps(sr, _mm256_mul_ps(r, w));
+        sg = _mm256_add_ps(sg, _mm256_mul_ps(g, w));
+        sb = _mm256_add_ps(sb, _mm256_mul_ps(bl, w));
+    }
+    inv = _mm256_set1_ps(job->invweight);
+    _mm256_storeu_ps(rgb[0], _mm256_mul_ps(sr, inv));
+    _mm256_storeu_ps(rgb[1], _mm256_mul_ps(sg, inv));
+    _mm256_storeu_ps(rgb[2], _mm256_mul_ps(sb, inv));
+    for (i = 0; i < 8; i++) {
+        out[3 * i + 0] = rgb[0][i];
+        out[3 * i + 1] = rgb[1][i];
+        out[3 * i + 2] = rgb[2][i];
+    }
+}
+
+#endif
+
+/* envfilterGGXTask: filters one row of one face of the job's level */
+static void envfilterGGXTask(int index, void* arg)
+{
+    const ENVggxJob* job = (const ENVggxJob*)arg;
+    int size = job->size, face = index / size, y = index % size, x = 0;
+    float b = (2.0f * (y + 0.5f)) / (float)size - 1.0f;
+    float* out = job->dst + (size_t)3 * size * index;
+#ifdef ENVFILTER_X86
+    if (envfilterHasSIMD())
+        for (; x + 8 <= size; x += 8)
+            envfilterTexelsAVX2(job, face, x, b, out + 3 * x);
+#endif
+    for (; x < size; x++)
+        envfilterTexelScalar(job, face, (2.0f * (x + 0.5f)) / (float)size - 1.0f, b, out + 3 * x);
+}
+
+void envfilterPrefilterGGX(ENVcube* cube, int samples)
+{
+    ENVggxJob job;
+    float* mips[ENVFILTER_MAX_LEVELS];
+    int srclevels = 1, i;
+    if (cube->levels < 2 || samples < 1)
+        return;
+
+    /* box filtered mips of level 0 to read the samples from */
+    memset(mips, 0, sizeof(mips));
+    job.src[0] = cube->data[0];
+    job.srcsize = cube->size;
+    while ((cube->size >> srclevels) && srclevels < ENVFILTER_MAX_LEVELS) {
+        int s = cube->size >> srclevels;
+        mips[srclevels] = (float*)malloc(sizeof(float) * 3 * 6 * s * s);
+        envfilterDownsample(job.src[srclevels - 1], cube->size >> (srclevels - 1), mips[srclevels]);
+        job.src[srclevels] = mips[srclevels];
+        srclevels++;
+    }
+
+    job.samples = (ENVsample*)malloc(sizeof(ENVsample) * samples);
+    for (i = 1; i < cube->levels; i++) {
+        if (!envfilterSampleTable(&job, samples, (double)i / (cube->levels - 1), srclevels))
+            continue;
+        job.dst = cube->data[i];
+        job.size = envfilterLevelSize(cube, i);
+        parallelFor(6 * job.size, envfilterGGXTask, &job);
+    }
+    free(job.samples);
+    for (i = 1; i < srclevels; i++)
+        free(mips[i]);
+}
+
+/* ---- SH9 irradiance ---- */
+
+typedef struct {
+    const ENVcube* cube;
+    double* sums;                       /* 28 per row: 9 RGB sums and the solid angle */
+} ENVsh9Job;
+
+/* envfilterSH9Task: sums the radiance of one row of a face times the
+ * nine basis polynomials, weighted by the solid angle of each texel.
+ */
+static void envfilterSH9Task(int index, void* arg)
+{
+    const ENVsh9Job* job = (const ENVsh9Job*)arg;
+    int size = job->cube->size, face = index / size, y = index % size, x, i, c;
+    const float (*axes)[3] = ENV_FACE_AXES[face];
+    const float* texel = job->cube->data[0] + (size_t)3 * size * index;
+    double* sums = job->sums + 28 * index;
+    double b = 2.0 * (y + 0.5) / size - 1.0;
+    memset(sums, 0, 28 * sizeof(double));
+    for (x = 0; x < size; x++, texel += 3) {
+        double a = 2.0 * (x + 0.5) / size - 1.0;
+        double len2 = 1.0 + a * a + b * b, len = sqrt(len2);
+        double dx = (axes[0][0] * a + axes[0][1] * b + axes[0][2]) / len;
+        double dy = (axes[1][0] * a + axes[1][1] * b + axes[1][2]) / len;
+        double dz = (axes[2][0] * a + axes[2][1] * b + axes[2][2]) / len;
+        double dw = 4.0 / ((double)size * size * len2 * len);
+        double p[9];
+        p[0] = 1.0;
+        p[1] = dy;
+        p[2] = dz;
+        p[3] = dx;
+        p[4] = dx * dy;
+        p[5] = dy * dz;
+        p[6] = 3.0 * dz * dz - 1.0;
+        p[7] = dx * dz;
+        p[8] = dx * dx - dy * dy;
+        for (i = 0; i < 9; i++)
+            for (c = 0; c < 3; c++)
+                sums[3 * i + c] += texel[c] * p[i] * dw;
+        sums[27] += dw;
+    }
+}
+
+void envfilterIrradianceSH9(const ENVcube* cube, float sh[27])
+{
+    /* the squares of the basis constants, times the cosine lobe's
+       coefficients over pi (1, 2/3 and 1/4 for bands 0, 1 and 2) */
+    static const double k[9] = {
+        0.282094792 * 0.282094792,
+        0.488602512 * 0.488602512 * 2.0 / 3.0,
+        0.488602512 * 0.488602512 * 2.0 / 3.0,
+        0.488602512 * 0.488602512 * 2.0 / 3.0,
+        1.092548431 * 1.092548431 / 4.0,
+        1.092548431 * 1.092548431 / 4.0,
+        0.315391565 * 0.315391565 / 4.0,
+        1.092548431 * 1.092548431 / 4.0,
+        0.546274215 * 0.546274215 / 4.0
+    };
+    ENVsh9Job job;
+    double total[28], scale;
+    int rows = 6 * cube->size, i, j;
+    job.cube = cube;
+    job.sums = (double*)malloc(sizeof(double) * 28 * rows);
+    parallelFor(rows, envfilterSH9Task, &job);
+
+    /* add the rows up in order, so the result doesn't depend on the threads */
+    memset(total, 0, sizeof(total));
+    for (i = 0; i < rows; i++)
+        for (j = 0; j < 28; j++)
+            total[j] += job.sums[28 * i + j];
+    free(job.sums);
+
+    /* the texel solid angles are approximate; make them add up to 4 pi */
+    scale = 4.0 * M_PI / total[27];
+    for (i = 0; i < 27; i++)
+        sh[i] = (float)(total[i] * scale * k[i / 3]);
+}
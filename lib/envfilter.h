@@ -0,0 +1,83 @@
+#ifndef ENVFILTER_H
+#define ENVFILTER_H
+
+/*
+      envfilter.h
+
+      Prefiltering of environment cube maps for glossy and diffuse
+      lighting.  The mip levels of a cube are refiltered with the GGX
+      distribution, one roughness per level, so that a shader can look up
+      any roughness with one trilinear fetch, and the diffuse light is
+      projected onto nine spherical harmonics.  Both spread their work
+      over the parallel.h pool; the GGX filter has an AVX2 version,
+      picked at runtime, which gives the same floats as the scalar one.
+
+      Faces are in OpenGL order (+X, -X, +Y, -Y, +Z, -Z), each with its
+      top row first, which is how they are uploaded.
+*/
+
+/* ENVFILTER_MAX_LEVELS: most mip levels an ENVcube can have */
+#define ENVFILTER_MAX_LEVELS 16
+
+/* ENVcube: a cube map of float RGB texels with a chain of mip levels */
+typedef struct _ENVcube {
+    int size;                           /* width and height of a level 0 face */
+    int levels;                         /* number of levels, each half the last */
+    float* data[ENVFILTER_MAX_LEVELS];  /* per level, its six faces one after another */
+} ENVcube;
+
+/* envfilterNew: allocates a cube with levels mip levels.  levels is
+ * cut down to the length of a full mip chain.  The texels are not
+ * initialized.  Returns NULL if out of memory.
+ *
+ * size   - width and height of the level 0 faces
+ * levels - number of mip levels wanted
+ */
+ENVcube* envfilterNew(int size, int levels);
+
+/* envfilterFree: frees a cube and its levels.
+ */
+void envfilterFree(ENVcube* cube);
+
+/* envfilterLevelSize: width and height of the faces of a level */
+int envfilterLevelSize(const ENVcube* cube, int level);
+
+/* envfilterFace: the texels of one face of a level */
+float* envfilterFace(const ENVcube* cube, int level, int face);
+
+/* envfilterPrefilterGGX: fills levels 1 and up with level 0 convolved
+ * with the GGX distribution, for a roughness of level / (levels - 1),
+ * so the last level is fully rough.  The view is taken to be along the
+ * normal.  Every texel takes samples importance sampled directions,
+ * each read from a box filtered mip of level 0 whose texels cover about
+ * as much solid angle as the sample does, which keeps the noise down
+ * with few samples.
+ *
+ * cube    - a cube with level 0 filled in
+ * samples - directions per texel
+ */
+void envfilterPrefilterGGX(ENVcube* cube, int samples);
+
+/* envfilterIrradianceSH9: projects level 0 onto the first nine real
+ * spherical harmonics and convolves them with the clamped cosine, so
+ * that the diffuse light (irradiance over pi) in a direction n is
+ *
+ *   c0 + c1 y + c2 z + c3 x + c4 x y + c5 y z + c6 (3 z z - 1)
+ *      + c7 x z + c8 (x x - y y)
+ *
+ * with the basis functions' constants folded into the coefficients.
+ *
+ * cube - a cube with level 0 filled in
+ * sh   - receives the nine RGB coefficients c0 to c8
+ */
+void envfilterIrradianceSH9(const ENVcube* cube, float sh[27]);
+
+/* envfilterHasSIMD: returns nonzero if the AVX2 filter is in use */
+int envfilterHasSIMD();
+
+/* envfilterSetSIMD: turns the AVX2 filter on (if the processor supports
+ * it) or off.  Returns nonzero if it is in use afterwards.
+ */
+int envfilterSetSIMD(int enable);
+
+#endif // ENVFILTER_H
@@ -16,17 +16,28 @@
       Made it actually work.
 */
 
+#define GL_GLEXT_PROTOTYPES
 #include <math.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <limits.h>
 #include <assert.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <ctype.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
 #define GL_GLEXT_PROTOTYPES
 #include <GL/gl.h>
 #include <GL/glu.h>
 #include <GL/glext.h>
 #include "glm.h"
 #include "targa.h"
+#include "parallel.h"
+#include "meshmath.h"
 
 
 #ifndef GL_BGR
@@ -46,14 +57,6 @@
 #define T(x) (model->triangles[(x)])
 GLuint glmLoadTexture(char *filename, GLboolean alpha, GLboolean repeat, GLboolean filtering, GLboolean mipmaps, GLfloat *texcoordwidth, GLfloat *texcoordheight);
 
-/* _GLMnode: general purpose node */
-typedef struct _GLMnode {
-    GLuint         index;
-    GLboolean      averaged;
-    struct _GLMnode* next;
-} GLMnode;
-
-
 /* glmMax: returns the maximum of two floats */
 static GLfloat
         glmMax(GLfloat a, GLfloat b)
@@ -83,20 +86,6 @@ GLfloat glmDot(GLfloat* u, GLfloat* v){
     return u[0]*v[0] + u[1]*v[1] + u[2]*v[2];
 }
 
-/* glmCross: compute the cross product of two vectors
- *
- * u - array of 3 GLfloats (GLfloat u[3])
- * v - array of 3 GLfloats (GLfloat v[3])
- * n - array of 3 GLfloats (GLfloat n[3]) to return the cross product in
- */
-static GLvoid glmCross(GLfloat* u, GLfloat* v, GLfloat* n){
-    assert(u); assert(v); assert(n);
-    
-    n[0] = u[1]*v[2] - u[2]*v[1];
-    n[1] = u[2]*v[0] - u[0]*v[2];
-    n[2] = u[0]*v[1] - u[1]*v[0];
-}
-
 /* glmNormalize: normalize a vector
  *
  * v - array of 3 GLfloats (GLfloat v[3]) to be normalized
@@ -208,8 +197,67 @@ GLuint glmLoadTexture(char *filename, GLboolean alpha, GLboolean repeat,
 }
 
 
+/* GLMweldcell: one slot of the hash grid used by glmWeldVectors */
+typedef struct _GLMweldcell {
+    GLuint head;                  /* last vector kept in the cell (0 = free slot) */
+    GLuint hash;                  /* hash of the cell coordinates */
+} GLMweldcell;
+
+/* GLM_WELD_CELL: width of a welding grid cell, in epsilons */
+#define GLM_WELD_CELL 8
+
+/* glmWeldCoord: find the grid cell of a coordinate, and the range of
+ * neighbouring cells (from *lo to *hi, each -1, 0 or 1) that can also
+ * hold coordinates within epsilon of it.
+ */
+static inline int64_t glmWeldCoord(GLfloat f, GLfloat epsilon, int* lo, int* hi) {
+    double cell = (double)f / (GLM_WELD_CELL * (double)epsilon);
+    double base = floor(cell);
+    double pos = (cell - base) * GLM_WELD_CELL;
+    /* leave some slack for rounding at the edges */
+    *lo = pos < 1.001 ? -1 : 0;
+    *hi = pos > GLM_WELD_CELL - 1.001 ? 1 : 0;
+    if (base < -4611686018427387904.0)
+        return -4611686018427387904LL;
+    if (base > 4611686018427387904.0)
+        return 4611686018427387904LL;
+    return (int64_t)base;
+}
+
+/* glmWeldHash: hash of the cell coordinates */
+static inline GLuint glmWeldHash(int64_t x, int64_t y, int64_t z) {
+    uint64_t h = (uint64_t)x * 73856093ULL ^ (uint64_t)y * 19349663ULL ^ (uint64_t)z * 83492791ULL;
+    return (GLuint)((h * 0x9e3779b97f4a7c15ULL) >> 32);
+}
+
+/* glmWeldSlot: find the slot of a cell in the hash grid (either the
+ * cell's own slot or the free slot it would go in).  Cells are told
+ * apart by their hash and then by the cell of the vector heading them.
+ */
+static inline GLMweldcell* glmWeldSlot(GLMweldcell* grid, GLuint mask, GLfloat* copies,
+                                       GLfloat epsilon, int64_t x, int64_t y, int64_t z) {
+    GLuint hash = glmWeldHash(x, y, z);
+    GLuint slot = hash & mask;
+    int lo, hi;
+    while (grid[slot].head) {
+        if (grid[slot].hash == hash) {
+            GLfloat* u = &copies[3 * grid[slot].head];
+            if (glmWeldCoord(u[0], epsilon, &lo, &hi) == x &&
+                glmWeldCoord(u[1], epsilon, &lo, &hi) == y &&
+                glmWeldCoord(u[2], epsilon, &lo, &hi) == z)
+                break;
+        }
+        slot = (slot + 1) & mask;
+    }
+    return &grid[slot];
+}
+
 /* glmWeldVectors: eliminate (weld) vectors that are within an
- * epsilon of each other.
+ * epsilon of each other.  Each vector is replaced by the first vector
+ * kept before it that it is glmEqual() to, or kept itself if there is
+ * none.  Kept vectors are bucketed in a hash grid of cells a few
+ * epsilons wide, so only the cell of a vector (and a neighbour when it
+ * lies within epsilon of the cell's edge) needs to be searched.
  *
  * vectors     - array of GLfloat[3]'s to be welded
  * numvectors - number of GLfloat[3]'s in vectors
@@ -219,33 +267,89 @@ GLuint glmLoadTexture(char *filename, GLboolean alpha, GLboolean repeat,
 GLfloat* glmWeldVectors(GLfloat* vectors, GLuint* numvectors, GLfloat epsilon){
     GLfloat* copies;
     GLuint   copied;
-    GLuint   i, j;
+    GLMweldcell* grid;
+    GLMweldcell* cell;
+    GLMweldcell* old;
+    GLuint*  next;                /* previous vector kept in the same cell */
+    GLuint   capacity, mask, numcells, found, k, slot;
+    int64_t  x, y, z, dx, dy, dz;
+    int      lx, ly, lz, hx, hy, hz;
+    GLuint   i;
     
     copies = (GLfloat*)malloc(sizeof(GLfloat) * 3 * (*numvectors + 1));
-    memcpy(copies, vectors, (sizeof(GLfloat) * 3 * (*numvectors + 1)));
+    next = (GLuint*)malloc(sizeof(GLuint) * (*numvectors + 1));
+    capacity = 1024;
+    mask = capacity - 1;
+    numcells = 0;
+    grid = (GLMweldcell*)calloc(capacity, sizeof(GLMweldcell));
     
-    copied = 1;
+    copied = 0;
     for (i = 1; i <= *numvectors; i++) {
-        for (j = 1; j <= copied; j++) {
-            if (glmEqual(&vectors[3 * i], &copies[3 * j], epsilon)) {
-                goto duplicate;
+        GLfloat* v = &vectors[3 * i];
+        found = 0;
+        /* nothing is glmEqual() to a NaN or infinite vector, or to
+         * anything at all with a non-positive epsilon */
+        if (epsilon > 0 && isfinite(v[0]) && isfinite(v[1]) && isfinite(v[2])) {
+            x = glmWeldCoord(v[0], epsilon, &lx, &hx);
+            y = glmWeldCoord(v[1], epsilon, &ly, &hy);
+            z = glmWeldCoord(v[2], epsilon, &lz, &hz);
+            for (dx = lx; dx <= hx; dx++)
+            for (dy = ly; dy <= hy; dy++)
+            for (dz = lz; dz <= hz; dz++) {
+                cell = glmWeldSlot(grid, mask, copies, epsilon, x + dx, y + dy, z + dz);
+                /* the first match is the one with the lowest index */
+                for (k = cell->head; k; k = next[k]) {
+                    if ((!found || k < found) && glmEqual(v, &copies[3 * k], epsilon))
+                        found = k;
+                }
+            }
+            if (!found) {
+                /* add to the copies array and to its cell */
+                copied++;
+                copies[3 * copied + 0] = v[0];
+                copies[3 * copied + 1] = v[1];
+                copies[3 * copied + 2] = v[2];
+                cell = glmWeldSlot(grid, mask, copies, epsilon, x, y, z);
+                if (!cell->head) {
+                    cell->hash = glmWeldHash(x, y, z);
+                    numcells++;
+                }
+                next[copied] = cell->head;
+                cell->head = copied;
+                found = copied;
+                /* keep the grid at most half full */
+                if (2 * numcells > capacity) {
+                    old = grid;
+                    capacity *= 2;
+                    mask = capacity - 1;
+                    grid = (GLMweldcell*)calloc(capacity, sizeof(GLMweldcell));
+                    for (k = 0; k < capacity / 2; k++) {
+                        if (!old[k].head)
+                            continue;
+                        slot = old[k].hash & mask;
+                        while (grid[slot].head)
+                            slot = (slot + 1) & mask;
+                        grid[slot] = old[k];
+                    }
+                    free(old);
+                }
             }
+        } else {
+            copied++;
+            copies[3 * copied + 0] = v[0];
+            copies[3 * copied + 1] = v[1];
+            copies[3 * copied + 2] = v[2];
+            next[copied] = 0;
+            found = copied;
         }
-        
-        /* must not be any duplicates -- add to the copies array */
-        copies[3 * copied + 0] = vectors[3 * i + 0];
-        copies[3 * copied + 1] = vectors[3 * i + 1];
-        copies[3 * copied + 2] = vectors[3 * i + 2];
-        j = copied;             /* pass this along for below */
-        copied++;
-        
-        duplicate:
         /* set the first component of this vector to point at the correct
         index into the new copies array */
-        vectors[3 * i + 0] = (GLfloat)j;
+        v[0] = (GLfloat)found;
     }
+    free(grid);
+    free(next);
     
-    *numvectors = copied-1;
+    *numvectors = copied;
     return copies;
 }
 
@@ -546,335 +650,617 @@ static GLvoid glmWriteMTL(GLMmodel* model, char* modelpath, char* mtllibname){
 }
 
 
-/* glmFirstPass: first pass at a Wavefront OBJ file that gets all the
- * statistics of the model (such as #vertices, #normals, etc)
+/* glmMapFile: map a whole file read-only into memory.  Returns NULL
+ * (and sets *size to 0) if the file can't be opened.  An empty file,
+ * which can't be mapped, comes back as an empty string.  Release the
+ * mapping with glmUnmapFile().
  *
- * model - properly initialized GLMmodel structure
- * file  - (fopen'd) file descriptor 
+ * filename - name of the file to map
+ * size     - will contain the size of the mapping on return
  */
-static GLvoid glmFirstPass(GLMmodel* model, FILE* file, mycallback *call) {
-    GLuint  numvertices;        /* number of vertices in model */
-    GLuint  numnormals;         /* number of normals in model */
-    GLuint  numtexcoords;       /* number of texcoords in model */
-    GLuint  numtriangles;       /* number of triangles in model */
-    GLMgroup* group;            /* current group */
-    unsigned    v, n, t;
-    char        buf[128];
-    /* make a default group */
-    group = glmAddGroup(model, "default");
-    numvertices = numnormals = numtexcoords = numtriangles = 0;
-    while(fscanf(file, "%s", buf) != EOF) {
-        switch(buf[0]) {
-        case '#':               /* comment */
-            /* eat up rest of line */
-            fgets(buf, sizeof(buf), file);
+static const char* glmMapFile(const char* filename, size_t* size) {
+    struct stat st;
+    void* data;
+    int fd;
+    *size = 0;
+    fd = open(filename, O_RDONLY);
+    if (fd < 0)
+        return NULL;
+    if (fstat(fd, &st) < 0) {
+        close(fd);
+        return NULL;
+    }
+    if (st.st_size == 0) {
+        close(fd);
+        return "";
+    }
+    data = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (data == MAP_FAILED)
+        return NULL;
+    madvise(data, st.st_size, MADV_SEQUENTIAL);
+    *size = st.st_size;
+    return (const char*)data;
+}
+
+/* glmUnmapFile: release a mapping made by glmMapFile() */
+static GLvoid glmUnmapFile(const char* data, size_t size) {
+    if (size)
+        munmap((void*)data, size);
+}
+
+/* glmGrow: make sure a malloc'd array has room for at least needed
+ * elements, doubling its capacity when it runs out.
+ *
+ * array    - array to grow (may be NULL)
+ * capacity - current capacity in elements, updated on return
+ * needed   - number of elements that must fit
+ * elemsize - size of one element in bytes
+ */
+static GLvoid* glmGrow(GLvoid* array, GLuint* capacity, GLuint needed, size_t elemsize) {
+    if (needed <= *capacity)
+        return array;
+    while (*capacity < needed)
+        *capacity = *capacity ? *capacity * 2 : 1024;
+    return realloc(array, elemsize * *capacity);
+}
+
+/* glmFreeArray: free one of the arrays of a model, unless it points
+ * into a cache mapped by glmReadCache().
+ *
+ * model - initialized GLMmodel structure
+ * array - array to free (may be NULL)
+ */
+static GLvoid glmFreeArray(GLMmodel* model, GLvoid* array) {
+    const char* p = (const char*)array;
+    const char* mapped = (const char*)model->mapped;
+    if (mapped && p >= mapped && p < mapped + model->mappedsize)
+        return;
+    free(array);
+}
+
+/* glmSkipSpace: skip blanks (but not newlines) */
+static inline const char* glmSkipSpace(const char* p, const char* end) {
+    while (p < end && (*p == ' ' || *p == '\t' || *p == '\r'))
+        p++;
+    return p;
+}
+
+/* glmSkipLine: skip past the end of the current line */
+static inline const char* glmSkipLine(const char* p, const char* end) {
+    p = (const char*)memchr(p, '\n', end - p);
+    return p ? p + 1 : end;
+}
+
+/* glmReadWord: copy the next whitespace delimited word into buf
+ * (always NUL terminated) and return the position after it.
+ */
+static const char* glmReadWord(const char* p, const char* end, char* buf, size_t size) {
+    size_t n = 0;
+    p = glmSkipSpace(p, end);
+    while (p < end && !isspace((unsigned char)*p)) {
+        if (n < size - 1)
+            buf[n++] = *p;
+        p++;
+    }
+    buf[n] = '\0';
+    return p;
+}
+
+/* glmReadRest: copy the rest of the line (without surrounding blanks)
+ * into buf and return the position of the line end.
+ */
+static const char* glmReadRest(const char* p, const char* end, char* buf, size_t size) {
+    const char* eol;
+    size_t n;
+    p = glmSkipSpace(p, end);
+    eol = (const char*)memchr(p, '\n', end - p);
+    if (!eol)
+        eol = end;
+    n = eol - p;
+    while (n > 0 && isspace((unsigned char)p[n - 1]))
+        n--;
+    if (n > size - 1)
+        n = size - 1;
+    memcpy(buf, p, n);
+    buf[n] = '\0';
+    return eol;
+}
+
+/* glmParseFloat: parse a decimal floating point number ([-]d.dE[-]d)
+ * starting at p.  Returns the position after the number, or p itself
+ * if there is no number there.
+ */
+static const char* glmParseFloat(const char* p, const char* end, GLfloat* f) {
+    static const double powers[] = {
+        1e0,  1e1,  1e2,  1e3,  1e4,  1e5,  1e6,  1e7,  1e8,  1e9,  1e10, 1e11,
+        1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22
+    };
+    const char* start;
+    unsigned long long mantissa = 0;
+    int digits = 0, exponent = 0, negative = 0;
+    double value;
+    p = glmSkipSpace(p, end);
+    start = p;
+    if (p < end && (*p == '-' || *p == '+'))
+        negative = (*p++ == '-');
+    while (p < end && *p >= '0' && *p <= '9') {
+        if (digits < 19) {
+            mantissa = mantissa * 10 + (*p - '0');
+            if (mantissa) digits++;
+        } else {
+            exponent++;
+        }
+        p++;
+    }
+    if (p < end && *p == '.') {
+        p++;
+        while (p < end && *p >= '0' && *p <= '9') {
+            if (digits < 19) {
+                mantissa = mantissa * 10 + (*p - '0');
+                if (mantissa) digits++;
+                exponent--;
+            }
+            p++;
+        }
+    }
+    if (p == start || (p == start + 1 && (*start == '-' || *start == '+' || *start == '.')))
+        return start;
+    if (p < end && (*p == 'e' || *p == 'E')) {
+        const char* q = p + 1;
+        int e = 0, eneg = 0;
+        if (q < end && (*q == '-' || *q == '+'))
+            eneg = (*q++ == '-');
+        if (q < end && *q >= '0' && *q <= '9') {
+            while (q < end && *q >= '0' && *q <= '9')
+                e = e * 10 + (*q++ - '0');
+            exponent += eneg ? -e : e;
+            p = q;
+        }
+    }
+    value = (double)mantissa;
+    while (exponent > 22) { value *= 1e22; exponent -= 22; }
+    while (exponent < -22) { value /= 1e22; exponent += 22; }
+    value = exponent >= 0 ? value * powers[exponent] : value / powers[-exponent];
+    *f = (GLfloat)(negative ? -value : value);
+    return p;
+}
+
+/* glmParseIndex: parse a (possibly negative) integer index starting at
+ * p.  Returns the position after the number, or p itself if there is
+ * no number there or it is larger than INT_MAX.
+ */
+static inline const char* glmParseIndex(const char* p, const char* end, int* i) {
+    const char* start = p;
+    int negative = 0;
+    unsigned value = 0;
+    if (p < end && *p == '-') {
+        negative = 1;
+        p++;
+    }
+    if (p == end || *p < '0' || *p > '9')
+        return start;
+    while (p < end && *p >= '0' && *p <= '9') {
+        unsigned digit = *p++ - '0';
+        if (value > (INT_MAX - digit) / 10)
+            return start;
+        value = value * 10 + digit;
+    }
+    *i = negative ? -(int)value : (int)value;
+    return p;
+}
+
+/* GLM_RELATIVE: marks a face index that was given relative to the end
+ * of its chunk (a negative OBJ index) and still has to be rebased once
+ * the number of items in the chunks before it is known.
+ */
+#define GLM_RELATIVE        0x80000000u
+#define GLM_RELATIVE_BIAS   0x40000000
+#define GLM_ENCODE_RELATIVE(i) (GLM_RELATIVE | (GLuint)((i) + GLM_RELATIVE_BIAS))
+#define GLM_DECODE_RELATIVE(i) ((int)((i) & ~GLM_RELATIVE) - GLM_RELATIVE_BIAS)
+
+/* _GLMevent: a g, usemtl or mtllib statement seen while parsing a chunk */
+typedef struct _GLMevent {
+    GLuint triangle;            /* chunk triangles before the statement */
+    char   type;                /* 'g', 'u' or 'm' */
+    char*  name;                /* argument of the statement */
+} GLMevent;
+
+/* _GLMchunk: everything read from one newline-aligned piece of a file.
+ * The arrays are 1-based like the ones in GLMmodel.
+ */
+typedef struct _GLMchunk {
+    const char*  begin;         /* first byte of the chunk */
+    const char*  end;           /* one past the last byte of the chunk */
+    GLuint       numvertices, maxvertices;
+    GLfloat*     vertices;
+    GLuint       numnormals, maxnormals;
+    GLfloat*     normals;
+    GLuint       numtexcoords, maxtexcoords;
+    GLfloat*     texcoords;
+    GLuint       numtriangles, maxtriangles;
+    GLMtriangle* triangles;
+    GLuint       numevents, maxevents;
+    GLMevent*    events;
+    GLboolean    relative;      /* chunk has GLM_RELATIVE face indices */
+    GLuint       basevertex;    /* items in all the chunks before this one */
+    GLuint       basenormal;
+    GLuint       basetexcoord;
+    GLuint       basetriangle;
+} GLMchunk;
+
+/* glmChunkIndex: turn an OBJ face index into a 1-based index.
+ * Negative (relative) indices that reach back past the start of the
+ * chunk are encoded with GLM_RELATIVE and fixed up when merging.
+ */
+static inline GLuint glmChunkIndex(GLMchunk* chunk, int index, GLuint count) {
+    if (index >= 0)
+        return (GLuint)index;
+    chunk->relative = GL_TRUE;
+    return GLM_ENCODE_RELATIVE((int)count + index + 1);
+}
+
+/* glmAddEvent: remember a g, usemtl or mtllib statement */
+static GLvoid glmAddEvent(GLMchunk* chunk, char type, const char* name) {
+    chunk->events = (GLMevent*)glmGrow(chunk->events, &chunk->maxevents,
+                                       chunk->numevents + 1, sizeof(GLMevent));
+    chunk->events[chunk->numevents].triangle = chunk->numtriangles;
+    chunk->events[chunk->numevents].type = type;
+    chunk->events[chunk->numevents].name = strdup(name);
+    chunk->numevents++;
+}
+
+/* glmParseChunk: single pass over a piece of a Wavefront OBJ file held
+ * in memory that reads all the data into the chunk, growing its
+ * vertex, normal, texcoord and triangle arrays as it goes.  Group and
+ * material statements are only recorded; glmMergeChunks applies them.
+ *
+ * chunk - chunk with begin/end set and everything else zeroed
+ */
+static GLvoid glmParseChunk(GLMchunk* chunk) {
+    const char* p = chunk->begin;
+    const char* end = chunk->end;
+    GLuint  v[3], n[3], t[3];
+    GLuint  numcorners, i;
+    int     index;
+    char    buf[1024];
+    /* index 0 of the arrays is unused, the OBJ format is 1-based */
+    chunk->vertices = (GLfloat*)glmGrow(NULL, &chunk->maxvertices, 1, 3 * sizeof(GLfloat));
+    while (p < end) {
+        p = glmSkipSpace(p, end);
+        if (p == end)
             break;
+        switch (*p) {
         case 'v':               /* v, vn, vt */
-            switch(buf[1]) {
-            case '\0':          /* vertex */
-                /* eat up rest of line */
-                fgets(buf, sizeof(buf), file);
-                numvertices++;
-                break;
-            case 'n':           /* normal */
-                /* eat up rest of line */
-                fgets(buf, sizeof(buf), file);
-                numnormals++;
-                break;
-            case 't':           /* texcoord */
-                /* eat up rest of line */
-                fgets(buf, sizeof(buf), file);
-                numtexcoords++;
-                break;
-            default:
-                printf("glmFirstPass(): Unknown token \"%s\".\n", buf);
-                exit(1);
-                break;
+            if (p + 1 < end && (p[1] == ' ' || p[1] == '\t')) {
+                chunk->vertices = (GLfloat*)glmGrow(chunk->vertices, &chunk->maxvertices,
+                                                    chunk->numvertices + 2, 3 * sizeof(GLfloat));
+                GLfloat* vertex = &chunk->vertices[3 * (chunk->numvertices + 1)];
+                vertex[0] = vertex[1] = vertex[2] = 0.0;
+                p = glmParseFloat(p + 1, end, &vertex[0]);
+                p = glmParseFloat(p, end, &vertex[1]);
+                p = glmParseFloat(p, end, &vertex[2]);
+                chunk->numvertices++;
+            } else if (p + 1 < end && p[1] == 'n') {
+                chunk->normals = (GLfloat*)glmGrow(chunk->normals, &chunk->maxnormals,
+                                                   chunk->numnormals + 2, 3 * sizeof(GLfloat));
+                GLfloat* normal = &chunk->normals[3 * (chunk->numnormals + 1)];
+                normal[0] = normal[1] = normal[2] = 0.0;
+                p = glmParseFloat(p + 2, end, &normal[0]);
+                p = glmParseFloat(p, end, &normal[1]);
+                p = glmParseFloat(p, end, &normal[2]);
+                chunk->numnormals++;
+            } else if (p + 1 < end && p[1] == 't') {
+                chunk->texcoords = (GLfloat*)glmGrow(chunk->texcoords, &chunk->maxtexcoords,
+                                                     chunk->numtexcoords + 2, 2 * sizeof(GLfloat));
+                GLfloat* texcoord = &chunk->texcoords[2 * (chunk->numtexcoords + 1)];
+                texcoord[0] = texcoord[1] = 0.0;
+                p = glmParseFloat(p + 2, end, &texcoord[0]);
+                p = glmParseFloat(p, end, &texcoord[1]);
+                chunk->numtexcoords++;
             }
             break;
-            case 'm': //mtllib
-                fgets(buf, sizeof(buf), file);
-                sscanf(buf, "%s %s", buf, buf);
-                model->mtllibname = strdup(buf);
-                glmReadMTL(model, buf, call);
-                break;
-            case 'u': //usemtl
-                /* eat up rest of line */
-                fgets(buf, sizeof(buf), file);
-                break;
-            case 'g':               /* group */
-                /* eat up rest of line */
-                fgets(buf, sizeof(buf), file);
-#if SINGLE_STRING_GROUP_NAMES
-                sscanf(buf, "%s", buf);
-#else
-                buf[strlen(buf)-1] = '\0';  /* nuke '\n' */
-#endif
-                group = glmAddGroup(model, buf);
-                break;
-            case 'f':               /* face */
-                v = n = t = 0;
-                fscanf(file, "%s", buf);
-                /* can be one of %d, %d//%d, %d/%d, %d/%d/%d %d//%d */
-                if (strstr(buf, "//")) {
-                    /* v//n */
-                    sscanf(buf, "%d//%d", &v, &n);
-                    fscanf(file, "%d//%d", &v, &n);
-                    fscanf(file, "%d//%d", &v, &n);
-                    numtriangles++;
-                    group->numtriangles++;
-                    while(fscanf(file, "%d//%d", &v, &n) > 0) {
-                        numtriangles++;
-                        group->numtriangles++;
-                    }
-                } else if (sscanf(buf, "%d/%d/%d", &v, &t, &n) == 3) {
-                    /* v/t/n */
-                    fscanf(file, "%d/%d/%d", &v, &t, &n);
-                    fscanf(file, "%d/%d/%d", &v, &t, &n);
-                    numtriangles++;
-                    group->numtriangles++;
-                    while(fscanf(file, "%d/%d/%d", &v, &t, &n) > 0) {
-                        numtriangles++;
-                        group->numtriangles++;
-                    }
-                } else if (sscanf(buf, "%d/%d", &v, &t) == 2) {
-                    /* v/t */
-                    fscanf(file, "%d/%d", &v, &t);
-                    fscanf(file, "%d/%d", &v, &t);
-                    numtriangles++;
-                    group->numtriangles++;
-                    while(fscanf(file, "%d/%d", &v, &t) > 0) {
-                        numtriangles++;
-                        group->numtriangles++;
+        case 'f':               /* face */
+            p++;
+            numcorners = 0;
+            for (;;) {
+                const char* q;
+                p = glmSkipSpace(p, end);
+                q = glmParseIndex(p, end, &index);
+                if (q == p)
+                    break;
+                p = q;
+                /* can be one of %d, %d//%d, %d/%d, %d/%d/%d */
+                v[2] = glmChunkIndex(chunk, index, chunk->numvertices);
+                t[2] = n[2] = 0;
+                if (p < end && *p == '/') {
+                    p++;
+                    q = glmParseIndex(p, end, &index);
+                    if (q != p)
+                        t[2] = glmChunkIndex(chunk, index, chunk->numtexcoords);
+                    p = q;
+                    if (p < end && *p == '/') {
+                        p++;
+                        q = glmParseIndex(p, end, &index);
+                        if (q != p)
+                            n[2] = glmChunkIndex(chunk, index, chunk->numnormals);
+                        p = q;
                     }
+                }
+                if (numcorners == 0) {
+                    v[0] = v[2]; t[0] = t[2]; n[0] = n[2];
+                } else if (numcorners == 1) {
+                    v[1] = v[2]; t[1] = t[2]; n[1] = n[2];
                 } else {
-                    /* v */
-                    fscanf(file, "%d", &v);
-                    fscanf(file, "%d", &v);
-                    numtriangles++;
-                    group->numtriangles++;
-                    while(fscanf(file, "%d", &v) > 0) {
-                        numtriangles++;
-                        group->numtriangles++;
+                    /* fan out a triangle from the first corner */
+                    chunk->triangles = (GLMtriangle*)glmGrow(chunk->triangles, &chunk->maxtriangles,
+                                                             chunk->numtriangles + 1, sizeof(GLMtriangle));
+                    GLMtriangle* triangle = &chunk->triangles[chunk->numtriangles++];
+                    memset(triangle, 0, sizeof(GLMtriangle));
+                    for (i = 0; i < 3; i++) {
+                        triangle->vindices[i] = v[i];
+                        triangle->tindices[i] = t[i];
+                        triangle->nindices[i] = n[i];
                     }
+                    v[1] = v[2]; t[1] = t[2]; n[1] = n[2];
                 }
-                break;
-                
-            default:
-                /* eat up rest of line */
-                fgets(buf, sizeof(buf), file);
-                break;
+                numcorners++;
             }
-
+            break;
+        case 'm':               /* mtllib */
+            if (end - p > 6 && !strncmp(p, "mtllib", 6)) {
+                glmReadWord(p + 6, end, buf, sizeof(buf));
+                glmAddEvent(chunk, 'm', buf);
+            }
+            break;
+        case 'u':               /* usemtl */
+            if (end - p > 6 && !strncmp(p, "usemtl", 6)) {
+                glmReadWord(p + 6, end, buf, sizeof(buf));
+                glmAddEvent(chunk, 'u', buf);
+            }
+            break;
+        case 'g':               /* group */
+#if SINGLE_STRING_GROUP_NAMES
+            glmReadWord(p + 1, end, buf, sizeof(buf));
+#else
+            glmReadRest(p + 1, end, buf, sizeof(buf));
+#endif
+            glmAddEvent(chunk, 'g', buf);
+            break;
+        default:                /* comments, smoothing groups, etc */
+            break;
+        }
+        /* eat up rest of line */
+        p = glmSkipLine(p, end);
     }
+}
+
+/* glmRebase: move a chunk-local face index to its place in the model */
+static inline GLuint glmRebase(GLuint index, GLuint base) {
+    if (index & GLM_RELATIVE)
+        return (GLuint)((int)base + GLM_DECODE_RELATIVE(index));
+    return index;
+}
 
-    /* set the stats in the model structure */
-    model->numvertices  = numvertices;
-    model->numnormals   = numnormals;
-    model->numtexcoords = numtexcoords;
-    model->numtriangles = numtriangles;
+/* glmParseTask: parallelFor task that parses chunk[index] */
+static void glmParseTask(int index, void* arg) {
+    glmParseChunk(&((GLMchunk*)arg)[index]);
+}
 
-    /* allocate memory for the triangles in each group */
-    group = model->groups;
-    while(group) {
-        group->triangles = (GLuint*)malloc(sizeof(GLuint) * group->numtriangles);
-        group->numtriangles = 0;
-        group = group->next;
+/* glmCopyTask: parallelFor task that copies chunk[index] into the
+ * model arrays at its offsets, rebasing relative face indices.
+ */
+typedef struct _GLMcopyjob {
+    GLMmodel* model;
+    GLMchunk* chunks;
+} GLMcopyjob;
+
+static void glmCopyTask(int index, void* arg) {
+    GLMcopyjob* job = (GLMcopyjob*)arg;
+    GLMmodel* model = job->model;
+    GLMchunk* chunk = &job->chunks[index];
+    GLMtriangle* triangle;
+    GLuint i, j;
+    memcpy(&model->vertices[3 * (chunk->basevertex + 1)], &chunk->vertices[3],
+           sizeof(GLfloat) * 3 * chunk->numvertices);
+    if (chunk->numnormals)
+        memcpy(&model->normals[3 * (chunk->basenormal + 1)], &chunk->normals[3],
+               sizeof(GLfloat) * 3 * chunk->numnormals);
+    if (chunk->numtexcoords)
+        memcpy(&model->texcoords[2 * (chunk->basetexcoord + 1)], &chunk->texcoords[2],
+               sizeof(GLfloat) * 2 * chunk->numtexcoords);
+    triangle = &T(chunk->basetriangle);
+    memcpy(triangle, chunk->triangles, sizeof(GLMtriangle) * chunk->numtriangles);
+    if (chunk->relative) {
+        for (i = 0; i < chunk->numtriangles; i++, triangle++) {
+            for (j = 0; j < 3; j++) {
+                triangle->vindices[j] = glmRebase(triangle->vindices[j], chunk->basevertex);
+                triangle->tindices[j] = glmRebase(triangle->tindices[j], chunk->basetexcoord);
+                triangle->nindices[j] = glmRebase(triangle->nindices[j], chunk->basenormal);
+            }
+        }
+    }
+}
+
+/* glmAdoptChunk: take over the arrays of a lone chunk without copying */
+static GLvoid glmAdoptChunk(GLMmodel* model, GLMchunk* chunk) {
+    GLuint i, j;
+    model->vertices  = chunk->vertices;
+    model->normals   = chunk->normals;
+    model->texcoords = chunk->texcoords;
+    model->triangles = chunk->triangles;
+    chunk->vertices = chunk->normals = chunk->texcoords = NULL;
+    chunk->triangles = NULL;
+    if (chunk->relative) {
+        for (i = 0; i < model->numtriangles; i++) {
+            for (j = 0; j < 3; j++) {
+                T(i).vindices[j] = glmRebase(T(i).vindices[j], 0);
+                T(i).tindices[j] = glmRebase(T(i).tindices[j], 0);
+                T(i).nindices[j] = glmRebase(T(i).nindices[j], 0);
+            }
+        }
     }
+    /* give back the slack from growing the arrays */
+    model->vertices = (GLfloat*)realloc(model->vertices,
+                                        sizeof(GLfloat) * 3 * (model->numvertices + 1));
+    if (model->normals)
+        model->normals = (GLfloat*)realloc(model->normals,
+                                           sizeof(GLfloat) * 3 * (model->numnormals + 1));
+    if (model->texcoords)
+        model->texcoords = (GLfloat*)realloc(model->texcoords,
+                                             sizeof(GLfloat) * 2 * (model->numtexcoords + 1));
+    if (model->triangles)
+        model->triangles = (GLMtriangle*)realloc(model->triangles,
+                                                 sizeof(GLMtriangle) * model->numtriangles);
 }
 
-/* glmSecondPass: second pass at a Wavefront OBJ file that gets all
- * the data.
+/* glmMergeChunks: combine parsed chunks into the model.  A prefix sum
+ * over the chunk counts gives every chunk its offsets, the chunks are
+ * copied in parallel and then the group and material statements are
+ * replayed in file order to hand the triangles out to their groups.
  *
- * model - properly initialized GLMmodel structure
- * file  - (fopen'd) file descriptor 
+ * model     - properly initialized GLMmodel structure
+ * chunks    - parsed chunks, in file order
+ * numchunks - number of chunks
  */
-static GLvoid glmSecondPass(GLMmodel* model, FILE* file, mycallback *call) {
-    GLuint  numvertices;        /* number of vertices in model */
-    GLuint  numnormals;         /* number of normals in model */
-    GLuint  numtexcoords;       /* number of texcoords in model */
-    GLuint  numtriangles;       /* number of triangles in model */
-    GLfloat*    vertices;           /* array of vertices  */
-    GLfloat*    normals;            /* array of normals */
-    GLfloat*    texcoords;          /* array of texture coordinates */
-    GLMgroup* group;            /* current group pointer */
-    GLuint  material;           /* current material */
-    GLuint  v, n, t;
-    char        buf[128];
-    /* set the pointer shortcuts */
-    vertices       = model->vertices;
-    normals    = model->normals;
-    texcoords    = model->texcoords;
-    group      = model->groups;
-    /* on the second pass through the file, read all the data into the
-    allocated arrays */
-    numvertices = numnormals = numtexcoords = 1;
-    numtriangles = 0;
+static GLvoid glmMergeChunks(GLMmodel* model, GLMchunk* chunks, GLuint numchunks, mycallback *call) {
+    GLMgroup*  group;
+    GLMgroup** owners;          /* group of each run of triangles */
+    GLuint*    runs;            /* first triangle of each run */
+    GLuint     numruns, maxruns;
+    GLuint     material, first, last;
+    GLuint     i, j, k;
+    GLMcopyjob job;
+
+    /* prefix sums give each chunk its place in the model arrays */
+    for (i = 0; i < numchunks; i++) {
+        chunks[i].basevertex   = model->numvertices;
+        chunks[i].basenormal   = model->numnormals;
+        chunks[i].basetexcoord = model->numtexcoords;
+        chunks[i].basetriangle = model->numtriangles;
+        model->numvertices  += chunks[i].numvertices;
+        model->numnormals   += chunks[i].numnormals;
+        model->numtexcoords += chunks[i].numtexcoords;
+        model->numtriangles += chunks[i].numtriangles;
+    }
+
+    if (numchunks == 1) {
+        glmAdoptChunk(model, &chunks[0]);
+    } else {
+        model->vertices = (GLfloat*)malloc(sizeof(GLfloat) * 3 * (model->numvertices + 1));
+        if (model->numnormals)
+            model->normals = (GLfloat*)malloc(sizeof(GLfloat) * 3 * (model->numnormals + 1));
+        if (model->numtexcoords)
+            model->texcoords = (GLfloat*)malloc(sizeof(GLfloat) * 2 * (model->numtexcoords + 1));
+        if (model->numtriangles)
+            model->triangles = (GLMtriangle*)malloc(sizeof(GLMtriangle) * model->numtriangles);
+        job.model = model;
+        job.chunks = chunks;
+        parallelFor(numchunks, glmCopyTask, &job);
+    }
+
+    /* replay the group and material statements in order, splitting the
+       triangles into runs that each belong to a single group */
     material = 0;
-    while(fscanf(file, "%s", buf) != EOF) {
-        switch(buf[0]) {
-        case '#':               /* comment */
-            /* eat up rest of line */
-            fgets(buf, sizeof(buf), file);
-            break;
-        case 'v':               /* v, vn, vt */
-            switch(buf[1]) {
-            case '\0':          /* vertex */
-                fscanf(file, "%f %f %f",
-                       &vertices[3 * numvertices + 0],
-                       &vertices[3 * numvertices + 1],
-                       &vertices[3 * numvertices + 2]);
-                numvertices++;
-                /*  if (numvertices%200==0)
-                        if (call)
-                        {
-                                sprintf(afis,"%s (%s )... ",call->text, group->name);
-                                int procent = ((float)((float)numvertices*70/model->numvertices+30)/100)*(call->end-call->start)+call->start;
-                                call->loadcallback(procent,afis); // Modelul e 70% din incarcare
-                        }*/
-                break;
-            case 'n':           /* normal */
-                fscanf(file, "%f %f %f",
-                       &normals[3 * numnormals + 0],
-                       &normals[3 * numnormals + 1],
-                       &normals[3 * numnormals + 2]);
-                numnormals++;
+    group = glmAddGroup(model, "default");
+    owners = NULL;
+    runs = NULL;
+    numruns = maxruns = 0;
+    first = 0;
+    for (i = 0; i <= numchunks; i++) {
+        GLuint numevents = i < numchunks ? chunks[i].numevents : 1;
+        for (j = 0; j < numevents; j++) {
+            /* the run of the current group ends here */
+            last = i < numchunks ? chunks[i].basetriangle + chunks[i].events[j].triangle
+                                 : model->numtriangles;
+            if (last > first) {
+                runs = (GLuint*)glmGrow(runs, &maxruns, numruns + 1, sizeof(GLuint));
+                owners = (GLMgroup**)realloc(owners, sizeof(GLMgroup*) * maxruns);
+                runs[numruns] = first;
+                owners[numruns++] = group;
+                first = last;
+            }
+            if (i == numchunks)
                 break;
-            case 't':           /* texcoord */
-                fscanf(file, "%f %f", 
-                       &texcoords[2 * numtexcoords + 0],
-                       &texcoords[2 * numtexcoords + 1]);
-                numtexcoords++;
+            GLMevent* event = &chunks[i].events[j];
+            switch (event->type) {
+            case 'm':
+                model->mtllibname = strdup(event->name);
+                glmReadMTL(model, event->name, call);
                 break;
-            }
-            break;
             case 'u':
-            fgets(buf, sizeof(buf), file);
-            sscanf(buf, "%s %s", buf, buf);
-            group->material = material = glmFindMaterial(model, buf);
-            break;
-            case 'g':               /* group */
-                /* eat up rest of line */
-                fgets(buf, sizeof(buf), file);
-#if SINGLE_STRING_GROUP_NAMES
-                sscanf(buf, "%s", buf);
-#else
-                buf[strlen(buf)-1] = '\0';  /* nuke '\n' */
-#endif
-                group = glmFindGroup(model, buf);
+                group->material = material = glmFindMaterial(model, event->name);
+                break;
+            case 'g':
+                group = glmAddGroup(model, event->name);
                 group->material = material;
                 break;
-case 'f':				/* face */
-    v = n = t = 0;
-    fscanf(file, "%s", buf);
-    /* can be one of %d, %d//%d, %d/%d, %d/%d/%d %d//%d */
-    if (strstr(buf, "//")) {
-        /* v//n */
-        sscanf(buf, "%d//%d", &v, &n);
-        T(numtriangles).vindices[0] = v;
-        T(numtriangles).nindices[0] = n;
-        fscanf(file, "%d//%d", &v, &n);
-        T(numtriangles).vindices[1] = v;
-        T(numtriangles).nindices[1] = n;
-        fscanf(file, "%d//%d", &v, &n);
-        T(numtriangles).vindices[2] = v;
-        T(numtriangles).nindices[2] = n;
-        group->triangles[group->numtriangles++] = numtriangles;
-        numtriangles++;
-        while(fscanf(file, "%d//%d", &v, &n) > 0) {
-            T(numtriangles).vindices[0] = T(numtriangles-1).vindices[0];
-            T(numtriangles).nindices[0] = T(numtriangles-1).nindices[0];
-            T(numtriangles).vindices[1] = T(numtriangles-1).vindices[2];
-            T(numtriangles).nindices[1] = T(numtriangles-1).nindices[2];
-            T(numtriangles).vindices[2] = v;
-            T(numtriangles).nindices[2] = n;
-            group->triangles[group->numtriangles++] = numtriangles;
-            numtriangles++;
-        }
-    } else if (sscanf(buf, "%d/%d/%d", &v, &t, &n) == 3) {
-        /* v/t/n */
-        T(numtriangles).vindices[0] = v;
-        T(numtriangles).tindices[0] = t;
-        T(numtriangles).nindices[0] = n;
-        fscanf(file, "%d/%d/%d", &v, &t, &n);
-        T(numtriangles).vindices[1] = v;
-        T(numtriangles).tindices[1] = t;
-        T(numtriangles).nindices[1] = n;
-        fscanf(file, "%d/%d/%d", &v, &t, &n);
-        T(numtriangles).vindices[2] = v;
-        T(numtriangles).tindices[2] = t;
-        T(numtriangles).nindices[2] = n;
-        group->triangles[group->numtriangles++] = numtriangles;
-        numtriangles++;
-        while(fscanf(file, "%d/%d/%d", &v, &t, &n) > 0) {
-            T(numtriangles).vindices[0] = T(numtriangles-1).vindices[0];
-            T(numtriangles).tindices[0] = T(numtriangles-1).tindices[0];
-            T(numtriangles).nindices[0] = T(numtriangles-1).nindices[0];
-            T(numtriangles).vindices[1] = T(numtriangles-1).vindices[2];
-            T(numtriangles).tindices[1] = T(numtriangles-1).tindices[2];
-            T(numtriangles).nindices[1] = T(numtriangles-1).nindices[2];
-            T(numtriangles).vindices[2] = v;
-            T(numtriangles).tindices[2] = t;
-            T(numtriangles).nindices[2] = n;
-            group->triangles[group->numtriangles++] = numtriangles;
-            numtriangles++;
-        }
-    } else if (sscanf(buf, "%d/%d", &v, &t) == 2) {
-        /* v/t */
-        T(numtriangles).vindices[0] = v;
-        T(numtriangles).tindices[0] = t;
-        fscanf(file, "%d/%d", &v, &t);
-        T(numtriangles).vindices[1] = v;
-        T(numtriangles).tindices[1] = t;
-        fscanf(file, "%d/%d", &v, &t);
-        T(numtriangles).vindices[2] = v;
-        T(numtriangles).tindices[2] = t;
-        group->triangles[group->numtriangles++] = numtriangles;
-        numtriangles++;
-        while(fscanf(file, "%d/%d", &v, &t) > 0) {
-            T(numtriangles).vindices[0] = T(numtriangles-1).vindices[0];
-            T(numtriangles).tindices[0] = T(numtriangles-1).tindices[0];
-            T(numtriangles).vindices[1] = T(numtriangles-1).vindices[2];
-            T(numtriangles).tindices[1] = T(numtriangles-1).tindices[2];
-            T(numtriangles).vindices[2] = v;
-            T(numtriangles).tindices[2] = t;
-            group->triangles[group->numtriangles++] = numtriangles;
-            numtriangles++;
-        }
-    } else {
-        /* v */
-        sscanf(buf, "%d", &v);
-        T(numtriangles).vindices[0] = v;
-        fscanf(file, "%d", &v);
-        T(numtriangles).vindices[1] = v;
-        fscanf(file, "%d", &v);
-        T(numtriangles).vindices[2] = v;
-        group->triangles[group->numtriangles++] = numtriangles;
-        numtriangles++;
-        while(fscanf(file, "%d", &v) > 0) {
-            T(numtriangles).vindices[0] = T(numtriangles-1).vindices[0];
-            T(numtriangles).vindices[1] = T(numtriangles-1).vindices[2];
-            T(numtriangles).vindices[2] = v;
-            group->triangles[group->numtriangles++] = numtriangles;
-            numtriangles++;
+            }
         }
     }
-    break;
-            default:
-    /* eat up rest of line */
-    fgets(buf, sizeof(buf), file);
-    break;
-}
+
+    /* hand the triangles out to their groups */
+    for (i = 0; i < numruns; i++) {
+        last = i + 1 < numruns ? runs[i + 1] : model->numtriangles;
+        owners[i]->numtriangles += last - runs[i];
     }
+    for (group = model->groups; group; group = group->next) {
+        group->triangles = (GLuint*)malloc(sizeof(GLuint) * (group->numtriangles ? group->numtriangles : 1));
+        group->numtriangles = 0;
+    }
+    for (i = 0; i < numruns; i++) {
+        first = runs[i];
+        last = i + 1 < numruns ? runs[i + 1] : model->numtriangles;
+        for (k = first; k < last; k++)
+            owners[i]->triangles[owners[i]->numtriangles++] = k;
+    }
+    free(runs);
+    free(owners);
+}
 
-#if 0
-    /* announce the memory requirements */
-    printf(" Memory: %d bytes\n",
-           numvertices  * 3*sizeof(GLfloat) +
-           numnormals   * 3*sizeof(GLfloat) * (numnormals ? 1 : 0) +
-           numtexcoords * 3*sizeof(GLfloat) * (numtexcoords ? 1 : 0) +
-           numtriangles * sizeof(GLMtriangle));
-#endif
+/* glmFreeChunk: release whatever a chunk still owns */
+static GLvoid glmFreeChunk(GLMchunk* chunk) {
+    GLuint i;
+    free(chunk->vertices);
+    free(chunk->normals);
+    free(chunk->texcoords);
+    free(chunk->triangles);
+    for (i = 0; i < chunk->numevents; i++)
+        free(chunk->events[i].name);
+    free(chunk->events);
+}
+
+/* glmParse: parse a Wavefront OBJ file held in memory into the model,
+ * splitting it into newline-aligned chunks that are parsed in parallel.
+ *
+ * model     - properly initialized GLMmodel structure
+ * p         - start of the file contents
+ * end       - end of the file contents
+ * numchunks - number of chunks to split the file into (at least 1)
+ */
+static GLvoid glmParse(GLMmodel* model, const char* p, const char* end,
+                       GLuint numchunks, mycallback *call) {
+    GLMchunk* chunks;
+    const char* split;
+    size_t size = end - p;
+    GLuint i;
+    chunks = (GLMchunk*)calloc(numchunks, sizeof(GLMchunk));
+    for (i = 0; i < numchunks; i++) {
+        chunks[i].begin = i ? chunks[i - 1].end : p;
+        if (i + 1 == numchunks) {
+            chunks[i].end = end;
+        } else {
+            split = p + size / numchunks * (i + 1);
+            if (split < chunks[i].begin)
+                split = chunks[i].begin;
+            chunks[i].end = split < end ? glmSkipLine(split, end) : end;
+        }
+    }
+    parallelFor(numchunks, glmParseTask, chunks);
+    glmMergeChunks(model, chunks, numchunks, call);
+    for (i = 0; i < numchunks; i++)
+        glmFreeChunk(&chunks[i]);
+    free(chunks);
 }
 
 
@@ -888,50 +1274,29 @@ case 'f':				/* face */
  * model - properly initialized GLMmodel structure 
  */
 GLfloat glmUnitize(GLMmodel* model){
-    GLuint  i;
-    GLfloat maxx, minx, maxy, miny, maxz, minz;
-    GLfloat cx, cy, cz, w, h, d;
+    GLfloat min[3], max[3], center[3];
+    GLfloat w, h, d;
     GLfloat scale;
     assert(model);
     assert(model->vertices);
     /* get the max/mins */
-    maxx = minx = model->vertices[3 + 0];
-    maxy = miny = model->vertices[3 + 1];
-    maxz = minz = model->vertices[3 + 2];
-    for (i = 1; i <= model->numvertices; i++) {
-        if (maxx < model->vertices[3 * i + 0])
-            maxx = model->vertices[3 * i + 0];
-        if (minx > model->vertices[3 * i + 0])
-            minx = model->vertices[3 * i + 0];
-        if (maxy < model->vertices[3 * i + 1])
-            maxy = model->vertices[3 * i + 1];
-        if (miny > model->vertices[3 * i + 1])
-            miny = model->vertices[3 * i + 1];
-        if (maxz < model->vertices[3 * i + 2])
-            maxz = model->vertices[3 * i + 2];
-        if (minz > model->vertices[3 * i + 2])
-            minz = model->vertices[3 * i + 2];
-    }
+    min[0] = max[0] = model->vertices[3 + 0];
+    min[1] = max[1] = model->vertices[3 + 1];
+    min[2] = max[2] = model->vertices[3 + 2];
+    meshmathBounds(&model->vertices[3], model->numvertices, min, max);
     
     /* calculate model width, height, and depth */
-    w = glmAbs(maxx) + glmAbs(minx);
-    h = glmAbs(maxy) + glmAbs(miny);
-    d = glmAbs(maxz) + glmAbs(minz);
+    w = glmAbs(max[0]) + glmAbs(min[0]);
+    h = glmAbs(max[1]) + glmAbs(min[1]);
+    d = glmAbs(max[2]) + glmAbs(min[2]);
     /* calculate center of the model */
-    cx = (maxx + minx) / 2.0;
-    cy = (maxy + miny) / 2.0;
-    cz = (maxz + minz) / 2.0;
+    center[0] = (max[0] + min[0]) / 2.0;
+    center[1] = (max[1] + min[1]) / 2.0;
+    center[2] = (max[2] + min[2]) / 2.0;
     /* calculate unitizing scale factor */
     scale = 2.0 / glmMax(glmMax(w, h), d);
     /* translate around center then scale */
-    for (i = 1; i <= model->numvertices; i++) {
-        model->vertices[3 * i + 0] -= cx;
-        model->vertices[3 * i + 1] -= cy;
-        model->vertices[3 * i + 2] -= cz;
-        model->vertices[3 * i + 0] *= scale;
-        model->vertices[3 * i + 1] *= scale;
-        model->vertices[3 * i + 2] *= scale;
-    }
+    meshmathTransform(&model->vertices[3], model->numvertices, center, scale);
     return scale;
 }
 
@@ -942,34 +1307,20 @@ GLfloat glmUnitize(GLMmodel* model){
  * dimensions - array of 3 GLfloats (GLfloat dimensions[3])
  */
 GLvoid glmDimensions(GLMmodel* model, GLfloat* dimensions) {
-    GLuint i;
-    GLfloat maxx, minx, maxy, miny, maxz, minz;
+    GLfloat min[3], max[3];
     assert(model);
     assert(model->vertices);
     assert(dimensions);
     /* get the max/mins */
-    maxx = minx = model->vertices[3 + 0];
-    maxy = miny = model->vertices[3 + 1];
-    maxz = minz = model->vertices[3 + 2];
-    for (i = 1; i <= model->numvertices; i++) {
-        if (maxx < model->vertices[3 * i + 0])
-            maxx = model->vertices[3 * i + 0];
-        if (minx > model->vertices[3 * i + 0])
-            minx = model->vertices[3 * i + 0];
-        if (maxy < model->vertices[3 * i + 1])
-            maxy = model->vertices[3 * i + 1];
-        if (miny > model->vertices[3 * i + 1])
-            miny = model->vertices[3 * i + 1];
-        if (maxz < model->vertices[3 * i + 2])
-            maxz = model->vertices[3 * i + 2];
-        if (minz > model->vertices[3 * i + 2])
-            minz = model->vertices[3 * i + 2];
-    }
+    min[0] = max[0] = model->vertices[3 + 0];
+    min[1] = max[1] = model->vertices[3 + 1];
+    min[2] = max[2] = model->vertices[3 + 2];
+    meshmathBounds(&model->vertices[3], model->numvertices, min, max);
     
     /* calculate model width, height, and depth */
-    dimensions[0] = glmAbs(maxx) + glmAbs(minx);
-    dimensions[1] = glmAbs(maxy) + glmAbs(miny);
-    dimensions[2] = glmAbs(maxz) + glmAbs(minz);
+    dimensions[0] = glmAbs(max[0]) + glmAbs(min[0]);
+    dimensions[1] = glmAbs(max[1]) + glmAbs(min[1]);
+    dimensions[2] = glmAbs(max[2]) + glmAbs(min[2]);
 }
 
 /* glmScale: Scales a model by a given amount.
@@ -978,12 +1329,8 @@ GLvoid glmDimensions(GLMmodel* model, GLfloat* dimensions) {
  * scale - scalefactor (0.5 = half as large, 2.0 = twice as large)
  */
 GLvoid glmScale(GLMmodel* model, GLfloat scale) {
-    GLuint i;
-    for (i = 1; i <= model->numvertices; i++) {
-        model->vertices[3 * i + 0] *= scale;
-        model->vertices[3 * i + 1] *= scale;
-        model->vertices[3 * i + 2] *= scale;
-    }
+    static const GLfloat origin[3] = { 0.0, 0.0, 0.0 };
+    meshmathTransform(&model->vertices[3], model->numvertices, origin, scale);
 }
 
 /* glmReverseWinding: Reverse the polygon winding for all polygons in
@@ -1032,190 +1379,247 @@ GLvoid glmReverseWinding(GLMmodel* model) {
  */
 GLvoid glmFacetNormals(GLMmodel* model) {
     GLuint  i;
-    GLfloat u[3];
-    GLfloat v[3];
     assert(model);
     assert(model->vertices);
     /* clobber any old facetnormals */
     if (model->facetnorms)
-        free(model->facetnorms);
+        glmFreeArray(model, model->facetnorms);
     /* allocate memory for the new facet normals */
     model->numfacetnorms = model->numtriangles;
     model->facetnorms = (GLfloat*)malloc(sizeof(GLfloat) *
                                          3 * (model->numfacetnorms + 1));
-    for (i = 0; i < model->numtriangles; i++) {
-        model->triangles[i].findex = i+1;		
-        u[0] = model->vertices[3 * T(i).vindices[1] + 0] -
-               model->vertices[3 * T(i).vindices[0] + 0];
-        u[1] = model->vertices[3 * T(i).vindices[1] + 1] -
-               model->vertices[3 * T(i).vindices[0] + 1];
-        u[2] = model->vertices[3 * T(i).vindices[1] + 2] -
-               model->vertices[3 * T(i).vindices[0] + 2];
-        
-        v[0] = model->vertices[3 * T(i).vindices[2] + 0] -
-               model->vertices[3 * T(i).vindices[0] + 0];
-        v[1] = model->vertices[3 * T(i).vindices[2] + 1] -
-               model->vertices[3 * T(i).vindices[0] + 1];
-        v[2] = model->vertices[3 * T(i).vindices[2] + 2] -
-               model->vertices[3 * T(i).vindices[0] + 2];
-        glmCross(u, v, &model->facetnorms[3 * (i+1)]);
-        glmNormalize(&model->facetnorms[3 * (i+1)]);
-    }
+    for (i = 0; i < model->numtriangles; i++)
+        model->triangles[i].findex = i+1;
+    if (model->numtriangles)
+        meshmathFacetNormals(model->vertices, T(0).vindices, sizeof(GLMtriangle) / sizeof(GLuint),
+                             model->numtriangles, &model->facetnorms[3]);
 }
 
-/* glmVertexNormals: Generates smooth vertex normals for a model.
- * First builds a list of all the triangles each vertex is in.   Then
- * loops through each vertex in the the list averaging all the facet
- * normals of the triangles each vertex is in.   Finally, sets the
- * normal index in the triangle for the vertex to the generated smooth
- * normal.   If the dot product of a facet normal and the facet normal
- * associated with the first triangle in the list of triangles the
- * current vertex is in is greater than the cosine of the angle
- * parameter to the function, that facet normal is not added into the
- * average normal calculation and the corresponding vertex is given
- * the facet normal.  This tends to preserve hard edges.  The angle to
- * use depends on the model, but 90 degrees is usually a good start.
+/* glmBuildAdjacency: Builds the vertex-to-triangle adjacency of a
+ * model in compressed (CSR) form: the triangles around vertex i are
+ * triangles[offsets[i]] up to (but not including)
+ * triangles[offsets[i + 1]], in decreasing triangle order.  A triangle
+ * is listed once per corner, so a degenerate triangle can appear twice
+ * for the same vertex.  Returns an adjacency that should be free'd with
+ * glmDeleteAdjacency().
  *
  * model - initialized GLMmodel structure
- * angle - maximum angle (in degrees) to smooth across
  */
-GLvoid glmVertexNormals(GLMmodel* model, GLfloat angle){
-    GLMnode*    node;
-    GLMnode*    tail;
-    GLMnode** members;
-    GLfloat*    normals;
-    GLuint  numnormals;
-    GLfloat average[3];
-    GLfloat dot, cos_angle;
-    GLuint  i, avg;
+GLMadjacency* glmBuildAdjacency(GLMmodel* model){
+    GLMadjacency* adjacency;
+    GLuint* offsets;
+    GLuint i, j, v, sum;
     assert(model);
-    assert(model->facetnorms);
-    /* calculate the cosine of the angle (in degrees) */
-    cos_angle = cos(angle * M_PI / 180.0);
-    /* nuke any previous normals */
-    if (model->normals)
-        free(model->normals);
-    /* allocate space for new normals */
-    model->numnormals = model->numtriangles * 3; /* 3 normals per triangle */
-    model->normals = (GLfloat*)malloc(sizeof(GLfloat)* 3* (model->numnormals+1));
-    /* allocate a structure that will hold a linked list of triangle
-    indices for each vertex */
-    members = (GLMnode**)malloc(sizeof(GLMnode*) * (model->numvertices + 1));
-    for (i = 1; i <= model->numvertices; i++)
-        members[i] = NULL;
-    /* for every triangle, create a node for each vertex in it */
+    adjacency = (GLMadjacency*)malloc(sizeof(GLMadjacency));
+    adjacency->numvertices = model->numvertices;
+    adjacency->offsets = offsets = (GLuint*)calloc(model->numvertices + 2, sizeof(GLuint));
+    adjacency->triangles = (GLuint*)malloc(sizeof(GLuint) * (3 * model->numtriangles + 1));
+    /* count the corners at each vertex */
     for (i = 0; i < model->numtriangles; i++) {
-        node = (GLMnode*)malloc(sizeof(GLMnode));
-        node->index = i;
-        node->next  = members[T(i).vindices[0]];
-        members[T(i).vindices[0]] = node;
-        node = (GLMnode*)malloc(sizeof(GLMnode));
-        node->index = i;
-        node->next  = members[T(i).vindices[1]];
-        members[T(i).vindices[1]] = node;
-        node = (GLMnode*)malloc(sizeof(GLMnode));
-        node->index = i;
-        node->next  = members[T(i).vindices[2]];
-        members[T(i).vindices[2]] = node;
+        for (j = 0; j < 3; j++) {
+            v = T(i).vindices[j];
+            if (v <= model->numvertices)
+                offsets[v]++;
+        }
     }
-    
-    /* calculate the average normal for each vertex */
-    numnormals = 1;
-    for (i = 1; i <= model->numvertices; i++) {
-        /* calculate an average normal for this vertex by averaging the
-        facet normal of every triangle this vertex is in */
-        node = members[i];
-        if (!node)
-            fprintf(stderr, "glmVertexNormals(): vertex w/o a triangle\n");
-        average[0] = 0.0; average[1] = 0.0; average[2] = 0.0;
-        avg = 0;
-        while (node) {
+    /* turn the counts into offsets just past the end of each list */
+    sum = 0;
+    for (v = 0; v <= model->numvertices; v++) {
+        sum += offsets[v];
+        offsets[v] = sum;
+    }
+    offsets[model->numvertices + 1] = sum;
+    /* fill each list from its end, so the lists come out in decreasing
+       triangle order and every offset is left at the start of its list */
+    for (i = 0; i < model->numtriangles; i++) {
+        for (j = 0; j < 3; j++) {
+            v = T(i).vindices[j];
+            if (v <= model->numvertices)
+                adjacency->triangles[--offsets[v]] = i;
+        }
+    }
+    return adjacency;
+}
+
+/* glmDeleteAdjacency: Deletes an adjacency built by glmBuildAdjacency().
+ *
+ * adjacency - adjacency returned by glmBuildAdjacency()
+ */
+GLvoid glmDeleteAdjacency(GLMadjacency* adjacency){
+    assert(adjacency);
+    free(adjacency->offsets);
+    free(adjacency->triangles);
+    free(adjacency);
+}
+
+/* GLM_NORMAL_BLOCK: vertices handled by one glmVertexNormals task */
+#define GLM_NORMAL_BLOCK 4096
+
+/* GLMnormaljob: state shared by the glmVertexNormals tasks, which
+ * each handle one block of vertices.
+ */
+typedef struct _GLMnormaljob {
+    GLMmodel*     model;
+    GLMadjacency* adjacency;
+    GLubyte*      averaged;       /* per adjacency entry: averaged in? */
+    GLuint*       first;          /* first new normal of each vertex */
+    GLfloat       cos_angle;
+    GLuint        blocksize;      /* vertices per task */
+} GLMnormaljob;
+
+/* glmCountNormalsTask: decide which triangles around each vertex of a
+ * block are smoothed together and count the normals the vertex needs.
+ */
+static void glmCountNormalsTask(int index, void* arg) {
+    GLMnormaljob* job = (GLMnormaljob*)arg;
+    GLMmodel* model = job->model;
+    GLuint* offsets = job->adjacency->offsets;
+    GLuint* triangles = job->adjacency->triangles;
+    GLuint i, k, end, count, avg;
+    GLfloat* first = NULL;
+    end = (index + 1) * job->blocksize;
+    if (end > model->numvertices)
+        end = model->numvertices;
+    for (i = index * job->blocksize + 1; i <= end; i++) {
+        count = avg = 0;
+        if (offsets[i] < offsets[i + 1])
+            first = &model->facetnorms[3 * T(triangles[offsets[i]]).findex];
+        for (k = offsets[i]; k < offsets[i + 1]; k++) {
             /* only average if the dot product of the angle between the two
-        facet normals is greater than the cosine of the threshold
-        angle -- or, said another way, the angle between the two
+            facet normals is greater than the cosine of the threshold
+            angle -- or, said another way, the angle between the two
             facet normals is less than (or equal to) the threshold angle */
-            dot = glmDot(&model->facetnorms[3 * T(node->index).findex],
-                         &model->facetnorms[3 * T(members[i]->index).findex]);
-            if (dot > cos_angle) {
-                node->averaged = GL_TRUE;
-                average[0] += model->facetnorms[3 * T(node->index).findex + 0];
-                average[1] += model->facetnorms[3 * T(node->index).findex + 1];
-                average[2] += model->facetnorms[3 * T(node->index).findex + 2];
-                avg = 1;            /* we averaged at least one normal! */
+            if (glmDot(&model->facetnorms[3 * T(triangles[k]).findex], first) > job->cos_angle) {
+                job->averaged[k] = GL_TRUE;
+                avg = 1;
             } else {
-                node->averaged = GL_FALSE;
+                job->averaged[k] = GL_FALSE;
+                count++;
             }
-            node = node->next;
-        }
-        if (avg) {
-            /* normalize the averaged normal */
-            glmNormalize(average);
-            /* add the normal to the vertex normals list */
-            model->normals[3 * numnormals + 0] = average[0];
-            model->normals[3 * numnormals + 1] = average[1];
-            model->normals[3 * numnormals + 2] = average[2];
-            avg = numnormals;
-            numnormals++;
         }
-        
-        /* set the normal of this vertex in each triangle it is in */
-        node = members[i];
-        while (node) {
-            if (node->index==204543)  {
-                //printf("");
+        job->first[i] = count + avg;
+    }
+}
+
+/* glmWriteNormalsTask: write the normals of each vertex of a block,
+ * starting at the slot the counting pass reserved for it, and point
+ * the triangles at them.
+ */
+static void glmWriteNormalsTask(int index, void* arg) {
+    GLMnormaljob* job = (GLMnormaljob*)arg;
+    GLMmodel* model = job->model;
+    GLuint* offsets = job->adjacency->offsets;
+    GLuint* triangles = job->adjacency->triangles;
+    GLMtriangle* triangle;
+    GLfloat average[3];
+    GLfloat* facetnorm;
+    GLuint i, k, end, avg, numnormals, normal;
+    end = (index + 1) * job->blocksize;
+    if (end > model->numvertices)
+        end = model->numvertices;
+    for (i = index * job->blocksize + 1; i <= end; i++) {
+        numnormals = job->first[i];
+        /* the average of the smoothed facet normals comes first */
+        average[0] = 0.0; average[1] = 0.0; average[2] = 0.0;
+        avg = 0;
+        for (k = offsets[i]; k < offsets[i + 1]; k++) {
+            if (job->averaged[k]) {
+                facetnorm = &model->facetnorms[3 * T(triangles[k]).findex];
+                average[0] += facetnorm[0];
+                average[1] += facetnorm[1];
+                average[2] += facetnorm[2];
+                avg = 1;
             }
-            if (node->averaged) {
-
-                /* if this node was averaged, use the average normal */
-                if (T(node->index).vindices[0] == i)
-                    T(node->index).nindices[0] = avg;
-                else if (T(node->index).vindices[1] == i)
-                    T(node->index).nindices[1] = avg;
-                else if (T(node->index).vindices[2] == i)
-                    T(node->index).nindices[2] = avg;
+        }
+        if (avg) {
+            glmNormalize(average);
+            model->normals[3 * numnormals + 0] = average[0];
+            model->normals[3 * numnormals + 1] = average[1];
+            model->normals[3 * numnormals + 2] = average[2];
+            avg = numnormals;
+            numnormals++;
+        }
+        /* then a copy of the facet normal of every other triangle */
+        for (k = offsets[i]; k < offsets[i + 1]; k++) {
+            triangle = &T(triangles[k]);
+            if (job->averaged[k]) {
+                normal = avg;
             } else {
-                /* if this node wasn't averaged, use the facet normal */
-                model->normals[3 * numnormals + 0] = 
-                        model->facetnorms[3 * T(node->index).findex + 0];
-                model->normals[3 * numnormals + 1] = 
-                        model->facetnorms[3 * T(node->index).findex + 1];
-                model->normals[3 * numnormals + 2] = 
-                        model->facetnorms[3 * T(node->index).findex + 2];
-                if (T(node->index).vindices[0] == i)
-                    T(node->index).nindices[0] = numnormals;
-                else if (T(node->index).vindices[1] == i)
-                    T(node->index).nindices[1] = numnormals;
-                else if (T(node->index).vindices[2] == i)
-                    T(node->index).nindices[2] = numnormals;
+                facetnorm = &model->facetnorms[3 * triangle->findex];
+                model->normals[3 * numnormals + 0] = facetnorm[0];
+                model->normals[3 * numnormals + 1] = facetnorm[1];
+                model->normals[3 * numnormals + 2] = facetnorm[2];
+                normal = numnormals;
                 numnormals++;
             }
-            node = node->next;
+            if (triangle->vindices[0] == i)
+                triangle->nindices[0] = normal;
+            else if (triangle->vindices[1] == i)
+                triangle->nindices[1] = normal;
+            else if (triangle->vindices[2] == i)
+                triangle->nindices[2] = normal;
         }
     }
-    
-    model->numnormals = numnormals - 1;
-    /* free the member information */
+}
+
+/* glmVertexNormals: Generates smooth vertex normals for a model.
+ * First builds a list of all the triangles each vertex is in (see
+ * glmBuildAdjacency()).   Then loops through each vertex in the the
+ * list averaging all the facet normals of the triangles each vertex is
+ * in.   Finally, sets the normal index in the triangle for the vertex
+ * to the generated smooth normal.   If the dot product of a facet
+ * normal and the facet normal associated with the first triangle in
+ * the list of triangles the current vertex is in is greater than the
+ * cosine of the angle parameter to the function, that facet normal is
+ * not added into the average normal calculation and the corresponding
+ * vertex is given the facet normal.  This tends to preserve hard
+ * edges.  The angle to use depends on the model, but 90 degrees is
+ * usually a good start.  Vertices are processed in parallel blocks: a
+ * first pass counts the normals each vertex needs, so that the second
+ * can write them straight to their final place.
+ *
+ * model - initialized GLMmodel structure
+ * angle - maximum angle (in degrees) to smooth across
+ */
+GLvoid glmVertexNormals(GLMmodel* model, GLfloat angle){
+    GLMadjacency* adjacency;
+    GLMnormaljob job;
+    GLuint i, count, numnormals, numblocks;
+    assert(model);
+    assert(model->facetnorms);
+    /* calculate the cosine of the angle (in degrees) */
+    job.cos_angle = cos(angle * M_PI / 180.0);
+    /* nuke any previous normals */
+    if (model->normals)
+        glmFreeArray(model, model->normals);
+    model->normals = NULL;
+    /* find the triangles each vertex is in */
+    adjacency = glmBuildAdjacency(model);
     for (i = 1; i <= model->numvertices; i++) {
-        node = members[i];
-        while (node) {
-            tail = node;
-            node = node->next;
-            free(tail);
-        }
+        if (adjacency->offsets[i] == adjacency->offsets[i + 1])
+            fprintf(stderr, "glmVertexNormals(): vertex w/o a triangle\n");
     }
-    free(members);
-    /* pack the normals array (we previously allocated the maximum
-    number of normals that could possibly be created (numtriangles *
-    3), so get rid of some of them (usually alot unless none of the
-    facet normals were averaged)) */
-    normals = model->normals;
-    model->normals = (GLfloat*)malloc(sizeof(GLfloat)* 3* (model->numnormals+1));
-    for (i = 1; i <= model->numnormals; i++) {
-        model->normals[3 * i + 0] = normals[3 * i + 0];
-        model->normals[3 * i + 1] = normals[3 * i + 1];
-        model->normals[3 * i + 2] = normals[3 * i + 2];
+    job.model = model;
+    job.adjacency = adjacency;
+    job.averaged = (GLubyte*)malloc(sizeof(GLubyte) * (3 * model->numtriangles + 1));
+    job.first = (GLuint*)malloc(sizeof(GLuint) * (model->numvertices + 1));
+    job.blocksize = GLM_NORMAL_BLOCK;
+    numblocks = (model->numvertices + job.blocksize - 1) / job.blocksize;
+    /* count the normals of every vertex, then give each vertex its
+       first slot so that vertices keep their order in the array */
+    parallelFor(numblocks, glmCountNormalsTask, &job);
+    numnormals = 1;
+    for (i = 1; i <= model->numvertices; i++) {
+        count = job.first[i];
+        job.first[i] = numnormals;
+        numnormals += count;
     }
-    free(normals);
+    model->numnormals = numnormals - 1;
+    model->normals = (GLfloat*)malloc(sizeof(GLfloat)* 3* (model->numnormals+1));
+    parallelFor(numblocks, glmWriteNormalsTask, &job);
+    free(job.averaged);
+    free(job.first);
+    glmDeleteAdjacency(adjacency);
 }
 
 GLvoid glmLinearTexture(GLMmodel* model){
@@ -1225,7 +1629,7 @@ GLvoid glmLinearTexture(GLMmodel* model){
     GLuint i;
     assert(model);
     if (model->texcoords)
-        free(model->texcoords);
+        glmFreeArray(model, model->texcoords);
     model->numtexcoords = model->numvertices;
     model->texcoords=(GLfloat*)malloc(sizeof(GLfloat)*2*(model->numtexcoords+1));
     
@@ -1274,7 +1678,7 @@ GLvoid glmSpheremapTexture(GLMmodel* model){
     assert(model);
     assert(model->normals);
     if (model->texcoords)
-        free(model->texcoords);
+        glmFreeArray(model, model->texcoords);
     model->numtexcoords = model->numnormals;
     model->texcoords=(GLfloat*)malloc(sizeof(GLfloat)*2*(model->numtexcoords+1));
     for (i = 1; i <= model->numnormals; i++) {
@@ -1322,11 +1726,11 @@ GLvoid glmDelete(GLMmodel* model){
     assert(model);
     if (model->pathname)     free(model->pathname);
     if (model->mtllibname) free(model->mtllibname);
-    if (model->vertices)     free(model->vertices);
-    if (model->normals)  free(model->normals);
-    if (model->texcoords)  free(model->texcoords);
-    if (model->facetnorms) free(model->facetnorms);
-    if (model->triangles)  free(model->triangles);
+    if (model->vertices)     glmFreeArray(model, model->vertices);
+    if (model->normals)  glmFreeArray(model, model->normals);
+    if (model->texcoords)  glmFreeArray(model, model->texcoords);
+    if (model->facetnorms) glmFreeArray(model, model->facetnorms);
+    if (model->triangles)  glmFreeArray(model, model->triangles);
     if (model->materials) {
         for (i = 0; i < model->nummaterials; i++)
             free(model->materials[i].name);
@@ -1344,29 +1748,28 @@ GLvoid glmDelete(GLMmodel* model){
         group = model->groups;
         model->groups = model->groups->next;
         free(group->name);
-        free(group->triangles);
+        glmFreeArray(model, group->triangles);
         free(group);
     }
+    if (model->mapped)
+        munmap(model->mapped, model->mappedsize);
     free(model);
 }
 
-/* glmReadOBJ: Reads a model description from a Wavefront .OBJ file.
- * Returns a pointer to the created object which should be free'd with
- * glmDelete().
- *
- * filename - name of the file containing the Wavefront .OBJ format data.  
- */
+/* GLM_MIN_CHUNK_SIZE: smallest piece of a file worth a thread of its own */
+#define GLM_MIN_CHUNK_SIZE (256 * 1024)
 
-GLMmodel* glmReadOBJ(const char* filename){
-    return glmReadOBJ(filename,0);
-}
-GLMmodel* glmReadOBJ(const char* filename,mycallback *call){
+/* glmReadOBJChunks: map the file and parse it as numchunks chunks.
+ * Files too small to be worth splitting are parsed as one chunk.
+ */
+static GLMmodel* glmReadOBJChunks(const char* filename, GLuint numchunks, mycallback *call){
     GLMmodel* model;
-    FILE*   file;
+    const char* data;
+    size_t  size;
     //if (call) call->loadcallback(0,"Loading Models...");
-    /* open the file */
-    file = fopen(filename, "r");
-    if (!file) {
+    /* map the file */
+    data = glmMapFile(filename, &size);
+    if (!data) {
         fprintf(stderr, "glmReadOBJ() failed: can't open data file \"%s\".\n",
                 filename);
         exit(1);
@@ -1394,28 +1797,550 @@ GLMmodel* glmReadOBJ(const char* filename,mycallback *call){
     model->position[0]   = 0.0;
     model->position[1]   = 0.0;
     model->position[2]   = 0.0;
-    /* make a first pass through the file to get a count of the number
-    of vertices, normals, texcoords & triangles */
-    glmFirstPass(model, file, call);
-    /* allocate memory */
-    model->vertices = (GLfloat*)malloc(sizeof(GLfloat) *
-                                       3 * (model->numvertices + 1));
-    model->triangles = (GLMtriangle*)malloc(sizeof(GLMtriangle) *
-                                            model->numtriangles);
-    if (model->numnormals) {
-        model->normals = (GLfloat*)malloc(sizeof(GLfloat) *
-                                          3 * (model->numnormals + 1));
-    }
-    if (model->numtexcoords) {
-        model->texcoords = (GLfloat*)malloc(sizeof(GLfloat) *
-                                            2 * (model->numtexcoords + 1));
-    }
-    /* rewind to beginning of file and read in the data this pass */
-    rewind(file);
-    
-    glmSecondPass(model, file,call);
-    /* close the file */
-    fclose(file);
+    model->mapped        = NULL;
+    model->mappedsize    = 0;
+    /* read everything in a single pass over the mapped file */
+    if (numchunks > size / GLM_MIN_CHUNK_SIZE)
+        numchunks = size / GLM_MIN_CHUNK_SIZE;
+    if (numchunks < 1)
+        numchunks = 1;
+    glmParse(model, data, data + size, numchunks, call);
+    /* unmap the file */
+    glmUnmapFile(data, size);
+    return model;
+}
+
+/* glmReadOBJ: Reads a model description from a Wavefront .OBJ file.
+ * Returns a pointer to the created object which should be free'd with
+ * glmDelete().  The file is mapped into memory and parsed in a single
+ * pass.
+ *
+ * filename - name of the file containing the Wavefront .OBJ format data.  
+ */
+GLMmodel* glmReadOBJ(const char* filename){
+    return glmReadOBJ(filename,0);
+}
+GLMmodel* glmReadOBJ(const char* filename,mycallback *call){
+    return glmReadOBJChunks(filename, 1, call);
+}
+
+/* glmReadOBJParallel: Reads a model description from a Wavefront .OBJ
+ * file like glmReadOBJ, but splits the file into newline-aligned
+ * chunks that are parsed on separate threads.
+ *
+ * filename   - name of the file containing the Wavefront .OBJ format data.
+ * numthreads - number of chunks to parse at once (0 = one per processor)
+ */
+GLMmodel* glmReadOBJParallel(const char* filename, GLuint numthreads){
+    return glmReadOBJChunks(filename, numthreads ? numthreads : parallelNumThreads(), 0);
+}
+
+/* GLM_CACHE_MAGIC: "GLMB" read as a little-endian word */
+#define GLM_CACHE_MAGIC   0x424d4c47
+/* GLM_CACHE_VERSION: bump whenever the layout below changes */
+#define GLM_CACHE_VERSION 2
+/* GLM_CACHE_ALIGN: alignment of every section in the file */
+#define GLM_CACHE_ALIGN   16
+/* GLM_CACHE_NONE: string offset of a missing string */
+#define GLM_CACHE_NONE    0xffffffffu
+
+/* GLMcacheheader: start of a binary model cache.  Every array is
+ * stored exactly as a GLMmodel holds it (1-based, with the unused
+ * first element) at an aligned offset, so that a mapped cache can be
+ * used in place.  An offset of 0 stands for a NULL array.
+ */
+typedef struct _GLMcacheheader {
+    GLuint   magic;
+    GLuint   version;
+    GLuint   headersize;          /* sizeof(GLMcacheheader) */
+    GLuint   trianglesize;        /* sizeof(GLMtriangle) */
+    uint64_t filesize;            /* size of the whole cache */
+    uint64_t srcsize;             /* size of the source .obj */
+    int64_t  srcmtime;            /* modification time of the source (ns) */
+    uint64_t srchash;             /* FNV-1a hash of the source contents */
+    GLuint   numvertices;
+    GLuint   numnormals;
+    GLuint   numtexcoords;
+    GLuint   numfacetnorms;
+    GLuint   numtriangles;
+    GLuint   nummaterials;
+    GLuint   numtextures;
+    GLuint   numgroups;
+    GLfloat  position[3];
+    GLuint   mtllibname;          /* string offset */
+    uint64_t vertices;            /* section offsets */
+    uint64_t normals;
+    uint64_t texcoords;
+    uint64_t facetnorms;
+    uint64_t triangles;
+    uint64_t groups;              /* numgroups GLMcachegroups */
+    uint64_t materials;           /* nummaterials GLMcachematerials */
+    uint64_t textures;            /* numtextures string offsets */
+    uint64_t strings;             /* NUL terminated strings */
+    uint64_t stringsize;          /* size of the string pool */
+} GLMcacheheader;
+
+/* GLMcachegroup: a group as stored in the cache, in list order */
+typedef struct _GLMcachegroup {
+    GLuint   name;                /* string offset */
+    GLuint   numtriangles;
+    GLuint   material;
+    GLuint   pad;
+    uint64_t triangles;           /* offset of the triangle indices */
+} GLMcachegroup;
+
+/* GLMcachematerial: a material as stored in the cache */
+typedef struct _GLMcachematerial {
+    GLuint  name;                 /* string offset */
+    GLfloat diffuse[4];
+    GLfloat ambient[4];
+    GLfloat specular[4];
+    GLfloat emmissive[4];
+    GLfloat shininess;
+    GLuint  textureid;
+    GLuint  bumpid;
+} GLMcachematerial;
+
+/* glmHash: 64-bit FNV-1a hash of a block of memory */
+static uint64_t glmHash(const char* p, size_t size) {
+    uint64_t hash = 14695981039346656037ULL;
+    size_t i;
+    for (i = 0; i < size; i++) {
+        hash ^= (unsigned char)p[i];
+        hash *= 1099511628211ULL;
+    }
+    return hash;
+}
+
+/* glmHashFile: hash the contents of a file.  Returns GL_FALSE if the
+ * file can't be read.
+ */
+static GLboolean glmHashFile(const char* filename, uint64_t* hash) {
+    const char* data;
+    size_t size;
+    data = glmMapFile(filename, &size);
+    if (!data)
+        return GL_FALSE;
+    *hash = glmHash(data, size);
+    glmUnmapFile(data, size);
+    return GL_TRUE;
+}
+
+/* glmCacheSection: reserve size bytes at the next aligned offset.
+ * Returns the offset of the section, or 0 if it is empty.
+ */
+static uint64_t glmCacheSection(uint64_t* offset, uint64_t size) {
+    uint64_t start;
+    if (!size)
+        return 0;
+    start = (*offset + GLM_CACHE_ALIGN - 1) & ~(uint64_t)(GLM_CACHE_ALIGN - 1);
+    *offset = start + size;
+    return start;
+}
+
+/* glmCacheString: append a string to the string pool of a cache being
+ * written and return its offset.
+ */
+static GLuint glmCacheString(char* pool, GLuint* used, const char* s) {
+    GLuint offset;
+    if (!s)
+        return GLM_CACHE_NONE;
+    offset = *used;
+    strcpy(pool + offset, s);
+    *used += strlen(s) + 1;
+    return offset;
+}
+
+/* glmModTime: modification time of a file in nanoseconds */
+static int64_t glmModTime(const struct stat* st) {
+    return (int64_t)st->st_mtim.tv_sec * 1000000000 + st->st_mtim.tv_nsec;
+}
+
+/* glmCacheCheck: is the section [offset, offset + size) aligned and
+ * inside the file?
+ */
+static GLboolean glmCacheCheck(const GLMcacheheader* header, uint64_t offset, uint64_t size) {
+    if (!offset)
+        return size == 0;
+    return offset % GLM_CACHE_ALIGN == 0 && offset >= sizeof(GLMcacheheader) &&
+        offset <= header->filesize && size <= header->filesize - offset;
+}
+
+/* glmCacheName: is a string offset the start of a NUL terminated
+ * string inside the pool, or GLM_CACHE_NONE where a string is optional?
+ */
+static GLboolean glmCacheName(const GLMcacheheader* header, const char* pool,
+                              GLuint offset, GLboolean optional) {
+    if (offset == GLM_CACHE_NONE)
+        return optional;
+    return offset < header->stringsize &&
+        memchr(pool + offset, '\0', header->stringsize - offset) != NULL;
+}
+
+/* glmCacheContents: check what the sections of a cache hold, once the
+ * sections themselves are known to be inside the file.  Every string
+ * must end inside the pool and every index must stay inside the array
+ * it indexes, so that a corrupt cache can't send glmBuildMesh() or
+ * glmDraw() out of bounds.  Indices into arrays the cache doesn't have
+ * are never followed and aren't checked.
+ */
+static GLboolean glmCacheContents(const GLMcacheheader* header, const char* data) {
+    const GLMtriangle* triangles = (const GLMtriangle*)(data + header->triangles);
+    const GLMcachegroup* groups = (const GLMcachegroup*)(data + header->groups);
+    const GLMcachematerial* materials = (const GLMcachematerial*)(data + header->materials);
+    const GLuint* textures = (const GLuint*)(data + header->textures);
+    const char* pool = data + header->strings;
+    const GLuint* indices;
+    GLuint i, j;
+
+    if (!glmCacheName(header, pool, header->mtllibname, GL_TRUE))
+        return GL_FALSE;
+    for (i = 0; i < header->numtriangles; i++) {
+        for (j = 0; j < 3; j++) {
+            if (triangles[i].vindices[j] > header->numvertices ||
+                (header->normals && triangles[i].nindices[j] > header->numnormals) ||
+                (header->texcoords && triangles[i].tindices[j] > header->numtexcoords))
+                return GL_FALSE;
+        }
+        if (header->facetnorms && triangles[i].findex > header->numfacetnorms)
+            return GL_FALSE;
+    }
+    for (i = 0; i < header->numgroups; i++) {
+        if (!glmCacheName(header, pool, groups[i].name, GL_FALSE) ||
+            (header->nummaterials && groups[i].material >= header->nummaterials))
+            return GL_FALSE;
+        indices = (const GLuint*)(data + groups[i].triangles);
+        for (j = 0; j < groups[i].numtriangles; j++) {
+            if (indices[j] >= header->numtriangles)
+                return GL_FALSE;
+        }
+    }
+    for (i = 0; i < header->nummaterials; i++) {
+        if (!glmCacheName(header, pool, materials[i].name, GL_TRUE) ||
+            (materials[i].textureid != (GLuint)-1 && materials[i].textureid >= header->numtextures))
+            return GL_FALSE;
+    }
+    for (i = 0; i < header->numtextures; i++) {
+        if (!glmCacheName(header, pool, textures[i], GL_FALSE))
+            return GL_FALSE;
+    }
+    return GL_TRUE;
+}
+
+/* glmCacheFresh: check that a cache was built from the current
+ * contents of its source.  A matching size and mtime is trusted as is;
+ * if only the mtime differs (the file was touched or checked out
+ * again) the source is hashed, and the stored mtime is refreshed when
+ * the contents turn out to be unchanged.
+ */
+static GLboolean glmCacheFresh(const GLMcacheheader* header, const char* filename, const char* source) {
+    struct stat st;
+    uint64_t hash;
+    int64_t mtime;
+    int fd;
+    if (stat(source, &st) < 0 || (uint64_t)st.st_size != header->srcsize)
+        return GL_FALSE;
+    if (glmModTime(&st) == header->srcmtime)
+        return GL_TRUE;
+    if (!glmHashFile(source, &hash) || hash != header->srchash)
+        return GL_FALSE;
+    mtime = glmModTime(&st);
+    fd = open(filename, O_WRONLY);
+    if (fd >= 0) {
+        if (pwrite(fd, &mtime, sizeof(mtime), offsetof(GLMcacheheader, srcmtime)) != sizeof(mtime))
+            fprintf(stderr, "glmReadCache(): can't refresh \"%s\".\n", filename);
+        close(fd);
+    }
+    return GL_TRUE;
+}
+
+/* glmWriteCache: Writes a model to a binary cache that glmReadCache()
+ * can map back in.  The cache records the size, modification time and
+ * a hash of the source file it stands for.  It is written to a
+ * temporary file first and renamed into place, so a reader never sees
+ * a half-written cache.  Returns GL_FALSE if the cache can't be
+ * written.
+ *
+ * model    - initialized GLMmodel structure
+ * filename - name of the cache file to write
+ * source   - name of the .obj file the model was read from
+ */
+GLboolean glmWriteCache(GLMmodel* model, const char* filename, const char* source){
+    GLMcacheheader header;
+    GLMcachegroup* groups;
+    GLMcachematerial* materials;
+    GLuint* textures;
+    GLMgroup* group;
+    struct stat st;
+    char* data;
+    char* pool;
+    char* tempname;
+    FILE* file;
+    uint64_t offset, strsize;
+    GLuint used, i;
+    size_t written;
+
+    assert(model);
+    memset(&header, 0, sizeof(header));
+    if (stat(source, &st) < 0 || !glmHashFile(source, &header.srchash)) {
+        fprintf(stderr, "glmWriteCache(): can't read source \"%s\".\n", source);
+        return GL_FALSE;
+    }
+    header.magic         = GLM_CACHE_MAGIC;
+    header.version       = GLM_CACHE_VERSION;
+    header.headersize    = sizeof(GLMcacheheader);
+    header.trianglesize  = sizeof(GLMtriangle);
+    header.srcsize       = st.st_size;
+    header.srcmtime      = glmModTime(&st);
+    header.numvertices   = model->numvertices;
+    header.numnormals    = model->normals ? model->numnormals : 0;
+    header.numtexcoords  = model->texcoords ? model->numtexcoords : 0;
+    header.numfacetnorms = model->facetnorms ? model->numfacetnorms : 0;
+    header.numtriangles  = model->numtriangles;
+    header.nummaterials  = model->materials ? model->nummaterials : 0;
+    header.numtextures   = model->textures ? model->numtextures : 0;
+    header.numgroups     = model->numgroups;
+    header.position[0]   = model->position[0];
+    header.position[1]   = model->position[1];
+    header.position[2]   = model->position[2];
+
+    /* size up the string pool */
+    strsize = model->mtllibname ? strlen(model->mtllibname) + 1 : 0;
+    for (group = model->groups; group; group = group->next)
+        strsize += strlen(group->name) + 1;
+    for (i = 0; i < header.nummaterials; i++)
+        strsize += model->materials[i].name ? strlen(model->materials[i].name) + 1 : 0;
+    for (i = 0; i < header.numtextures; i++)
+        strsize += strlen(model->textures[i].name) + 1;
+
+    /* lay out the sections */
+    offset = sizeof(GLMcacheheader);
+    header.vertices   = glmCacheSection(&offset, model->vertices ?
+        sizeof(GLfloat) * 3 * (header.numvertices + 1) : 0);
+    header.normals    = glmCacheSection(&offset, model->normals ?
+        sizeof(GLfloat) * 3 * (header.numnormals + 1) : 0);
+    header.texcoords  = glmCacheSection(&offset, model->texcoords ?
+        sizeof(GLfloat) * 2 * (header.numtexcoords + 1) : 0);
+    header.facetnorms = glmCacheSection(&offset, model->facetnorms ?
+        sizeof(GLfloat) * 3 * (header.numfacetnorms + 1) : 0);
+    header.triangles  = glmCacheSection(&offset, sizeof(GLMtriangle) * header.numtriangles);
+    header.groups     = glmCacheSection(&offset, sizeof(GLMcachegroup) * header.numgroups);
+    header.materials  = glmCacheSection(&offset, sizeof(GLMcachematerial) * header.nummaterials);
+    header.textures   = glmCacheSection(&offset, sizeof(GLuint) * header.numtextures);
+    header.strings    = glmCacheSection(&offset, strsize);
+    header.stringsize = strsize;
+    for (group = model->groups; group; group = group->next)
+        glmCacheSection(&offset, sizeof(GLuint) * group->numtriangles);
+    header.filesize = offset;
+
+    /* fill in a copy of the whole file */
+    data = (char*)calloc(1, header.filesize);
+    if (!data) {
+        fprintf(stderr, "glmWriteCache(): out of memory.\n");
+        return GL_FALSE;
+    }
+    if (header.vertices)
+        memcpy(data + header.vertices, model->vertices, sizeof(GLfloat) * 3 * (header.numvertices + 1));
+    if (header.normals)
+        memcpy(data + header.normals, model->normals, sizeof(GLfloat) * 3 * (header.numnormals + 1));
+    if (header.texcoords)
+        memcpy(data + header.texcoords, model->texcoords, sizeof(GLfloat) * 2 * (header.numtexcoords + 1));
+    if (header.facetnorms)
+        memcpy(data + header.facetnorms, model->facetnorms, sizeof(GLfloat) * 3 * (header.numfacetnorms + 1));
+    if (header.triangles)
+        memcpy(data + header.triangles, model->triangles, sizeof(GLMtriangle) * header.numtriangles);
+
+    pool = data + header.strings;
+    used = 0;
+    header.mtllibname = glmCacheString(pool, &used, model->mtllibname);
+
+    groups = (GLMcachegroup*)(data + header.groups);
+    offset = header.strings + strsize;
+    i = 0;
+    for (group = model->groups; group; group = group->next, i++) {
+        groups[i].name         = glmCacheString(pool, &used, group->name);
+        groups[i].numtriangles = group->numtriangles;
+        groups[i].material     = group->material;
+        groups[i].triangles    = glmCacheSection(&offset, sizeof(GLuint) * group->numtriangles);
+        if (groups[i].triangles)
+            memcpy(data + groups[i].triangles, group->triangles, sizeof(GLuint) * group->numtriangles);
+    }
+
+    materials = (GLMcachematerial*)(data + header.materials);
+    for (i = 0; i < header.nummaterials; i++) {
+        materials[i].name = glmCacheString(pool, &used, model->materials[i].name);
+        memcpy(materials[i].diffuse, model->materials[i].diffuse, sizeof(materials[i].diffuse));
+        memcpy(materials[i].ambient, model->materials[i].ambient, sizeof(materials[i].ambient));
+        memcpy(materials[i].specular, model->materials[i].specular, sizeof(materials[i].specular));
+        memcpy(materials[i].emmissive, model->materials[i].emmissive, sizeof(materials[i].emmissive));
+        materials[i].shininess = model->materials[i].shininess;
+        materials[i].textureid = model->materials[i].textureid;
+        materials[i].bumpid    = model->materials[i].bumpid;
+    }
+
+    textures = (GLuint*)(data + header.textures);
+    for (i = 0; i < header.numtextures; i++)
+        textures[i] = glmCacheString(pool, &used, model->textures[i].name);
+
+    memcpy(data, &header, sizeof(header));
+
+    /* write it out under a temporary name and move it into place */
+    tempname = (char*)malloc(strlen(filename) + 5);
+    strcpy(tempname, filename);
+    strcat(tempname, ".tmp");
+    written = 0;
+    file = fopen(tempname, "wb");
+    if (file) {
+        written = fwrite(data, 1, header.filesize, file);
+        if (fclose(file) != 0)
+            written = 0;
+    }
+    free(data);
+    if (written != header.filesize || rename(tempname, filename) < 0) {
+        fprintf(stderr, "glmWriteCache(): can't write cache \"%s\".\n", filename);
+        unlink(tempname);
+        free(tempname);
+        return GL_FALSE;
+    }
+    free(tempname);
+    return GL_TRUE;
+}
+
+/* glmReadCache: Reads a model from a binary cache written by
+ * glmWriteCache().  The cache is mapped copy-on-write and the vertex,
+ * normal, texcoord, triangle and group arrays of the returned model
+ * point straight into the mapping, so loading costs little more than
+ * the page faults.  Returns NULL if the cache is missing, corrupt (a
+ * section, string or index out of bounds), from another version, or no
+ * longer matches its source file; the caller then reads the source
+ * again.  The model should be free'd with glmDelete() as usual.
+ *
+ * filename - name of the cache file to read
+ * source   - name of the .obj file the cache was built from
+ */
+GLMmodel* glmReadCache(const char* filename, const char* source){
+    const GLMcacheheader* header;
+    const GLMcachegroup* groups;
+    const GLMcachematerial* materials;
+    const GLuint* textures;
+    const char* pool;
+    GLMmodel* model;
+    GLMgroup* group;
+    GLMgroup** tail;
+    struct stat st;
+    char* data;
+    GLuint i;
+    int fd;
+
+    fd = open(filename, O_RDONLY);
+    if (fd < 0)
+        return NULL;
+    if (fstat(fd, &st) < 0 || (size_t)st.st_size < sizeof(GLMcacheheader)) {
+        close(fd);
+        return NULL;
+    }
+    data = (char*)mmap(NULL, st.st_size, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (data == MAP_FAILED)
+        return NULL;
+
+    /* make sure the cache is one we can use */
+    header = (const GLMcacheheader*)data;
+    if (header->magic != GLM_CACHE_MAGIC || header->version != GLM_CACHE_VERSION ||
+        header->headersize != sizeof(GLMcacheheader) ||
+        header->trianglesize != sizeof(GLMtriangle) ||
+        header->filesize != (uint64_t)st.st_size ||
+        !glmCacheCheck(header, header->vertices, header->vertices ?
+            sizeof(GLfloat) * 3 * ((uint64_t)header->numvertices + 1) : 0) ||
+        !glmCacheCheck(header, header->normals, header->normals ?
+            sizeof(GLfloat) * 3 * ((uint64_t)header->numnormals + 1) : 0) ||
+        !glmCacheCheck(header, header->texcoords, header->texcoords ?
+            sizeof(GLfloat) * 2 * ((uint64_t)header->numtexcoords + 1) : 0) ||
+        !glmCacheCheck(header, header->facetnorms, header->facetnorms ?
+            sizeof(GLfloat) * 3 * ((uint64_t)header->numfacetnorms + 1) : 0) ||
+        !glmCacheCheck(header, header->triangles, sizeof(GLMtriangle) * (uint64_t)header->numtriangles) ||
+        !glmCacheCheck(header, header->groups, sizeof(GLMcachegroup) * (uint64_t)header->numgroups) ||
+        !glmCacheCheck(header, header->materials, sizeof(GLMcachematerial) * (uint64_t)header->nummaterials) ||
+        !glmCacheCheck(header, header->textures, sizeof(GLuint) * (uint64_t)header->numtextures) ||
+        !glmCacheCheck(header, header->strings, header->stringsize)) {
+        munmap(data, st.st_size);
+        return NULL;
+    }
+    groups = (const GLMcachegroup*)(data + header->groups);
+    for (i = 0; i < header->numgroups; i++) {
+        if (!glmCacheCheck(header, groups[i].triangles, sizeof(GLuint) * (uint64_t)groups[i].numtriangles)) {
+            munmap(data, st.st_size);
+            return NULL;
+        }
+    }
+    if (!glmCacheContents(header, data) || !glmCacheFresh(header, filename, source)) {
+        munmap(data, st.st_size);
+        return NULL;
+    }
+    madvise(data, st.st_size, MADV_WILLNEED);
+    pool = data + header->strings;
+
+    /* point a new model at the mapped arrays */
+    model = (GLMmodel*)malloc(sizeof(GLMmodel));
+    model->pathname      = strdup(source);
+    model->mtllibname    = header->mtllibname != GLM_CACHE_NONE ? strdup(pool + header->mtllibname) : NULL;
+    model->numvertices   = header->numvertices;
+    model->vertices      = header->vertices ? (GLfloat*)(data + header->vertices) : NULL;
+    model->numnormals    = header->numnormals;
+    model->normals       = header->normals ? (GLfloat*)(data + header->normals) : NULL;
+    model->numtexcoords  = header->numtexcoords;
+    model->texcoords     = header->texcoords ? (GLfloat*)(data + header->texcoords) : NULL;
+    model->numfacetnorms = header->numfacetnorms;
+    model->facetnorms    = header->facetnorms ? (GLfloat*)(data + header->facetnorms) : NULL;
+    model->numtriangles  = header->numtriangles;
+    model->triangles     = header->triangles ? (GLMtriangle*)(data + header->triangles) : NULL;
+    model->nummaterials  = 0;
+    model->materials     = NULL;
+    model->numtextures   = 0;
+    model->textures      = NULL;
+    model->numgroups     = 0;
+    model->groups        = NULL;
+    model->position[0]   = header->position[0];
+    model->position[1]   = header->position[1];
+    model->position[2]   = header->position[2];
+    model->mapped        = data;
+    model->mappedsize    = st.st_size;
+
+    /* groups keep their order; only the small bits are copied */
+    tail = &model->groups;
+    for (i = 0; i < header->numgroups; i++) {
+        group = (GLMgroup*)malloc(sizeof(GLMgroup));
+        group->name         = strdup(pool + groups[i].name);
+        group->numtriangles = groups[i].numtriangles;
+        group->triangles    = groups[i].triangles ? (GLuint*)(data + groups[i].triangles) : NULL;
+        group->material     = groups[i].material;
+        group->next         = NULL;
+        *tail = group;
+        tail = &group->next;
+        model->numgroups++;
+    }
+
+    /* materials are copied, textures are loaded again in the same order */
+    if (header->nummaterials) {
+        materials = (const GLMcachematerial*)(data + header->materials);
+        model->nummaterials = header->nummaterials;
+        model->materials = (GLMmaterial*)malloc(sizeof(GLMmaterial) * model->nummaterials);
+        for (i = 0; i < model->nummaterials; i++) {
+            model->materials[i].name = materials[i].name != GLM_CACHE_NONE ?
+                strdup(pool + materials[i].name) : NULL;
+            memcpy(model->materials[i].diffuse, materials[i].diffuse, sizeof(materials[i].diffuse));
+            memcpy(model->materials[i].ambient, materials[i].ambient, sizeof(materials[i].ambient));
+            memcpy(model->materials[i].specular, materials[i].specular, sizeof(materials[i].specular));
+            memcpy(model->materials[i].emmissive, materials[i].emmissive, sizeof(materials[i].emmissive));
+            model->materials[i].shininess = materials[i].shininess;
+            model->materials[i].textureid = materials[i].textureid;
+            model->materials[i].bumpid    = materials[i].bumpid;
+        }
+    }
+    textures = (const GLuint*)(data + header->textures);
+    for (i = 0; i < header->numtextures; i++)
+        glmFindOrAddTexture(model, (char*)(pool + textures[i]), 0);
+
     return model;
 }
 
@@ -1610,33 +2535,10 @@ GLvoid glmWriteOBJ(GLMmodel* model, char* filename, GLuint mode){
     fclose(file);
 }
 
-/* glmDraw: Renders the model to the current OpenGL context using the
- * mode specified.
- *
- * model - initialized GLMmodel structure
- * mode  - a bitwise OR of values describing what is to be rendered.
- *             GLM_NONE     -  render with only vertices
- *             GLM_FLAT     -  render with facet normals
- *             GLM_SMOOTH   -  render with vertex normals
- *             GLM_TEXTURE  -  render with texture coords
- *             GLM_COLOR    -  render with colors (color material)
- *             GLM_MATERIAL -  render with materials
- *             GLM_COLOR and GLM_MATERIAL should not both be specified.  
- *             GLM_FLAT and GLM_SMOOTH should not both be specified.  
+/* glmCheckMode: drop the parts of a render mode the model has no data
+ * for (or that conflict), warning about each of them.
  */
-
-GLvoid glmDraw(GLMmodel* model, GLuint mode){
-    glmDraw(model,mode,0);
-}
-GLvoid glmDraw(GLMmodel* model, GLuint mode,char *drawonly){
-    static GLuint i;
-    static GLMgroup* group;
-    static GLMtriangle* triangle;
-    static GLMmaterial* material;
-    GLuint textureid;
-    assert(model);
-    assert(model->vertices);
-    /* do a bit of warning */
+static GLuint glmCheckMode(GLMmodel* model, GLuint mode){
     if (mode & GLM_FLAT && !model->facetnorms) {
         printf("glmDraw() warning: flat render mode requested "
                "with no facet normals defined.\n");
@@ -1672,6 +2574,60 @@ GLvoid glmDraw(GLMmodel* model, GLuint mode,char *drawonly){
                "using only material mode.\n");
         mode &= ~GLM_COLOR;
     }
+    return mode;
+}
+
+/* glmApplyMaterial: set up the material, color and texture of a group
+ * for the parts of the render mode that need them.
+ */
+static GLvoid glmApplyMaterial(GLMmodel* model, GLuint mode, GLuint index){
+    GLMmaterial* material;
+    GLuint textureid;
+    material = model->materials ? &model->materials[index] : NULL;
+    textureid = material ? material->textureid : (GLuint)-1;
+    if (mode & GLM_MATERIAL)  {
+        glMaterialfv(GL_FRONT_AND_BACK, GL_AMBIENT, material->ambient);
+        glMaterialfv(GL_FRONT_AND_BACK, GL_DIFFUSE, material->diffuse);
+        glMaterialfv(GL_FRONT_AND_BACK, GL_SPECULAR, material->specular);
+        glMaterialf(GL_FRONT_AND_BACK, GL_SHININESS, material->shininess);
+    }
+    if (mode & GLM_TEXTURE)  {
+        if (textureid == (GLuint)-1)
+            glBindTexture(GL_TEXTURE_2D, 0);
+        else
+            glBindTexture(GL_TEXTURE_2D, model->textures[textureid].id);
+    }
+    if (mode & GLM_COLOR) {
+        glColor3fv(material->diffuse);
+    }
+}
+
+/* glmDraw: Renders the model to the current OpenGL context using the
+ * mode specified.
+ *
+ * model - initialized GLMmodel structure
+ * mode  - a bitwise OR of values describing what is to be rendered.
+ *             GLM_NONE     -  render with only vertices
+ *             GLM_FLAT     -  render with facet normals
+ *             GLM_SMOOTH   -  render with vertex normals
+ *             GLM_TEXTURE  -  render with texture coords
+ *             GLM_COLOR    -  render with colors (color material)
+ *             GLM_MATERIAL -  render with materials
+ *             GLM_COLOR and GLM_MATERIAL should not both be specified.  
+ *             GLM_FLAT and GLM_SMOOTH should not both be specified.  
+ */
+
+GLvoid glmDraw(GLMmodel* model, GLuint mode){
+    glmDraw(model,mode,0);
+}
+GLvoid glmDraw(GLMmodel* model, GLuint mode,char *drawonly){
+    static GLuint i;
+    static GLMgroup* group;
+    static GLMtriangle* triangle;
+    assert(model);
+    assert(model->vertices);
+    /* do a bit of warning */
+    mode = glmCheckMode(model, mode);
     if (mode & GLM_COLOR)
         glEnable(GL_COLOR_MATERIAL);
     else if (mode & GLM_MATERIAL)
@@ -1685,7 +2641,6 @@ GLvoid glmDraw(GLMmodel* model, GLuint mode,char *drawonly){
        schemes (and these branches will always go one way), probably
        wouldn't gain too much?  */
     
-    textureid = -1;
     group = model->groups;
     while (group)  {
         if (drawonly)
@@ -1694,30 +2649,7 @@ GLvoid glmDraw(GLMmodel* model, GLuint mode,char *drawonly){
             continue;
          }
 
-        material = &model->materials[group->material];
-        if (material) {
-            textureid = material->textureid;
-
-        }
-        else textureid = -1;
-        if (mode & GLM_MATERIAL)  {
-            glMaterialfv(GL_FRONT_AND_BACK, GL_AMBIENT, material->ambient);
-            glMaterialfv(GL_FRONT_AND_BACK, GL_DIFFUSE, material->diffuse);
-            glMaterialfv(GL_FRONT_AND_BACK, GL_SPECULAR, material->specular);
-            glMaterialf(GL_FRONT_AND_BACK, GL_SHININESS, material->shininess);
-        }
-
-        if (mode & GLM_TEXTURE)  {
-            if(textureid == -1)
-                glBindTexture(GL_TEXTURE_2D, 0);
-            else{
-                glBindTexture(GL_TEXTURE_2D, model->textures[textureid].id);
-            }
-        }
-        
-        if (mode & GLM_COLOR) {
-            glColor3fv(material->diffuse);
-        }
+        glmApplyMaterial(model, mode, group->material);
         
         glBegin(GL_TRIANGLES);
         for (i = 0; i < group->numtriangles; i++) {
@@ -1778,6 +2710,236 @@ GLuint glmList(GLMmodel* model, GLuint mode){
     return list;
 }
 
+/* glmHasVertexArrays: can vertex array objects be used in the current
+ * context?  (GL 3.0 or ARB_vertex_array_object)
+ */
+static GLboolean glmHasVertexArrays(){
+    const char* version = (const char*)glGetString(GL_VERSION);
+    const char* extensions = (const char*)glGetString(GL_EXTENSIONS);
+    if (version && atoi(version) >= 3)
+        return GL_TRUE;
+    return extensions && strstr(extensions, "GL_ARB_vertex_array_object") ? GL_TRUE : GL_FALSE;
+}
+
+/* glmMeshKey: hash of a vertex/normal/texcoord index triplet */
+static inline GLuint glmMeshKey(GLuint v, GLuint n, GLuint t){
+    GLuint h = v * 73856093u ^ n * 19349663u ^ t * 83492791u;
+    return h * 2654435761u;
+}
+
+/* glmBindMeshArrays: point the fixed-function vertex arrays at the
+ * vertex buffer of a mesh (and remember them in its VAO, if bound).
+ */
+static GLvoid glmBindMeshArrays(GLMmesh* mesh){
+    const char* offset = 0;
+    glBindBuffer(GL_ARRAY_BUFFER, mesh->vbo);
+    glEnableClientState(GL_VERTEX_ARRAY);
+    glVertexPointer(3, GL_FLOAT, mesh->stride, offset);
+    offset += 3 * sizeof(GLfloat);
+    if (mesh->mode & (GLM_FLAT | GLM_SMOOTH)) {
+        glEnableClientState(GL_NORMAL_ARRAY);
+        glNormalPointer(GL_FLOAT, mesh->stride, offset);
+        offset += 3 * sizeof(GLfloat);
+    }
+    if (mesh->mode & GLM_TEXTURE) {
+        glEnableClientState(GL_TEXTURE_COORD_ARRAY);
+        glTexCoordPointer(2, GL_FLOAT, mesh->stride, offset);
+    }
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, mesh->ibo);
+}
+
+/* glmBuildMesh: Uploads the model into vertex and index buffers for
+ * drawing with glmDrawMesh().  Corners of the triangles that share a
+ * vertex, normal and texcoord are merged into one vertex (with an
+ * open-addressing hash on the index triplet), and indices are 16 bit
+ * whenever the vertex count allows it.  Returns a mesh that should be
+ * free'd with glmDeleteMesh().
+ *
+ * model - initialized GLMmodel structure
+ * mode  - a bitwise OR of values describing what is to be rendered.
+ *             GLM_NONE     -  render with only vertices
+ *             GLM_FLAT     -  render with facet normals
+ *             GLM_SMOOTH   -  render with vertex normals
+ *             GLM_TEXTURE  -  render with texture coords
+ *             GLM_COLOR    -  render with colors (color material)
+ *             GLM_MATERIAL -  render with materials
+ *             GLM_COLOR and GLM_MATERIAL should not both be specified.
+ *             GLM_FLAT and GLM_SMOOTH should not both be specified.
+ */
+GLMmesh* glmBuildMesh(GLMmodel* model, GLuint mode){
+    GLMmesh* mesh;
+    GLMgroup* group;
+    GLMtriangle* triangle;
+    GLuint* keys;                 /* v, n, t of each distinct vertex */
+    GLuint* slots;                /* hash table of vertex numbers + 1 */
+    GLuint* indices;
+    GLfloat* vertices;
+    GLfloat* dst;
+    GLuint numcorners, capacity, mask, numfloats;
+    GLuint i, j, k, v, n, t, slot;
+
+    assert(model);
+    assert(model->vertices);
+    mode = glmCheckMode(model, mode);
+
+    mesh = (GLMmesh*)malloc(sizeof(GLMmesh));
+    mesh->mode = mode;
+    mesh->vao = 0;
+    mesh->numvertices = 0;
+    mesh->numindices = 0;
+    mesh->numranges = model->numgroups;
+    mesh->ranges = (GLMmeshrange*)malloc(sizeof(GLMmeshrange) * (model->numgroups + 1));
+    numfloats = 3;
+    if (mode & (GLM_FLAT | GLM_SMOOTH))
+        numfloats += 3;
+    if (mode & GLM_TEXTURE)
+        numfloats += 2;
+    mesh->stride = numfloats * sizeof(GLfloat);
+
+    numcorners = 0;
+    for (group = model->groups; group; group = group->next)
+        numcorners += 3 * group->numtriangles;
+    capacity = 16;
+    while (capacity < 2 * numcorners)
+        capacity *= 2;
+    mask = capacity - 1;
+    slots = (GLuint*)calloc(capacity, sizeof(GLuint));
+    keys = (GLuint*)malloc(sizeof(GLuint) * 3 * (numcorners + 1));
+    indices = (GLuint*)malloc(sizeof(GLuint) * (numcorners + 1));
+    vertices = (GLfloat*)malloc(sizeof(GLfloat) * numfloats * (numcorners + 1));
+
+    /* merge the corners into distinct vertices, group by group */
+    for (group = model->groups, k = 0; group; group = group->next, k++) {
+        mesh->ranges[k].first = mesh->numindices;
+        mesh->ranges[k].material = group->material;
+        for (i = 0; i < group->numtriangles; i++) {
+            triangle = &T(group->triangles[i]);
+            for (j = 0; j < 3; j++) {
+                v = triangle->vindices[j];
+                n = mode & GLM_FLAT ? triangle->findex :
+                    mode & GLM_SMOOTH ? triangle->nindices[j] : 0;
+                t = mode & GLM_TEXTURE ? triangle->tindices[j] : 0;
+                slot = glmMeshKey(v, n, t) & mask;
+                while (slots[slot]) {
+                    GLuint* key = &keys[3 * (slots[slot] - 1)];
+                    if (key[0] == v && key[1] == n && key[2] == t)
+                        break;
+                    slot = (slot + 1) & mask;
+                }
+                if (!slots[slot]) {
+                    keys[3 * mesh->numvertices + 0] = v;
+                    keys[3 * mesh->numvertices + 1] = n;
+                    keys[3 * mesh->numvertices + 2] = t;
+                    dst = &vertices[numfloats * mesh->numvertices];
+                    memcpy(dst, &model->vertices[3 * v], 3 * sizeof(GLfloat));
+                    dst += 3;
+                    if (mode & GLM_FLAT) {
+                        memcpy(dst, &model->facetnorms[3 * n], 3 * sizeof(GLfloat));
+                        dst += 3;
+                    } else if (mode & GLM_SMOOTH) {
+                        memcpy(dst, &model->normals[3 * n], 3 * sizeof(GLfloat));
+                        dst += 3;
+                    }
+                    if (mode & GLM_TEXTURE)
+                        memcpy(dst, &model->texcoords[2 * t], 2 * sizeof(GLfloat));
+                    slots[slot] = ++mesh->numvertices;
+                }
+                indices[mesh->numindices++] = slots[slot] - 1;
+            }
+        }
+        mesh->ranges[k].count = mesh->numindices - mesh->ranges[k].first;
+    }
+    free(slots);
+    free(keys);
+
+    /* upload, packing the indices down to 16 bits when they fit */
+    glGenBuffers(1, &mesh->vbo);
+    glBindBuffer(GL_ARRAY_BUFFER, mesh->vbo);
+    glBufferData(GL_ARRAY_BUFFER, mesh->stride * mesh->numvertices, vertices, GL_STATIC_DRAW);
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+    free(vertices);
+
+    glGenBuffers(1, &mesh->ibo);
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, mesh->ibo);
+    if (mesh->numvertices <= 65536) {
+        GLushort* shorts = (GLushort*)indices;
+        for (i = 0; i < mesh->numindices; i++)
+            shorts[i] = (GLushort)indices[i];
+        mesh->indextype = GL_UNSIGNED_SHORT;
+        glBufferData(GL_ELEMENT_ARRAY_BUFFER, sizeof(GLushort) * mesh->numindices, shorts, GL_STATIC_DRAW);
+    } else {
+        mesh->indextype = GL_UNSIGNED_INT;
+        glBufferData(GL_ELEMENT_ARRAY_BUFFER, sizeof(GLuint) * mesh->numindices, indices, GL_STATIC_DRAW);
+    }
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
+    free(indices);
+
+    /* record the array setup once if the context can */
+    if (glmHasVertexArrays()) {
+        glGenVertexArrays(1, &mesh->vao);
+        glBindVertexArray(mesh->vao);
+        glmBindMeshArrays(mesh);
+        glBindVertexArray(0);
+        glBindBuffer(GL_ARRAY_BUFFER, 0);
+    }
+    return mesh;
+}
+
+/* glmDrawMesh: Renders a mesh built by glmBuildMesh() to the current
+ * OpenGL context, one glDrawElements() call per group.
+ *
+ * model - the GLMmodel the mesh was built from (for its materials)
+ * mesh  - mesh returned by glmBuildMesh()
+ */
+GLvoid glmDrawMesh(GLMmodel* model, GLMmesh* mesh){
+    GLuint i, size;
+    assert(model);
+    assert(mesh);
+    if (mesh->mode & GLM_COLOR)
+        glEnable(GL_COLOR_MATERIAL);
+    else if (mesh->mode & GLM_MATERIAL)
+        glDisable(GL_COLOR_MATERIAL);
+    if (mesh->mode & GLM_TEXTURE) {
+        glEnable(GL_TEXTURE_2D);
+        glTexEnvf(GL_TEXTURE_ENV, GL_TEXTURE_ENV_MODE, GL_MODULATE);
+    }
+    if (mesh->vao)
+        glBindVertexArray(mesh->vao);
+    else
+        glmBindMeshArrays(mesh);
+    size = mesh->indextype == GL_UNSIGNED_SHORT ? sizeof(GLushort) : sizeof(GLuint);
+    for (i = 0; i < mesh->numranges; i++) {
+        if (!mesh->ranges[i].count)
+            continue;
+        glmApplyMaterial(model, mesh->mode, mesh->ranges[i].material);
+        glDrawElements(GL_TRIANGLES, mesh->ranges[i].count, mesh->indextype,
+                       (const char*)0 + size * mesh->ranges[i].first);
+    }
+    if (mesh->vao) {
+        glBindVertexArray(0);
+    } else {
+        glDisableClientState(GL_VERTEX_ARRAY);
+        glDisableClientState(GL_NORMAL_ARRAY);
+        glDisableClientState(GL_TEXTURE_COORD_ARRAY);
+        glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
+    }
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+}
+
+/* glmDeleteMesh: Deletes the buffers of a mesh and the mesh itself.
+ *
+ * mesh - mesh returned by glmBuildMesh()
+ */
+GLvoid glmDeleteMesh(GLMmesh* mesh){
+    assert(mesh);
+    if (mesh->vao)
+        glDeleteVertexArrays(1, &mesh->vao);
+    glDeleteBuffers(1, &mesh->vbo);
+    glDeleteBuffers(1, &mesh->ibo);
+    free(mesh->ranges);
+    free(mesh);
+}
+
 /* glmWeld: eliminate (weld) vectors that are within an epsilon of
  * each other.
  *
@@ -1809,21 +2971,12 @@ GLvoid  glmWeld(GLMmodel* model, GLfloat epsilon){
     }
     
     /* free space for old vertices */
-    free(vectors);
+    glmFreeArray(model, vectors);
     
-    /* allocate space for the new vertices */
+    /* the optimized vertices become the actual vertex list */
     model->numvertices = numvectors;
-    model->vertices = (GLfloat*)malloc(sizeof(GLfloat) * 
-                                       3 * (model->numvertices + 1));
-    
-    /* copy the optimized vertices into the actual vertex list */
-    for (i = 1; i <= model->numvertices; i++) {
-        model->vertices[3 * i + 0] = copies[3 * i + 0];
-        model->vertices[3 * i + 1] = copies[3 * i + 1];
-        model->vertices[3 * i + 2] = copies[3 * i + 2];
-    }
-    
-    free(copies);
+    model->vertices = (GLfloat*)realloc(copies, sizeof(GLfloat) * 
+                                        3 * (model->numvertices + 1));
 }
 
 /* glmReadPPM: read a PPM raw (type P6) file.  The PPM file has a header
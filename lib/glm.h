@@ -90,8 +90,46 @@ typedef struct _GLMmodel {
 
     GLfloat position[3];          /* position of the model */
 
+    GLvoid*  mapped;              /* cache file the arrays may point into */
+    size_t   mappedsize;          /* size of the mapped cache */
+
 } GLMmodel;
 
+/* GLMadjacency: Structure that lists the triangles around each vertex
+ * of a model, packed into a single array.
+ */
+typedef struct _GLMadjacency {
+    GLuint  numvertices;          /* number of vertices in model */
+    GLuint* offsets;              /* start of the list of each vertex (numvertices + 2) */
+    GLuint* triangles;            /* triangle indices of all the lists */
+} GLMadjacency;
+
+/* GLMmeshrange: Structure that defines the indices of one group in a
+ * mesh.
+ */
+typedef struct _GLMmeshrange {
+    GLuint first;                 /* first index of the range */
+    GLuint count;                 /* number of indices in the range */
+    GLuint material;              /* index to material for range */
+} GLMmeshrange;
+
+/* GLMmesh: Structure that defines a model uploaded to the GPU: an
+ * interleaved vertex buffer holding each distinct vertex/normal/texcoord
+ * combination once, an index buffer and one range per group.
+ */
+typedef struct _GLMmesh {
+    GLuint   mode;                /* attributes in the vertex buffer */
+    GLuint   vao;                 /* vertex array object (0 if unsupported) */
+    GLuint   vbo;                 /* interleaved vertex buffer */
+    GLuint   ibo;                 /* index buffer */
+    GLsizei  stride;              /* size of one vertex in bytes */
+    GLenum   indextype;           /* GL_UNSIGNED_SHORT or GL_UNSIGNED_INT */
+    GLuint   numvertices;         /* number of distinct vertices */
+    GLuint   numindices;          /* number of indices (3 per triangle) */
+    GLuint   numranges;           /* number of ranges in mesh */
+    GLMmeshrange* ranges;         /* array of ranges, in group order */
+} GLMmesh;
+
 struct mycallback
 {
     void (*loadcallback)(int,char *);
@@ -143,6 +181,21 @@ GLvoid glmReverseWinding(GLMmodel* model);
  */
 GLvoid glmFacetNormals(GLMmodel* model);
 
+/* glmBuildAdjacency: Builds the vertex-to-triangle adjacency of a
+ * model in compressed (CSR) form.  The triangles around vertex i are
+ * triangles[offsets[i]] up to triangles[offsets[i + 1]], in decreasing
+ * triangle order, once per corner.  Free it with glmDeleteAdjacency().
+ *
+ * model - initialized GLMmodel structure
+ */
+GLMadjacency* glmBuildAdjacency(GLMmodel* model);
+
+/* glmDeleteAdjacency: Deletes an adjacency built by glmBuildAdjacency().
+ *
+ * adjacency - adjacency returned by glmBuildAdjacency()
+ */
+GLvoid glmDeleteAdjacency(GLMadjacency* adjacency);
+
 /* glmVertexNormals: Generates smooth vertex normals for a model.
  * First builds a list of all the triangles each vertex is in.  Then
  * loops through each vertex in the the list averaging all the facet
@@ -190,7 +243,8 @@ GLvoid glmDelete(GLMmodel* model);
 
 /* glmReadOBJ: Reads a model description from a Wavefront .OBJ file.
  * Returns a pointer to the created object which should be free'd with
- * glmDelete().
+ * glmDelete().  The file is mapped into memory and parsed in a single
+ * pass.
  *
  * filename - name of the file containing the Wavefront .OBJ format data.  
  */
@@ -198,6 +252,36 @@ GLvoid glmDelete(GLMmodel* model);
 GLMmodel* glmReadOBJ(const char* filename);
 GLMmodel* glmReadOBJ(const char* filename,mycallback *call);
 
+/* glmReadOBJParallel: Reads a model description from a Wavefront .OBJ
+ * file like glmReadOBJ, but splits the mapped file into newline-aligned
+ * chunks that are parsed on separate threads and then merged.
+ *
+ * filename   - name of the file containing the Wavefront .OBJ format data.
+ * numthreads - number of chunks to parse at once (0 = one per processor)
+ */
+GLMmodel* glmReadOBJParallel(const char* filename, GLuint numthreads);
+
+/* glmReadCache: Reads a model from a binary cache written by
+ * glmWriteCache().  The arrays of the model point straight into the
+ * mapped cache.  Returns NULL if the cache is missing, corrupt or out
+ * of date with respect to its source file.  Free the model with
+ * glmDelete().
+ *
+ * filename - name of the cache file
+ * source   - name of the .obj file the cache was built from
+ */
+GLMmodel* glmReadCache(const char* filename, const char* source);
+
+/* glmWriteCache: Writes a model to a binary cache, stamped with the
+ * size, modification time and contents hash of its source file.
+ * Returns GL_FALSE if the cache can't be written.
+ *
+ * model    - initialized GLMmodel structure
+ * filename - name of the cache file
+ * source   - name of the .obj file the model was read from
+ */
+GLboolean glmWriteCache(GLMmodel* model, const char* filename, const char* source);
+
 /* glmWriteOBJ: Writes a model description in Wavefront .OBJ format to
  * a file.
  *
@@ -238,6 +322,39 @@ GLvoid glmDraw(GLMmodel* model, GLuint mode);
  */
 GLuint glmList(GLMmodel* model, GLuint mode);
 
+/* glmBuildMesh: Uploads the model into vertex and index buffers for
+ * drawing with glmDrawMesh().  Corners of the triangles that share a
+ * vertex, normal and texcoord are merged into one vertex, and indices
+ * are 16 bit whenever the vertex count allows it.  Returns a mesh that
+ * should be free'd with glmDeleteMesh().
+ *
+ * model - initialized GLMmodel structure
+ * mode  - a bitwise OR of values describing what is to be rendered.
+ *             GLM_NONE     -  render with only vertices
+ *             GLM_FLAT     -  render with facet normals
+ *             GLM_SMOOTH   -  render with vertex normals
+ *             GLM_TEXTURE  -  render with texture coords
+ *             GLM_COLOR    -  render with colors (color material)
+ *             GLM_MATERIAL -  render with materials
+ *             GLM_COLOR and GLM_MATERIAL should not both be specified.
+ *             GLM_FLAT and GLM_SMOOTH should not both be specified.
+ */
+GLMmesh* glmBuildMesh(GLMmodel* model, GLuint mode);
+
+/* glmDrawMesh: Renders a mesh built by glmBuildMesh() to the current
+ * OpenGL context, one glDrawElements() call per group.
+ *
+ * model - the GLMmodel the mesh was built from (for its materials)
+ * mesh  - mesh returned by glmBuildMesh()
+ */
+GLvoid glmDrawMesh(GLMmodel* model, GLMmesh* mesh);
+
+/* glmDeleteMesh: Deletes the buffers of a mesh and the mesh itself.
+ *
+ * mesh - mesh returned by glmBuildMesh()
+ */
+GLvoid glmDeleteMesh(GLMmesh* mesh);
+
 /* glmWeld: eliminate (weld) vectors that are within an epsilon of
  * each other.
  *
@@ -0,0 +1,255 @@
+/*
+      meshmath.cpp
+
+      Scalar and AVX2 versions of the batch routines declared in
+      meshmath.h.  The AVX2 versions work on 8 vectors at a time: packed
+      xyz data is handled as three registers whose lanes repeat the
+      x, y, z pattern, and triangles are gathered into separate x, y and
+      z registers.
+*/
+
+#include "meshmath.h"
+#include <math.h>
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define MESHMATH_X86 1
+#include <immintrin.h>
+#define MESHMATH_AVX2 __attribute__((target("avx2")))
+#endif
+
+static int g_simd = -1;             /* -1 = not decided yet */
+
+/* meshmathCanUseSIMD: does the processor run AVX2 code? */
+static int meshmathCanUseSIMD()
+{
+#ifdef MESHMATH_X86
+    __builtin_cpu_init();
+    return __builtin_cpu_supports("avx2") ? 1 : 0;
+#else
+    return 0;
+#endif
+}
+
+int meshmathHasSIMD()
+{
+    if (g_simd < 0)
+        g_simd = meshmathCanUseSIMD();
+    return g_simd;
+}
+
+int meshmathSetSIMD(int enable)
+{
+    g_simd = enable ? meshmathCanUseSIMD() : 0;
+    return g_simd;
+}
+
+/* ---- scalar versions ---- */
+
+static void meshmathBoundsScalar(const float* xyz, unsigned count, float* min, float* max)
+{
+    float minx = min[0], miny = min[1], minz = min[2];
+    float maxx = max[0], maxy = max[1], maxz = max[2];
+    unsigned i;
+    for (i = 0; i < count; i++, xyz += 3) {
+        if (maxx < xyz[0])
+            maxx = xyz[0];
+        if (minx > xyz[0])
+            minx = xyz[0];
+        if (maxy < xyz[1])
+            maxy = xyz[1];
+        if (miny > xyz[1])
+            miny = xyz[1];
+        if (maxz < xyz[2])
+            maxz = xyz[2];
+        if (minz > xyz[2])
+            minz = xyz[2];
+    }
+    min[0] = minx; min[1] = miny; min[2] = minz;
+    max[0] = maxx; max[1] = maxy; max[2] = maxz;
+}
+
+static void meshmathTransformScalar(float* xyz, unsigned count, const float* offset, float scale)
+{
+    float x = offset[0], y = offset[1], z = offset[2];
+    unsigned i;
+    for (i = 0; i < count; i++, xyz += 3) {
+        xyz[0] = (xyz[0] - x) * scale;
+        xyz[1] = (xyz[1] - y) * scale;
+        xyz[2] = (xyz[2] - z) * scale;
+    }
+}
+
+static void meshmathFacetNormalsScalar(const float* vertices, const unsigned* vindices, unsigned stride,
+                                       unsigned count, float* normals)
+{
+    const float *p0, *p1, *p2;
+    float u[3], v[3], l;
+    float* n;
+    unsigned i;
+    for (i = 0; i < count; i++, vindices += stride) {
+        p0 = &vertices[3 * vindices[0]];
+        p1 = &vertices[3 * vindices[1]];
+        p2 = &vertices[3 * vindices[2]];
+        u[0] = p1[0] - p0[0];
+        u[1] = p1[1] - p0[1];
+        u[2] = p1[2] - p0[2];
+        v[0] = p2[0] - p0[0];
+        v[1] = p2[1] - p0[1];
+        v[2] = p2[2] - p0[2];
+        n = &normals[3 * i];
+        n[0] = u[1]*v[2] - u[2]*v[1];
+        n[1] = u[2]*v[0] - u[0]*v[2];
+        n[2] = u[0]*v[1] - u[1]*v[0];
+        l = (float)sqrt(n[0]*n[0] + n[1]*n[1] + n[2]*n[2]);
+        n[0] /= l;
+        n[1] /= l;
+        n[2] /= l;
+    }
+}
+
+/* ---- AVX2 versions ---- */
+
+#ifdef MESHMATH_X86
+
+MESHMATH_AVX2
+static void meshmathBoundsAVX2(const float* xyz, unsigned count, float* min, float* max)
+{
+    /* lane j of register r holds component (8 * r + j) % 3; the new
+       value goes first so a NaN is skipped like the scalar compare does */
+    __m256 mn0 = _mm256_setr_ps(min[0], min[1], min[2], min[0], min[1], min[2], min[0], min[1]);
+    __m256 mn1 = _mm256_setr_ps(min[2], min[0], min[1], min[2], min[0], min[1], min[2], min[0]);
+    __m256 mn2 = _mm256_setr_ps(min[1], min[2], min[0], min[1], min[2], min[0], min[1], min[2]);
+    __m256 mx0 = _mm256_setr_ps(max[0], max[1], max[2], max[0], max[1], max[2], max[0], max[1]);
+    __m256 mx1 = _mm256_setr_ps(max[2], max[0], max[1], max[2], max[0], max[1], max[2], max[0]);
+    __m256 mx2 = _mm256_setr_ps(max[1], max[2], max[0], max[1], max[2], max[0], max[1], max[2]);
+    float lanes[6][8];
+    unsigned i, j;
+    for (i = 0; i + 8 <= count; i += 8) {
+        __m256 a = _mm256_loadu_ps(&xyz[3 * i + 0]);
+        __m256 b = _mm256_loadu_ps(&xyz[3 * i + 8]);
+        __m256 c = _mm256_loadu_ps(&xyz[3 * i + 16]);
+        mn0 = _mm256_min_ps(a, mn0);
+        mn1 = _mm256_min_ps(b, mn1);
+        mn2 = _mm256_min_ps(c, mn2);
+        mx0 = _mm256_max_ps(a, mx0);
+        mx1 = _mm256_max_ps(b, mx1);
+        mx2 = _mm256_max_ps(c, mx2);
+    }
+    _mm256_storeu_ps(lanes[0], mn0);
+    _mm256_storeu_ps(lanes[1], mn1);
+    _mm256_storeu_ps(lanes[2], mn2);
+    _mm256_storeu_ps(lanes[3], mx0);
+    _mm256_storeu_ps(lanes[4], mx1);
+    _mm256_storeu_ps(lanes[5], mx2);
+    for (j = 0; j < 24; j++) {
+        if (min[j % 3] > lanes[j / 8][j % 8])
+            min[j % 3] = lanes[j / 8][j % 8];
+        if (max[j % 3] < lanes[3 + j / 8][j % 8])
+            max[j % 3] = lanes[3 + j / 8][j % 8];
+    }
+    meshmathBoundsScalar(&xyz[3 * i], count - i, min, max);
+}
+
+MESHMATH_AVX2
+static void meshmathTransformAVX2(float* xyz, unsigned count, const float* offset, float scale)
+{
+    __m256 o0 = _mm256_setr_ps(offset[0], offset[1], offset[2], offset[0],
+                               offset[1], offset[2], offset[0], offset[1]);
+    __m256 o1 = _mm256_setr_ps(offset[2], offset[0], offset[1], offset[2],
+                               offset[0], offset[1], offset[2], offset[0]);
+    __m256 o2 = _mm256_setr_ps(offset[1], offset[2], offset[0], offset[1],
+                               offset[2], offset[0], offset[1], offset[2]);
+    __m256 s = _mm256_set1_ps(scale);
+    unsigned i;
+    for (i = 0; i + 8 <= count; i += 8) {
+        float* p = &xyz[3 * i];
+        _mm256_storeu_ps(p + 0,  _mm256_mul_ps(_mm256_sub_ps(_mm256_loadu_ps(p + 0),  o0), s));
+        _mm256_storeu_ps(p + 8,  _mm256_mul_ps(_mm256_sub_ps(_mm256_loadu_ps(p + 8),  o1), s));
+        _mm256_storeu_ps(p + 16, _mm256_mul_ps(_mm256_sub_ps(_mm256_loadu_ps(p + 16), o2), s));
+    }
+    meshmathTransformScalar(&xyz[3 * i], count - i, offset, scale);
+}
+
+MESHMATH_AVX2
+static void meshmathFacetNormalsAVX2(const float* vertices, const unsigned* vindices, unsigned stride,
+                                     unsigned count, float* normals)
+{
+    const __m256i lanes = _mm256_mullo_epi32(_mm256_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7),
+                                             _mm256_set1_epi32(stride));
+    const __m256i three = _mm256_set1_epi32(3);
+    float nx[8], ny[8], nz[8];
+    unsigned i, j;
+    for (i = 0; i + 8 <= count; i += 8) {
+        const int* t = (const int*)&vindices[(size_t)i * stride];
+        __m256i i0 = _mm256_mullo_epi32(_mm256_i32gather_epi32(t + 0, lanes, 4), three);
+        __m256i i1 = _mm256_mullo_epi32(_mm256_i32gather_epi32(t + 1, lanes, 4), three);
+        __m256i i2 = _mm256_mullo_epi32(_mm256_i32gather_epi32(t + 2, lanes, 4), three);
+        __m256 x0 = _mm256_i32gather_ps(vertices + 0, i0, 4);
+        __m256 y0 = _mm256_i32gather_ps(vertices + 1, i0, 4);
+        __m256 z0 = _mm256_i32gather_ps(vertices + 2, i0, 4);
+        __m256 ux = _mm256_sub_ps(_mm256_i32gather_ps(vertices + 0, i1, 4), x0);
+        __m256 uy = _mm256_sub_ps(_mm256_i32gather_ps(vertices + 1, i1, 4), y0);
+        __m256 uz = _mm256_sub_ps(_mm256_i32gather_ps(vertices + 2, i1, 4), z0);
+        __m256 vx = _mm256_sub_ps(_mm256_i32gather_ps(vertices + 0, i2, 4), x0);
+        __m256 vy = _mm256_sub_ps(_mm256_i32gather_ps(vertices + 1, i2, 4), y0);
+        __m256 vz = _mm256_sub_ps(_mm256_i32gather_ps(vertices + 2, i2, 4), z0);
+        __m256 cx = _mm256_sub_ps(_mm256_mul_ps(uy, vz), _mm256_mul_ps(uz, vy));
+        __m256 cy = _mm256_sub_ps(_mm256_mul_ps(uz, vx), _mm256_mul_ps(ux, vz));
+        __m256 cz = _mm256_sub_ps(_mm256_mul_ps(ux, vy), _mm256_mul_ps(uy, vx));
+        __m256 l = _mm256_sqrt_ps(_mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(cx, cx),
+                                                              _mm256_mul_ps(cy, cy)),
+                                                _mm256_mul_ps(cz, cz)));
+        _mm256_storeu_ps(nx, _mm256_div_ps(cx, l));
+        _mm256_storeu_ps(ny, _mm256_div_ps(cy, l));
+        _mm256_storeu_ps(nz, _mm256_div_ps(cz, l));
+        for (j = 0; j < 8; j++) {
+            normals[3 * (i + j) + 0] = nx[j];
+            normals[3 * (i + j) + 1] = ny[j];
+            normals[3 * (i + j) + 2] = nz[j];
+        }
+    }
+    meshmathFacetNormalsScalar(vertices, &vindices[(size_t)i * stride], stride, count - i, &normals[3 * i]);
+}
+
+#endif // MESHMATH_X86
+
+/* ---- dispatch ---- */
+
+void meshmathBounds(const float* xyz, unsigned count, float* min, float* max)
+{
+    unsigned c;
+    if (!count)
+        return;
+    for (c = 0; c < 3; c++)
+        min[c] = max[c] = xyz[c];
+#ifdef MESHMATH_X86
+    if (meshmathHasSIMD()) {
+        meshmathBoundsAVX2(xyz, count, min, max);
+        return;
+    }
+#endif
+    meshmathBoundsScalar(xyz, count, min, max);
+}
+
+void meshmathTransform(float* xyz, unsigned count, const float* offset, float scale)
+{
+#ifdef MESHMATH_X86
+    if (meshmathHasSIMD()) {
+        meshmathTransformAVX2(xyz, count, offset, scale);
+        return;
+    }
+#endif
+    meshmathTransformScalar(xyz, count, offset, scale);
+}
+
+void meshmathFacetNormals(const float* vertices, const unsigned* vindices, unsigned stride,
+                          unsigned count, float* normals)
+{
+#ifdef MESHMATH_X86
+    if (meshmathHasSIMD()) {
+        meshmathFacetNormalsAVX2(vertices, vindices, stride, count, normals);
+        return;
+    }
+#endif
+    meshmathFacetNormalsScalar(vertices, vindices, stride, count, normals);
+}
@@ -0,0 +1,58 @@
+#ifndef MESHMATH_H
+#define MESHMATH_H
+
+/*
+      meshmath.h
+
+      Batch math over the packed xyz arrays of a GLMmodel: bounding
+      boxes, translate+scale and facet normals.  Each routine has a
+      plain scalar version and an AVX2 version; the AVX2 one is picked at
+      runtime when the processor supports it.  Both give bit-identical
+      results (no fused multiply-adds, IEEE sqrt and division; only the
+      sign of a zero bound may differ), so switching between them does
+      not change a model.
+*/
+
+/* meshmathHasSIMD: returns nonzero if the AVX2 routines are in use */
+int meshmathHasSIMD();
+
+/* meshmathSetSIMD: turns the AVX2 routines on (if the processor
+ * supports them) or off.  Returns nonzero if they are in use afterwards.
+ */
+int meshmathSetSIMD(int enable);
+
+/* meshmathBounds: computes the bounding box of count xyz vectors.
+ * Leaves min and max untouched if count is 0.
+ *
+ * xyz   - packed array of count GLfloat[3]'s
+ * count - number of vectors
+ * min   - receives the smallest x, y and z
+ * max   - receives the largest x, y and z
+ */
+void meshmathBounds(const float* xyz, unsigned count, float* min, float* max);
+
+/* meshmathTransform: replaces every vector v by (v - offset) * scale,
+ * rounding after the subtraction and after the multiplication like
+ * the two separate steps would.
+ *
+ * xyz    - packed array of count GLfloat[3]'s
+ * count  - number of vectors
+ * offset - GLfloat[3] subtracted from every vector
+ * scale  - factor every vector is multiplied by afterwards
+ */
+void meshmathTransform(float* xyz, unsigned count, const float* offset, float scale);
+
+/* meshmathFacetNormals: computes the unit normal of count triangles,
+ * normalize(cross(v1 - v0, v2 - v0)).
+ *
+ * vertices - vertex array the indices point into (vertex i at [3 * i])
+ * vindices - first triangle's three vertex indices
+ * stride   - distance between the vindices of consecutive triangles,
+ *            in unsigned ints
+ * count    - number of triangles
+ * normals  - receives count packed GLfloat[3]'s
+ */
+void meshmathFacetNormals(const float* vertices, const unsigned* vindices, unsigned stride,
+                          unsigned count, float* normals);
+
+#endif // MESHMATH_H
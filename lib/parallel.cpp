@@ -0,0 +1,126 @@
+/*
+      parallel.cpp
+
+      pthread implementation of the worker pool declared in parallel.h.
+*/
+
+#include "parallel.h"
+#include <pthread.h>
+#include <unistd.h>
+
+#define PARALLEL_MAX_THREADS 64
+
+static pthread_mutex_t g_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t  g_wake = PTHREAD_COND_INITIALIZER;
+static pthread_cond_t  g_done = PTHREAD_COND_INITIALIZER;
+static pthread_t       g_workers[PARALLEL_MAX_THREADS];
+static int             g_numworkers = 0;    /* workers started so far */
+static int             g_numthreads = 0;    /* requested thread count, 0 = auto */
+static int             g_busy = 0;          /* a job is running */
+
+/* the job currently being run */
+static parallelTask    g_task = 0;
+static void*           g_arg = 0;
+static int             g_count = 0;
+static volatile int    g_next = 0;          /* next index to hand out */
+static int             g_jobworkers = 0;    /* workers taking part in the job */
+static int             g_active = 0;        /* workers still inside the job */
+static unsigned        g_generation = 0;    /* bumped for every job */
+
+static __thread int    t_inside = 0;        /* this thread is running a task */
+
+/* parallelRun: hand out indices of the current job until none are left */
+static void parallelRun(parallelTask task, void* arg, int count)
+{
+    int i;
+    t_inside = 1;
+    while ((i = __sync_fetch_and_add(&g_next, 1)) < count)
+        task(i, arg);
+    t_inside = 0;
+}
+
+static void* parallelWorker(void* id)
+{
+    unsigned seen = 0;
+    pthread_mutex_lock(&g_lock);
+    for (;;) {
+        while (g_generation == seen)
+            pthread_cond_wait(&g_wake, &g_lock);
+        seen = g_generation;
+        if ((long)id >= g_jobworkers)
+            continue;
+        parallelTask task = g_task;
+        void* arg = g_arg;
+        int count = g_count;
+        pthread_mutex_unlock(&g_lock);
+
+        parallelRun(task, arg, count);
+
+        pthread_mutex_lock(&g_lock);
+        if (--g_active == 0)
+            pthread_cond_signal(&g_done);
+    }
+    return 0;
+}
+
+int parallelNumThreads()
+{
+    int n = g_numthreads;
+    if (n <= 0)
+        n = (int)sysconf(_SC_NPROCESSORS_ONLN);
+    if (n < 1)
+        n = 1;
+    if (n > PARALLEL_MAX_THREADS + 1)
+        n = PARALLEL_MAX_THREADS + 1;
+    return n;
+}
+
+void parallelSetNumThreads(int numthreads)
+{
+    pthread_mutex_lock(&g_lock);
+    g_numthreads = numthreads;
+    pthread_mutex_unlock(&g_lock);
+}
+
+void parallelFor(int count, parallelTask task, void* arg)
+{
+    int i, numworkers;
+    if (count <= 0)
+        return;
+    numworkers = parallelNumThreads() - 1;
+    if (numworkers > count - 1)
+        numworkers = count - 1;
+
+    pthread_mutex_lock(&g_lock);
+    if (t_inside || g_busy || numworkers <= 0) {
+        /* nested call, another job in flight or nothing to spread */
+        pthread_mutex_unlock(&g_lock);
+        for (i = 0; i < count; i++)
+            task(i, arg);
+        return;
+    }
+    while (g_numworkers < numworkers) {
+        if (pthread_create(&g_workers[g_numworkers], 0, parallelWorker, (void*)(long)g_numworkers) != 0)
+            break;
+        pthread_detach(g_workers[g_numworkers]);
+        g_numworkers++;
+    }
+    g_busy = 1;
+    g_task = task;
+    g_arg = arg;
+    g_count = count;
+    g_next = 0;
+    g_jobworkers = numworkers < g_numworkers ? numworkers : g_numworkers;
+    g_active = g_jobworkers;
+    g_generation++;
+    pthread_cond_broadcast(&g_wake);
+    pthread_mutex_unlock(&g_lock);
+
+    parallelRun(task, arg, count);
+
+    pthread_mutex_lock(&g_lock);
+    while (g_active > 0)
+        pthread_cond_wait(&g_done, &g_lock);
+    g_busy = 0;
+    pthread_mutex_unlock(&g_lock);
+}
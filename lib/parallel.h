@@ -0,0 +1,37 @@
+#ifndef PARALLEL_H
+#define PARALLEL_H
+
+/*
+      parallel.h
+
+      A small pool of worker threads shared by the loaders and image
+      routines.  The pool is started the first time it is used and runs
+      one job at a time; a job is a task function called once for every
+      index in [0, count).
+*/
+
+/* parallelTask: work item run by parallelFor for a single index */
+typedef void (*parallelTask)(int index, void* arg);
+
+/* parallelNumThreads: returns the number of threads a job is spread
+ * over (the calling thread plus the pool workers).
+ */
+int parallelNumThreads();
+
+/* parallelSetNumThreads: limits the number of threads used by later
+ * jobs.  Zero means one thread per online processor.
+ */
+void parallelSetNumThreads(int numthreads);
+
+/* parallelFor: calls task(i, arg) for every i in [0, count) spread over
+ * the pool and waits for all of them to finish.  The calling thread
+ * takes part in the work.  Calls made from inside a task, or while
+ * another thread's job is running, simply run serially.
+ *
+ * count - number of indices to run
+ * task  - function to call for each index
+ * arg   - passed through to task
+ */
+void parallelFor(int count, parallelTask task, void* arg);
+
+#endif // PARALLEL_H
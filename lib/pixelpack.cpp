@@ -0,0 +1,188 @@
+/*
+      pixelpack.cpp
+
+      Scalar and AVX2/F16C versions of the routines declared in
+      pixelpack.h.  The scalar versions round in integer arithmetic on
+      the float's bits; the half float conversion instruction rounds the
+      same way, and the 11 and 10 bit formats are done with the same
+      integer steps 8 pixels at a time.
+*/
+
+#include "pixelpack.h"
+#include <math.h>
+#include <string.h>
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define PIXELPACK_X86 1
+#include <immintrin.h>
+#define PIXELPACK_AVX2 __attribute__((target("avx2,f16c")))
+#endif
+
+#define PIXELPACK_HALF_MAX  65504.0f
+#define PIXELPACK_UF11_MAX  65024.0f
+#define PIXELPACK_UF10_MAX  64512.0f
+#define PIXELPACK_MIN_NORMAL 6.103515625e-05f   /* 2^-14 in all three formats */
+
+static int g_simd = -1;             /* -1 = not decided yet */
+
+/* pixelpackCanUseSIMD: does the processor run AVX2 and F16C code? */
+static int pixelpackCanUseSIMD()
+{
+#ifdef PIXELPACK_X86
+    __builtin_cpu_init();
+    return __builtin_cpu_supports("avx2") && __builtin_cpu_supports("f16c") ? 1 : 0;
+#else
+    return 0;
+#endif
+}
+
+int pixelpackHasSIMD()
+{
+    if (g_simd < 0)
+        g_simd = pixelpackCanUseSIMD();
+    return g_simd;
+}
+
+int pixelpackSetSIMD(int enable)
+{
+    g_simd = enable ? pixelpackCanUseSIMD() : 0;
+    return g_simd;
+}
+
+/* ---- scalar versions ---- */
+
+/* pixelpackSmallFloat: encodes a non-negative float with a 5 bit
+ * exponent and mbits of mantissa (no sign), rounding to nearest even.
+ */
+static unsigned pixelpackSmallFloat(float v, int mbits, float max)
+{
+    unsigned u, shift = 23 - mbits;
+    if (!(v > 0.0f))
+        return 0;
+    if (v > max)
+        v = max;
+    if (v < PIXELPACK_MIN_NORMAL)
+        return (unsigned)lrintf(v * (float)(1 << (14 + mbits)));
+    memcpy(&u, &v, sizeof(u));
+    u += ((1u << (shift - 1)) - 1) + ((u >> shift) & 1);
+    return (u >> shift) - ((127 - 15) << mbits);
+}
+
+static unsigned short pixelpackHalfScalar1(float v)
+{
+    unsigned u;
+    memcpy(&u, &v, sizeof(u));
+    return (unsigned short)(((u >> 16) & 0x8000) | pixelpackSmallFloat(fabsf(v), 10, PIXELPACK_HALF_MAX));
+}
+
+static void pixelpackHalfScalar(const float* rgb, unsigned count, unsigned short* rgba)
+{
+    unsigned i;
+    for (i = 0; i < count; i++, rgb += 3, rgba += 4) {
+        rgba[0] = pixelpackHalfScalar1(rgb[0]);
+        rgba[1] = pixelpackHalfScalar1(rgb[1]);
+        rgba[2] = pixelpackHalfScalar1(rgb[2]);
+        rgba[3] = 0x3c00;
+    }
+}
+
+static void pixelpackR11G11B10FScalar(const float* rgb, unsigned count, unsigned* packed)
+{
+    unsigned i;
+    for (i = 0; i < count; i++, rgb += 3) {
+        packed[i] = pixelpackSmallFloat(rgb[0], 6, PIXELPACK_UF11_MAX) |
+                    pixelpackSmallFloat(rgb[1], 6, PIXELPACK_UF11_MAX) << 11 |
+                    pixelpackSmallFloat(rgb[2], 5, PIXELPACK_UF10_MAX) << 22;
+    }
+}
+
+/* ---- AVX2/F16C versions ---- */
+
+#ifdef PIXELPACK_X86
+
+PIXELPACK_AVX2
+static void pixelpackHalfAVX2(const float* rgb, unsigned count, unsigned short* rgba)
+{
+    const __m256 one = _mm256_set1_ps(1.0f);
+    const __m256 lo = _mm256_set1_ps(-PIXELPACK_HALF_MAX);
+    const __m256 hi = _mm256_set1_ps(PIXELPACK_HALF_MAX);
+    unsigned i;
+    /* two pixels per register; the second load reads one float past
+       the pixel, so the last pixel is left to the scalar loop */
+    for (i = 0; i + 2 < count; i += 2) {
+        __m256 p = _mm256_insertf128_ps(_mm256_castps128_ps256(_mm_loadu_ps(&rgb[3 * i])),
+                                        _mm_loadu_ps(&rgb[3 * i + 3]), 1);
+        p = _mm256_min_ps(_mm256_max_ps(p, lo), hi);
+        p = _mm256_blend_ps(p, one, 0x88);
+        _mm_storeu_si128((__m128i*)&rgba[4 * i], _mm256_cvtps_ph(p, _MM_FROUND_TO_NEAREST_INT));
+    }
+    pixelpackHalfScalar(&rgb[3 * i], count - i, &rgba[4 * i]);
+}
+
+/* pixelpackSmallFloatAVX2: pixelpackSmallFloat for 8 values */
+PIXELPACK_AVX2
+static inline __m256i pixelpackSmallFloatAVX2(__m256 v, int mbits, float max)
+{
+    const int shift = 23 - mbits;
+    const __m128i count = _mm_cvtsi32_si128(shift);
+    __m256i u, normal, denormal;
+    __m256 small;
+    v = _mm256_min_ps(_mm256_max_ps(v, _mm256_setzero_ps()), _mm256_set1_ps(max));
+    small = _mm256_cmp_ps(v, _mm256_set1_ps(PIXELPACK_MIN_NORMAL), _CMP_LT_OQ);
+    denormal = _mm256_cvtps_epi32(_mm256_mul_ps(v, _mm256_set1_ps((float)(1 << (14 + mbits)))));
+    u = _mm256_castps_si256(v);
+    u = _mm256_add_epi32(u, _mm256_add_epi32(_mm256_set1_epi32((1 << (shift - 1)) - 1),
+                                             _mm256_and_si256(_mm256_srl_epi32(u, count), _mm256_set1_epi32(1))));
+    normal = _mm256_sub_epi32(_mm256_srl_epi32(u, count), _mm256_set1_epi32((127 - 15) << mbits));
+    return _mm256_blendv_epi8(normal, denormal, _mm256_castps_si256(small));
+}
+
+PIXELPACK_AVX2
+static void pixelpackR11G11B10FAVX2(const float* rgb, unsigned count, unsigned* packed)
+{
+    /* the three loads hold r g b r g b r g | b r g b r g b r | g b r g b r g b;
+       a blend picks one channel's lanes and a permute puts them in order */
+    const __m256i rorder = _mm256_setr_epi32(0, 3, 6, 1, 4, 7, 2, 5);
+    const __m256i gorder = _mm256_setr_epi32(1, 4, 7, 2, 5, 0, 3, 6);
+    const __m256i border = _mm256_setr_epi32(2, 5, 0, 3, 6, 1, 4, 7);
+    unsigned i;
+    for (i = 0; i + 8 <= count; i += 8) {
+        __m256 a = _mm256_loadu_ps(&rgb[3 * i + 0]);
+        __m256 b = _mm256_loadu_ps(&rgb[3 * i + 8]);
+        __m256 c = _mm256_loadu_ps(&rgb[3 * i + 16]);
+        __m256 r = _mm256_permutevar8x32_ps(_mm256_blend_ps(_mm256_blend_ps(a, b, 0x92), c, 0x24), rorder);
+        __m256 g = _mm256_permutevar8x32_ps(_mm256_blend_ps(_mm256_blend_ps(a, b, 0x24), c, 0x49), gorder);
+        __m256 bl = _mm256_permutevar8x32_ps(_mm256_blend_ps(_mm256_blend_ps(a, b, 0x49), c, 0x92), border);
+        __m256i t = _mm256_or_si256(pixelpackSmallFloatAVX2(r, 6, PIXELPACK_UF11_MAX),
+                    _mm256_or_si256(_mm256_slli_epi32(pixelpackSmallFloatAVX2(g, 6, PIXELPACK_UF11_MAX), 11),
+                                    _mm256_slli_epi32(pixelpackSmallFloatAVX2(bl, 5, PIXELPACK_UF10_MAX), 22)));
+        _mm256_storeu_si256((__m256i*)&packed[i], t);
+    }
+    pixelpackR11G11B10FScalar(&rgb[3 * i], count - i, &packed[i]);
+}
+
+#endif
+
+/* ---- dispatch ---- */
+
+void pixelpackHalf(const float* rgb, unsigned count, unsigned short* rgba)
+{
+#ifdef PIXELPACK_X86
+    if (pixelpackHasSIMD()) {
+        pixelpackHalfAVX2(rgb, count, rgba);
+        return;
+    }
+#endif
+    pixelpackHalfScalar(rgb, count, rgba);
+}
+
+void pixelpackR11G11B10F(const float* rgb, unsigned count, unsigned* packed)
+{
+#ifdef PIXELPACK_X86
+    if (pixelpackHasSIMD()) {
+        pixelpackR11G11B10FAVX2(rgb, count, packed);
+        return;
+    }
+#endif
+    pixelpackR11G11B10FScalar(rgb, count, packed);
+}
@@ -0,0 +1,42 @@
+#ifndef PIXELPACK_H
+#define PIXELPACK_H
+
+/*
+      pixelpack.h
+
+      Packs float RGB pixels into the compact floating point texel
+      formats, so textures can be uploaded without the driver converting
+      them: RGBA16F (GL_RGBA + GL_HALF_FLOAT) and R11F_G11F_B10F
+      (GL_RGB + GL_UNSIGNED_INT_10F_11F_11F_REV).  Values are rounded to
+      nearest even and clamped to the largest finite value of the format,
+      so overly bright pixels don't turn into infinities.  Inputs must
+      not be NaN.  An AVX2/F16C version is picked at runtime; it packs
+      exactly the same bits as the scalar one.
+*/
+
+/* pixelpackHalf: packs RGB floats into RGBA half floats, alpha 1.
+ *
+ * rgb   - 3 * count floats
+ * count - number of pixels
+ * rgba  - receives 4 * count halves
+ */
+void pixelpackHalf(const float* rgb, unsigned count, unsigned short* rgba);
+
+/* pixelpackR11G11B10F: packs RGB floats into 32-bit R11F_G11F_B10F
+ * texels, red in the low bits.  Negative values become 0.
+ *
+ * rgb    - 3 * count floats
+ * count  - number of pixels
+ * packed - receives count texels
+ */
+void pixelpackR11G11B10F(const float* rgb, unsigned count, unsigned* packed);
+
+/* pixelpackHasSIMD: returns nonzero if the AVX2/F16C versions are in use */
+int pixelpackHasSIMD();
+
+/* pixelpackSetSIMD: turns the AVX2/F16C versions on (if the processor
+ * supports them) or off.  Returns nonzero if they are in use afterwards.
+ */
+int pixelpackSetSIMD(int enable);
+
+#endif // PIXELPACK_H
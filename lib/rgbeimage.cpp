@@ -0,0 +1,699 @@
+/*
+      rgbeimage.cpp
+
+      Reads Radiance RGBE images from a memory mapping.  A run length
+      encoded scanline stores its red, green, blue and exponent bytes as
+      four separate runs, so it is expanded into a planar buffer and the
+      planes are converted 8 pixels at a time; the results are the same
+      as rgbe2float in rgbe/rgbe.cpp.
+
+      Writing converts a scanline into the same planar form and run
+      length encodes each plane exactly as RGBE_WriteBytes_RLE does.
+*/
+
+#include "rgbeimage.h"
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "parallel.h"
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define RGBE_X86 1
+#include <immintrin.h>
+#define RGBE_AVX2 __attribute__((target("avx2")))
+#endif
+
+/* scanlines decoded by one parallelFor index */
+#define RGBE_ROWS_PER_TASK 16
+
+static int g_simd = -1;             /* -1 = not decided yet */
+static float g_scale[256];          /* 2^(e - 136), 0 for e = 0 */
+static int g_scaleReady = 0;
+
+/* rgbeCanUseSIMD: does the processor run AVX2 code? */
+static int rgbeCanUseSIMD()
+{
+#ifdef RGBE_X86
+    __builtin_cpu_init();
+    return __builtin_cpu_supports("avx2") ? 1 : 0;
+#else
+    return 0;
+#endif
+}
+
+int rgbeHasSIMD()
+{
+    if (g_simd < 0)
+        g_simd = rgbeCanUseSIMD();
+    return g_simd;
+}
+
+int rgbeSetSIMD(int enable)
+{
+    g_simd = enable ? rgbeCanUseSIMD() : 0;
+    return g_simd;
+}
+
+/* rgbeInitScale: fills the exponent table the way rgbe2float computes it */
+static void rgbeInitScale()
+{
+    int e;
+    if (g_scaleReady)
+        return;
+    g_scale[0] = 0.0f;
+    for (e = 1; e < 256; e++)
+        g_scale[e] = (float)ldexp(1.0, e - (128 + 8));
+    g_scaleReady = 1;
+}
+
+/* ---- conversion ---- */
+
+static void rgbeConvertPlanarScalar(const unsigned char* planes, int width, int first, float* rgb)
+{
+    const unsigned char* r = planes;
+    const unsigned char* g = planes + width;
+    const unsigned char* b = planes + 2 * width;
+    const unsigned char* e = planes + 3 * width;
+    int i;
+    for (i = first; i < width; i++) {
+        float f = g_scale[e[i]];
+        rgb[3 * i + 0] = r[i] * f;
+        rgb[3 * i + 1] = g[i] * f;
+        rgb[3 * i + 2] = b[i] * f;
+    }
+}
+
+static void rgbeConvertFlat(const unsigned char* rgbe, int count, float* rgb)
+{
+    int i;
+    for (i = 0; i < count; i++, rgbe += 4, rgb += 3) {
+        float f = g_scale[rgbe[3]];
+        rgb[0] = rgbe[0] * f;
+        rgb[1] = rgbe[1] * f;
+        rgb[2] = rgbe[2] * f;
+    }
+}
+
+#ifdef RGBE_X86
+
+RGBE_AVX2
+static inline __m256 rgbeLoadPlane(const unsigned char* p)
+{
+    return _mm256_cvtepi32_ps(_mm256_cvtepu8_epi32(_mm_loadl_epi64((const __m128i*)p)));
+}
+
+RGBE_AVX2
+static void rgbeConvertPlanarAVX2(const unsigned char* planes, int width, float* rgb)
+{
+    /* each output register takes lanes 0,3,6 / 1,4,7 / 2,5 from one of
+       the red, green and blue registers, rotating which one goes first */
+    const __m256i spread0 = _mm256_setr_epi32(0, 0, 0, 1, 1, 1, 2, 2);
+    const __m256i spread1 = _mm256_setr_epi32(2, 3, 3, 3, 4, 4, 4, 5);
+    const __m256i spread2 = _mm256_setr_epi32(5, 5, 6, 6, 6, 7, 7, 7);
+    int i;
+    for (i = 0; i + 8 <= width; i += 8) {
+        __m256i e = _mm256_cvtepu8_epi32(_mm_loadl_epi64((const __m128i*)(planes + 3 * width + i)));
+        __m256 f = _mm256_i32gather_ps(g_scale, e, 4);
+        __m256 r = _mm256_mul_ps(rgbeLoadPlane(planes + i), f);
+        __m256 g = _mm256_mul_ps(rgbeLoadPlane(planes + width + i), f);
+        __m256 b = _mm256_mul_ps(rgbeLoadPlane(planes + 2 * width + i), f);
+        float* out = &rgb[3 * i];
+        _mm256_storeu_ps(out + 0, _mm256_blend_ps(_mm256_blend_ps(
+            _mm256_permutevar8x32_ps(r, spread0), _mm256_permutevar8x32_ps(g, spread0), 0x92),
+            _mm256_permutevar8x32_ps(b, spread0), 0x24));
+        _mm256_storeu_ps(out + 8, _mm256_blend_ps(_mm256_blend_ps(
+            _mm256_permutevar8x32_ps(b, spread1), _mm256_permutevar8x32_ps(r, spread1), 0x92),
+            _mm256_permutevar8x32_ps(g, spread1), 0x24));
+        _mm256_storeu_ps(out + 16, _mm256_blend_ps(_mm256_blend_ps(
+            _mm256_permutevar8x32_ps(g, spread2), _mm256_permutevar8x32_ps(b, spread2), 0x92),
+            _mm256_permutevar8x32_ps(r, spread2), 0x24));
+    }
+    rgbeConvertPlanarScalar(planes, width, i, rgb);
+}
+
+#endif
+
+static void rgbeConvertPlanar(const unsigned char* planes, int width, float* rgb)
+{
+#ifdef RGBE_X86
+    if (rgbeHasSIMD()) {
+        rgbeConvertPlanarAVX2(planes, width, rgb);
+        return;
+    }
+#endif
+    rgbeConvertPlanarScalar(planes, width, 0, rgb);
+}
+
+/* ---- scanlines ---- */
+
+/* rgbeSkipScanline: steps over one run length encoded scanline without
+ * expanding it.  Returns where the next one starts, or NULL if the
+ * scanline is corrupt or runs past end.
+ */
+static const unsigned char* rgbeSkipScanline(const unsigned char* p, const unsigned char* end, int width)
+{
+    int i, n, count;
+    if (end - p < 4 || p[0] != 2 || p[1] != 2 || ((p[2] << 8) | p[3]) != width)
+        return NULL;
+    p += 4;
+    for (i = 0; i < 4; i++) {
+        for (n = 0; n < width; n += count) {
+            if (end - p < 2)
+                return NULL;
+            if (p[0] > 128) {
+                count = p[0] - 128;
+                p += 2;
+            } else {
+                count = p[0];
+                p += 1 + count;
+            }
+            if (count == 0 || count > width - n || p > end)
+                return NULL;
+        }
+    }
+    return p;
+}
+
+/* rgbeExpandScanline: expands one run length encoded scanline (already
+ * checked by rgbeSkipScanline) into four planes of width bytes.
+ */
+static void rgbeExpandScanline(const unsigned char* p, int width, unsigned char* planes)
+{
+    unsigned char* out = planes;
+    unsigned char* planeEnd;
+    int i, count;
+    p += 4;
+    for (i = 0; i < 4; i++) {
+        planeEnd = planes + (i + 1) * width;
+        while (out < planeEnd) {
+            if (p[0] > 128) {
+                count = p[0] - 128;
+                memset(out, p[1], count);
+                p += 2;
+            } else {
+                count = p[0];
+                memcpy(out, p + 1, count);
+                p += 1 + count;
+            }
+            out += count;
+        }
+    }
+}
+
+int rgbeDecodeScanlines(const RGBEimage* image, int first, int count, float* pixels)
+{
+    unsigned char* planes;
+    int width = image->width;
+    int y;
+
+    if (first < 0 || count < 0 || first + count > image->height)
+        return 0;
+    if (!image->rle) {
+        rgbeConvertFlat(image->scanlines[first], width * count, pixels);
+        return 1;
+    }
+    planes = (unsigned char*)malloc(4 * width);
+    if (!planes)
+        return 0;
+    for (y = first; y < first + count; y++, pixels += 3 * width) {
+        rgbeExpandScanline(image->scanlines[y], width, planes);
+        rgbeConvertPlanar(planes, width, pixels);
+    }
+    free(planes);
+    return 1;
+}
+
+typedef struct {
+    const RGBEimage* image;
+    float* pixels;
+    int failed;
+} RGBEdecodeJob;
+
+static void rgbeDecodeTask(int index, void* arg)
+{
+    RGBEdecodeJob* job = (RGBEdecodeJob*)arg;
+    int first = index * RGBE_ROWS_PER_TASK;
+    int count = job->image->height - first;
+    if (count > RGBE_ROWS_PER_TASK)
+        count = RGBE_ROWS_PER_TASK;
+    if (!rgbeDecodeScanlines(job->image, first, count, job->pixels + (size_t)3 * job->image->width * first))
+        job->failed = 1;
+}
+
+int rgbeDecode(const RGBEimage* image, float* pixels)
+{
+    RGBEdecodeJob job;
+    job.image = image;
+    job.pixels = pixels;
+    job.failed = 0;
+    parallelFor((image->height + RGBE_ROWS_PER_TASK - 1) / RGBE_ROWS_PER_TASK, rgbeDecodeTask, &job);
+    return !job.failed;
+}
+
+/* ---- files ---- */
+
+/* rgbeReadHeader: parses the header lines up to the resolution line.
+ * Returns where the pixels start, or NULL if the header is not one we
+ * can read.
+ */
+static const unsigned char* rgbeReadHeader(RGBEimage* image, const char* filename)
+{
+    const char* p = (const char*)image->data;
+    const char* end = p + image->size;
+    const char* eol;
+    char line[128];
+    size_t length;
+    int blank = 0;
+
+    image->exposure = 1.0f;
+    while (p < end) {
+        eol = (const char*)memchr(p, '\n', end - p);
+        if (!eol)
+            break;
+        length = eol - p;
+        if (length >= sizeof(line))
+            length = sizeof(line) - 1;
+        memcpy(line, p, length);
+        line[length] = '\0';
+        p = eol + 1;
+
+        if (blank) {
+            /* the resolution line follows the blank line */
+            if (sscanf(line, "-Y %d +X %d", &image->height, &image->width) != 2 ||
+                image->width <= 0 || image->height <= 0) {
+                fprintf(stderr, "rgbeOpen() failed: %s: unsupported resolution \"%s\"\n", filename, line);
+                return NULL;
+            }
+            return (const unsigned char*)p;
+        }
+        if (line[0] == '\0' || (line[0] == '\r' && line[1] == '\0'))
+            blank = 1;
+        else if (strncmp(line, "FORMAT=", 7) == 0 && strncmp(line + 7, "32-bit_rle_rgbe", 15) != 0) {
+            fprintf(stderr, "rgbeOpen() failed: %s: unsupported %s\n", filename, line);
+            return NULL;
+        }
+        else if (strncmp(line, "EXPOSURE=", 9) == 0)
+            image->exposure = (float)atof(line + 9);
+    }
+    fprintf(stderr, "rgbeOpen() failed: %s: truncated header\n", filename);
+    return NULL;
+}
+
+/* rgbeIndexScanlines: finds where every scanline starts.  Files whose
+ * first scanline is not run length encoded are read flat, as
+ * RGBE_ReadPixels_RLE does.
+ */
+static int rgbeIndexScanlines(RGBEimage* image, const unsigned char* p)
+{
+    const unsigned char* end = image->data + image->size;
+    int width = image->width;
+    int y;
+
+    image->rle = width >= 8 && width <= 0x7fff && end - p >= 4 &&
+                 p[0] == 2 && p[1] == 2 && !(p[2] & 0x80);
+    if (!image->rle) {
+        if ((size_t)(end - p) / 4 / width < (size_t)image->height)
+            return 0;
+        for (y = 0; y < image->height; y++)
+            image->scanlines[y] = p + (size_t)4 * width * y;
+        return 1;
+    }
+    for (y = 0; y < image->height; y++) {
+        image->scanlines[y] = p;
+        p = rgbeSkipScanline(p, end, width);
+        if (!p)
+            return 0;
+    }
+    return 1;
+}
+
+RGBEimage* rgbeOpen(const char* filename)
+{
+    RGBEimage* image;
+    const unsigned char* pixels;
+    struct stat st;
+    void* data;
+    int fd;
+
+    rgbeInitScale();
+
+    fd = open(filename, O_RDONLY);
+    if (fd < 0) {
+        fprintf(stderr, "rgbeOpen() failed: can't open \"%s\".\n", filename);
+        return NULL;
+    }
+    if (fstat(fd, &st) < 0 || st.st_size == 0) {
+        fprintf(stderr, "rgbeOpen() failed: \"%s\" is empty.\n", filename);
+        close(fd);
+        return NULL;
+    }
+    data = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (data == MAP_FAILED) {
+        fprintf(stderr, "rgbeOpen() failed: can't map \"%s\".\n", filename);
+        return NULL;
+    }
+    madvise(data, st.st_size, MADV_SEQUENTIAL);
+
+    image = (RGBEimage*)calloc(1, sizeof(RGBEimage));
+    image->data = (const unsigned char*)data;
+    image->size = st.st_size;
+    pixels = rgbeReadHeader(image, filename);
+    if (!pixels) {
+        rgbeClose(image);
+        return NULL;
+    }
+    image->scanlines = (const unsigned char**)malloc(sizeof(unsigned char*) * image->height);
+    if (!image->scanlines || !rgbeIndexScanlines(image, pixels)) {
+        fprintf(stderr, "rgbeOpen() failed: %s: corrupt or truncated pixel data\n", filename);
+        rgbeClose(image);
+        return NULL;
+    }
+    return image;
+}
+
+void rgbeClose(RGBEimage* image)
+{
+    if (!image)
+        return;
+    if (image->data)
+        munmap((void*)image->data, image->size);
+    free(image->scanlines);
+    free(image);
+}
+
+/* ---- writing ---- */
+
+/* RGBE_HEADER_BOUND: room for the header, resolution line included */
+#define RGBE_HEADER_BOUND 64
+
+/* RGBE_MIN_RUN: shortest run worth encoding, as in RGBE_WriteBytes_RLE */
+#define RGBE_MIN_RUN 4
+
+/* g_minValue: smallest float that float2rgbe doesn't write as black */
+static float g_minValue = 0.0f;
+
+/* rgbeInitMinValue: finds the float at or just above float2rgbe's 1e-32 */
+static void rgbeInitMinValue()
+{
+    float v = (float)1e-32;
+    if (g_minValue != 0.0f)
+        return;
+    if ((double)v < 1e-32)
+        v = nextafterf(v, 1.0f);
+    g_minValue = v;
+}
+
+/* rgbeUsesRLE: can scanlines of this width be run length encoded? */
+static int rgbeUsesRLE(int width)
+{
+    return width >= 8 && width <= 0x7fff;
+}
+
+/* rgbeScanlineBound: the most bytes one encoded scanline can take.  A
+ * run always encodes shorter than its bytes, so only the count byte of
+ * every literal stretch of up to 128 bytes adds to a plane.
+ */
+static size_t rgbeScanlineBound(int width)
+{
+    if (!rgbeUsesRLE(width))
+        return (size_t)4 * width;
+    return 4 + (size_t)4 * (width + (width + 127) / 128);
+}
+
+/* rgbeToPlanarScalar: float2rgbe for pixels first to width of a scanline.
+ * The scale float2rgbe gets from frexp is 2^(8 - e), which can be made
+ * straight from the exponent bits of the largest component.
+ */
+static void rgbeToPlanarScalar(const float* rgb, int width, int first, unsigned char* planes)
+{
+    int i, c;
+    for (i = first; i < width; i++) {
+        const float* p = &rgb[3 * i];
+        union { float f; unsigned u; } v, scale;
+        v.f = p[0];
+        if (p[1] > v.f) v.f = p[1];
+        if (p[2] > v.f) v.f = p[2];
+        if (v.f < g_minValue) {
+            for (c = 0; c < 4; c++)
+                planes[c * width + i] = 0;
+            continue;
+        }
+        scale.u = (261 - (v.u >> 23)) << 23;
+        for (c = 0; c < 3; c++)
+            planes[c * width + i] = (unsigned char)(int)((p[c] > 0.0f ? p[c] : 0.0f) * scale.f);
+        planes[3 * width + i] = (unsigned char)((v.u >> 23) + 2);
+    }
+}
+
+#ifdef RGBE_X86
+
+RGBE_AVX2
+static void rgbeToPlanarAVX2(const float* rgb, int width, unsigned char* planes)
+{
+    const __m256i rorder = _mm256_setr_epi32(0, 3, 6, 1, 4, 7, 2, 5);
+    const __m256i gorder = _mm256_setr_epi32(1, 4, 7, 2, 5, 0, 3, 6);
+    const __m256i border = _mm256_setr_epi32(2, 5, 0, 3, 6, 1, 4, 7);
+    const __m256i gather = _mm256_setr_epi32(0, 4, 1, 5, 2, 6, 3, 7);
+    const __m256 zero = _mm256_setzero_ps();
+    const __m256 minValue = _mm256_set1_ps(g_minValue);
+    int i;
+    for (i = 0; i + 8 <= width; i += 8) {
+        /* the same deinterleave as pixelpack: blend one channel's lanes
+           together, then permute them into order */
+        __m256 a = _mm256_loadu_ps(&rgb[3 * i]);
+        __m256 b = _mm256_loadu_ps(&rgb[3 * i + 8]);
+        __m256 c = _mm256_loadu_ps(&rgb[3 * i + 16]);
+        __m256 r = _mm256_permutevar8x32_ps(_mm256_blend_ps(_mm256_blend_ps(a, b, 0x92), c, 0x24), rorder);
+        __m256 g = _mm256_permutevar8x32_ps(_mm256_blend_ps(_mm256_blend_ps(a, b, 0x24), c, 0x49), gorder);
+        __m256 bl = _mm256_permutevar8x32_ps(_mm256_blend_ps(_mm256_blend_ps(a, b, 0x49), c, 0x92), border);
+        __m256 v = _mm256_max_ps(_mm256_max_ps(g, r), bl);
+        __m256i keep = _mm256_castps_si256(_mm256_cmp_ps(v, minValue, _CMP_GE_OQ));
+        __m256i bits = _mm256_srli_epi32(_mm256_castps_si256(v), 23);
+        __m256 scale = _mm256_castsi256_ps(_mm256_slli_epi32(_mm256_sub_epi32(_mm256_set1_epi32(261), bits), 23));
+        __m256i ri = _mm256_and_si256(_mm256_cvttps_epi32(_mm256_mul_ps(_mm256_max_ps(r, zero), scale)), keep);
+        __m256i gi = _mm256_and_si256(_mm256_cvttps_epi32(_mm256_mul_ps(_mm256_max_ps(g, zero), scale)), keep);
+        __m256i bi = _mm256_and_si256(_mm256_cvttps_epi32(_mm256_mul_ps(_mm256_max_ps(bl, zero), scale)), keep);
+        __m256i ei = _mm256_and_si256(_mm256_and_si256(_mm256_add_epi32(bits, _mm256_set1_epi32(2)),
+                                                       _mm256_set1_epi32(0xff)), keep);
+        /* pack to bytes: each 128-bit half ends up as r g b e for 4
+           pixels, and the permute puts the halves of each channel together */
+        __m256i packed = _mm256_permutevar8x32_epi32(
+            _mm256_packus_epi16(_mm256_packus_epi32(ri, gi), _mm256_packus_epi32(bi, ei)), gather);
+        __m128i lo = _mm256_castsi256_si128(packed);
+        __m128i hi = _mm256_extracti128_si256(packed, 1);
+        _mm_storel_epi64((__m128i*)(planes + i), lo);
+        _mm_storel_epi64((__m128i*)(planes + width + i), _mm_unpackhi_epi64(lo, lo));
+        _mm_storel_epi64((__m128i*)(planes + 2 * width + i), hi);
+        _mm_storel_epi64((__m128i*)(planes + 3 * width + i), _mm_unpackhi_epi64(hi, hi));
+    }
+    rgbeToPlanarScalar(rgb, width, i, planes);
+}
+
+#endif
+
+static void rgbeToPlanar(const float* rgb, int width, unsigned char* planes)
+{
+#ifdef RGBE_X86
+    if (rgbeHasSIMD()) {
+        rgbeToPlanarAVX2(rgb, width, planes);
+        return;
+    }
+#endif
+    rgbeToPlanarScalar(rgb, width, 0, planes);
+}
+
+/* rgbeFindRunScalar: where the first RGBE_MIN_RUN equal bytes at or
+ * after from start, or count if there are none
+ */
+static int rgbeFindRunScalar(const unsigned char* data, int from, int count)
+{
+    int i;
+    for (i = from; i + RGBE_MIN_RUN <= count; i++)
+        if (data[i] == data[i + 1] && data[i + 1] == data[i + 2] && data[i + 2] == data[i + 3])
+            return i;
+    return count;
+}
+
+#ifdef RGBE_X86
+
+/* rgbeFindRunAVX2: rgbeFindRunScalar, testing 32 starts at once */
+RGBE_AVX2
+static int rgbeFindRunAVX2(const unsigned char* data, int from, int count)
+{
+    int i;
+    for (i = from; i + 32 + RGBE_MIN_RUN - 1 <= count; i += 32) {
+        __m256i a = _mm256_loadu_si256((const __m256i*)(data + i));
+        __m256i b = _mm256_loadu_si256((const __m256i*)(data + i + 1));
+        __m256i c = _mm256_loadu_si256((const __m256i*)(data + i + 2));
+        __m256i d = _mm256_loadu_si256((const __m256i*)(data + i + 3));
+        unsigned mask = (unsigned)_mm256_movemask_epi8(_mm256_and_si256(
+            _mm256_cmpeq_epi8(a, b), _mm256_and_si256(_mm256_cmpeq_epi8(b, c), _mm256_cmpeq_epi8(c, d))));
+        if (mask)
+            return i + __builtin_ctz(mask);
+    }
+    return rgbeFindRunScalar(data, i, count);
+}
+
+#endif
+
+static int rgbeFindRun(const unsigned char* data, int from, int count)
+{
+#ifdef RGBE_X86
+    if (rgbeHasSIMD())
+        return rgbeFindRunAVX2(data, from, count);
+#endif
+    return rgbeFindRunScalar(data, from, count);
+}
+
+/* rgbeRunLength: run length encodes one plane, giving the same bytes as
+ * RGBE_WriteBytes_RLE.  That steps from run to run until it finds one
+ * of RGBE_MIN_RUN bytes, which starts exactly where the first
+ * RGBE_MIN_RUN equal bytes do, so those are searched for directly.
+ * Returns the end of what it wrote.
+ */
+static unsigned char* rgbeRunLength(const unsigned char* data, int count, unsigned char* out)
+{
+    int cur = 0, begin, run, gap, literal;
+    while (cur < count) {
+        begin = rgbeFindRun(data, cur, count);
+        run = 0;
+        if (begin < count) {
+            run = RGBE_MIN_RUN;
+            while (begin + run < count && run < 127 && data[begin] == data[begin + run])
+                run++;
+        }
+        /* a gap before it that is one short run is written as a run too */
+        gap = begin - cur;
+        if ((gap == 2 && data[cur] == data[cur + 1]) ||
+            (gap == 3 && data[cur] == data[cur + 1] && data[cur] == data[cur + 2])) {
+            *out++ = (unsigned char)(128 + gap);
+            *out++ = data[cur];
+            cur = begin;
+        }
+        /* otherwise the bytes up to it, up to 128 at a time */
+        while (cur < begin) {
+            literal = begin - cur;
+            if (literal > 128)
+                literal = 128;
+            *out++ = (unsigned char)literal;
+            memcpy(out, &data[cur], literal);
+            out += literal;
+            cur += literal;
+        }
+        if (run) {
+            *out++ = (unsigned char)(128 + run);
+            *out++ = data[begin];
+            cur += run;
+        }
+    }
+    return out;
+}
+
+/* rgbeEncodeScanline: converts and encodes one scanline.  planes is
+ * scratch space of 4 * width bytes.  Returns the end of what it wrote.
+ */
+static unsigned char* rgbeEncodeScanline(const float* rgb, int width, unsigned char* planes, unsigned char* out)
+{
+    int i, c;
+    rgbeToPlanar(rgb, width, planes);
+    if (!rgbeUsesRLE(width)) {
+        for (i = 0; i < width; i++)
+            for (c = 0; c < 4; c++)
+                *out++ = planes[c * width + i];
+        return out;
+    }
+    *out++ = 2;
+    *out++ = 2;
+    *out++ = (unsigned char)(width >> 8);
+    *out++ = (unsigned char)(width & 0xff);
+    for (c = 0; c < 4; c++)
+        out = rgbeRunLength(planes + c * width, width, out);
+    return out;
+}
+
+typedef struct {
+    const float* pixels;
+    int width, height;
+    int bottomUp;
+    unsigned char* out;                 /* every band starts bandbound bytes after the last */
+    size_t bandbound;
+    size_t* sizes;                      /* bytes each band took */
+    int failed;
+} RGBEencodeJob;
+
+static void rgbeEncodeTask(int index, void* arg)
+{
+    RGBEencodeJob* job = (RGBEencodeJob*)arg;
+    int width = job->width, first = index * RGBE_ROWS_PER_TASK, y;
+    int last = first + RGBE_ROWS_PER_TASK < job->height ? first + RGBE_ROWS_PER_TASK : job->height;
+    unsigned char* start = job->out + job->bandbound * index;
+    unsigned char* out = start;
+    unsigned char* planes = (unsigned char*)malloc(4 * width);
+    if (!planes) {
+        job->failed = 1;
+        job->sizes[index] = 0;
+        return;
+    }
+    for (y = first; y < last; y++) {
+        int row = job->bottomUp ? job->height - 1 - y : y;
+        out = rgbeEncodeScanline(job->pixels + (size_t)3 * width * row, width, planes, out);
+    }
+    free(planes);
+    job->sizes[index] = out - start;
+}
+
+size_t rgbeEncodeBound(int width, int height)
+{
+    return RGBE_HEADER_BOUND + rgbeScanlineBound(width) * height;
+}
+
+size_t rgbeEncode(const float* pixels, int width, int height, int bottomUp, unsigned char* out)
+{
+    RGBEencodeJob job;
+    int bands = (height + RGBE_ROWS_PER_TASK - 1) / RGBE_ROWS_PER_TASK, i;
+    size_t header, size;
+    if (width <= 0 || height <= 0)
+        return 0;
+    rgbeInitMinValue();
+    header = sprintf((char*)out, "#?RGBE\nFORMAT=32-bit_rle_rgbe\n\n-Y %d +X %d\n", height, width);
+
+    job.pixels = pixels;
+    job.width = width;
+    job.height = height;
+    job.bottomUp = bottomUp;
+    job.out = out + header;
+    job.bandbound = rgbeScanlineBound(width) * RGBE_ROWS_PER_TASK;
+    job.sizes = (size_t*)malloc(sizeof(size_t) * bands);
+    job.failed = 0;
+    if (!job.sizes)
+        return 0;
+    parallelFor(bands, rgbeEncodeTask, &job);
+
+    /* close up the gaps between the bands */
+    size = header + job.sizes[0];
+    for (i = 1; i < bands; i++) {
+        memmove(out + size, job.out + job.bandbound * i, job.sizes[i]);
+        size += job.sizes[i];
+    }
+    free(job.sizes);
+    return job.failed ? 0 : size;
+}
+
+int rgbeWrite(FILE* file, const float* pixels, int width, int height, int bottomUp)
+{
+    unsigned char* buffer = (unsigned char*)malloc(rgbeEncodeBound(width, height));
+    size_t size;
+    int ok;
+    if (!buffer)
+        return 0;
+    size = rgbeEncode(pixels, width, height, bottomUp, buffer);
+    ok = size > 0 && fwrite(buffer, 1, size, file) == size;
+    free(buffer);
+    return ok;
+}
@@ -0,0 +1,99 @@
+#ifndef RGBEIMAGE_H
+#define RGBEIMAGE_H
+
+#include <stddef.h>
+#include <stdio.h>
+
+/*
+      rgbeimage.h
+
+      Fast reading of Radiance .hdr (RGBE) files.  rgbeOpen maps the file
+      into memory, parses the header and finds where every scanline starts
+      in one quick pass over the run lengths, without expanding them.  The
+      scanlines can then be decoded in any order and from any thread;
+      rgbeDecode spreads them over the parallel.h pool.  The conversion
+      to floats looks the exponent up in a table and has an AVX2 version,
+      picked at runtime, which gives the same floats as the scalar one and
+      as rgbe2float in rgbe/rgbe.cpp.
+
+      Writing goes the other way over the same pool: bands of scanlines
+      are converted (8 pixels at a time with AVX2) and run length encoded
+      into their own parts of one buffer, which is then closed up and
+      written with a single call.  The bytes are the same as
+      RGBE_WriteHeader and RGBE_WritePixels_RLE produce.
+*/
+
+/* RGBEimage: a mapped .hdr file */
+typedef struct _RGBEimage {
+    int width;                          /* pixels per scanline */
+    int height;                         /* number of scanlines, top one first */
+    float exposure;                     /* EXPOSURE from the header, 1 if none */
+    int rle;                            /* scanlines are run length encoded */
+    const unsigned char* data;          /* the mapped file */
+    size_t size;                        /* its size in bytes */
+    const unsigned char** scanlines;    /* where each scanline starts in data */
+} RGBEimage;
+
+/* rgbeOpen: maps a .hdr file and indexes its scanlines.  Only the usual
+ * -Y height +X width orientation is read.  Returns NULL (after printing
+ * why) if the file can't be read or is not a valid RGBE image.
+ *
+ * filename - name of the file
+ */
+RGBEimage* rgbeOpen(const char* filename);
+
+/* rgbeClose: unmaps the file and frees the image.
+ */
+void rgbeClose(RGBEimage* image);
+
+/* rgbeDecodeScanlines: decodes a range of scanlines into floats.  Safe to
+ * call from several threads at once.  Returns 0 if the data is corrupt.
+ *
+ * image  - an opened image
+ * first  - index of the first scanline (0 is the top one)
+ * count  - number of scanlines to decode
+ * pixels - receives 3 * width * count floats: red, green, blue
+ */
+int rgbeDecodeScanlines(const RGBEimage* image, int first, int count, float* pixels);
+
+/* rgbeDecode: decodes the whole image, the scanlines spread over the
+ * thread pool.  Returns 0 if the data is corrupt.
+ *
+ * image  - an opened image
+ * pixels - receives 3 * width * height floats, top scanline first
+ */
+int rgbeDecode(const RGBEimage* image, float* pixels);
+
+/* rgbeEncodeBound: the most bytes rgbeEncode can need for an image */
+size_t rgbeEncodeBound(int width, int height);
+
+/* rgbeEncode: encodes a float RGB image as a whole .hdr file in memory:
+ * the header RGBE_WriteHeader writes, then the scanlines, run length
+ * encoded unless width is below 8 or above 32767.  Returns the number
+ * of bytes of out used.
+ *
+ * pixels   - 3 * width * height floats: red, green, blue
+ * bottomUp - nonzero if the bottom scanline comes first, as glReadPixels
+ *            gives them
+ * out      - receives the file; rgbeEncodeBound(width, height) bytes
+ */
+size_t rgbeEncode(const float* pixels, int width, int height, int bottomUp, unsigned char* out);
+
+/* rgbeWrite: encodes an image and writes it to file with one fwrite.
+ * Returns 0 if out of memory or the write fails.
+ *
+ * file     - a file or pipe open for writing
+ * pixels   - 3 * width * height floats: red, green, blue
+ * bottomUp - nonzero if the bottom scanline comes first
+ */
+int rgbeWrite(FILE* file, const float* pixels, int width, int height, int bottomUp);
+
+/* rgbeHasSIMD: returns nonzero if the AVX2 conversions are in use */
+int rgbeHasSIMD();
+
+/* rgbeSetSIMD: turns the AVX2 conversions on (if the processor supports
+ * them) or off.  Returns nonzero if they are in use afterwards.
+ */
+int rgbeSetSIMD(int enable);
+
+#endif // RGBEIMAGE_H
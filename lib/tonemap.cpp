@@ -0,0 +1,803 @@
+/*
+      tonemap.cpp
+
+      The CPU tone mapping declared in tonemap.h.  Each stage runs over
+      bands of TONEMAP_ROWS_PER_TASK rows on the pool, and within a row
+      a kernel works along x, so the AVX2 version can do 8 pixels with
+      the same operations in the same order as the scalar one does 1.
+      The log and exp used by both are the polynomials below rather than
+      the C library's, which is what keeps their results identical.
+*/
+
+#include "tonemap.h"
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+#include "parallel.h"
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define TONEMAP_X86 1
+#include <immintrin.h>
+#define TONEMAP_AVX2 __attribute__((target("avx2")))
+#endif
+
+/* TONEMAP_ROWS_PER_TASK: rows handed to a pool thread at a time */
+#define TONEMAP_ROWS_PER_TASK 16
+
+/* TONEMAP_MIN_LUMINANCE: luminances are clamped to this, as in the shaders */
+#define TONEMAP_MIN_LUMINANCE 0.0001f
+
+#define TONEMAP_LOG2E    1.44269504088896341
+#define TONEMAP_LN2      0.69314718055994531
+#define TONEMAP_LOG10_2  0.30102999566398120f
+#define TONEMAP_LOG2_10  3.32192809488736235f
+#define TONEMAP_SQRT2    1.41421356f
+
+/* 2^f for f in [-0.5, 0.5]: Taylor series of e^(f ln 2) */
+#define TONEMAP_EXP2_C1  0.693147181f
+#define TONEMAP_EXP2_C2  0.240226507f
+#define TONEMAP_EXP2_C3  0.0555041087f
+#define TONEMAP_EXP2_C4  0.00961812911f
+#define TONEMAP_EXP2_C5  0.00133335581f
+#define TONEMAP_EXP2_C6  0.000154035304f
+#define TONEMAP_EXP2_C7  0.0000152527338f
+
+/* log2 m for m in [sqrt(1/2), sqrt(2)): with t = (m - 1) / (m + 1),
+   ln m = 2 (t + t^3 / 3 + t^5 / 5 + ...), here already times log2 e */
+#define TONEMAP_LOG2_C1  ((float)(2.0 * TONEMAP_LOG2E))
+#define TONEMAP_LOG2_C3  ((float)(2.0 / 3.0 * TONEMAP_LOG2E))
+#define TONEMAP_LOG2_C5  ((float)(2.0 / 5.0 * TONEMAP_LOG2E))
+#define TONEMAP_LOG2_C7  ((float)(2.0 / 7.0 * TONEMAP_LOG2E))
+#define TONEMAP_LOG2_C9  ((float)(2.0 / 9.0 * TONEMAP_LOG2E))
+
+static int g_simd = -1;             /* -1 = not decided yet */
+
+/* tonemapCanUseSIMD: does the processor run AVX2 code? */
+static int tonemapCanUseSIMD()
+{
+#ifdef TONEMAP_X86
+    __builtin_cpu_init();
+    return __builtin_cpu_supports("avx2") ? 1 : 0;
+#else
+    return 0;
+#endif
+}
+
+int tonemapHasSIMD()
+{
+    if (g_simd < 0)
+        g_simd = tonemapCanUseSIMD();
+    return g_simd;
+}
+
+int tonemapSetSIMD(int enable)
+{
+    g_simd = enable ? tonemapCanUseSIMD() : 0;
+    return g_simd;
+}
+
+int tonemapBaseSize(int size)
+{
+    size /= TONEMAP_DOWNSAMPLE;
+    return size > 1 ? size : 1;
+}
+
+/* ---- scalar kernels ---- */
+
+typedef union {
+    float f;
+    unsigned u;
+} TMbits;
+
+/* tonemapExp2: 2^x, to about a float's precision, for x down to -126 */
+static inline float tonemapExp2(float x)
+{
+    TMbits scale;
+    float n, f, p;
+    x = x > -126.0f ? x : -126.0f;
+    x = x < 127.0f ? x : 127.0f;
+    n = floorf(x + 0.5f);
+    f = x - n;
+    p = TONEMAP_EXP2_C7;
+    p = p * f + TONEMAP_EXP2_C6;
+    p = p * f + TONEMAP_EXP2_C5;
+    p = p * f + TONEMAP_EXP2_C4;
+    p = p * f + TONEMAP_EXP2_C3;
+    p = p * f + TONEMAP_EXP2_C2;
+    p = p * f + TONEMAP_EXP2_C1;
+    p = p * f + 1.0f;
+    scale.u = (unsigned)((int)n + 127) << 23;
+    return p * scale.f;
+}
+
+/* tonemapLog2: log2 x for a positive, normal x */
+static inline float tonemapLog2(float x)
+{
+    TMbits m;
+    float e, t, t2, p;
+    m.f = x;
+    e = (float)((int)(m.u >> 23) - 127);
+    m.u = (m.u & 0x7fffff) | 0x3f800000;
+    if (m.f >= TONEMAP_SQRT2) {
+        m.f = m.f * 0.5f;
+        e = e + 1.0f;
+    }
+    t = (m.f - 1.0f) / (m.f + 1.0f);
+    t2 = t * t;
+    p = TONEMAP_LOG2_C9;
+    p = p * t2 + TONEMAP_LOG2_C7;
+    p = p * t2 + TONEMAP_LOG2_C5;
+    p = p * t2 + TONEMAP_LOG2_C3;
+    p = p * t2 + TONEMAP_LOG2_C1;
+    return p * t + e;
+}
+
+/* tonemapLuminance: luminance of an RGB pixel, with tonemap.frag's weights */
+static inline float tonemapLuminance(const float* rgb)
+{
+    return 0.299f * rgb[0] + 0.587f * rgb[1] + 0.114f * rgb[2];
+}
+
+/* TMreinhard: the settings of a Reinhard mapping */
+typedef struct {
+    int key;                            /* scale by the key and burn out at white */
+    float exposure;
+    float scale;                        /* exposure / the average luminance */
+    float white2;                       /* squared luminance that maps to white */
+} TMreinhard;
+
+/* tonemapReinhardRatio: mapped over original luminance of a pixel */
+static inline float tonemapReinhardRatio(const TMreinhard* map, float lum)
+{
+    float mapped;
+    lum = lum > TONEMAP_MIN_LUMINANCE ? lum : TONEMAP_MIN_LUMINANCE;
+    if (map->key) {
+        float scaled = map->scale * lum;
+        mapped = scaled * (1.0f + scaled / map->white2) / (1.0f + scaled);
+    } else {
+        mapped = map->exposure * lum / (lum + 1.0f);
+    }
+    return mapped / lum;
+}
+
+/* TMcombine: the settings and upsampling tables of a recombination */
+typedef struct {
+    const float* rgb;
+    float* out;
+    int width, height;
+    const float* base;
+    int basewidth, baseheight;
+    const int* x0;                      /* per column, its left and right base texels */
+    const int* x1;
+    const float* fx;                    /* and how far it is between them */
+    float rangeScale;                   /* -1 / (2 sigma_r^2), times log2 e */
+    float compression;
+    float exposure;
+} TMcombine;
+
+/* tonemapCombineRatio: mapped over original luminance of a pixel, given
+ * its luminance, its bilinear weights and its four base texels
+ */
+static inline float tonemapCombineRatio(const TMcombine* job, float lum, const float w[4], const float b[4])
+{
+    float logLum, wr[4], baseLum, detail, mapped;
+    int i;
+    lum = lum > TONEMAP_MIN_LUMINANCE ? lum : TONEMAP_MIN_LUMINANCE;
+    logLum = tonemapLog2(lum) * TONEMAP_LOG10_2;
+    for (i = 0; i < 4; i++) {
+        float d = b[i] - logLum;
+        wr[i] = w[i] * tonemapExp2(job->rangeScale * d * d) + 0.0001f * w[i];
+    }
+    baseLum = (wr[0] * b[0] + wr[1] * b[1] + wr[2] * b[2] + wr[3] * b[3]) /
+        (wr[0] + wr[1] + wr[2] + wr[3]);
+    detail = logLum - baseLum;
+    mapped = job->exposure * tonemapExp2((job->compression * baseLum + detail) * TONEMAP_LOG2_10);
+    return mapped / lum;
+}
+
+/* tonemapBilateralTexel: one output of a bilateral filter pass; up[i]
+ * and down[i] are the rows i steps either side of the center
+ */
+static inline float tonemapBilateralTexel(const float* center, const float* const* up, const float* const* down,
+                                          const float* weights, int radius, float rangeScale, int x)
+{
+    float c = center[x];
+    float sum = weights[0] * c;
+    float total = weights[0];
+    int i;
+    for (i = 1; i <= radius; i++) {
+        float a = up[i][x], b = down[i][x];
+        float wa = weights[i] * tonemapExp2(rangeScale * (a - c) * (a - c));
+        float wb = weights[i] * tonemapExp2(rangeScale * (b - c) * (b - c));
+        sum = sum + (wa * a + wb * b);
+        total = total + (wa + wb);
+    }
+    return sum / total;
+}
+
+/* ---- AVX2 kernels ---- */
+
+#ifdef TONEMAP_X86
+
+TONEMAP_AVX2 static inline __m256 tonemapExp2AVX2(__m256 x)
+{
+    __m256 n, f, p;
+    __m256i scale;
+    x = _mm256_max_ps(x, _mm256_set1_ps(-126.0f));
+    x = _mm256_min_ps(x, _mm256_set1_ps(127.0f));
+    n = _mm256_floor_ps(_mm256_add_ps(x, _mm256_set1_ps(0.5f)));
+    f = _mm256_sub_ps(x, n);
+    p = _mm256_set1_ps(TONEMAP_EXP2_C7);
+    p = _mm256_add_ps(_mm256_mul_ps(p, f), _mm256_set1_ps(TONEMAP_EXP2_C6));
+    p = _mm256_add_ps(_mm256_mul_ps(p, f), _mm256_set1_ps(TONEMAP_EXP2_C5));
+    p = _mm256_add_ps(_mm256_mul_ps(p, f), _mm256_set1_ps(TONEMAP_EXP2_C4));
+    p = _mm256_add_ps(_mm256_mul_ps(p, f), _mm256_set1_ps(TONEMAP_EXP2_C3));
+    p = _mm256_add_ps(_mm256_mul_ps(p, f), _mm256_set1_ps(TONEMAP_EXP2_C2));
+    p = _mm256_add_ps(_mm256_mul_ps(p, f), _mm256_set1_ps(TONEMAP_EXP2_C1));
+    p = _mm256_add_ps(_mm256_mul_ps(p, f), _mm256_set1_ps(1.0f));
+    scale = _mm256_slli_epi32(_mm256_add_epi32(_mm256_cvttps_epi32(n), _mm256_set1_epi32(127)), 23);
+    return _mm256_mul_ps(p, _mm256_castsi256_ps(scale));
+}
+
+TONEMAP_AVX2 static inline __m256 tonemapLog2AVX2(__m256 x)
+{
+    const __m256 one = _mm256_set1_ps(1.0f);
+    __m256i u = _mm256_castps_si256(x);
+    __m256 e = _mm256_cvtepi32_ps(_mm256_sub_epi32(_mm256_srli_epi32(u, 23), _mm256_set1_epi32(127)));
+    __m256 m = _mm256_castsi256_ps(_mm256_or_si256(_mm256_and_si256(u, _mm256_set1_epi32(0x7fffff)),
+                                                   _mm256_set1_epi32(0x3f800000)));
+    __m256 big = _mm256_cmp_ps(m, _mm256_set1_ps(TONEMAP_SQRT2), _CMP_GE_OQ);
+    __m256 t, t2, p;
+    m = _mm256_blendv_ps(m, _mm256_mul_ps(m, _mm256_set1_ps(0.5f)), big);
+    e = _mm256_add_ps(e, _mm256_and_ps(big, one));
+    t = _mm256_div_ps(_mm256_sub_ps(m, one), _mm256_add_ps(m, one));
+    t2 = _mm256_mul_ps(t, t);
+    p = _mm256_set1_ps(TONEMAP_LOG2_C9);
+    p = _mm256_add_ps(_mm256_mul_ps(p, t2), _mm256_set1_ps(TONEMAP_LOG2_C7));
+    p = _mm256_add_ps(_mm256_mul_ps(p, t2), _mm256_set1_ps(TONEMAP_LOG2_C5));
+    p = _mm256_add_ps(_mm256_mul_ps(p, t2), _mm256_set1_ps(TONEMAP_LOG2_C3));
+    p = _mm256_add_ps(_mm256_mul_ps(p, t2), _mm256_set1_ps(TONEMAP_LOG2_C1));
+    return _mm256_add_ps(_mm256_mul_ps(p, t), e);
+}
+
+/* tonemapLuminanceAVX2: luminance of the 8 pixels in a, b and c.  The
+   three loads hold r g b r g b r g | b r g b r g b r | g b r g b r g b;
+   a blend picks one channel's lanes and a permute puts them in order */
+TONEMAP_AVX2 static inline __m256 tonemapLuminanceAVX2(__m256 a, __m256 b, __m256 c)
+{
+    const __m256i rorder = _mm256_setr_epi32(0, 3, 6, 1, 4, 7, 2, 5);
+    const __m256i gorder = _mm256_setr_epi32(1, 4, 7, 2, 5, 0, 3, 6);
+    const __m256i border = _mm256_setr_epi32(2, 5, 0, 3, 6, 1, 4, 7);
+    __m256 r = _mm256_permutevar8x32_ps(_mm256_blend_ps(_mm256_blend_ps(a, b, 0x92), c, 0x24), rorder);
+    __m256 g = _mm256_permutevar8x32_ps(_mm256_blend_ps(_mm256_blend_ps(a, b, 0x24), c, 0x49), gorder);
+    __m256 bl = _mm256_permutevar8x32_ps(_mm256_blend_ps(_mm256_blend_ps(a, b, 0x49), c, 0x92), border);
+    return _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(_mm256_set1_ps(0.299f), r),
+                                       _mm256_mul_ps(_mm256_set1_ps(0.587f), g)),
+                         _mm256_mul_ps(_mm256_set1_ps(0.114f), bl));
+}
+
+/* tonemapScaleAVX2: stores the 8 pixels in a, b and c, each scaled by its
+   lane of ratio; the permutes spread every lane over its pixel's channels */
+TONEMAP_AVX2 static inline void tonemapScaleAVX2(__m256 a, __m256 b, __m256 c, __m256 ratio, float* out)
+{
+    const __m256i spread0 = _mm256_setr_epi32(0, 0, 0, 1, 1, 1, 2, 2);
+    const __m256i spread1 = _mm256_setr_epi32(2, 3, 3, 3, 4, 4, 4, 5);
+    const __m256i spread2 = _mm256_setr_epi32(5, 5, 6, 6, 6, 7, 7, 7);
+    _mm256_storeu_ps(out, _mm256_mul_ps(a, _mm256_permutevar8x32_ps(ratio, spread0)));
+    _mm256_storeu_ps(out + 8, _mm256_mul_ps(b, _mm256_permutevar8x32_ps(ratio, spread1)));
+    _mm256_storeu_ps(out + 16, _mm256_mul_ps(c, _mm256_permutevar8x32_ps(ratio, spread2)));
+}
+
+TONEMAP_AVX2 static int tonemapLuminanceRowAVX2(const float* rgb, float* lum, int count)
+{
+    int x;
+    for (x = 0; x + 8 <= count; x += 8)
+        _mm256_storeu_ps(&lum[x], tonemapLuminanceAVX2(_mm256_loadu_ps(&rgb[3 * x]), _mm256_loadu_ps(&rgb[3 * x + 8]),
+                                                       _mm256_loadu_ps(&rgb[3 * x + 16])));
+    return x;
+}
+
+TONEMAP_AVX2 static int tonemapLog2RowAVX2(float* v, int count, float lo, float add)
+{
+    const __m256 vlo = _mm256_set1_ps(lo), vadd = _mm256_set1_ps(add);
+    int x;
+    for (x = 0; x + 8 <= count; x += 8)
+        _mm256_storeu_ps(&v[x], tonemapLog2AVX2(_mm256_add_ps(_mm256_max_ps(_mm256_loadu_ps(&v[x]), vlo), vadd)));
+    return x;
+}
+
+TONEMAP_AVX2 static int tonemapReinhardRowAVX2(const TMreinhard* map, const float* rgb, float* out, int count)
+{
+    const __m256 one = _mm256_set1_ps(1.0f);
+    int x;
+    for (x = 0; x + 8 <= count; x += 8) {
+        __m256 a = _mm256_loadu_ps(&rgb[3 * x]);
+        __m256 b = _mm256_loadu_ps(&rgb[3 * x + 8]);
+        __m256 c = _mm256_loadu_ps(&rgb[3 * x + 16]);
+        __m256 lum = _mm256_max_ps(tonemapLuminanceAVX2(a, b, c), _mm256_set1_ps(TONEMAP_MIN_LUMINANCE));
+        __m256 mapped;
+        if (map->key) {
+            __m256 scaled = _mm256_mul_ps(_mm256_set1_ps(map->scale), lum);
+            mapped = _mm256_div_ps(_mm256_mul_ps(scaled, _mm256_add_ps(one, _mm256_div_ps(scaled, _mm256_set1_ps(map->white2)))),
+                                   _mm256_add_ps(one, scaled));
+        } else {
+            mapped = _mm256_div_ps(_mm256_mul_ps(_mm256_set1_ps(map->exposure), lum), _mm256_add_ps(lum, one));
+        }
+        tonemapScaleAVX2(a, b, c, _mm256_div_ps(mapped, lum), &out[3 * x]);
+    }
+    return x;
+}
+
+TONEMAP_AVX2 static int tonemapBilateralRowAVX2(const float* center, const float* const* up, const float* const* down,
+                                                const float* weights, int radius, float rangeScale, float* out, int count)
+{
+    const __m256 scale = _mm256_set1_ps(rangeScale);
+    int x, i;
+    for (x = 0; x + 8 <= count; x += 8) {
+        __m256 c = _mm256_loadu_ps(&center[x]);
+        __m256 sum = _mm256_mul_ps(_mm256_set1_ps(weights[0]), c);
+        __m256 total = _mm256_set1_ps(weights[0]);
+        for (i = 1; i <= radius; i++) {
+            __m256 w = _mm256_set1_ps(weights[i]);
+            __m256 a = _mm256_loadu_ps(&up[i][x]);
+            __m256 b = _mm256_loadu_ps(&down[i][x]);
+            __m256 da = _mm256_sub_ps(a, c), db = _mm256_sub_ps(b, c);
+            __m256 wa = _mm256_mul_ps(w, tonemapExp2AVX2(_mm256_mul_ps(_mm256_mul_ps(scale, da), da)));
+            __m256 wb = _mm256_mul_ps(w, tonemapExp2AVX2(_mm256_mul_ps(_mm256_mul_ps(scale, db), db)));
+            sum = _mm256_add_ps(sum, _mm256_add_ps(_mm256_mul_ps(wa, a), _mm256_mul_ps(wb, b)));
+            total = _mm256_add_ps(total, _mm256_add_ps(wa, wb));
+        }
+        _mm256_storeu_ps(&out[x], _mm256_div_ps(sum, total));
+    }
+    return x;
+}
+
+TONEMAP_AVX2 static int tonemapCombineRowAVX2(const TMcombine* job, const float* rgb, const float* row0,
+                                              const float* row1, float fy, float* out)
+{
+    const __m256 one = _mm256_set1_ps(1.0f);
+    const __m256 scale = _mm256_set1_ps(job->rangeScale);
+    const __m256 vfy = _mm256_set1_ps(fy), gy = _mm256_sub_ps(one, vfy);
+    int x, i;
+    for (x = 0; x + 8 <= job->width; x += 8) {
+        __m256 a = _mm256_loadu_ps(&rgb[3 * x]);
+        __m256 b = _mm256_loadu_ps(&rgb[3 * x + 8]);
+        __m256 c = _mm256_loadu_ps(&rgb[3 * x + 16]);
+        __m256 lum = _mm256_max_ps(tonemapLuminanceAVX2(a, b, c), _mm256_set1_ps(TONEMAP_MIN_LUMINANCE));
+        __m256 logLum = _mm256_mul_ps(tonemapLog2AVX2(lum), _mm256_set1_ps(TONEMAP_LOG10_2));
+        __m256i x0 = _mm256_loadu_si256((const __m256i*)&job->x0[x]);
+        __m256i x1 = _mm256_loadu_si256((const __m256i*)&job->x1[x]);
+        __m256 fx = _mm256_loadu_ps(&job->fx[x]), gx = _mm256_sub_ps(one, fx);
+        __m256 w[4], base[4], wr[4], baseLum, detail, mapped;
+        w[0] = _mm256_mul_ps(gx, gy);
+        w[1] = _mm256_mul_ps(fx, gy);
+        w[2] = _mm256_mul_ps(gx, vfy);
+        w[3] = _mm256_mul_ps(fx, vfy);
+        base[0] = _mm256_i32gather_ps(row0, x0, 4);
+        base[1] = _mm256_i32gather_ps(row0, x1, 4);
+        base[2] = _mm256_i32gather_ps(row1, x0, 4);
+        base[3] = _mm256_i32gather_ps(row1, x1, 4);
+        for (i = 0; i < 4; i++) {
+            __m256 d = _mm256_sub_ps(base[i], logLum);
+            wr[i] = _mm256_add_ps(_mm256_mul_ps(w[i], tonemapExp2AVX2(_mm256_mul_ps(_mm256_mul_ps(scale, d), d))),
+                                  _mm256_mul_ps(_mm256_set1_ps(0.0001f), w[i]));
+        }
+        baseLum = _mm256_div_ps(
+            _mm256_add_ps(_mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(wr[0], base[0]), _mm256_mul_ps(wr[1], base[1])),
+                                        _mm256_mul_ps(wr[2], base[2])), _mm256_mul_ps(wr[3], base[3])),
+            _mm256_add_ps(_mm256_add_ps(_mm256_add_ps(wr[0], wr[1]), wr[2]), wr[3]));
+        detail = _mm256_sub_ps(logLum, baseLum);
+        mapped = _mm256_mul_ps(_mm256_set1_ps(job->exposure),
+                               tonemapExp2AVX2(_mm256_mul_ps(_mm256_add_ps(_mm256_mul_ps(_mm256_set1_ps(job->compression), baseLum),
+                                                                           detail), _mm256_set1_ps(TONEMAP_LOG2_10))));
+        tonemapScaleAVX2(a, b, c, _mm256_div_ps(mapped, lum), &out[3 * x]);
+    }
+    return x;
+}
+
+#endif
+
+/* ---- rows ---- */
+
+/* tonemapLuminanceRow: luminance of count pixels */
+static void tonemapLuminanceRow(const float* rgb, float* lum, int count)
+{
+    int x = 0;
+#ifdef TONEMAP_X86
+    if (tonemapHasSIMD())
+        x = tonemapLuminanceRowAVX2(rgb, lum, count);
+#endif
+    for (; x < count; x++)
+        lum[x] = tonemapLuminance(&rgb[3 * x]);
+}
+
+/* tonemapLog2Row: replaces each v by log2(max(v, lo) + add) */
+static void tonemapLog2Row(float* v, int count, float lo, float add)
+{
+    int x = 0;
+#ifdef TONEMAP_X86
+    if (tonemapHasSIMD())
+        x = tonemapLog2RowAVX2(v, count, lo, add);
+#endif
+    for (; x < count; x++)
+        v[x] = tonemapLog2((v[x] > lo ? v[x] : lo) + add);
+}
+
+/* tonemapBand: the rows of a task, as [*first, return value) */
+static int tonemapBand(int index, int height, int* first)
+{
+    int last = (index + 1) * TONEMAP_ROWS_PER_TASK;
+    *first = index * TONEMAP_ROWS_PER_TASK;
+    return last < height ? last : height;
+}
+
+/* tonemapBands: number of tasks for an image height */
+static int tonemapBands(int height)
+{
+    return (height + TONEMAP_ROWS_PER_TASK - 1) / TONEMAP_ROWS_PER_TASK;
+}
+
+/* tonemapClamp: i limited to [0, size) */
+static inline int tonemapClamp(int i, int size)
+{
+    return i < 0 ? 0 : i >= size ? size - 1 : i;
+}
+
+/* ---- Reinhard ---- */
+
+typedef struct {
+    const float* rgb;
+    int width, height;
+    double* sums;                       /* per band, the sum of the log luminances */
+    float* maxes;                       /* and the largest luminance */
+} TMaverageJob;
+
+static void tonemapAverageTask(int index, void* arg)
+{
+    const TMaverageJob* job = (const TMaverageJob*)arg;
+    float* lum = (float*)malloc(sizeof(float) * job->width);
+    float largest = 0.0f;
+    double sum = 0.0;
+    int first, last = tonemapBand(index, job->height, &first), x, y;
+    for (y = first; y < last; y++) {
+        tonemapLuminanceRow(job->rgb + (size_t)3 * job->width * y, lum, job->width);
+        for (x = 0; x < job->width; x++)
+            largest = lum[x] > largest ? lum[x] : largest;
+        tonemapLog2Row(lum, job->width, 0.0f, TONEMAP_MIN_LUMINANCE);
+        for (x = 0; x < job->width; x++)
+            sum += lum[x];
+    }
+    free(lum);
+    job->sums[index] = sum;
+    job->maxes[index] = largest;
+}
+
+void tonemapLogAverage(const float* rgb, int width, int height, float* logAverage, float* maxLuminance)
+{
+    TMaverageJob job;
+    int bands = tonemapBands(height), i;
+    double sum = 0.0;
+    float largest = 0.0f;
+    job.rgb = rgb;
+    job.width = width;
+    job.height = height;
+    job.sums = (double*)malloc(sizeof(double) * bands);
+    job.maxes = (float*)malloc(sizeof(float) * bands);
+    parallelFor(bands, tonemapAverageTask, &job);
+
+    /* add the bands up in order, so the result doesn't depend on the threads */
+    for (i = 0; i < bands; i++) {
+        sum += job.sums[i];
+        largest = job.maxes[i] > largest ? job.maxes[i] : largest;
+    }
+    free(job.sums);
+    free(job.maxes);
+    *logAverage = width > 0 && height > 0 ? (float)(sum * TONEMAP_LN2 / ((double)width * height)) : 0.0f;
+    *maxLuminance = largest;
+}
+
+typedef struct {
+    TMreinhard map;
+    const float* rgb;
+    float* out;
+    int width, height;
+} TMreinhardJob;
+
+static void tonemapReinhardTask(int index, void* arg)
+{
+    const TMreinhardJob* job = (const TMreinhardJob*)arg;
+    int first, last = tonemapBand(index, job->height, &first), x, y, c;
+    for (y = first; y < last; y++) {
+        const float* rgb = job->rgb + (size_t)3 * job->width * y;
+        float* out = job->out + (size_t)3 * job->width * y;
+        x = 0;
+#ifdef TONEMAP_X86
+        if (tonemapHasSIMD())
+            x = tonemapReinhardRowAVX2(&job->map, rgb, out, job->width);
+#endif
+        for (; x < job->width; x++) {
+            float ratio = tonemapReinhardRatio(&job->map, tonemapLuminance(&rgb[3 * x]));
+            for (c = 0; c < 3; c++)
+                out[3 * x + c] = rgb[3 * x + c] * ratio;
+        }
+    }
+}
+
+/* tonemapReinhardImage: runs a Reinhard mapping over an image */
+static void tonemapReinhardImage(const TMreinhard* map, const float* rgb, int width, int height, float* out)
+{
+    TMreinhardJob job;
+    job.map = *map;
+    job.rgb = rgb;
+    job.out = out;
+    job.width = width;
+    job.height = height;
+    parallelFor(tonemapBands(height), tonemapReinhardTask, &job);
+}
+
+void tonemapReinhard(const float* rgb, int width, int height, float exposure, float* out)
+{
+    TMreinhard map;
+    memset(&map, 0, sizeof(map));
+    map.exposure = exposure;
+    tonemapReinhardImage(&map, rgb, width, height, out);
+}
+
+void tonemapReinhardKey(const float* rgb, int width, int height, float exposure,
+                        float logAverage, float maxLuminance, float* out)
+{
+    TMreinhard map;
+    float white;
+    map.key = 1;
+    map.exposure = exposure;
+    map.scale = exposure / expf(logAverage);
+    white = map.scale * maxLuminance;
+    white = white > TONEMAP_MIN_LUMINANCE ? white : TONEMAP_MIN_LUMINANCE;
+    map.white2 = white * white;
+    tonemapReinhardImage(&map, rgb, width, height, out);
+}
+
+/* ---- bilateral ---- */
+
+typedef struct {
+    const float* rgb;
+    int width, height;
+    float* loglum;
+    int basewidth, baseheight;
+} TMdownJob;
+
+/* tonemapDownTask: a band of base rows.  Like bilat_down.frag, every
+ * base texel is the average log luminance of the four 2x2 blocks of
+ * the 4x4 pixels it covers.
+ */
+static void tonemapDownTask(int index, void* arg)
+{
+    const TMdownJob* job = (const TMdownJob*)arg;
+    int width = job->width, basewidth = job->basewidth;
+    float* lum = (float*)malloc(sizeof(float) * (4 * width + 4 * basewidth));
+    float* block = lum + 4 * width;
+    int first, last = tonemapBand(index, job->baseheight, &first), x, y, i, k;
+    for (y = first; y < last; y++) {
+        for (i = 0; i < 4; i++)
+            tonemapLuminanceRow(job->rgb + (size_t)3 * width * tonemapClamp(TONEMAP_DOWNSAMPLE * y + i, job->height),
+                                lum + i * width, width);
+        for (k = 0; k < 4; k++) {
+            const float* top = lum + (k & 2) * width;
+            const float* bottom = top + width;
+            float* out = block + k * basewidth;
+            for (x = 0; x < basewidth; x++) {
+                int x0 = tonemapClamp(TONEMAP_DOWNSAMPLE * x + 2 * (k & 1), width);
+                int x1 = tonemapClamp(TONEMAP_DOWNSAMPLE * x + 2 * (k & 1) + 1, width);
+                out[x] = 0.25f * ((top[x0] + top[x1]) + (bottom[x0] + bottom[x1]));
+            }
+            tonemapLog2Row(out, basewidth, TONEMAP_MIN_LUMINANCE, 0.0f);
+        }
+        for (x = 0; x < basewidth; x++)
+            job->loglum[(size_t)basewidth * y + x] = (block[x] + block[basewidth + x] + block[2 * basewidth + x] +
+                                                      block[3 * basewidth + x]) * (0.25f * TONEMAP_LOG10_2);
+    }
+    free(lum);
+}
+
+void tonemapLogLuminance(const float* rgb, int width, int height, float* loglum)
+{
+    TMdownJob job;
+    job.rgb = rgb;
+    job.width = width;
+    job.height = height;
+    job.loglum = loglum;
+    job.basewidth = tonemapBaseSize(width);
+    job.baseheight = tonemapBaseSize(height);
+    parallelFor(tonemapBands(job.baseheight), tonemapDownTask, &job);
+}
+
+typedef struct {
+    const float* src;
+    float* dst;
+    int width, height;
+    int radius;
+    float weights[TONEMAP_MAX_RADIUS + 1];  /* spatial gaussian, weights[0] is the center */
+    float rangeScale;                   /* -1 / (2 sigma_r^2), times log2 e */
+} TMbilateralJob;
+
+/* tonemapBilateralRow: one row of a filter pass */
+static void tonemapBilateralRow(const TMbilateralJob* job, const float* center, const float* const* up,
+                                const float* const* down, float* out)
+{
+    int x = 0;
+#ifdef TONEMAP_X86
+    if (tonemapHasSIMD())
+        x = tonemapBilateralRowAVX2(center, up, down, job->weights, job->radius, job->rangeScale, out, job->width);
+#endif
+    for (; x < job->width; x++)
+        out[x] = tonemapBilateralTexel(center, up, down, job->weights, job->radius, job->rangeScale, x);
+}
+
+/* tonemapHorizontalTask: filters a band of rows along x.  Each row is
+ * copied out with its edge texels repeated radius times either side,
+ * so the kernel never has to clamp.
+ */
+static void tonemapHorizontalTask(int index, void* arg)
+{
+    const TMbilateralJob* job = (const TMbilateralJob*)arg;
+    const float* up[TONEMAP_MAX_RADIUS + 1];
+    const float* down[TONEMAP_MAX_RADIUS + 1];
+    int width = job->width, radius = job->radius;
+    float* row = (float*)malloc(sizeof(float) * (width + 2 * radius));
+    int first, last = tonemapBand(index, job->height, &first), x, y, i;
+    for (i = 1; i <= radius; i++) {
+        up[i] = row + radius + i;
+        down[i] = row + radius - i;
+    }
+    for (y = first; y < last; y++) {
+        const float* src = job->src + (size_t)width * y;
+        for (x = 0; x < radius; x++) {
+            row[x] = src[0];
+            row[radius + width + x] = src[width - 1];
+        }
+        memcpy(row + radius, src, sizeof(float) * width);
+        tonemapBilateralRow(job, row + radius, up, down, job->dst + (size_t)width * y);
+    }
+    free(row);
+}
+
+/* tonemapVerticalTask: filters a band of rows along y, a whole row of
+ * taps at a time
+ */
+static void tonemapVerticalTask(int index, void* arg)
+{
+    const TMbilateralJob* job = (const TMbilateralJob*)arg;
+    const float* up[TONEMAP_MAX_RADIUS + 1];
+    const float* down[TONEMAP_MAX_RADIUS + 1];
+    int width = job->width;
+    int first, last = tonemapBand(index, job->height, &first), y, i;
+    for (y = first; y < last; y++) {
+        for (i = 1; i <= job->radius; i++) {
+            up[i] = job->src + (size_t)width * tonemapClamp(y + i, job->height);
+            down[i] = job->src + (size_t)width * tonemapClamp(y - i, job->height);
+        }
+        tonemapBilateralRow(job, job->src + (size_t)width * y, up, down, job->dst + (size_t)width * y);
+    }
+}
+
+void tonemapBilateral(const float* loglum, int width, int height, int radius, float rangeSigma, float* base)
+{
+    TMbilateralJob job;
+    float sigma, twoSigmaSigma;
+    float* half;
+    int x;
+    if (radius > TONEMAP_MAX_RADIUS)
+        radius = TONEMAP_MAX_RADIUS;
+    if (radius < 0)
+        radius = 0;
+    half = (float*)malloc(sizeof(float) * width * height);
+    if (!half)
+        return;
+
+    /* the same kernel as Renderer::createBilatKernel */
+    sigma = (radius > 1 ? radius : 1) / 3.0f;
+    twoSigmaSigma = 2.0f * sigma * sigma;
+    for (x = 0; x <= radius; x++)
+        job.weights[x] = expf(-(x * x) / twoSigmaSigma);
+    job.radius = radius;
+    job.rangeScale = (float)(-0.5 / (rangeSigma * rangeSigma) * TONEMAP_LOG2E);
+    job.width = width;
+    job.height = height;
+
+    job.src = loglum;
+    job.dst = half;
+    parallelFor(tonemapBands(height), tonemapHorizontalTask, &job);
+    job.src = half;
+    job.dst = base;
+    parallelFor(tonemapBands(height), tonemapVerticalTask, &job);
+    free(half);
+}
+
+static void tonemapCombineTask(int index, void* arg)
+{
+    const TMcombine* job = (const TMcombine*)arg;
+    int first, last = tonemapBand(index, job->height, &first), x, y, c;
+    for (y = first; y < last; y++) {
+        const float* rgb = job->rgb + (size_t)3 * job->width * y;
+        float* out = job->out + (size_t)3 * job->width * y;
+        float py = ((y + 0.5f) / job->height) * job->baseheight - 0.5f;
+        float fy0 = floorf(py), fy = py - fy0;
+        const float* row0 = job->base + (size_t)job->basewidth * tonemapClamp((int)fy0, job->baseheight);
+        const float* row1 = job->base + (size_t)job->basewidth * tonemapClamp((int)fy0 + 1, job->baseheight);
+        x = 0;
+#ifdef TONEMAP_X86
+        if (tonemapHasSIMD())
+            x = tonemapCombineRowAVX2(job, rgb, row0, row1, fy, out);
+#endif
+        for (; x < job->width; x++) {
+            float fx = job->fx[x], w[4], b[4], ratio;
+            w[0] = (1.0f - fx) * (1.0f - fy);
+            w[1] = fx * (1.0f - fy);
+            w[2] = (1.0f - fx) * fy;
+            w[3] = fx * fy;
+            b[0] = row0[job->x0[x]];
+            b[1] = row0[job->x1[x]];
+            b[2] = row1[job->x0[x]];
+            b[3] = row1[job->x1[x]];
+            ratio = tonemapCombineRatio(job, tonemapLuminance(&rgb[3 * x]), w, b);
+            for (c = 0; c < 3; c++)
+                out[3 * x + c] = rgb[3 * x + c] * ratio;
+        }
+    }
+}
+
+void tonemapCombine(const float* rgb, int width, int height, const float* base,
+                    float rangeSigma, float compression, float exposure, float* out)
+{
+    TMcombine job;
+    int* columns;
+    float* fx;
+    int x;
+    columns = (int*)malloc(sizeof(int) * 2 * width);
+    fx = (float*)malloc(sizeof(float) * width);
+    if (!columns || !fx) {
+        free(columns);
+        free(fx);
+        return;
+    }
+    job.rgb = rgb;
+    job.out = out;
+    job.width = width;
+    job.height = height;
+    job.base = base;
+    job.basewidth = tonemapBaseSize(width);
+    job.baseheight = tonemapBaseSize(height);
+    job.rangeScale = (float)(-0.5 / (rangeSigma * rangeSigma) * TONEMAP_LOG2E);
+    job.compression = compression;
+    job.exposure = exposure;
+
+    /* which base texels every column falls between, as combine.frag
+       finds them from its texture coordinate */
+    for (x = 0; x < width; x++) {
+        float px = ((x + 0.5f) / width) * job.basewidth - 0.5f;
+        float fx0 = floorf(px);
+        columns[x] = tonemapClamp((int)fx0, job.basewidth);
+        columns[width + x] = tonemapClamp((int)fx0 + 1, job.basewidth);
+        fx[x] = px - fx0;
+    }
+    job.x0 = columns;
+    job.x1 = columns + width;
+    job.fx = fx;
+    parallelFor(tonemapBands(height), tonemapCombineTask, &job);
+    free(columns);
+    free(fx);
+}
+
+int tonemapDurandDorsey(const float* rgb, int width, int height, int radius, float rangeSigma,
+                        float compression, float exposure, float* out)
+{
+    size_t size = (size_t)tonemapBaseSize(width) * tonemapBaseSize(height);
+    float* loglum = (float*)malloc(sizeof(float) * 2 * size);
+    if (!loglum)
+        return 0;
+    tonemapLogLuminance(rgb, width, height, loglum);
+    tonemapBilateral(loglum, tonemapBaseSize(width), tonemapBaseSize(height), radius, rangeSigma, loglum + size);
+    tonemapCombine(rgb, width, height, loglum + size, rangeSigma, compression, exposure, out);
+    free(loglum);
+    return 1;
+}
@@ -0,0 +1,116 @@
+#ifndef TONEMAP_H
+#define TONEMAP_H
+
+/*
+      tonemap.h
+
+      CPU versions of the tone mapping done by the shaders, for tone
+      mapping .hdr files offline and making reference images to check
+      the GPU path against.  Images are float RGB, top row first, as
+      rgbeDecode and RGBE_ReadPixels_RLE give them.
+
+      Reinhard's global operator follows tonemap.frag and the log average
+      follows luminance.frag.  The Durand-Dorsey operator goes through
+      the same stages as the bilateral render graph: bilat_down.frag
+      shrinks the image by TONEMAP_DOWNSAMPLE into its log10 luminance,
+      bilat.frag filters that along x and then y, and combine.frag splits
+      off the detail, compresses the base and puts the color back by
+      scaling each pixel by its new over its old luminance.  Borders are
+      clamped, as the textures are.
+
+      The work is spread over the parallel.h pool in bands of rows, and
+      every kernel has an AVX2 version, picked at runtime, that does 8
+      pixels of a row at once.  exp and log are evaluated with the same
+      polynomials in both, so the two give exactly the same floats.
+*/
+
+/* TONEMAP_DOWNSAMPLE: how much smaller the bilateral base layer is */
+#define TONEMAP_DOWNSAMPLE 4
+
+/* TONEMAP_MAX_RADIUS: widest bilateral filter, as in bilat.frag */
+#define TONEMAP_MAX_RADIUS 32
+
+/* tonemapLogAverage: the average natural log of the luminance (plus
+ * 0.0001) of an image, and its largest luminance.
+ *
+ * rgb          - 3 * width * height floats
+ * logAverage   - receives the average log luminance
+ * maxLuminance - receives the largest luminance
+ */
+void tonemapLogAverage(const float* rgb, int width, int height, float* logAverage, float* maxLuminance);
+
+/* tonemapReinhard: Reinhard's operator with a fixed exposure,
+ * L * exposure / (L + 1).  out may be rgb.
+ *
+ * rgb      - 3 * width * height floats
+ * exposure - scale of the mapped luminance
+ * out      - receives 3 * width * height floats
+ */
+void tonemapReinhard(const float* rgb, int width, int height, float exposure, float* out);
+
+/* tonemapReinhardKey: Reinhard's operator scaled by the image's key,
+ * so its log average maps to exposure, and with its brightest pixel
+ * mapping to white.  out may be rgb.
+ *
+ * rgb          - 3 * width * height floats
+ * exposure     - what the average luminance maps to
+ * logAverage   - from tonemapLogAverage
+ * maxLuminance - from tonemapLogAverage
+ * out          - receives 3 * width * height floats
+ */
+void tonemapReinhardKey(const float* rgb, int width, int height, float exposure,
+                        float logAverage, float maxLuminance, float* out);
+
+/* tonemapBaseSize: width or height of the base layer of an image */
+int tonemapBaseSize(int size);
+
+/* tonemapLogLuminance: shrinks an image by TONEMAP_DOWNSAMPLE into the
+ * average log10 luminance of each block of pixels.
+ *
+ * rgb    - 3 * width * height floats
+ * loglum - receives tonemapBaseSize(width) * tonemapBaseSize(height) floats
+ */
+void tonemapLogLuminance(const float* rgb, int width, int height, float* loglum);
+
+/* tonemapBilateral: separable bilateral filter of a log luminance
+ * image, along x and then along y.  The spatial weights are a gaussian
+ * with a sigma of radius / 3, and the range weights a gaussian of the
+ * difference in log10 luminance.
+ *
+ * loglum     - width * height floats
+ * radius     - of the spatial filter, at most TONEMAP_MAX_RADIUS
+ * rangeSigma - sigma of the range gaussian
+ * base       - receives width * height floats; may not be loglum
+ */
+void tonemapBilateral(const float* loglum, int width, int height, int radius, float rangeSigma, float* base);
+
+/* tonemapCombine: Durand-Dorsey recombination.  The base layer is
+ * upsampled guided by each pixel's log luminance, the detail is what is
+ * left of it, and the pixel is scaled to a luminance of
+ * exposure * 10^(compression * base + detail).  out may be rgb.
+ *
+ * rgb         - 3 * width * height floats
+ * base        - tonemapBaseSize(width) * tonemapBaseSize(height) floats
+ * rangeSigma  - sigma of the range gaussian used for the base
+ * compression - contrast kept of the base layer
+ * exposure    - scale of the mapped luminance
+ * out         - receives 3 * width * height floats
+ */
+void tonemapCombine(const float* rgb, int width, int height, const float* base,
+                    float rangeSigma, float compression, float exposure, float* out);
+
+/* tonemapDurandDorsey: all the stages of the bilateral operator.
+ * Returns 0 if out of memory.  out may be rgb.
+ */
+int tonemapDurandDorsey(const float* rgb, int width, int height, int radius, float rangeSigma,
+                        float compression, float exposure, float* out);
+
+/* tonemapHasSIMD: returns nonzero if the AVX2 kernels are in use */
+int tonemapHasSIMD();
+
+/* tonemapSetSIMD: turns the AVX2 kernels on (if the processor supports
+ * them) or off.  Returns nonzero if they are in use afterwards.
+ */
+int tonemapSetSIMD(int enable);
+
+#endif // TONEMAP_H
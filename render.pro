@@ -0,0 +1,61 @@
+QT += core \
+    gui \
+    opengl
+TARGET = render
+TEMPLATE = app
+CONFIG += console
+CONFIG -= app_bundle
+INCLUDEPATH += lab \
+    lib \
+    math \
+    support
+DEPENDPATH += lab \
+    lib \
+    math \
+    support
+HEADERS += lab/renderer.h \
+    lab/rendergraph.h \
+    lab/readbackring.h \
+    lab/framecapture.h \
+    lab/environmentmanager.h \
+    lab/shadermanager.h \
+    lab/uniforms.h \
+    lab/drawlist.h \
+    lib/targa.h \
+    lib/glm.h \
+    lib/parallel.h \
+    lib/meshmath.h \
+    lib/rgbeimage.h \
+    lib/pixelpack.h \
+    lib/envfilter.h \
+    lib/envcache.h \
+    lib/tonemap.h \
+    math/vector.h \
+    support/resourceloader.h \
+    support/framewriter.h \
+    support/environmentdecoder.h \
+    support/camera.h \
+    rgbe/rgbe.h
+SOURCES += lab/renderer.cpp \
+    lab/rendergraph.cpp \
+    lab/readbackring.cpp \
+    lab/framecapture.cpp \
+    lab/environmentmanager.cpp \
+    lab/shadermanager.cpp \
+    lab/uniforms.cpp \
+    lab/drawlist.cpp \
+    lib/targa.cpp \
+    lib/glm.cpp \
+    lib/parallel.cpp \
+    lib/meshmath.cpp \
+    lib/rgbeimage.cpp \
+    lib/pixelpack.cpp \
+    lib/envfilter.cpp \
+    lib/envcache.cpp \
+    lib/tonemap.cpp \
+    support/resourceloader.cpp \
+    support/framewriter.cpp \
+    support/environmentdecoder.cpp \
+    support/batchmain.cpp \
+    support/camera.cpp \
+    rgbe/rgbe.cpp
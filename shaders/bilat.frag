@@ -1,58 +1,26 @@
-const int MAX_KERNEL_SIZE = 128;
+const int MAX_RADIUS = 32;
 uniform sampler2D tex;
-const float M_PI = 3.14159;
-const vec3 avgVector = vec3(0.299, 0.587, 0.114);
-
+uniform vec2 direction;             // one texel along the filter axis
+uniform int radius;
+uniform float weights[MAX_RADIUS + 1];  // spatial gaussian, weights[0] is the center
+uniform float rangeScale;           // -1 / (2 sigma_r^2), in log10 luminance
+
+// one axis of a separable bilateral filter over a log luminance image:
+// neighbours are weighted by their distance and by how far their
+// luminance is from the center's, so strong edges are not blurred across
 void main(void) {
-
-
-    int radius = 5;
-    int size = radius * 2 + 1;
-
-float kernel[MAX_KERNEL_SIZE];
-float sigma = radius / 3.0f;
-float twoSigmaSigma = 2.0f * sigma * sigma;
-float rootSigma = sqrt(twoSigmaSigma * M_PI);
-float total = 0.0f;
-for (int y = -radius, idx = 0; y <= radius; ++y)
-{
-    for (int x = -radius; x <= radius; ++x,++idx)
-    {
-        float d = x * x + y * y;
-        kernel[idx] = exp(-d / twoSigmaSigma) / rootSigma;
-        total += kernel[idx];
-    }
-}
-for (int i = 0; i < size * size; ++i)
-{
-    kernel[i] /= total;
-}
-
-int arraySize = size*size;
-
-
-    vec4 blurColor = vec4(0.0, 0.0, 0.0, 0.0);
-    vec4 test;
-    vec4 curr = texture2D(tex, gl_TexCoord[0].st);
-
-    float cur_lum = dot(avgVector, curr.rgb);
-    float blurOff_lum;
-    float colordist;
-    for(int i = 0; i < arraySize; i++){
-        vec4 blurOff = texture2D(tex, gl_TexCoord[0].st + (i - (arraySize/2)));
-
-        blurOff_lum = dot(avgVector, blurOff);
-
-        //If you print out colordist, it is a cool edge detector
-        colordist = abs(blurOff_lum - cur_lum);
-
-        colordist = colordist/(colordist+1);
-        vec4 convTemp = blurOff*kernel[i]*(1-colordist);
-
-        blurColor = blurColor + convTemp;
+    vec2 st = gl_TexCoord[0].st;
+    float center = texture2D(tex, st).r;
+    float sum = weights[0] * center;
+    float total = weights[0];
+    for(int i = 1; i <= radius; i++){
+        float a = texture2D(tex, st + float(i) * direction).r;
+        float b = texture2D(tex, st - float(i) * direction).r;
+        float wa = weights[i] * exp(rangeScale * (a - center) * (a - center));
+        float wb = weights[i] * exp(rangeScale * (b - center) * (b - center));
+        sum += wa * a + wb * b;
+        total += wa + wb;
     }
 
-    vec4 temp = curr-blurColor;
-    temp = dot(avgVector, temp);
-    gl_FragColor = temp;
+    gl_FragColor = vec4(vec3(sum / total), 1.0);
 }
@@ -0,0 +1,20 @@
+uniform sampler2D tex;
+uniform vec2 texel;                 // one texel of tex
+
+const vec3 avgVector = vec3(0.299, 0.587, 0.114);
+
+float logLuminance(vec2 st) {
+    return log(max(dot(avgVector, texture2D(tex, st).rgb), 0.0001)) / log(10.0);
+}
+
+// shrinks the hdr image by 4 into its log10 luminance; every output pixel
+// covers 4x4 input pixels, read as four linearly filtered 2x2 blocks
+void main(void) {
+    vec2 st = gl_TexCoord[0].st;
+    float lum = logLuminance(st + vec2(-texel.x, -texel.y)) +
+                logLuminance(st + vec2( texel.x, -texel.y)) +
+                logLuminance(st + vec2(-texel.x,  texel.y)) +
+                logLuminance(st + vec2( texel.x,  texel.y));
+
+    gl_FragColor = vec4(vec3(0.25 * lum), 1.0);
+}
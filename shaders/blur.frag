@@ -1,15 +1,18 @@
-const int MAX_KERNEL_SIZE = 128;
+const int MAX_TAPS = 33;
 uniform sampler2D tex;
-uniform int arraySize;
-uniform vec2 offsets[MAX_KERNEL_SIZE];
-uniform float kernel[MAX_KERNEL_SIZE];
+uniform vec2 direction;             // one texel along the blur axis
+uniform int taps;                   // used entries of offsets and weights
+uniform float offsets[MAX_TAPS];    // in texels, offsets[0] is the center
+uniform float weights[MAX_TAPS];
+
+// one axis of a separable gaussian blur; every tap but the center one sits
+// between two texels so the linear filter averages them for free
 void main(void) {
-    int i;
-    vec4 blurColor = vec4(0, 0, 0, 0);
-    for(i = 0; i < arraySize; i++){
-        vec4 blurOff = texture2D(tex, gl_TexCoord[0].st + offsets[i]);
-        vec4 conv = kernel[i] * blurOff;
-        blurColor = blurColor + conv;
+    vec2 st = gl_TexCoord[0].st;
+    vec4 blurColor = weights[0] * texture2D(tex, st);
+    for(int i = 1; i < taps; i++){
+        vec2 offset = offsets[i] * direction;
+        blurColor += weights[i] * (texture2D(tex, st + offset) + texture2D(tex, st - offset));
     }
 
     gl_FragColor = blurColor;
@@ -1,13 +1,36 @@
+#extension GL_ARB_uniform_buffer_object : require
+
+// Per-frame values, filled from FrameUniforms (renderer.h)
+layout(std140) uniform Frame
+{
+    vec3 irradiance[9];             // SH9 coefficients of the environment's diffuse light
+    float exposure;                 // with auto exposure, what the average luminance maps to
+    float logAverage;               // last adapted luminance read back
+    float maxLuminance;
+    float maxLod;                   // last mip level of the environment's cube map
+    bool autoExposure;
+    bool readback;                  // take logAverage and maxLuminance from here instead of the texture
+};
+
 uniform sampler2D tex;
+uniform sampler2D luminance;        // as in tonemap.frag
+uniform float threshold;
+
 const vec3 avgVector = vec3(0.299, 0.587, 0.114);
 void main(void) {
     vec4 sample = texture2D(tex, gl_TexCoord[0].st);
+    if (autoExposure) {
+        float adapted = readback ? logAverage : texture2D(luminance, vec2(0.5)).r;
+        sample.rgb *= exposure / exp(adapted);
+    } else {
+        sample.rgb *= exposure;
+    }
     float luminance = max(0.0, dot(avgVector, sample.rgb));
 
-
-   //sample.rgb = luminance/(luminance+1);
-   sample.rgb *= sign(luminance - 1.0);
-
+    // keep only the part of the luminance above the threshold, compressed
+    // below 1 like the tone mapped image, with the hue of the original color
+    float excess = max(luminance - threshold, 0.0);
+    sample.rgb *= excess / (1.0 + excess) / max(luminance, 0.0001);
 
     gl_FragColor = sample;
 }
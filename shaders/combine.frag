@@ -1,14 +1,54 @@
-uniform sampler2D tex;
+#extension GL_ARB_uniform_buffer_object : require
+
+// Per-frame values, filled from FrameUniforms (renderer.h)
+layout(std140) uniform Frame
+{
+    vec3 irradiance[9];             // SH9 coefficients of the environment's diffuse light
+    float exposure;                 // with auto exposure, what the average luminance maps to
+    float logAverage;               // last adapted luminance read back
+    float maxLuminance;
+    float maxLod;                   // last mip level of the environment's cube map
+    bool autoExposure;
+    bool readback;                  // take logAverage and maxLuminance from here instead of the texture
+};
+
+uniform sampler2D tex;              // hdr image
+uniform sampler2D base;             // bilateral filtered log10 luminance, smaller than tex
+uniform vec2 baseSize;              // size of base in pixels
+uniform float rangeScale;           // -1 / (2 sigma_r^2), as in bilat.frag
+uniform float compression;          // contrast kept of the base layer
+uniform bool showDetail;            // draw the detail layer instead
 
 const vec3 avgVector = vec3(0.299, 0.587, 0.114);
 
-//this shader is used on a texture that has the hdr luminance from the bilateral filter and the chromiance added together.
-//it maps the colors back to the appropriate range and relationship.
+// Durand-Dorsey tone mapping: the log luminance is split into a base layer
+// (upsampled from the small filtered image, guided by the full resolution
+// luminance so edges stay sharp) and a detail layer.  Only the base layer
+// is compressed, and the color is put back by scaling the hdr pixel.
 void main(void) {
-    vec4 sample_color = texture2D(tex, gl_TexCoord[0].st);
+    vec4 sample = texture2D(tex, gl_TexCoord[0].st);
+    float lum = max(dot(avgVector, sample.rgb), 0.0001);
+    float logLum = log(lum) / log(10.0);
+
+    // joint bilateral upsampling from the four nearest base texels
+    vec2 p = gl_TexCoord[0].st * baseSize - 0.5;
+    vec2 f = fract(p);
+    vec2 st = (floor(p) + 0.5) / baseSize;
+    float b00 = texture2D(base, st).r;
+    float b10 = texture2D(base, st + vec2(1.0, 0.0) / baseSize).r;
+    float b01 = texture2D(base, st + vec2(0.0, 1.0) / baseSize).r;
+    float b11 = texture2D(base, st + vec2(1.0, 1.0) / baseSize).r;
+    vec4 w = vec4((1.0 - f.x) * (1.0 - f.y), f.x * (1.0 - f.y), (1.0 - f.x) * f.y, f.x * f.y);
+    vec4 d = vec4(b00, b10, b01, b11) - logLum;
+    vec4 wr = w * exp(rangeScale * d * d) + 0.0001 * w;
+    float baseLum = dot(wr, vec4(b00, b10, b01, b11)) / dot(wr, vec4(1.0));
 
-    float lum = dot(avgVector, sample_color);
-    sample_color.rgb = lum*normalize(sample_color.rgb);
+    float detail = logLum - baseLum;
+    if (showDetail) {
+        gl_FragColor = vec4(vec3(0.5 + detail), 1.0);
+        return;
+    }
 
-    gl_FragColor = sample_color;
+    float mapped = exposure * pow(10.0, compression * baseLum + detail);
+    gl_FragColor = vec4(sample.rgb * (mapped / lum), 1.0);
 }
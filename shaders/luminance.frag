@@ -0,0 +1,28 @@
+uniform sampler2D tex;
+uniform vec2 spacing;               // distance between the 4x4 samples, in texture coordinates
+uniform bool first;                 // tex is the hdr image rather than a previous level
+
+const vec3 avgVector = vec3(0.299, 0.587, 0.114);
+
+// one step of the luminance reduction: every output pixel sums 4x4 samples
+// of the level before it into r = average log luminance, g = max luminance
+void main(void) {
+    vec2 st = gl_TexCoord[0].st;
+    float logSum = 0.0;
+    float maxLum = 0.0;
+    for(int y = 0; y < 4; y++){
+        for(int x = 0; x < 4; x++){
+            vec4 sample = texture2D(tex, st + (vec2(float(x), float(y)) - 1.5) * spacing);
+            if (first) {
+                float lum = max(dot(avgVector, sample.rgb), 0.0);
+                logSum += log(lum + 0.0001);
+                maxLum = max(maxLum, lum);
+            } else {
+                logSum += sample.r;
+                maxLum = max(maxLum, sample.g);
+            }
+        }
+    }
+
+    gl_FragColor = vec4(logSum / 16.0, maxLum, 0.0, 1.0);
+}
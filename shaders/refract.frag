@@ -1,3 +1,25 @@
+#extension GL_ARB_shader_texture_lod : require
+#extension GL_ARB_uniform_buffer_object : require
+
+// Per-frame values, filled from FrameUniforms (renderer.h)
+layout(std140) uniform Frame
+{
+    vec3 irradiance[9];             // SH9 coefficients of the environment's diffuse light
+    float exposure;                 // with auto exposure, what the average luminance maps to
+    float logAverage;               // last adapted luminance read back
+    float maxLuminance;
+    float maxLod;                   // last mip level of the environment's cube map
+    bool autoExposure;
+    bool readback;                  // take logAverage and maxLuminance from here instead of the texture
+};
+
+// The surface drawn, filled from MaterialUniforms (renderer.h)
+layout(std140) uniform Material
+{
+    float roughness;                // GGX roughness, read from cube map level roughness * maxLod
+    float diffuse;                  // how much of the diffuse light to add
+};
+
 uniform samplerCube envMap;
 varying vec3 normal, lightDir, r;
 
@@ -7,17 +29,28 @@ uniform float etaR;
 uniform float etaG;
 uniform float etaB;
 
+// The diffuse light reaching a surface facing n, over pi (see envfilter.h)
+vec3 diffuseLight(vec3 n)
+{
+        return irradiance[0] + irradiance[1] * n.y + irradiance[2] * n.z + irradiance[3] * n.x
+             + irradiance[4] * (n.x * n.y) + irradiance[5] * (n.y * n.z)
+             + irradiance[6] * (3.0 * n.z * n.z - 1.0) + irradiance[7] * (n.x * n.z)
+             + irradiance[8] * (n.x * n.x - n.y * n.y);
+}
+
 void main (void)
 {
-        vec4 final_color = textureCube(envMap, r);
+        float lod = roughness * maxLod;
+        vec4 final_color = textureCubeLod(envMap, r, lod);
         vec3 N = normalize(normal);
         vec3 L = normalize(lightDir);
         float lambertTerm = dot(N,L);
         if(lambertTerm > 0.0)
         {
                 // Specular
-                final_color += textureCube(envMap, r);
+                final_color += textureCubeLod(envMap, r, lod);
         }
+        final_color.rgb += diffuse * diffuseLight(N);
         gl_FragColor = final_color;
 }
 
@@ -1,13 +1,37 @@
+#extension GL_ARB_uniform_buffer_object : require
+
+// Per-frame values, filled from FrameUniforms (renderer.h)
+layout(std140) uniform Frame
+{
+    vec3 irradiance[9];             // SH9 coefficients of the environment's diffuse light
+    float exposure;                 // with auto exposure, what the average luminance maps to
+    float logAverage;               // last adapted luminance read back
+    float maxLuminance;
+    float maxLod;                   // last mip level of the environment's cube map
+    bool autoExposure;
+    bool readback;                  // take logAverage and maxLuminance from here instead of the texture
+};
+
 uniform sampler2D tex;
-uniform float exposure;
+uniform sampler2D luminance;        // 1x1, r = adapted log average luminance, g = adapted max luminance
 
 const vec3 avgVector = vec3(0.299, 0.587, 0.114);
 void main(void) {
     vec4 sample = texture2D(tex, gl_TexCoord[0].st);
+    float lum = max(dot(avgVector, sample.rgb), 0.0001);
 
-    float luminance = max(0.0, dot(avgVector, sample.rgb));
-
-    sample.rgb = vec3(1.0, 1.0, 1.0)*exposure*luminance/(luminance+1.0);
+    float mapped;
+    if (autoExposure) {
+        // Reinhard's operator scaled by the scene's key, with the brightest
+        // pixel mapping to white
+        vec2 adapted = readback ? vec2(logAverage, maxLuminance) : texture2D(luminance, vec2(0.5)).rg;
+        float scale = exposure / exp(adapted.r);
+        float scaled = scale * lum;
+        float white = max(scale * adapted.g, 0.0001);
+        mapped = scaled * (1.0 + scaled / (white * white)) / (1.0 + scaled);
+    } else {
+        mapped = exposure * lum / (lum + 1.0);
+    }
 
-    gl_FragColor = sample;
+    gl_FragColor = vec4(sample.rgb * (mapped / lum), sample.a);
 }
@@ -0,0 +1,240 @@
+#include <QtGui/QApplication>
+#include <QDir>
+#include <QGLFramebufferObject>
+#include <QGLPixelBuffer>
+#include <QStringList>
+#include <QTime>
+#include <QVector>
+#include <iostream>
+#include <math.h>
+#include "renderer.h"
+#include "framecapture.h"
+
+using std::cout;
+using std::cerr;
+using std::endl;
+
+// GLWidget advances the animation one tick per frame, at up to this many
+// frames per second
+static const float TICKS_PER_SECOND = 120.f;
+
+static void usage()
+{
+    cerr << "usage: render [options]" << endl
+         << "  --frames N          frames to render (1)" << endl
+         << "  --size WxH          resolution (1280x720)" << endl
+         << "  --step SECONDS      time between frames (1/60)" << endl
+         << "  --mode MODE         ldr, global, bilateral or detail (global)" << endl
+         << "  --exposure E        exposure (0.5)" << endl
+         << "  --orbit DEGREES     camera turn per second, for turntables (0)" << endl
+         << "  --env FILE          environment cross, a Radiance .hdr" << endl
+         << "  --out DIR           where frameNNNN.png and frameNNNN.hdr go (.)" << endl
+         << "  --no-png, --no-hdr  skip the tone mapped or the hdr frames" << endl
+         << "  --reference         also tone map the radiance on the CPU into" << endl
+         << "                      frameNNNN_ref.png, to check the GPU's against" << endl
+         << "                      (global or bilateral mode; no bloom)" << endl
+         << "  --verbose           report how each model was loaded" << endl
+         << "  --raw TARGET        also append raw RGBA frames to a file, or pipe" << endl
+         << "                      them into a command given as '|command'" << endl;
+}
+
+/**
+  Renders frames of the scene without a window: the same Renderer GLWidget
+  draws with, in an offscreen pixel buffer.  Every frame is read back through
+  a lossless FrameCapture, whose writer thread saves the tone mapped image as
+  PNG (or streams it raw) and the scene's radiance as RGBE while the next
+  frames render.  With --reference the writer also tone maps the radiance
+  with the CPU versions of the shaders (tonemap.h), making a golden image
+  for every frame.  Prints the average GPU time of every render graph pass
+  at the end.
+ **/
+int main(int argc, char *argv[])
+{
+    // The pixel buffer needs the GUI side of Qt for its display connection
+    QApplication app(argc, argv);
+
+    int frames = 1, width = 1280, height = 720;
+    float step = 1.f / 60.f, exposure = 0.5f, orbit = 0.f;
+    Renderer::Mode mode = Renderer::GlobalToneMapping;
+    QString env, out = ".", raw;
+    bool savePng = true, saveHdr = true, reference = false;
+
+    QStringList args = app.arguments();
+    for (int i = 1; i < args.size(); ++i)
+    {
+        QString arg = args[i];
+        bool ok = true;
+        if (arg == "--no-png")
+            savePng = false;
+        else if (arg == "--no-hdr")
+            saveHdr = false;
+        else if (arg == "--reference")
+            reference = true;
+        else if (arg == "--verbose")
+            ResourceLoader::setVerbose(true);
+        else if (i + 1 == args.size())
+            ok = false;
+        else
+        {
+            QString value = args[++i];
+            if (arg == "--frames")
+                frames = value.toInt(&ok);
+            else if (arg == "--size")
+            {
+                QStringList size = value.split('x');
+                ok = size.size() == 2;
+                if (ok)
+                    width = size[0].toInt(&ok);
+                if (ok)
+                    height = size[1].toInt(&ok);
+            }
+            else if (arg == "--step")
+                step = value.toFloat(&ok);
+            else if (arg == "--exposure")
+                exposure = value.toFloat(&ok);
+            else if (arg == "--orbit")
+                orbit = value.toFloat(&ok);
+            else if (arg == "--env")
+                env = value;
+            else if (arg == "--out")
+                out = value;
+            else if (arg == "--raw")
+                raw = value;
+            else if (arg == "--mode" && value == "ldr")
+                mode = Renderer::LowDynamicRange;
+            else if (arg == "--mode" && value == "global")
+                mode = Renderer::GlobalToneMapping;
+            else if (arg == "--mode" && value == "bilateral")
+                mode = Renderer::BilateralToneMapping;
+            else if (arg == "--mode" && value == "detail")
+                mode = Renderer::DetailLayer;
+            else
+                ok = false;
+        }
+
+        if (!ok || frames < 1 || width < 1 || height < 1)
+        {
+            cerr << "render: bad argument " << arg.toStdString() << endl;
+            usage();
+            return 1;
+        }
+    }
+    if (reference && mode != Renderer::GlobalToneMapping && mode != Renderer::BilateralToneMapping)
+    {
+        cerr << "render: --reference needs the global or bilateral mode" << endl;
+        return 1;
+    }
+    if (mode == Renderer::LowDynamicRange)
+        saveHdr = false;
+    if (!QDir().mkpath(out))
+    {
+        cerr << "render: cannot create " << out.toStdString() << endl;
+        return 1;
+    }
+
+    if (!QGLPixelBuffer::hasOpenGLPbuffers())
+    {
+        cerr << "render: no offscreen pixel buffers on this system" << endl;
+        return 1;
+    }
+    QGLPixelBuffer pbuffer(width, height);
+    if (!pbuffer.isValid() || !pbuffer.makeCurrent())
+    {
+        cerr << "render: cannot create a " << width << "x" << height << " pixel buffer" << endl;
+        return 1;
+    }
+
+    int failed;
+    {
+        Renderer renderer;
+        renderer.initialize();
+        if (!env.isEmpty())
+            renderer.loadCubeMap(env.toLocal8Bit().constData());
+        renderer.setMode(mode);
+        renderer.setExposure(exposure);
+        renderer.setKeepHdr(saveHdr || reference);
+        RenderGraph &graph = renderer.renderGraph();
+        graph.setTimingEnabled(true);
+
+        // Enough pixel buffers for three frames in flight
+        int perFrame = (savePng ? 1 : 0) + (saveHdr ? 1 : 0) + (reference ? 1 : 0) + (raw.isEmpty() ? 0 : 1);
+        FrameCapture capture(3 * qMax(perFrame, 1));
+        capture.setLossless(true);
+        if (reference)
+        {
+            ReferenceToneMapping toneMapping;
+            toneMapping.bilateral = mode == Renderer::BilateralToneMapping;
+            toneMapping.autoExposure = renderer.autoExposure();
+            toneMapping.exposure = exposure;
+            toneMapping.radius = renderer.bilateralRadius();
+            toneMapping.rangeSigma = renderer.bilateralRangeSigma();
+            toneMapping.compression = renderer.bilateralCompression();
+            capture.setReferenceToneMapping(toneMapping);
+        }
+        if (!raw.isEmpty())
+            capture.openStream(raw);
+
+        // The timer queries of a frame are collected two frames later, so
+        // the first frames have no pass timings yet
+        QVector<double> passTotals;
+        int timedFrames = 0;
+        double renderTotal = 0, readTotal = 0;
+        QTime clock;
+
+        for (int frame = 0; frame < frames; ++frame)
+        {
+            renderer.camera().theta += orbit * step * M_PI / 180.f;
+            renderer.advance(step, step * TICKS_PER_SECOND);
+
+            clock.start();
+            renderer.render(width, height);
+            glFinish();
+            renderTotal += clock.restart();
+
+            QString name = QString("%1/frame%2").arg(out).arg(frame, 4, 10, QChar('0'));
+            if (savePng)
+                capture.capture(FrameCapture::Png, name + ".png", width, height);
+            if (!raw.isEmpty())
+                capture.capture(FrameCapture::Raw, QString(), width, height);
+            if (saveHdr || reference)
+            {
+                QGLFramebufferObject *hdr = renderer.hdrFramebuffer();
+                hdr->bind();
+                if (saveHdr)
+                    capture.capture(FrameCapture::Rgbe, name + ".hdr", width, height);
+                if (reference)
+                    capture.capture(FrameCapture::Reference, name + "_ref.png", width, height);
+                hdr->release();
+            }
+            capture.poll();
+            readTotal += clock.elapsed();
+
+            if (mode != Renderer::LowDynamicRange && frame >= 2)
+            {
+                passTotals.resize(graph.numPasses());
+                for (int i = 0; i < graph.numPasses(); ++i)
+                    passTotals[i] += graph.passMilliseconds(i);
+                timedFrames++;
+            }
+        }
+
+        clock.start();
+        capture.finish();
+        failed = capture.failed();
+
+        cout << frames << " frames of " << width << "x" << height << ": " << renderTotal / frames
+             << " ms rendering, " << readTotal / frames << " ms capturing per frame, "
+             << clock.elapsed() << " ms to finish writing; " << capture.written() << " of "
+             << capture.captured() << " captures written, " << failed << " failed" << endl;
+        if (timedFrames)
+        {
+            cout << "GPU time per pass, averaged over " << timedFrames << " frames:" << endl;
+            for (int i = 0; i < passTotals.size(); ++i)
+                cout << "  " << graph.passName(i).toStdString() << ": "
+                     << passTotals[i] / timedFrames << " ms" << endl;
+        }
+    }
+    pbuffer.doneCurrent();
+
+    return failed ? 1 : 0;
+}
@@ -0,0 +1,79 @@
+#include "environmentdecoder.h"
+
+#include <QMutexLocker>
+
+EnvironmentDecoder::EnvironmentDecoder() :
+    m_format(GL_R11F_G11F_B10F), m_requested(false), m_running(false), m_ready(false)
+{
+}
+
+/**
+  Drops any request not started yet and waits for the one being decoded.
+ **/
+EnvironmentDecoder::~EnvironmentDecoder()
+{
+    m_mutex.lock();
+    m_requested = false;
+    m_mutex.unlock();
+    wait();
+}
+
+void EnvironmentDecoder::decode(const QString &filename, GLenum format)
+{
+    QMutexLocker lock(&m_mutex);
+    m_filename = filename;
+    m_format = format;
+    m_requested = true;
+    m_ready = false;
+    if (!m_running)
+    {
+        // The thread may still be on its way out of run()
+        wait();
+        m_running = true;
+        start();
+    }
+}
+
+bool EnvironmentDecoder::take(CubeFaces &faces)
+{
+    QMutexLocker lock(&m_mutex);
+    if (!m_ready)
+        return false;
+    faces = m_faces;
+    m_faces = CubeFaces();
+    m_ready = false;
+    return true;
+}
+
+/**
+  The decoder thread: decodes the latest request until there are none left.
+ **/
+void EnvironmentDecoder::run()
+{
+    forever
+    {
+        m_mutex.lock();
+        if (!m_requested)
+        {
+            m_running = false;
+            m_mutex.unlock();
+            break;
+        }
+        QByteArray filename = m_filename.toLocal8Bit();
+        GLenum format = m_format;
+        m_requested = false;
+        m_mutex.unlock();
+
+        CubeFaces faces;
+        ResourceLoader::decodeCubeCross(filename.constData(), format, faces);
+
+        // Keep the faces only if nothing newer was asked for meanwhile
+        m_mutex.lock();
+        if (!m_requested)
+        {
+            m_faces = faces;
+            m_ready = true;
+        }
+        m_mutex.unlock();
+    }
+}
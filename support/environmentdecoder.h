@@ -0,0 +1,41 @@
+#ifndef ENVIRONMENTDECODER_H
+#define ENVIRONMENTDECODER_H
+
+#include <QMutex>
+#include <QString>
+#include <QThread>
+#include "resourceloader.h"
+
+/**
+    Decodes vertical cross .hdr images into packed cube map faces on its own
+    thread, so that loading a new environment costs the render loop nothing
+    but the upload.  Only the latest request counts: one made while another
+    is being decoded supersedes it, and the older faces are thrown away.
+ **/
+class EnvironmentDecoder : public QThread
+{
+public:
+    EnvironmentDecoder();
+    ~EnvironmentDecoder();
+
+    // Starts decoding a file, superseding any earlier request
+    void decode(const QString &filename, GLenum format);
+
+    // Hands over the faces of the latest request once they are decoded (with
+    // a size of 0 if that failed); returns false until then
+    bool take(CubeFaces &faces);
+
+protected:
+    void run();
+
+private:
+    QMutex m_mutex;
+    QString m_filename;                 // the latest request
+    GLenum m_format;
+    bool m_requested;                   // it has not been started yet
+    bool m_running;                     // run() will look for requests again
+    CubeFaces m_faces;                  // the result of the latest request
+    bool m_ready;
+};
+
+#endif // ENVIRONMENTDECODER_H
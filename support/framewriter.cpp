@@ -0,0 +1,313 @@
+#include "framewriter.h"
+
+#include <QImage>
+#include <QMutexLocker>
+#include "rgbeimage.h"
+#include "tonemap.h"
+
+/**
+  A tone mapped channel as the GPU stores it in an 8-bit framebuffer.
+ **/
+static inline int unorm8(float value)
+{
+    return value <= 0.f ? 0 : value >= 1.f ? 255 : (int) (value * 255.f + 0.5f);
+}
+
+FrameWriter::FrameWriter(int maxQueued) :
+    m_maxQueued(maxQueued), m_dropWhenFull(false), m_stop(false),
+    m_written(0), m_failed(0), m_dropped(0), m_stream(0), m_pipe(false)
+{
+}
+
+FrameWriter::~FrameWriter()
+{
+    finish();
+}
+
+/**
+  Queues an 8-bit RGBA frame, bottom row first, to be saved as a PNG.
+ **/
+bool FrameWriter::writePng(const QString &path, const QByteArray &rgba, int width, int height)
+{
+    Job job;
+    job.kind = Png;
+    job.path = path;
+    job.pixels = rgba;
+    job.width = width;
+    job.height = height;
+    return enqueue(job, true);
+}
+
+/**
+  Queues a float RGB frame, bottom row first, to be saved as Radiance RGBE.
+ **/
+bool FrameWriter::writeHdr(const QString &path, const QByteArray &rgb, int width, int height)
+{
+    Job job;
+    job.kind = Rgbe;
+    job.path = path;
+    job.pixels = rgb;
+    job.width = width;
+    job.height = height;
+    return enqueue(job, true);
+}
+
+/**
+  Queues a float RGB frame, bottom row first, to be tone mapped on the CPU and
+  saved as a PNG.
+ **/
+bool FrameWriter::writeReference(const QString &path, const QByteArray &rgb, int width, int height,
+                                 const ReferenceToneMapping &toneMapping)
+{
+    Job job;
+    job.kind = Reference;
+    job.path = path;
+    job.pixels = rgb;
+    job.width = width;
+    job.height = height;
+    job.toneMapping = toneMapping;
+    return enqueue(job, true);
+}
+
+/**
+  Queues an 8-bit RGBA frame, bottom row first, to be appended to the stream.
+ **/
+bool FrameWriter::writeRaw(const QByteArray &rgba, int width, int height)
+{
+    Job job;
+    job.kind = Raw;
+    job.pixels = rgba;
+    job.width = width;
+    job.height = height;
+    return enqueue(job, true);
+}
+
+void FrameWriter::openStream(const QString &target)
+{
+    Job job;
+    job.kind = OpenStream;
+    job.path = target;
+    job.width = job.height = 0;
+    enqueue(job, false);
+}
+
+void FrameWriter::closeStream()
+{
+    Job job;
+    job.kind = CloseStream;
+    job.width = job.height = 0;
+    enqueue(job, false);
+}
+
+/**
+  Queues a job, waiting for room if the queue is full.  Frames are dropped
+  instead when that is enabled; opening and closing the stream never are.
+
+  @return whether the job was queued
+ **/
+bool FrameWriter::enqueue(const Job &job, bool droppable)
+{
+    QMutexLocker lock(&m_mutex);
+    if (droppable && m_dropWhenFull && m_jobs.size() >= m_maxQueued)
+    {
+        m_dropped++;
+        return false;
+    }
+    while (droppable && m_jobs.size() >= m_maxQueued)
+        m_taken.wait(&m_mutex);
+    m_jobs.enqueue(job);
+    m_queued.wakeOne();
+    return true;
+}
+
+/**
+  Lets the queued jobs finish and stops the thread; a stream still open is
+  closed.  The writer can be started again afterwards.
+ **/
+void FrameWriter::finish()
+{
+    if (!isRunning())
+        return;
+    m_mutex.lock();
+    m_stop = true;
+    m_queued.wakeOne();
+    m_mutex.unlock();
+    wait();
+    m_stop = false;
+}
+
+void FrameWriter::setDropWhenFull(bool drop)
+{
+    QMutexLocker lock(&m_mutex);
+    m_dropWhenFull = drop;
+}
+
+int FrameWriter::written() const
+{
+    QMutexLocker lock(&m_mutex);
+    return m_written;
+}
+
+int FrameWriter::failed() const
+{
+    QMutexLocker lock(&m_mutex);
+    return m_failed;
+}
+
+int FrameWriter::dropped() const
+{
+    QMutexLocker lock(&m_mutex);
+    return m_dropped;
+}
+
+/**
+  The writer thread: takes the queued jobs in order until it is stopped and
+  the queue is empty.
+ **/
+void FrameWriter::run()
+{
+    forever
+    {
+        m_mutex.lock();
+        while (m_jobs.isEmpty() && !m_stop)
+            m_queued.wait(&m_mutex);
+        if (m_jobs.isEmpty())
+        {
+            m_mutex.unlock();
+            break;
+        }
+        Job job = m_jobs.dequeue();
+        m_taken.wakeAll();
+        m_mutex.unlock();
+
+        bool ok = write(job);
+
+        // Opening or closing the stream only counts when it fails
+        if (!ok || (job.kind != OpenStream && job.kind != CloseStream))
+        {
+            m_mutex.lock();
+            if (ok)
+                m_written++;
+            else
+                m_failed++;
+            m_mutex.unlock();
+        }
+    }
+
+    Job close;
+    close.kind = CloseStream;
+    write(close);
+}
+
+/**
+  Flips a frame upright and saves it, or opens or closes the stream.
+
+  @return whether it worked
+ **/
+bool FrameWriter::write(const Job &job)
+{
+    int width = job.width, height = job.height;
+    switch (job.kind)
+    {
+        case OpenStream:
+        {
+            Job close;
+            close.kind = CloseStream;
+            write(close);
+            QByteArray target = job.path.toLocal8Bit();
+            m_pipe = target.startsWith('|');
+            m_stream = m_pipe ? popen(target.constData() + 1, "w") : fopen(target.constData(), "wb");
+            return m_stream != 0;
+        }
+
+        case CloseStream:
+        {
+            if (!m_stream)
+                return true;
+            int status = m_pipe ? pclose(m_stream) : fclose(m_stream);
+            m_stream = 0;
+            return status == 0;
+        }
+
+        case Raw:
+        {
+            if (!m_stream)
+                return false;
+            const char *pixels = job.pixels.constData();
+            bool ok = true;
+            for (int y = height - 1; y >= 0 && ok; --y)
+                ok = fwrite(pixels + 4 * width * y, 4 * width, 1, m_stream) == 1;
+            return ok;
+        }
+
+        case Png:
+        {
+            const uchar *pixels = (const uchar *) job.pixels.constData();
+            QImage image(width, height, QImage::Format_RGB32);
+            for (int y = 0; y < height; ++y)
+            {
+                const uchar *src = pixels + 4 * width * (height - 1 - y);
+                QRgb *dst = (QRgb *) image.scanLine(y);
+                for (int x = 0; x < width; ++x, src += 4)
+                    dst[x] = qRgb(src[0], src[1], src[2]);
+            }
+            return image.save(job.path, "PNG");
+        }
+
+        case Rgbe:
+        {
+            // Flipped upright as it is encoded, over the pool, into a buffer
+            // kept between frames so a sequence doesn't reallocate it
+            const float *pixels = (const float *) job.pixels.constData();
+            size_t bound = rgbeEncodeBound(width, height);
+            if ((size_t) m_encoded.size() < bound)
+                m_encoded.resize(bound);
+            size_t size = rgbeEncode(pixels, width, height, 1, (unsigned char *) m_encoded.data());
+
+            FILE *file = fopen(job.path.toLocal8Bit().constData(), "wb");
+            if (!file)
+                return false;
+            bool ok = size > 0 && fwrite(m_encoded.constData(), 1, size, file) == size;
+            return fclose(file) == 0 && ok;
+        }
+
+        case Reference:
+        {
+            // Tone mapped bottom row first, so the bilateral base layer's
+            // blocks line up with the GPU's, into a buffer kept between frames
+            const float *pixels = (const float *) job.pixels.constData();
+            const ReferenceToneMapping &toneMapping = job.toneMapping;
+            int bytes = 3 * sizeof(float) * width * height;
+            if (m_mapped.size() < bytes)
+                m_mapped.resize(bytes);
+            float *mapped = (float *) m_mapped.data();
+            if (toneMapping.bilateral)
+            {
+                if (!tonemapDurandDorsey(pixels, width, height, toneMapping.radius, toneMapping.rangeSigma,
+                                         toneMapping.compression, toneMapping.exposure, mapped))
+                    return false;
+            }
+            else if (toneMapping.autoExposure)
+            {
+                float logAverage, maxLuminance;
+                tonemapLogAverage(pixels, width, height, &logAverage, &maxLuminance);
+                tonemapReinhardKey(pixels, width, height, toneMapping.exposure, logAverage, maxLuminance, mapped);
+            }
+            else
+            {
+                tonemapReinhard(pixels, width, height, toneMapping.exposure, mapped);
+            }
+
+            QImage image(width, height, QImage::Format_RGB32);
+            for (int y = 0; y < height; ++y)
+            {
+                const float *src = mapped + 3 * width * (height - 1 - y);
+                QRgb *dst = (QRgb *) image.scanLine(y);
+                for (int x = 0; x < width; ++x, src += 3)
+                    dst[x] = qRgb(unorm8(src[0]), unorm8(src[1]), unorm8(src[2]));
+            }
+            return image.save(job.path, "PNG");
+        }
+    }
+    return false;
+}
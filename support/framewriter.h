@@ -0,0 +1,101 @@
+#ifndef FRAMEWRITER_H
+#define FRAMEWRITER_H
+
+#include <QByteArray>
+#include <QMutex>
+#include <QQueue>
+#include <QString>
+#include <QThread>
+#include <QWaitCondition>
+#include <stdio.h>
+
+/**
+    How a reference frame is tone mapped on the CPU (see tonemap.h): the
+    operator and settings the renderer drew the frame with.
+ **/
+struct ReferenceToneMapping
+{
+    ReferenceToneMapping() : bilateral(false), autoExposure(true), exposure(0.5f),
+        radius(8), rangeSigma(0.4f), compression(0.5f) {}
+
+    bool bilateral;             // Durand-Dorsey instead of Reinhard
+    bool autoExposure;          // Reinhard scaled by the frame's own key
+    float exposure;
+    int radius;                 // of the bilateral filter, in pixels of the base layer
+    float rangeSigma;           // of the bilateral filter, in log10 luminance
+    float compression;          // contrast kept of the base layer
+};
+
+/**
+    Encodes and saves frames on its own thread, so the renderer only pays for
+    reading the pixels back.  Frames come in as glReadPixels left them, bottom
+    row first: 8-bit RGBA is saved as PNG or appended raw (top row first) to a
+    stream, float RGB is saved as Radiance RGBE (encoded over the thread pool
+    by rgbeEncode and written in one piece) or tone mapped on the CPU into a
+    reference PNG.  The stream is a file, or the input of a command (an
+    encoder) when it starts with '|'.
+
+    At most maxQueued frames wait at a time.  Beyond that the caller blocks
+    until one is written, which bounds the memory they take, or, with
+    setDropWhenFull(), the frame is dropped and counted instead.
+ **/
+class FrameWriter : public QThread
+{
+public:
+    FrameWriter(int maxQueued = 8);
+    ~FrameWriter();
+
+    // Each returns false if the frame was dropped
+    bool writePng(const QString &path, const QByteArray &rgba, int width, int height);
+    bool writeHdr(const QString &path, const QByteArray &rgb, int width, int height);
+    bool writeReference(const QString &path, const QByteArray &rgb, int width, int height,
+                        const ReferenceToneMapping &toneMapping);
+    bool writeRaw(const QByteArray &rgba, int width, int height);
+
+    // Raw frames go to the stream opened last, in the order they are queued
+    void openStream(const QString &target);
+    void closeStream();
+
+    // Writes whatever is queued and stops the thread
+    void finish();
+
+    void setDropWhenFull(bool drop);
+    int written() const;
+    int failed() const;
+    int dropped() const;
+
+protected:
+    void run();
+
+private:
+    enum Kind { Png, Rgbe, Reference, Raw, OpenStream, CloseStream };
+
+    struct Job
+    {
+        Kind kind;
+        QString path;                   // the file, or the stream to open
+        QByteArray pixels;
+        int width, height;
+        ReferenceToneMapping toneMapping;   // for a Reference
+    };
+
+    bool enqueue(const Job &job, bool droppable);
+    bool write(const Job &job);
+
+    QQueue<Job> m_jobs;
+    mutable QMutex m_mutex;
+    QWaitCondition m_queued;            // a job was queued, or the thread must stop
+    QWaitCondition m_taken;             // a job left the queue
+    int m_maxQueued;
+    bool m_dropWhenFull;
+    bool m_stop;
+    int m_written, m_failed, m_dropped;
+
+    // Only touched by the writer thread
+    FILE *m_stream;
+    bool m_pipe;
+    QByteArray m_encoded;               // the last RGBE file, reused for the next
+    QByteArray m_mapped;                // the last reference tone mapped, likewise
+};
+
+#endif // FRAMEWRITER_H
@@ -1,183 +1,318 @@
+#define GL_GLEXT_PROTOTYPES
 #include "resourceloader.h"
 #include <QGLFramebufferObject>
 #include <QGLShaderProgram>
+#include <QFileInfo>
 #include <QList>
 #include <QString>
+#include <QTime>
 #include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
 #include "glm.h"
-#include "rgbe/rgbe.h"
+#include "rgbeimage.h"
+#include "parallel.h"
+#include "pixelpack.h"
+#include "envfilter.h"
+#include "envcache.h"
 #include <iostream>
-/**
-  Loads the cube map into video memory.
 
-  @param files: a list of files containing the cube map images (should be length
-  six) in order
-  @return the assigned OpenGL id to the cube map
-**/
-GLuint ResourceLoader::loadCubeMap(char* filename)//QList<QFile *> files)
+// Where each cube map face sits in a vertical cross, in face widths.  Faces
+// are mirrored horizontally, except -Z, which hangs upside down at the bottom.
+struct CrossFace
 {
-    //Q_ASSERT(files.length() == 1);//For LDR: 6);
+    int column, row;
+    bool flipY;
+};
 
-    // Generate an ID
-    GLuint id;
-    glGenTextures(1, &id);
+static const CrossFace CROSS_FACES[6] =
+{
+    { 0, 1, false },                    // +X
+    { 2, 1, false },                    // -X
+    { 1, 0, false },                    // +Y
+    { 1, 2, false },                    // -Y
+    { 1, 1, false },                    // +Z
+    { 1, 3, true }                      // -Z
+};
 
-    // Bind the texture
-    glBindTexture(GL_TEXTURE_CUBE_MAP, id);
+// Whether loads report what they did
+static bool s_verbose = false;
 
-    // Load and build mipmaps for each image
-//    for (int i = 0; i < 6; ++i)
-//    {
-//        QImage image, texture;
-//        image.load(files[0]->fileName());
-//        image = image.mirrored(false, true);
-//        texture = QGLWidget::convertToGLFormat(image);
-//        texture = texture.scaledToWidth(1024, Qt::SmoothTransformation);
-//        glTexImage2D(GL_TEXTURE_CUBE_MAP_POSITIVE_X + i, 3, 3, texture.width(), texture.height(), 0, GL_RGBA,GL_UNSIGNED_BYTE, texture.bits());
-//        gluBuild2DMipmaps(GL_TEXTURE_CUBE_MAP_POSITIVE_X + i, 3, texture.width(), texture.height(), GL_RGBA, GL_UNSIGNED_BYTE, texture.bits());
-//    }
-
-    int height;
-    int width;
-    FILE *hdrfile = fopen(filename, "rb");
-    RGBE_ReadHeader(hdrfile, &width, &height, NULL);
-    //TODO: may want to make this data accessible elsewhere?? also memory delete...
-    float* hdrpix = new float[3*width*height];
-    RGBE_ReadPixels_RLE(hdrfile, hdrpix, width, height);
-    fclose(hdrfile);    
-//    std::cout<<"check first pixels (should be black): "<<hdrpix[0]<<" "<<hdrpix[1]<<" "<<hdrpix[2]<<std::endl;
-//    std::cout<<"check first row middle pixels (should be hdr color): "<<hdrpix[1152]<<" "<<hdrpix[1153]<<" "<<hdrpix[1154]<<std::endl;
-
-    //break up cross file into 6 cube faces - specific to Debevec cross box layout for hdr images
-    int face_width = int(float(width)/3.0);
-    int face_height = int(float(height)/4.0);
-    std::cout<<"face height and width: "<<face_height<<", "<<face_width<<std::endl;
-    float* posx = new float[3*face_width*face_height];
-    int ind = 0;
-    for(int y = face_height; y < 2*face_height; y++)
-    {
-        for(int x = face_width-1; x >= 0 ; x--)
-        {
-            posx[ind] = hdrpix[3*(y*width+x)];
-            posx[ind+1] = hdrpix[3*(y*width+x)+1];
-            posx[ind+2] = hdrpix[3*(y*width+x)+2];
-            ind = ind+3;
-        }
-    }
-//    std::cout<<"size and ind: "<<3*face_width*face_height<<", "<<ind<<std::endl;
-    glTexImage2D(GL_TEXTURE_CUBE_MAP_POSITIVE_X, 3, GL_RGBA16F, face_width, face_height, 0, GL_RGB,GL_FLOAT, posx);
-    gluBuild2DMipmaps(GL_TEXTURE_CUBE_MAP_POSITIVE_X, GL_RGBA16F, face_width, face_height, GL_RGB,GL_FLOAT, posx);
+// Mip levels of a radiance cube map, from a mirror at level 0 to fully rough
+// at the last, and the GGX samples taken for each of their texels
+static const int RADIANCE_LEVELS = 6;
+static const int RADIANCE_SAMPLES = 128;
 
-    float* negx = new float[3*face_width*face_height];
-    ind = 0;
-    for(int y = face_height; y < 2*face_height; y++)
+// A run of scanlines from one row of faces, on its way into their levels
+struct CrossChunk
+{
+    const RGBEimage *image;
+    int faceSize;
+    int first, count;                   // the scanlines
+    GLenum format;                      // GL_RGBA16F, GL_R11F_G11F_B10F or GL_RGB32F
+    int texelBytes;
+    char *faces[6];                     // rows for the faces in the chunk, 0 for the others
+    bool failed;
+};
+
+/**
+  Packs float RGB pixels into texels of the given format, or copies them
+  for GL_RGB32F.
+ **/
+static void packTexels(GLenum format, const float *rgb, int count, char *texels)
+{
+    if (format == GL_RGB32F)
+        memcpy(texels, rgb, 3 * sizeof(float) * count);
+    else if (format == GL_RGBA16F)
+        pixelpackHalf(rgb, count, (unsigned short *) texels);
+    else
+        pixelpackR11G11B10F(rgb, count, (unsigned *) texels);
+}
+
+/**
+  Decodes one scanline of a chunk, and packs and scatters it into its faces'
+  rows.
+ **/
+static void scatterCrossScanline(int index, void *arg)
+{
+    CrossChunk *chunk = (CrossChunk *) arg;
+    int size = chunk->faceSize;
+    float *scanline = (float *) malloc(3 * sizeof(float) * (chunk->image->width + size));
+    float *mirrored = scanline + 3 * chunk->image->width;
+    if (!rgbeDecodeScanlines(chunk->image, chunk->first + index, 1, scanline))
     {
-        for(int x = 3*face_width-1; x >= 2*face_width ; x--)
-        {
-            negx[ind] = hdrpix[3*(y*width+x)];
-            negx[ind+1] = hdrpix[3*(y*width+x)+1];
-            negx[ind+2] = hdrpix[3*(y*width+x)+2];
-            ind = ind+3;
-        }
+        chunk->failed = true;
+        free(scanline);
+        return;
     }
-    glTexImage2D(GL_TEXTURE_CUBE_MAP_POSITIVE_X+1, 3, GL_RGBA16F, face_width, face_height, 0, GL_RGB,GL_FLOAT, negx);
-    gluBuild2DMipmaps(GL_TEXTURE_CUBE_MAP_POSITIVE_X+1, GL_RGBA16F, face_width, face_height, GL_RGB,GL_FLOAT, negx);
-
-    float* posy = new float[3*face_width*face_height];
-    ind = 0;
-    for(int y = 0; y < face_height; y++)
+    for (int f = 0; f < 6; ++f)
     {
-        for(int x = 2*face_width-1; x >= face_width ; x--)
+        if (!chunk->faces[f])
+            continue;
+        const CrossFace &face = CROSS_FACES[f];
+        const float *src = scanline + 3 * size * face.column;
+        int row = face.flipY ? chunk->count - 1 - index : index;
+        if (!face.flipY)
         {
-            posy[ind] = hdrpix[3*(y*width+x)];
-            posy[ind+1] = hdrpix[3*(y*width+x)+1];
-            posy[ind+2] = hdrpix[3*(y*width+x)+2];
-            ind = ind+3;
+            for (int x = 0; x < size; ++x)
+            {
+                mirrored[3 * x + 0] = src[3 * (size - 1 - x) + 0];
+                mirrored[3 * x + 1] = src[3 * (size - 1 - x) + 1];
+                mirrored[3 * x + 2] = src[3 * (size - 1 - x) + 2];
+            }
+            src = mirrored;
         }
+        packTexels(chunk->format, src, size, chunk->faces[f] + chunk->texelBytes * size * row);
     }
+    free(scanline);
+}
 
-    glTexImage2D(GL_TEXTURE_CUBE_MAP_POSITIVE_X+2, 3, GL_RGBA16F, face_width, face_height, 0, GL_RGB,GL_FLOAT, posy);
-    gluBuild2DMipmaps(GL_TEXTURE_CUBE_MAP_POSITIVE_X+2, GL_RGBA16F, face_width, face_height, GL_RGB,GL_FLOAT, posy);
+/**
+  Decodes a run of scanlines from one row of faces across the thread pool,
+  and packs them into the rows of those faces.
+
+  @param faces: where the first of the scanlines goes in each face of the
+  row, 0 for the faces in other rows
+  @return false if the scanlines are corrupt
+ **/
+static bool decodeCrossRows(const RGBEimage *image, int size, GLenum format, int first, int count, char **faces)
+{
+    CrossChunk chunk;
+    chunk.image = image;
+    chunk.faceSize = size;
+    chunk.first = first;
+    chunk.count = count;
+    chunk.format = format;
+    GLenum pixelFormat, type;
+    ResourceLoader::cubeTexelFormat(format, pixelFormat, type, chunk.texelBytes);
+    for (int f = 0; f < 6; ++f)
+        chunk.faces[f] = faces[f];
+    chunk.failed = false;
+    parallelFor(count, scatterCrossScanline, &chunk);
+    return !chunk.failed;
+}
 
-    float* negy = new float[3*face_width*face_height];
-    ind = 0;
-    for(int y = 2*face_height; y < 3*face_height; y++)
+/**
+  Returns the face size of a vertical cross, 0 (after saying so) if the
+  image isn't one.
+ **/
+static int crossFaceSize(const char *filename, const RGBEimage *image)
+{
+    int size = image->width / 3;
+    if (size == 0 || 4 * size > image->height)
     {
-        for(int x = 2*face_width-1; x >= face_width ; x--)
-        {
-            negy[ind] = hdrpix[3*(y*width+x)];
-            negy[ind+1] = hdrpix[3*(y*width+x)+1];
-            negy[ind+2] = hdrpix[3*(y*width+x)+2];
-            ind = ind+3;
-        }
+        std::cout << filename << " is not a vertical cross (" << image->width << "x"
+                  << image->height << ")" << std::endl;
+        return 0;
     }
-    glTexImage2D(GL_TEXTURE_CUBE_MAP_POSITIVE_X+3, 3, GL_RGBA16F, face_width, face_height, 0, GL_RGB,GL_FLOAT, negy);
-    gluBuild2DMipmaps(GL_TEXTURE_CUBE_MAP_POSITIVE_X+3, GL_RGBA16F, face_width, face_height, GL_RGB,GL_FLOAT, negy);
+    return size;
+}
 
-    float* posz = new float[3*face_width*face_height];
-    ind = 0;
-    for(int y = face_height; y < 2*face_height; y++)
+void ResourceLoader::cubeTexelFormat(GLenum format, GLenum &pixelFormat, GLenum &type, int &bytes)
+{
+    if (format == GL_RGB32F)
     {
-        for(int x = 2*face_width-1; x >= face_width ; x--)
-        {
-            posz[ind] = hdrpix[3*(y*width+x)];
-            posz[ind+1] = hdrpix[3*(y*width+x)+1];
-            posz[ind+2] = hdrpix[3*(y*width+x)+2];
-            ind = ind+3;
-        }
+        pixelFormat = GL_RGB;
+        type = GL_FLOAT;
+        bytes = 12;
+        return;
     }
-    glTexImage2D(GL_TEXTURE_CUBE_MAP_POSITIVE_X+4, 3, GL_RGBA16F, face_width, face_height, 0, GL_RGB,GL_FLOAT, posz);
-    gluBuild2DMipmaps(GL_TEXTURE_CUBE_MAP_POSITIVE_X+4, GL_RGBA16F, face_width, face_height, GL_RGB,GL_FLOAT, posz);
+    bool half = format == GL_RGBA16F;
+    pixelFormat = half ? GL_RGBA : GL_RGB;
+    type = half ? GL_HALF_FLOAT : GL_UNSIGNED_INT_10F_11F_11F_REV;
+    bytes = half ? 8 : 4;
+}
 
-    float* negz = new float[3*face_width*face_height];
-    ind = 0;
-    for(int y = 4*face_height-1; y >= 3*face_height; y--)
+/**
+  Creates a cube map with immutable storage for its mip levels and the
+  skybox's sampling parameters.  The new texture is left bound.
+
+  @param levels: the number of mip levels, 0 for a full chain
+ **/
+GLuint ResourceLoader::newCubeMap(GLenum format, int size, int levels)
+{
+    // Generate an ID
+    GLuint id;
+    glGenTextures(1, &id);
+
+    // Bind the texture
+    glBindTexture(GL_TEXTURE_CUBE_MAP, id);
+    if (levels <= 0)
     {
-        for(int x = face_width; x < 2*face_width ; x++)
-        {
-            negz[ind] = hdrpix[3*(y*width+x)];
-            negz[ind+1] = hdrpix[3*(y*width+x)+1];
-            negz[ind+2] = hdrpix[3*(y*width+x)+2];
-            ind = ind+3;
-        }
+        levels = 1;
+        while (size >> levels)
+            levels++;
     }
-    glTexImage2D(GL_TEXTURE_CUBE_MAP_POSITIVE_X+5, 3, GL_RGBA16F, face_width, face_height, 0, GL_RGB,GL_FLOAT, negz);
-    gluBuild2DMipmaps(GL_TEXTURE_CUBE_MAP_POSITIVE_X+5, GL_RGBA16F, face_width, face_height, GL_RGB,GL_FLOAT, negz);
-
+    glTexStorage2D(GL_TEXTURE_CUBE_MAP, levels, format, size, size);
 
     glTexParameterf(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
     glTexParameterf(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
     glTexParameterf(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_R, GL_CLAMP_TO_EDGE);
 
-    // Set filter when pixel occupies more than one texture element
-    glTexParameterf(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MIN_FILTER, GL_NEAREST_MIPMAP_NEAREST);
+    // Set filter when pixel occupies more than one texture element, blending
+    // mip levels so a roughness between two prefiltered ones gets a mix of them
+    glTexParameterf(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
     // Set filter when pixel smaller than one texture element
     glTexParameterf(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    return id;
+}
 
-    // Unbind the texture
-    glBindTexture(GL_TEXTURE_CUBE_MAP, 0);
+/**
+  Decodes a vertical cross .hdr image into six packed faces, with a radiance
+  mip chain and the diffuse light's SH9 coefficients.  Only touches memory,
+  so it can run on any thread.
 
-    std::cout<<"skybox texture : "<<id<<std::endl;
+  Level 0 is the image itself and the levels below it are prefiltered with
+  GGX for increasing roughness (see envfilter.h).  The result is kept in a
+  cache next to the .hdr (same name, .envc extension, see envcache.h), which
+  later calls map straight back in until the image changes, so an
+  environment that was seen before costs neither decoding nor filtering.
 
-    delete posx;
-    delete posy;
-    delete posz;
-    delete negx;
-    delete negy;
-    delete negz;
-    delete hdrpix;
-    return id;
+  @return false if the file can't be read
+ **/
+bool ResourceLoader::decodeCubeCross(const char* filename, GLenum format, CubeFaces &faces)
+{
+    faces = CubeFaces();
+    faces.format = format;
+    QFileInfo info(filename);
+    QByteArray cachePath = (info.path() + "/" + info.completeBaseName() + ".envc").toLocal8Bit();
+    ENVcache *cache = envcacheOpen(cachePath.constData(), filename, format, RADIANCE_LEVELS, RADIANCE_SAMPLES);
+    if (cache)
+    {
+        faces.cache = QSharedPointer<ENVcache>(cache, envcacheClose);
+        for (int f = 0; f < 6; ++f)
+            faces.faces[f] = QByteArray::fromRawData(cache->faces[f], cache->facesize);
+        faces.size = cache->size;
+        faces.levels = cache->levels;
+        memcpy(faces.irradiance, cache->sh, sizeof(faces.irradiance));
+        return true;
+    }
+
+    RGBEimage *image = rgbeOpen(filename);
+    if (!image)
+        return false;
+    int size = crossFaceSize(filename, image);
+    ENVcube *cube = size > 0 ? envfilterNew(size, RADIANCE_LEVELS) : 0;
+
+    bool ok = cube != 0;
+    for (int row = 0; row < 4 && ok; ++row)
+    {
+        char *rows[6];
+        for (int f = 0; f < 6; ++f)
+            rows[f] = CROSS_FACES[f].row == row ? (char *) envfilterFace(cube, 0, f) : 0;
+        ok = decodeCrossRows(image, size, GL_RGB32F, row * size, size, rows);
+    }
+    rgbeClose(image);
+    if (!ok)
+    {
+        envfilterFree(cube);
+        return false;
+    }
+    envfilterPrefilterGGX(cube, RADIANCE_SAMPLES);
+    envfilterIrradianceSH9(cube, faces.irradiance);
+
+    // Each face holds its levels one after another
+    GLenum pixelFormat, type;
+    int texelBytes, texels = 0;
+    cubeTexelFormat(format, pixelFormat, type, texelBytes);
+    for (int level = 0; level < cube->levels; ++level)
+        texels += envfilterLevelSize(cube, level) * envfilterLevelSize(cube, level);
+    const char *packed[6];
+    for (int f = 0; f < 6; ++f)
+    {
+        faces.faces[f].resize(texelBytes * texels);
+        char *texel = faces.faces[f].data();
+        packed[f] = texel;
+        for (int level = 0; level < cube->levels; ++level)
+        {
+            int count = envfilterLevelSize(cube, level) * envfilterLevelSize(cube, level);
+            packTexels(format, envfilterFace(cube, level, f), count, texel);
+            texel += texelBytes * count;
+        }
+    }
+    faces.size = size;
+    faces.levels = cube->levels;
+    envfilterFree(cube);
+    envcacheWrite(cachePath.constData(), filename, format, faces.size, faces.levels, RADIANCE_SAMPLES,
+                  faces.irradiance, packed, texelBytes * texels);
+    return true;
+}
+
+void ResourceLoader::setVerbose(bool verbose)
+{
+    s_verbose = verbose;
 }
 
 /**
     Loads an OBJ models from a file
+
+    The unitized model is kept in a binary cache next to the .obj (same name,
+    .glmb extension) which is mapped straight back in on later runs, as long
+    as the .obj hasn't changed since.
   **/
 Model ResourceLoader::loadObjModel(QString filePath)
 {
     Model m;
-    m.model = glmReadOBJ(filePath.toStdString().c_str());
-    glmUnitize(m.model);
-    m.idx = glmList(m.model, GLM_SMOOTH);
+    QFileInfo info(filePath);
+    QString cachePath = info.path() + "/" + info.completeBaseName() + ".glmb";
+    std::string path = filePath.toStdString(), cache = cachePath.toStdString();
+    QTime timer;
+    timer.start();
+    m.model = glmReadCache(cache.c_str(), path.c_str());
+    bool mapped = m.model != 0;
+    if (!mapped) {
+        m.model = glmReadOBJParallel(path.c_str(), 0);
+        glmUnitize(m.model);
+        glmWriteCache(m.model, cache.c_str(), path.c_str());
+    }
+    m.mesh = glmBuildMesh(m.model, GLM_SMOOTH);
+    if (s_verbose) {
+        std::cout << (mapped ? "mapped " + cache : "parsed " + path) << " (" << m.model->numvertices
+                  << " vertices, " << m.model->numtriangles << " triangles) in " << timer.elapsed() << " ms: "
+                  << m.mesh->numvertices << " unique vertices for " << m.mesh->numindices << " corners ("
+                  << (float)m.mesh->numindices / m.mesh->numvertices << "x reuse, "
+                  << (m.mesh->indextype == GL_UNSIGNED_SHORT ? 16 : 32) << "-bit indices)" << std::endl;
+    }
     return m;
 }
 
@@ -1,9 +1,12 @@
 #ifndef RESOURCELOADER_H
 #define RESOURCELOADER_H
 
+#include <QByteArray>
 #include <QFile>
 #include <QGLShaderProgram>
+#include <QSharedPointer>
 #include "glm.h"
+#include "envcache.h"
 
 /**
     A simple model struct
@@ -11,7 +14,24 @@
 struct Model
 {
     GLMmodel *model;
-    GLuint idx;
+    GLMmesh *mesh;
+};
+
+/**
+    The six faces of a radiance cube map, packed ready for upload, and the
+    spherical harmonics of its diffuse light.  Faces read from the cache
+    point into its mapping, which stays open while any copy of them is around.
+ **/
+struct CubeFaces
+{
+    CubeFaces() : format(GL_R11F_G11F_B10F), size(0), levels(0) {}
+
+    GLenum format;              // GL_R11F_G11F_B10F or GL_RGBA16F
+    int size;                   // width and height of a face, 0 if nothing was decoded
+    int levels;                 // mip levels, level i prefiltered for roughness i / (levels - 1)
+    QByteArray faces[6];        // +X, -X, +Y, -Y, +Z, -Z, each level after the last, top row first
+    float irradiance[27];       // SH9 coefficients of the diffuse light, RGB (see envfilter.h)
+    QSharedPointer<ENVcache> cache; // the cache entry the faces are mapped from, if any
 };
 
 /**
@@ -21,6 +41,9 @@ struct Model
    **/
 namespace ResourceLoader
 {
+    // Reports where each model came from, its load time and its vertex reuse (off by default)
+    void setVerbose(bool verbose);
+
     // Returns the model
     Model loadObjModel(QString filePath);
 
@@ -32,8 +55,14 @@ namespace ResourceLoader
     QGLShaderProgram * newFragShaderProgram(const QGLContext *context, QString fragShader);
     QGLShaderProgram * newShaderProgram(const QGLContext *context, QString vertShader, QString fragShader);
 
-    // Returns the cubeMap ID
-    GLuint loadCubeMap(char* filename);//(QList<QFile *> files);
+    // Decodes a vertical cross .hdr into packed, prefiltered faces, without touching OpenGL
+    bool decodeCubeCross(const char* filename, GLenum format, CubeFaces &faces);
+
+    // Creates and binds a cube map with immutable storage for its mip levels (0 for a full chain)
+    GLuint newCubeMap(GLenum format, int size, int levels = 0);
+
+    // The pixel format, type and size in bytes of the texels of a cube map format
+    void cubeTexelFormat(GLenum format, GLenum &pixelFormat, GLenum &type, int &bytes);
 
 }
 